@@ -1,13 +1,135 @@
 // Variables globales
-let currentSequenceIndex = 0;
+let currentSequenceIndex = -1;
+let teachSequenceIndex = -1;
 let movements = [];
 
+// La lista local y la secuencia del ESP32 coinciden mientras sequenceSynced
+// sea true: cada edición se replica con una sola petición (If-Match con la
+// versión). Si algo falla se descarta y Ejecutar la vuelve a crear.
+let sequenceSynced = false;
+let sequenceVersion = 0;
+let syncQueue = Promise.resolve();
+let editingIndex = -1;
+
 // Valores actuales de los controles
 let currentStepperDist = 0;
 let currentStepperSpeed = 50;
 let currentServoAngle = 90;
 let currentServoSpeed = 50;
 
+// ========== Canal WebSocket binario ==========
+// Formato definido en include/ControlProtocol.h (little-endian, 12 bytes)
+
+const OP_JOG = 0x01;
+const OP_GOTO = 0x02;
+const OP_STOP = 0x03;
+const OP_SHUTTER = 0x04;
+const OP_GO = 0x05;
+const OP_ACK = 0x80;
+
+const FLAG_RAIL = 0x01;
+const FLAG_PAN = 0x02;
+const FLAG_COALESCE = 0x80;
+
+const STATUS_OK = 0;
+const STATUS_BUSY = 1;
+const STATUS_TEXT = ['OK', 'Ocupado', 'Trama inválida', 'Comando desconocido',
+                     'No disponible', 'Error'];
+
+const JOG_RATE_MS = 20;      // 50 Hz
+const JOG_STEP_MM = 1;       // mm por tick a fondo de escala
+const JOG_STEP_DEG = 1;      // grados por tick a fondo de escala
+const ACK_TIMEOUT_MS = 1000;
+
+let ws = null;
+let nextCommandId = 1;
+const pendingAcks = new Map();
+let lastAck = null;
+
+function connectControlSocket() {
+  ws = new WebSocket(`ws://${location.host}/ws`);
+  ws.binaryType = 'arraybuffer';
+  
+  ws.onmessage = (event) => {
+    const view = new DataView(event.data);
+    if(view.byteLength !== 12 || view.getUint8(0) !== OP_ACK) return;
+    
+    const ack = {
+      status: view.getUint8(1),
+      id: view.getUint16(2, true),
+      positionMm: view.getInt32(4, true) / 1000,
+      angle: view.getInt16(8, true),
+      state: view.getUint8(10),
+      opcode: view.getUint8(11)
+    };
+    lastAck = ack;
+    
+    const pending = pendingAcks.get(ack.id);
+    if(pending) {
+      clearTimeout(pending.timer);
+      pendingAcks.delete(ack.id);
+      pending.resolve(ack);
+    }
+  };
+  
+  ws.onclose = () => {
+    pendingAcks.forEach(p => {
+      clearTimeout(p.timer);
+      p.reject(new Error('WebSocket cerrado'));
+    });
+    pendingAcks.clear();
+    setTimeout(connectControlSocket, 2000);
+  };
+}
+
+function controlSocketReady() {
+  return ws !== null && ws.readyState === WebSocket.OPEN;
+}
+
+// Envía una trama y devuelve una promesa que se resuelve con el ACK
+function sendFrame(opcode, flags, fillPayload) {
+  const id = nextCommandId;
+  nextCommandId = (nextCommandId + 1) & 0xFFFF;
+  
+  const buffer = new ArrayBuffer(fillPayload ? 12 : 4);
+  const view = new DataView(buffer);
+  view.setUint8(0, opcode);
+  view.setUint8(1, flags);
+  view.setUint16(2, id, true);
+  if(fillPayload) fillPayload(view);
+  
+  return new Promise((resolve, reject) => {
+    const timer = setTimeout(() => {
+      pendingAcks.delete(id);
+      reject(new Error('Sin respuesta'));
+    }, ACK_TIMEOUT_MS);
+    pendingAcks.set(id, {resolve, reject, timer});
+    ws.send(buffer);
+  });
+}
+
+function sendJog(flags, distanceMm, angleDelta, speed, angleSpeed) {
+  return sendFrame(OP_JOG, flags, view => {
+    view.setInt32(4, Math.round(distanceMm * 1000), true);
+    view.setInt16(8, Math.round(angleDelta), true);
+    view.setUint8(10, speed);
+    view.setUint8(11, angleSpeed);
+  });
+}
+
+function sendGoto(flags, positionMm, angle, speed, angleSpeed) {
+  return sendFrame(OP_GOTO, flags, view => {
+    view.setInt32(4, Math.round(positionMm * 1000), true);
+    view.setInt16(8, angle, true);
+    view.setUint8(10, speed);
+    view.setUint8(11, angleSpeed);
+  });
+}
+
+function ackToResult(ack) {
+  return {success: ack.status === STATUS_OK, message: STATUS_TEXT[ack.status]};
+}
+
 function updateStatus() {
   fetch('/status')
     .then(response => response.json())
@@ -34,8 +156,11 @@ function takePhoto() {
   msg.style.backgroundColor = '#e7f3ff';
   msg.style.color = '#667eea';
   
-  fetch('/photo')
-    .then(response => response.json())
+  const request = controlSocketReady()
+    ? sendFrame(OP_SHUTTER, 0).then(ackToResult)
+    : fetch('/photo').then(response => response.json());
+  
+  request
     .then(data => {
       if(data.success) {
         msg.textContent = '✅ Foto tomada correctamente';
@@ -86,8 +211,12 @@ function updateServoSpeed(value) {
 
 function moveStepperManual() {
   showMessage('🚂 Moviendo stepper...', 'info');
-  fetch(`/stepper?distance=${currentStepperDist}&speed=${currentStepperSpeed}`)
-    .then(response => response.json())
+  const request = controlSocketReady()
+    ? sendJog(FLAG_RAIL, currentStepperDist, 0, currentStepperSpeed, 0).then(ackToResult)
+    : fetch(`/stepper?distance=${currentStepperDist}&speed=${currentStepperSpeed}`)
+        .then(response => response.json());
+  
+  request
     .then(data => {
       if(data.success) {
         showMessage('✅ Stepper movido correctamente', 'success');
@@ -100,8 +229,12 @@ function moveStepperManual() {
 
 function moveServoManual() {
   showMessage('📐 Moviendo servo...', 'info');
-  fetch(`/servo?angle=${currentServoAngle}&speed=${currentServoSpeed}`)
-    .then(response => response.json())
+  const request = controlSocketReady()
+    ? sendGoto(FLAG_PAN, 0, currentServoAngle, 0, currentServoSpeed).then(ackToResult)
+    : fetch(`/servo?angle=${currentServoAngle}&speed=${currentServoSpeed}`)
+        .then(response => response.json());
+  
+  request
     .then(data => {
       if(data.success) {
         showMessage('✅ Servo movido correctamente', 'success');
@@ -126,30 +259,248 @@ function zeroStepper() {
     .catch(err => showMessage('❌ Error de conexión', 'error'));
 }
 
+// ========== Compensación de juego ==========
+
+function showBacklash(data) {
+  document.getElementById('backlashMm').value = data.stepperMm;
+  document.getElementById('backlashDeg').value = data.servoDeg;
+  const status = document.getElementById('backlashStatus');
+  const cal = data.calibration;
+  if(cal.running) {
+    status.textContent = '📏 Calibrando...';
+  } else if(cal.error) {
+    status.textContent = '❌ ' + cal.error;
+  } else if(cal.valid) {
+    status.textContent = `Medido: ${cal.backlashSteps} pasos (dispersión ${cal.spreadSteps}) - actual ${data.stepperSteps} pasos`;
+  } else {
+    status.textContent = `Actual: ${data.stepperSteps} pasos, servo ${data.servoDeg}°`;
+  }
+}
+
+function loadBacklash() {
+  fetch('/backlash/config')
+    .then(response => response.json())
+    .then(showBacklash)
+    .catch(() => {});
+}
+
+function saveBacklash() {
+  const mm = document.getElementById('backlashMm').value;
+  const deg = document.getElementById('backlashDeg').value;
+  fetch(`/backlash/config?stepperMm=${mm}&servoDeg=${deg}&save=1`)
+    .then(response => response.json())
+    .then(data => {
+      showBacklash(data);
+      showMessage('✅ Juego guardado', 'success');
+    })
+    .catch(err => showMessage('❌ Error de conexión', 'error'));
+}
+
+// Al terminar aplica y guarda la medición
+function waitBacklashCalibration() {
+  fetch('/backlash/config')
+    .then(response => response.json())
+    .then(data => {
+      showBacklash(data);
+      if(data.calibration.running) {
+        setTimeout(waitBacklashCalibration, 1000);
+      } else if(data.calibration.valid) {
+        fetch('/backlash/config?apply=1&save=1')
+          .then(response => response.json())
+          .then(showBacklash);
+        showMessage('✅ Juego calibrado y guardado', 'success');
+      } else {
+        showMessage('❌ Calibración fallida', 'error');
+      }
+    })
+    .catch(() => {});
+}
+
+function calibrateBacklash() {
+  fetch('/backlash/calibrate', {method: 'POST'})
+    .then(response => response.json())
+    .then(data => {
+      if(!data.success) throw new Error(data.message || 'No se pudo calibrar');
+      showMessage('📏 Calibrando: el carro va al final de carrera 1', 'info');
+      setTimeout(waitBacklashCalibration, 1000);
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// ========== Jog continuo (botones y mando) ==========
+
+let jogRail = 0;    // -1..1
+let jogPan = 0;     // -1..1
+let jogTimer = null;
+let gamepadActive = false;
+
+function jogTick() {
+  if(!controlSocketReady()) return;
+  
+  let rail = jogRail;
+  let pan = jogPan;
+  
+  // El mando tiene prioridad sobre los botones si está en uso
+  const pads = navigator.getGamepads ? navigator.getGamepads() : [];
+  for(const pad of pads) {
+    if(!pad) continue;
+    const deadzone = v => Math.abs(v) < 0.15 ? 0 : v;
+    const padRail = deadzone(pad.axes[0] || 0);
+    const padPan = deadzone(pad.axes[2] || 0);
+    if(padRail !== 0 || padPan !== 0) {
+      rail = padRail;
+      pan = padPan;
+      gamepadActive = true;
+    } else if(gamepadActive) {
+      gamepadActive = false;
+      sendFrame(OP_STOP, 0).catch(() => {});
+    }
+    break;
+  }
+  
+  if(rail === 0 && pan === 0) return;
+  
+  let flags = FLAG_COALESCE;
+  if(rail !== 0) flags |= FLAG_RAIL;
+  if(pan !== 0) flags |= FLAG_PAN;
+  
+  // BUSY es esperable a 50 Hz: el siguiente tick reintenta
+  sendJog(flags, rail * JOG_STEP_MM, pan * JOG_STEP_DEG,
+          currentStepperSpeed, currentServoSpeed).catch(() => {});
+}
+
+function startJog(rail, pan) {
+  jogRail = rail;
+  jogPan = pan;
+}
+
+function stopJog() {
+  if(jogRail === 0 && jogPan === 0) return;
+  jogRail = 0;
+  jogPan = 0;
+  if(controlSocketReady()) {
+    sendFrame(OP_STOP, 0).catch(() => {});
+  }
+}
+
 // ========== Programación de Secuencias ==========
 
-function addMovement() {
-  const distance = parseFloat(document.getElementById('seqDistance').value);
-  const speed = parseInt(document.getElementById('seqSpeed').value);
-  const angle = parseInt(document.getElementById('seqAngle').value);
-  const angleSpeed = parseInt(document.getElementById('seqAngleSpeed').value);
-  const pause = parseInt(document.getElementById('seqPause').value);
-  const simultaneous = document.getElementById('seqSimul').checked;
-  
-  const movement = {
-    distance: distance,
-    speed: speed,
-    angle: angle,
-    angleSpeed: angleSpeed,
-    pause: pause,
-    simultaneous: simultaneous
+function readMovementForm() {
+  return {
+    distance: parseFloat(document.getElementById('seqDistance').value),
+    speed: parseInt(document.getElementById('seqSpeed').value),
+    angle: parseInt(document.getElementById('seqAngle').value),
+    angleSpeed: parseInt(document.getElementById('seqAngleSpeed').value),
+    pause: parseInt(document.getElementById('seqPause').value),
+    simultaneous: document.getElementById('seqSimul').checked
   };
+}
+
+function movementParams(mov) {
+  return {
+    distance: mov.distance,
+    speed: mov.speed,
+    angle: mov.angle,
+    angleSpeed: mov.angleSpeed,
+    simultaneous: mov.simultaneous,
+    pause: mov.pause
+  };
+}
+
+// Replica una edición en la secuencia del ESP32. Van en cola para que cada
+// una lleve la versión que dejó la anterior.
+function syncEdit(path, params) {
+  if(!sequenceSynced) return;
+  syncQueue = syncQueue.then(() => {
+    if(!sequenceSynced) return;
+    const body = new URLSearchParams(Object.assign({seq: currentSequenceIndex}, params));
+    return fetch(path, {
+      method: 'POST',
+      headers: {
+        'Content-Type': 'application/x-www-form-urlencoded',
+        'If-Match': `"${sequenceVersion}"`
+      },
+      body: body.toString()
+    })
+    .then(response => response.json())
+    .then(data => {
+      if(data.success) {
+        sequenceVersion = data.version;
+      } else {
+        sequenceSynced = false;
+      }
+    })
+    .catch(() => { sequenceSynced = false; });
+  });
+}
+
+function addMovement() {
+  const movement = readMovementForm();
+  
+  if(editingIndex >= 0) {
+    const index = editingIndex;
+    movements[index] = movement;
+    editingIndex = -1;
+    document.getElementById('seqAddButton').textContent = '➕ Agregar Movimiento';
+    updateMovementList();
+    syncEdit('/sequence/update', Object.assign({index: index}, movementParams(movement)));
+    showMessage('✅ Movimiento actualizado', 'success');
+    return;
+  }
   
   movements.push(movement);
   updateMovementList();
+  syncEdit('/sequence/insert', Object.assign({index: movements.length - 1}, movementParams(movement)));
   showMessage('✅ Movimiento agregado', 'success');
 }
 
+// Carga el movimiento en el formulario; el botón de agregar guarda el cambio
+function editMovement(index) {
+  const mov = movements[index];
+  document.getElementById('seqDistance').value = mov.distance;
+  document.getElementById('seqSpeed').value = mov.speed;
+  document.getElementById('seqAngle').value = mov.angle;
+  document.getElementById('seqAngleSpeed').value = mov.angleSpeed;
+  document.getElementById('seqPause').value = mov.pause;
+  document.getElementById('seqSimul').checked = mov.simultaneous;
+  editingIndex = index;
+  document.getElementById('seqAddButton').textContent = `💾 Guardar #${index + 1}`;
+  updateMovementList();
+}
+
+function moveMovement(from, to) {
+  if(to < 0 || to >= movements.length) return;
+  const [mov] = movements.splice(from, 1);
+  movements.splice(to, 0, mov);
+  if(editingIndex === from) editingIndex = to;
+  else if(editingIndex === to) editingIndex = from;
+  updateMovementList();
+  syncEdit('/sequence/move', {from: from, to: to});
+}
+
+function removeMovement(index) {
+  movements.splice(index, 1);
+  if(editingIndex === index) {
+    editingIndex = -1;
+    document.getElementById('seqAddButton').textContent = '➕ Agregar Movimiento';
+  } else if(editingIndex > index) {
+    editingIndex--;
+  }
+  updateMovementList();
+  syncEdit('/sequence/remove', {index: index});
+}
+
+function repeatParams() {
+  return {
+    repeat: parseInt(document.getElementById('seqRepeat').value) || 1,
+    loop: document.getElementById('seqLoop').checked
+  };
+}
+
+function updateRepeat() {
+  syncEdit('/sequence/options', repeatParams());
+}
+
 function updateMovementList() {
   const listDiv = document.getElementById('movementList');
   const countSpan = document.getElementById('movCount');
@@ -164,7 +515,7 @@ function updateMovementList() {
   listDiv.innerHTML = '';
   movements.forEach((mov, index) => {
     const item = document.createElement('div');
-    item.className = 'movement-item';
+    item.className = 'movement-item' + (index === editingIndex ? ' editing' : '');
     item.innerHTML = `
       <div class="movement-info">
         <strong>#${index + 1}</strong> 
@@ -173,6 +524,12 @@ function updateMovementList() {
         ${mov.simultaneous ? '<span class="badge">⚡ Simul.</span>' : ''}
         ${mov.pause > 0 ? `<span class="badge">⏸ ${mov.pause}ms</span>` : ''}
       </div>
+      <div class="movement-actions">
+        <button title="Editar" onclick="editMovement(${index})">✏️</button>
+        <button title="Subir" onclick="moveMovement(${index}, ${index - 1})">▲</button>
+        <button title="Bajar" onclick="moveMovement(${index}, ${index + 1})">▼</button>
+        <button title="Quitar" onclick="removeMovement(${index})">✕</button>
+      </div>
     `;
     listDiv.appendChild(item);
   });
@@ -181,62 +538,426 @@ function updateMovementList() {
 function clearSequence() {
   if(confirm('¿Limpiar toda la secuencia?')) {
     movements = [];
+    editingIndex = -1;
+    document.getElementById('seqAddButton').textContent = '➕ Agregar Movimiento';
+    sequenceSynced = false;
     updateMovementList();
     showMessage('🗑️ Secuencia limpiada', 'info');
   }
 }
 
-function executeSequence() {
+// Libera la secuencia temporal anterior para no agotar el pool del ESP32
+function releaseTempSequence() {
+  sequenceSynced = false;
+  if(currentSequenceIndex < 0) return Promise.resolve();
+  const index = currentSequenceIndex;
+  currentSequenceIndex = -1;
+  return fetch('/sequence/delete', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: `index=${index}`
+  }).catch(() => {});
+}
+
+// Crea la secuencia con espacio justo para todos los movimientos y la carga
+function uploadSequence() {
+  return releaseTempSequence()
+  .then(() => fetch('/sequence/create', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: `name=TempSequence&capacity=${movements.length}`
+  }))
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error('Error creando secuencia');
+    
+    currentSequenceIndex = data.index;
+    
+    // Los movimientos van en orden: la posición en la secuencia es la de la lista
+    return movements.reduce((chain, mov) => chain.then(() => {
+      const params = new URLSearchParams(Object.assign({seq: currentSequenceIndex}, movementParams(mov)));
+      return fetch('/sequence/add', {
+        method: 'POST',
+        headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+        body: params.toString()
+      });
+    }), Promise.resolve());
+  })
+  .then(() => fetch('/sequence/options', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: new URLSearchParams(Object.assign({seq: currentSequenceIndex}, repeatParams())).toString()
+  }))
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Error configurando secuencia');
+    sequenceVersion = data.version;
+    sequenceSynced = true;
+  });
+}
+
+// arm = true: deja la secuencia en la pose inicial esperando el go
+function executeSequence(arm = false) {
   if(movements.length === 0) {
     showMessage('⚠️ No hay movimientos para ejecutar', 'error');
     return;
   }
   
-  showMessage('🎬 Creando y ejecutando secuencia...', 'info');
+  // Si la secuencia del ESP32 sigue al día con la lista, no hace falta
+  // volver a cargarla
+  if(sequenceSynced) {
+    showMessage(arm ? '🎯 Armando secuencia...' : '🎬 Ejecutando secuencia...', 'info');
+  } else {
+    showMessage(arm ? '🎯 Creando y armando secuencia...' : '🎬 Creando y ejecutando secuencia...', 'info');
+  }
   
-  // Crear secuencia
-  fetch('/sequence/create', {
+  syncQueue
+  .then(() => sequenceSynced ? null : uploadSequence())
+  .then(() => {
+    // Ejecutar (o armar) secuencia en el sentido elegido
+    const mode = document.getElementById('seqMode').value;
+    return fetch(`/sequence/${arm ? 'arm' : 'execute'}?index=${currentSequenceIndex}&mode=${mode}`);
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(data.success) {
+      showMessage(arm ? '🟢 Secuencia armada: pulsa Go' : '▶️ Secuencia ejecutándose...', 'success');
+    } else {
+      showMessage('❌ ' + (data.message || 'Error ejecutando secuencia'), 'error');
+    }
+  })
+  .catch(err => {
+    console.error(err);
+    showMessage('❌ Error: ' + err.message, 'error');
+  });
+}
+
+// Por WebSocket si está abierto: evita el handshake HTTP en el disparo
+function goSequence() {
+  const request = controlSocketReady()
+    ? sendFrame(OP_GO, 0).then(ackToResult)
+    : fetch('/sequence/go').then(response => response.json());
+  
+  request
+    .then(data => {
+      if(data.success) {
+        showMessage('🚀 Go', 'success');
+      } else {
+        showMessage('⚠️ No hay secuencia armada', 'error');
+      }
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// Vuelta rápida a la pose donde arrancó la última toma
+function rapidReturn() {
+  fetch('/sequence/return')
+    .then(response => response.json())
+    .then(data => {
+      if(data.success) {
+        showMessage(`⏪ Volviendo al inicio (~${(data.etaMs / 1000).toFixed(1)} s)`, 'success');
+      } else {
+        showMessage('⚠️ ' + (data.message || 'No se puede volver al inicio'), 'error');
+      }
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// Override de avance: se puede mover con la secuencia en marcha
+function updateFeedLabel(value) {
+  document.getElementById('feedValue').textContent = value + '%';
+}
+
+function setFeedOverride(value) {
+  fetch(`/sequence/feed?percent=${value}`)
+    .then(response => response.json())
+    .then(data => {
+      if(data.success) {
+        showMessage(`🎚️ Velocidad global: ${data.feed}%`, 'success');
+      } else {
+        showMessage('⚠️ ' + (data.message || 'Avance rechazado'), 'error');
+        // Volver al valor vigente
+        return fetch('/sequence/feed')
+          .then(response => response.json())
+          .then(current => {
+            document.getElementById('feedOverride').value = current.feed;
+            updateFeedLabel(current.feed);
+          });
+      }
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// ========== Trayectoria con puntos clave ==========
+
+// Una capa por línea: eje, forma, amplitud, periodo s, fase [, inicio s,
+// duración s, fundido s]. Devuelve null si alguna línea es inválida.
+function parseMotionLayers() {
+  const layers = [];
+  for(const line of document.getElementById('motionLayers').value.split('\n')) {
+    if(line.trim() === '') continue;
+    const parts = line.split(',').map(v => v.trim());
+    const numbers = parts.slice(2).map(v => parseFloat(v));
+    if(!['rail', 'pan'].includes(parts[0]) || !['sine', 'triangle', 'curve'].includes(parts[1]) ||
+       numbers.length < 3 || numbers.length > 6 || numbers.some(isNaN)) {
+      showMessage('❌ Capa inválida: ' + line, 'error');
+      return null;
+    }
+    // Periodo, inicio, duración y fundido van en ms
+    const fields = numbers.map((v, i) => i === 0 || i === 2 ? v : Math.round(v * 1000));
+    layers.push([parts[0], parts[1], ...fields].join(':'));
+  }
+  return layers;
+}
+
+function executeKeyframes() {
+  const lines = document.getElementById('keyframes').value.split('\n');
+  const keys = [];
+  
+  for(const line of lines) {
+    if(line.trim() === '') continue;
+    const parts = line.split(',').map(v => parseFloat(v));
+    if(parts.length !== 3 || parts.some(isNaN)) {
+      showMessage('❌ Línea inválida: ' + line, 'error');
+      return;
+    }
+    keys.push(`${Math.round(parts[0] * 1000)},${parts[1]},${parts[2]}`);
+  }
+  
+  if(keys.length < 2) {
+    showMessage('⚠️ Se necesitan al menos 2 puntos clave', 'error');
+    return;
+  }
+  
+  const layers = parseMotionLayers();
+  if(layers === null) return;
+  
+  showMessage('🎞️ Cargando trayectoria...', 'info');
+  
+  releaseTempSequence()
+  .then(() => fetch('/sequence/create', {
     method: 'POST',
     headers: {'Content-Type': 'application/x-www-form-urlencoded'},
-    body: 'name=TempSequence'
-  })
+    body: 'name=TempPath&type=keyframes'
+  }))
   .then(response => response.json())
   .then(data => {
     if(!data.success) throw new Error('Error creando secuencia');
+    currentSequenceIndex = data.index;
+    
+    const params = new URLSearchParams({
+      seq: currentSequenceIndex,
+      interp: document.getElementById('keyframeInterp').value,
+      keys: keys.join(';')
+    });
+    return fetch('/sequence/keyframes', {
+      method: 'POST',
+      headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+      body: params.toString()
+    });
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error('Puntos clave inválidos');
+    if(layers.length === 0) return data;
     
+    const params = new URLSearchParams({ seq: currentSequenceIndex, layers: layers.join(';') });
+    return fetch('/sequence/layers', {
+      method: 'POST',
+      headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+      body: params.toString()
+    }).then(response => response.json());
+  })
+  .then(data => {
+    if(!data.success) throw new Error('Capas inválidas');
+    return fetch(`/sequence/execute?index=${currentSequenceIndex}`);
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(data.success) {
+      showMessage('▶️ Trayectoria ejecutándose...', 'success');
+    } else {
+      showMessage('❌ Error ejecutando trayectoria', 'error');
+    }
+  })
+  .catch(err => {
+    console.error(err);
+    showMessage('❌ Error: ' + err.message, 'error');
+  });
+}
+
+// El ESP32 expande los frames: una sola petición sin importar la cantidad
+function executeTimelapse() {
+  const value = id => document.getElementById(id).value;
+  
+  showMessage('⏱️ Cargando timelapse...', 'info');
+  
+  releaseTempSequence()
+  .then(() => fetch('/sequence/create', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: 'name=TempTimelapse&capacity=1'
+  }))
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error('Error creando secuencia');
     currentSequenceIndex = data.index;
     
-    // Agregar todos los movimientos
-    const promises = movements.map(mov => {
-      const params = new URLSearchParams({
-        seq: currentSequenceIndex,
-        distance: mov.distance,
-        speed: mov.speed,
-        angle: mov.angle,
-        angleSpeed: mov.angleSpeed,
-        simultaneous: mov.simultaneous,
-        pause: mov.pause
-      });
-      
-      return fetch('/sequence/add', {
-        method: 'POST',
-        headers: {'Content-Type': 'application/x-www-form-urlencoded'},
-        body: params.toString()
-      });
+    const params = new URLSearchParams({
+      seq: currentSequenceIndex,
+      frames: value('tlFrames'),
+      distance: value('tlDistance'),
+      startAngle: value('tlStartAngle'),
+      endAngle: value('tlEndAngle'),
+      interval: value('tlInterval'),
+      settle: value('tlSettle'),
+      exposure: value('tlExposure'),
+      easing: value('tlEasing'),
+      shutter: true
+    });
+    return fetch('/sequence/generator', {
+      method: 'POST',
+      headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+      body: params.toString()
     });
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Timelapse inválido');
+    return fetch(`/sequence/execute?index=${currentSequenceIndex}`);
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(data.success) {
+      showMessage('▶️ Timelapse en curso...', 'success');
+    } else {
+      showMessage('❌ Error ejecutando timelapse', 'error');
+    }
+  })
+  .catch(err => {
+    console.error(err);
+    showMessage('❌ Error: ' + err.message, 'error');
+  });
+}
+
+// ========== Programas de movimiento ==========
+
+// Opcodes de include/drivers/MotionProgram.h
+const PROGRAM_OP = { end: 0, move: 1, turn: 2, moveTurn: 3, pause: 4, shutter: 5,
+                     loop: 6, endloop: 7, wait: 8, speed: 9 };
+
+// Ensambla el texto a bytecode: opcode de un byte y argumentos en varint
+// (zigzag la distancia). El ESP32 vuelve a verificar rangos y bucles.
+function assembleProgram(text) {
+  const bytes = [];
+  const varint = value => {
+    do {
+      const low = value % 128;
+      value = Math.floor(value / 128);
+      bytes.push(value > 0 ? low | 0x80 : low);
+    } while(value > 0);
+  };
+  const zigzag = value => value >= 0 ? value * 2 : -value * 2 - 1;
+  let depth = 0;
+  
+  text.split('\n').forEach((raw, i) => {
+    const line = raw.split('#')[0].trim();
+    if(line === '') return;
+    const [name, ...args] = line.split(/\s+/);
+    const numbers = args.map(Number);
+    const expect = (minArgs, maxArgs) => {
+      if(numbers.length < minArgs || numbers.length > maxArgs || numbers.some(n => isNaN(n) || (n < 0 && name !== 'move'))) {
+        throw new Error(`Línea ${i + 1}: ${raw.trim()}`);
+      }
+    };
     
-    return Promise.all(promises);
+    switch(name) {
+      case 'move':
+        expect(1, 2);
+        bytes.push(numbers.length === 2 ? PROGRAM_OP.moveTurn : PROGRAM_OP.move);
+        varint(zigzag(Math.round(numbers[0] * 100)));
+        if(numbers.length === 2) varint(Math.round(numbers[1]));
+        break;
+      case 'turn':
+      case 'pause':
+      case 'loop':
+        expect(1, 1);
+        bytes.push(PROGRAM_OP[name]);
+        varint(Math.round(numbers[0]));
+        if(name === 'loop') depth++;
+        break;
+      case 'wait':
+        expect(0, 1);
+        bytes.push(PROGRAM_OP.wait);
+        varint(Math.round(numbers[0] || 0));
+        break;
+      case 'speed':
+        expect(2, 2);
+        bytes.push(PROGRAM_OP.speed);
+        varint(Math.round(numbers[0]));
+        varint(Math.round(numbers[1]));
+        break;
+      case 'shutter':
+        expect(0, 0);
+        bytes.push(PROGRAM_OP.shutter);
+        break;
+      case 'end':
+        expect(0, 0);
+        if(depth === 0) throw new Error(`Línea ${i + 1}: "end" sin "loop"`);
+        bytes.push(PROGRAM_OP.endloop);
+        depth--;
+        break;
+      default:
+        throw new Error(`Línea ${i + 1}: instrucción desconocida "${name}"`);
+    }
+  });
+  
+  if(depth > 0) throw new Error('Falta "end" de un bucle');
+  bytes.push(PROGRAM_OP.end);
+  return bytes;
+}
+
+function executeProgram() {
+  let bytes;
+  try {
+    bytes = assembleProgram(document.getElementById('motionProgram').value);
+  } catch(err) {
+    showMessage('❌ ' + err.message, 'error');
+    return;
+  }
+  const code = bytes.map(b => b.toString(16).padStart(2, '0')).join('');
+  
+  showMessage(`🧩 Cargando programa (${bytes.length} bytes)...`, 'info');
+  
+  releaseTempSequence()
+  .then(() => fetch('/sequence/create', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: 'name=TempProgram&type=program'
+  }))
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error('Error creando secuencia');
+    currentSequenceIndex = data.index;
+    
+    const params = new URLSearchParams({ seq: currentSequenceIndex, code: code });
+    return fetch('/sequence/program', {
+      method: 'POST',
+      headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+      body: params.toString()
+    });
   })
-  .then(() => {
-    // Ejecutar secuencia
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Programa inválido');
     return fetch(`/sequence/execute?index=${currentSequenceIndex}`);
   })
   .then(response => response.json())
   .then(data => {
     if(data.success) {
-      showMessage('▶️ Secuencia ejecutándose...', 'success');
+      showMessage('▶️ Programa en curso...', 'success');
     } else {
-      showMessage('❌ Error ejecutando secuencia', 'error');
+      showMessage('❌ Error ejecutando programa', 'error');
     }
   })
   .catch(err => {
@@ -245,6 +966,167 @@ function executeSequence() {
   });
 }
 
+// ========== Modo teach ==========
+
+function startTeach() {
+  fetch('/teach/start', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: `tolerance=${document.getElementById('teachTolerance').value}`
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'No se pudo grabar');
+    document.getElementById('teachStatus').textContent = '⏺️ Grabando... usar el control manual para mover el slider';
+    showMessage('⏺️ Grabando recorrido', 'info');
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function stopTeach() {
+  const previous = teachSequenceIndex;
+  fetch('/teach/stop', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: 'name=Recorrido'
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Grabación vacía');
+    teachSequenceIndex = data.index;
+    document.getElementById('teachStatus').textContent =
+      `✅ ${(data.durationMs / 1000).toFixed(1)} s grabados: ${data.points} puntos, ${data.bytes} bytes`;
+    // Solo se conserva la última grabación
+    if(previous >= 0) {
+      return fetch('/sequence/delete', {
+        method: 'POST',
+        headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+        body: `index=${previous}`
+      });
+    }
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function playTeach() {
+  if(teachSequenceIndex < 0) {
+    showMessage('⚠️ No hay recorrido grabado', 'error');
+    return;
+  }
+  const speed = document.getElementById('teachSpeed').value;
+  fetch(`/sequence/playback?index=${teachSequenceIndex}&speed=${speed}`)
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Velocidad inválida');
+    return fetch(`/sequence/execute?index=${teachSequenceIndex}`);
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'No se pudo reproducir');
+    showMessage('▶️ Reproduciendo recorrido...', 'success');
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// ========== Disparos por posición ==========
+
+function loadTriggers() {
+  const value = id => document.getElementById(id).value;
+  const params = new URLSearchParams({
+    start: value('trigStart'),
+    spacing: value('trigSpacing'),
+    count: value('trigCount'),
+    action: value('trigAction'),
+    direction: value('trigDirection'),
+    pulse: value('trigPulse')
+  });
+  fetch('/triggers/series', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: params.toString()
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Disparos inválidos');
+    showMessage(`📍 ${data.count} disparos cargados`, 'success');
+    updateTriggerStatus();
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function clearTriggers() {
+  fetch('/triggers/clear', {method: 'POST'})
+  .then(() => updateTriggerStatus())
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function updateTriggerStatus() {
+  fetch('/triggers/status')
+    .then(response => response.json())
+    .then(data => {
+      const status = document.getElementById('triggerStatus');
+      if(data.count === 0) {
+        status.textContent = `Sin disparos cargados (${data.fired} disparados)`;
+        return;
+      }
+      let text = `${data.count} cargados, ${data.ahead} por delante`;
+      if(data.nextMm !== undefined) text += ` (próximo en ${data.nextMm} mm)`;
+      text += ` - ${data.fired} disparados`;
+      if(data.dropped > 0) text += `, ${data.dropped} sin registrar`;
+      if(data.last.length > 0) {
+        const last = data.last[0];
+        text += ` - último: ${last.action} en ${last.mm} mm`;
+      }
+      status.textContent = text;
+    })
+    .catch(() => {});
+}
+
+// ========== Seguimiento de sujeto ==========
+
+// Volver a llamarlo con el seguimiento activo cambia el sujeto
+function startTracking() {
+  const params = new URLSearchParams({
+    along: document.getElementById('trackAlong').value,
+    distance: document.getElementById('trackDistance').value,
+    center: document.getElementById('trackCenter').value,
+    invert: document.getElementById('trackInvert').checked
+  });
+  fetch('/track/start', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: params.toString()
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'No se pudo seguir');
+    showMessage('🎯 Seguimiento activo: el pan sigue al sujeto', 'success');
+    updateTrackStatus();
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function stopTracking() {
+  fetch('/track/stop', {method: 'POST'})
+  .then(() => updateTrackStatus())
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function updateTrackStatus() {
+  fetch('/track/status')
+    .then(response => response.json())
+    .then(data => {
+      const status = document.getElementById('trackStatus');
+      if(!data.active) {
+        status.textContent = 'Seguimiento inactivo';
+        return;
+      }
+      status.textContent = `${data.locked ? '🔒' : '↪️'} Pan ${data.angle.toFixed(1)}° ` +
+        `- sujeto a ${data.alongMm} mm, ${data.distanceMm} mm del rail (cálculo máx. ${data.maxUs} µs)`;
+    })
+    .catch(() => {});
+}
+
 function showMessage(text, type) {
   const msg = document.getElementById('message');
   msg.textContent = text;
@@ -270,6 +1152,198 @@ function showMessage(text, type) {
   }, 3000);
 }
 
+// ========== Playlist ==========
+
+function executePlaylist() {
+  const entries = document.getElementById('playlistEntries').value.replace(/\s/g, '');
+  const loop = document.getElementById('playlistLoop').checked ? 1 : 0;
+  
+  fetch('/playlist/set', {
+    method: 'POST',
+    headers: {'Content-Type': 'application/x-www-form-urlencoded'},
+    body: `entries=${encodeURIComponent(entries)}&loop=${loop}`
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'Playlist inválida');
+    return fetch('/playlist/execute');
+  })
+  .then(response => response.json())
+  .then(data => {
+    if(!data.success) throw new Error(data.message || 'No se pudo ejecutar');
+    showMessage('▶️ Playlist ejecutándose...', 'success');
+    updatePlaylistStatus();
+  })
+  .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function updatePlaylistStatus() {
+  fetch('/playlist/status')
+    .then(response => response.json())
+    .then(data => {
+      const status = document.getElementById('playlistStatus');
+      if(!data.active) {
+        status.textContent = data.entries.length > 0 ? `${data.entries.length} entradas` : 'Sin playlist';
+        return;
+      }
+      let text = `▶️ Entrada ${data.position + 1}/${data.entries.length}`;
+      if(data.remainingMs !== undefined) {
+        text += ` - quedan ${(data.remainingMs / 1000).toFixed(0)} s`;
+      }
+      status.textContent = text;
+      setTimeout(updatePlaylistStatus, 2000);
+    })
+    .catch(() => {});
+}
+
+// ========== Parada de emergencia ==========
+
+function showEmergencyStatus(data) {
+  const status = document.getElementById('estopStatus');
+  if(data.latched) {
+    let text = `⛔ Enclavada (${data.software ? 'software' : 'entrada'}) - ENA cortado en ${data.cutUs} µs`;
+    if(data.stepperAckUs > 0) text += `, stepper ${data.stepperAckUs} µs`;
+    if(data.servoAckUs > 0) text += `, servo ${data.servoAckUs} µs`;
+    if(data.inputActive) text += ' - liberar la entrada para resetear';
+    status.textContent = text;
+  } else {
+    status.textContent = data.triggers > 0
+      ? `✅ Normal (${data.triggers} disparos, peor corte ${data.maxCutUs} µs)`
+      : 'Sin disparos';
+  }
+}
+
+function updateEmergencyStatus() {
+  fetch('/estop/status')
+    .then(response => response.json())
+    .then(showEmergencyStatus)
+    .catch(() => {});
+}
+
+function triggerEmergencyStop() {
+  fetch('/estop/trigger')
+    .then(response => response.json())
+    .then(data => {
+      showEmergencyStatus(data);
+      showMessage('🛑 Parada de emergencia', 'error');
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function resetEmergencyStop() {
+  fetch('/estop/reset', {method: 'POST'})
+    .then(response => response.json())
+    .then(data => {
+      if(!data.success) throw new Error(data.message || 'No se pudo resetear');
+      showMessage('✅ Reset hecho: conviene volver a referenciar el carro', 'success');
+      updateEmergencyStatus();
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// ========== Punto de control ==========
+
+function showRecoveryStatus(data) {
+  const status = document.getElementById('recoveryStatus');
+  if(!data.enabled) {
+    status.textContent = 'Punto de control no disponible';
+    return;
+  }
+  document.getElementById('recoveryAuto').checked = data.autoResume;
+  const boot = data.boot;
+  let text;
+  if(boot.state === 'moving') {
+    text = `⚠️ Corte en marcha (de ${boot.steps} a ${boot.targetSteps} pasos): posición incierta, volver a referenciar`;
+  } else if(data.pendingResume) {
+    text = `⏸️ Ejecución interrumpida: pasada ${boot.pass + 1}, registro ${boot.record}, frame ${boot.frame} en ${boot.mm} mm / ${boot.angle}°`;
+  } else {
+    const saved = data.saved;
+    text = saved.state === 'none' ? 'Sin punto de control'
+         : `💾 ${saved.state === 'rest' ? 'En reposo' : 'En marcha'}: ${saved.mm} mm / ${saved.angle}°`;
+  }
+  status.textContent = text + ` (${data.restWrites + data.movingWrites} escrituras)`;
+}
+
+function updateRecoveryStatus() {
+  fetch('/recovery')
+    .then(response => response.json())
+    .then(showRecoveryStatus)
+    .catch(() => {});
+}
+
+function setAutoResume() {
+  const enabled = document.getElementById('recoveryAuto').checked;
+  fetch(`/recovery?autoResume=${enabled ? 1 : 0}`)
+    .then(response => response.json())
+    .then(showRecoveryStatus)
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function resumeRecovery() {
+  fetch('/recovery/resume', {method: 'POST'})
+    .then(response => response.json())
+    .then(data => {
+      if(!data.success) throw new Error(data.message || 'No se pudo retomar');
+      showMessage('▶️ Ejecución retomada', 'success');
+      updateRecoveryStatus();
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+function discardRecovery() {
+  fetch('/recovery/discard', {method: 'POST'})
+    .then(response => response.json())
+    .then(() => {
+      showMessage('🗑️ Ejecución interrumpida descartada', 'info');
+      updateRecoveryStatus();
+    })
+    .catch(err => showMessage('❌ Error: ' + err.message, 'error'));
+}
+
+// ========== Registro ==========
+
+let lastLogId = 0;
+
+function updateLog() {
+  fetch(`/system/log?since=${lastLogId}`)
+    .then(response => response.json())
+    .then(data => {
+      const view = document.getElementById('logView');
+      // El ESP32 se reinició: volver a pedir desde el principio
+      if(data.lastId < lastLogId) lastLogId = 0;
+      const atBottom = view.scrollTop + view.clientHeight >= view.scrollHeight - 5;
+      data.lines.forEach(line => {
+        const row = document.createElement('div');
+        row.className = `log-${line.level}`;
+        row.textContent = `${(line.ms / 1000).toFixed(1)}s ${line.text}`;
+        view.appendChild(row);
+        lastLogId = line.id;
+      });
+      while(view.childElementCount > 200) view.removeChild(view.firstChild);
+      if(atBottom) view.scrollTop = view.scrollHeight;
+      
+      let stats = `${data.written} registros`;
+      if(data.dropped > 0) stats += `, ${data.dropped} descartados`;
+      stats += ` - ocupación máxima ${data.maxPending}/${data.capacity}`;
+      document.getElementById('logStats').textContent = stats;
+    })
+    .catch(() => {});
+}
+
 // Actualizar estado cada 2 segundos
 setInterval(updateStatus, 2000);
-updateStatus();
\ No newline at end of file
+setInterval(updateEmergencyStatus, 2000);
+setInterval(updateLog, 2000);
+setInterval(updateTrackStatus, 2000);
+setInterval(updateTriggerStatus, 2000);
+setInterval(updateRecoveryStatus, 5000);
+updateStatus();
+updateEmergencyStatus();
+updateLog();
+updateTrackStatus();
+updateTriggerStatus();
+updateRecoveryStatus();
+loadBacklash();
+
+connectControlSocket();
+jogTimer = setInterval(jogTick, JOG_RATE_MS);
\ No newline at end of file
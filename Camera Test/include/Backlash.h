@@ -0,0 +1,32 @@
+#ifndef BACKLASH_H
+#define BACKLASH_H
+
+#include <Arduino.h>
+
+class StepperDriver;
+class ServoDriver;
+
+// Juego de cada eje guardado en NVS. Los drivers lo compensan al invertir
+// el sentido (StepperDriver::setBacklash, ServoDriver::setBacklash); aquí
+// solo se persiste y se reporta junto con la última calibración.
+
+// Calibración de juego con el final de carrera 1: cada ciclo mide los pasos
+// desde el contacto hasta que se libera y, tras alejarse, de vuelta hasta
+// el contacto. Ambos valen juego + histéresis del interruptor.
+struct BacklashCalibration {
+  bool running;
+  bool valid;
+  int cycles;                  // Ciclos pedidos
+  int samples;                 // Mediciones tomadas (2 por ciclo)
+  long deadBandSteps;          // Media de las mediciones
+  long spreadSteps;            // Máxima - mínima
+  long hysteresisSteps;        // Histéresis del interruptor a descontar
+  long backlashSteps;          // Resultado: deadBandSteps - hysteresisSteps
+  const char* error;           // nullptr si no falló
+};
+
+void loadBacklashConfig(StepperDriver* stepper, ServoDriver* servo);
+void saveBacklashConfig(StepperDriver* stepper, ServoDriver* servo);
+String getBacklashAsJson(StepperDriver* stepper, ServoDriver* servo);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+
+// Punto de control en NVS para retomar tras un corte de energía sin volver
+// a referenciar. La posición del stepper (lazo abierto) solo es exacta con
+// el carro quieto, así que se guarda en reposo (REST): en los límites de
+// movimiento de la ejecución y con los motores inactivos, a lo sumo una vez
+// cada 'intervalMs'. Antes de encolar el primer movimiento tras un REST
+// guardado se marca MOVING: si la energía se corta en marcha, al arrancar
+// se sabe que la posición es incierta y no se restaura. Así hay como mucho dos escrituras
+// por intervalo y ninguna con el stepper dando pasos. NVS ya es un registro
+// circular con nivelación de desgaste y escrituras atómicas por clave.
+//
+// Solo se retoman secuencias de movimientos hacia adelante y fuera de la
+// playlist: al arrancar una se guarda una copia (exportSnapshot) y el
+// avance (pasada, registro y frame del generador). Las demás ejecuciones
+// guardan solo la pose.
+
+class StepperDriver;
+class ServoDriver;
+class SequenceManager;
+
+#define CHECKPOINT_INTERVAL_DEFAULT_MS 5000
+#define CHECKPOINT_INTERVAL_MIN_MS 1000
+#define CHECKPOINT_INTERVAL_MAX_MS 600000
+#define CHECKPOINT_POLL_MS 250
+#define CHECKPOINT_SNAPSHOT_BYTES 4000   // El NVS de default.csv tiene ~20 KB
+
+enum CheckpointState : uint8_t {
+  CHECKPOINT_NONE,       // Nada guardado
+  CHECKPOINT_REST,       // Pose exacta
+  CHECKPOINT_MOVING      // Se cortó en marcha entre la pose guardada y 'targetSteps'
+};
+
+// Punto desde donde seguir la ejecución reanudable
+struct CheckpointProgress {
+  int16_t sequence;      // -1 = ninguna reanudable
+  uint16_t pass;
+  uint16_t record;       // Registro del pool a ejecutar
+  uint32_t frame;        // Frame siguiente si ese registro es un generador
+  uint32_t snapshotCrc;  // Copia de la secuencia a la que se refiere
+};
+
+struct Checkpoint {
+  uint8_t version;
+  uint8_t state;         // CheckpointState
+  uint8_t angle;
+  int32_t steps;
+  int32_t targetSteps;   // Solo MOVING
+  CheckpointProgress progress;
+};
+
+// Lee el último punto de control y, si está en reposo, devuelve la pose
+// al stepper y al servo. Llamar tras begin() de los drivers y antes de
+// cualquier movimiento.
+bool beginCheckpoints(StepperDriver* stepper, ServoDriver* servo);
+
+// Con la reanudación automática activada y una pose exacta, recrea la
+// secuencia interrumpida y la sigue desde el punto de control
+void autoResumeCheckpoint(SequenceManager* sequences);
+// Lo mismo a pedido; 'reason' explica el rechazo
+bool resumeFromCheckpoint(SequenceManager* sequences, String& reason);
+// Olvida la ejecución interrumpida (la pose se sigue guardando)
+void discardCheckpointRun();
+
+void setCheckpointAutoResume(bool enabled);
+void setCheckpointInterval(uint32_t ms);
+
+// Las llama SequenceManager. beginRun() guarda la copia de la secuencia
+// (solo si cambió; sequence < 0 = ejecución no reanudable), progress() y
+// frame() fijan el punto desde donde seguir y settled() avisa que los
+// motores ya llegaron: desde ahí se puede guardar.
+void checkpointBeginRun(int sequence, const uint8_t* snapshot, size_t length);
+void checkpointProgress(uint16_t pass, uint16_t record, uint32_t frame);
+void checkpointFrame(uint32_t frame);
+void checkpointSettled();
+void checkpointEndRun();
+
+// La llama StepperDriver al encolar cada movimiento, en la task que lo
+// pide y antes de encolarlo: la del stepper nunca escribe la flash ni
+// espera este módulo, así que el primer paso no se demora.
+void checkpointMotionStart(long from, long to);
+// Ejecución armada, ya en la pose inicial: marca MOVING ahora y no vuelve
+// a guardar REST hasta el primer movimiento, así el go no escribe la flash.
+// Un corte mientras espera el go deja la posición como incierta.
+void checkpointArm();
+
+String getCheckpointAsJson();
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef COMMAND_ROUTER_H
+#define COMMAND_ROUTER_H
+
+#include <Arduino.h>
+#include "ControlProtocol.h"
+#include "CommandTargets.h"
+
+// Capa de comandos independiente del transporte. Cada endpoint REST es una
+// función que lee parámetros de CommandParams y escribe un CommandResponse;
+// interface.cpp solo traduce AsyncWebServerRequest (y las tramas del canal
+// WebSocket) a estas llamadas. Los drivers y los módulos del sistema llegan
+// por CommandContext como interfaces (CommandTargets.h) en lugar de
+// globales: el router no incluye FreeRTOS ni los drivers, y el build
+// native de test/ lo enlaza contra drivers simulados.
+
+// Drivers y servicios que usan los comandos (nullptr = no disponible)
+struct CommandContext {
+  StepperControl* stepper;
+  ServoControl* servo;
+  SequenceControl* sequences;
+  AxesControl* motion;
+  TeachControl* teach;
+  TrackerControl* tracker;
+  SystemControl* system;
+  bool (*takePhoto)();       // false si no hay callback de foto
+  bool (*bleConnected)();
+};
+
+// Qué necesita una ruta: si falta, responde 500 sin llamar al comando
+enum CommandNeeds : uint8_t {
+  NEEDS_NOTHING   = 0,
+  NEEDS_STEPPER   = 0x01,
+  NEEDS_SERVO     = 0x02,
+  NEEDS_SEQUENCES = 0x04,
+  NEEDS_MOTION    = 0x08,
+  NEEDS_TEACH     = 0x10,
+  NEEDS_TRACKER   = 0x20,
+  NEEDS_SYSTEM    = 0x40
+};
+
+enum CommandMethod : uint8_t {
+  COMMAND_GET,
+  COMMAND_POST
+};
+
+// Parámetros de una petición. GET los toma de la query y POST del cuerpo.
+class CommandParams {
+public:
+  virtual bool has(const char* name) const = 0;
+  // Cadena vacía si no está
+  virtual String get(const char* name) const = 0;
+  // Cabecera de la petición (p. ej. If-Match); cadena vacía si no está
+  virtual String header(const char* name) const = 0;
+
+  long getInt(const char* name, long def) const { return has(name) ? get(name).toInt() : def; }
+  float getFloat(const char* name, float def) const { return has(name) ? get(name).toFloat() : def; }
+};
+
+struct CommandResponse {
+  int status;
+  String body;
+
+  void send(int code, const String& json) { status = code; body = json; }
+  void ok() { send(200, "{\"success\":true}"); }
+  void fail(int code) { send(code, "{\"success\":false}"); }
+  void fail(int code, const char* message);
+};
+
+typedef void (*CommandHandler)(const CommandContext& ctx, const CommandParams& params, CommandResponse& res);
+
+struct CommandRoute {
+  const char* path;
+  CommandMethod method;
+  uint8_t needs;          // CommandNeeds
+  CommandHandler handler;
+};
+
+// Tiempo de cada ruta dentro de dispatchCommand() (sin transporte)
+struct CommandStats {
+  uint32_t calls;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t maxBodyBytes;
+};
+
+void setCommandContext(const CommandContext& context);
+
+// Rutas en orden de registro: las más específicas van primero porque el
+// servidor web acepta "/x" también para "/x/y"
+int getCommandRouteCount();
+const CommandRoute& getCommandRoute(int index);
+
+void dispatchCommand(int routeIndex, const CommandParams& params, CommandResponse& res);
+String getCommandStatsAsJson();
+
+// Canal binario: valida la trama, ejecuta el opcode y devuelve el
+// ControlStatus; fillAck() completa el estado del ACK
+uint8_t dispatchControlFrame(const uint8_t* data, size_t len, ControlHeader& header);
+void fillAck(AckFrame& ack, const ControlHeader& header, uint8_t status);
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef COMMAND_TARGETS_H
+#define COMMAND_TARGETS_H
+
+#include <Arduino.h>
+#include <vector>
+#include "drivers/SequenceTypes.h"
+#include "Backlash.h"
+#include "PowerManager.h"
+#include "PositionTriggers.h"
+
+// Lo que CommandRouter usa de los drivers y de los módulos del sistema, sin
+// FreeRTOS, esp_timer ni globales. En el ESP32 los drivers implementan
+// estas interfaces y interface.cpp adapta los módulos (SystemControl); el
+// build native de test/ enlaza sus propias implementaciones.
+//
+// Solo para la capa de comandos: no llamar desde un ISR (la vtable vive en
+// flash y el ISR puede correr con la caché deshabilitada).
+
+// Avance del carro por vuelta del motor. Todas las conversiones entre mm
+// y pasos pasan por mmToSteps/stepsToMm con este valor.
+#define MM_PER_REVOLUTION 8.0f
+
+class StepperControl {
+public:
+  virtual ~StepperControl() {}
+
+  virtual bool moveTo(long position, int speed = -1, bool wait = false) = 0;
+  virtual bool moveRelative(long steps, int speed = -1, bool wait = false) = 0;
+  virtual void stop() = 0;
+  virtual void enable() = 0;
+  virtual void disable() = 0;
+  virtual void zero() = 0;
+
+  virtual long getCurrentPosition() const = 0;
+  virtual bool getIsMoving() const = 0;
+  virtual int getQueuedCommands() const = 0;
+
+  virtual void setIdleTimeout(uint32_t ms) = 0;
+  virtual uint32_t getIdleTimeout() const = 0;
+  virtual bool getIsHoldReleased() const = 0;
+
+  virtual void setBacklash(int steps, int speed = -1) = 0;
+  virtual int getBacklashSteps() const = 0;
+  virtual bool startBacklashCalibration(int cycles, int speed, long hysteresisSteps) = 0;
+  virtual BacklashCalibration getBacklashCalibration() const = 0;
+
+  virtual long mmToSteps(float mm, float mmPerRevolution) = 0;
+  virtual float stepsToMm(long steps, float mmPerRevolution) = 0;
+};
+
+class ServoControl {
+public:
+  virtual ~ServoControl() {}
+
+  virtual bool moveTo(int angle, int speed = -1, bool wait = false) = 0;
+  virtual void stop() = 0;
+
+  virtual int getCurrentAngle() const = 0;
+  virtual bool getIsMoving() const = 0;
+  virtual int getQueuedCommands() const = 0;
+
+  virtual void setBacklash(int degrees) = 0;
+  virtual void setIdleTimeout(uint32_t ms) = 0;
+  virtual uint32_t getIdleTimeout() const = 0;
+  virtual bool getIsAttached() const = 0;
+};
+
+// Ejes adicionales del MotionController, por índice
+class AxesControl {
+public:
+  virtual ~AxesControl() {}
+
+  virtual int getAxisCount() const = 0;
+  // 'value' en unidades de usuario del eje (°, pasos...)
+  virtual int32_t toAxisUnits(int axis, float value) const = 0;
+  virtual uint32_t rateForSpeed(int axis, int speed) const = 0;
+  virtual bool queueMove(int axis, int32_t delta, uint32_t rate) = 0;
+  virtual String getAxesAsJson() const = 0;
+};
+
+class TeachControl {
+public:
+  virtual ~TeachControl() {}
+
+  virtual bool start(float toleranceMm = 0.2f, int toleranceDeg = 1) = 0;
+  // El llamador libera la trayectoria (nullptr = no se estaba grabando)
+  virtual RecordedPath* stop() = 0;
+  virtual String getStatusAsJson() const = 0;
+};
+
+class TrackerControl {
+public:
+  virtual ~TrackerControl() {}
+
+  virtual bool start(float alongMm, float distanceMm, float centerDeg = 90, bool invert = false) = 0;
+  virtual void stop() = 0;
+  virtual String getStatusAsJson() const = 0;
+};
+
+// Contrato documentado en SequenceManager.h
+class SequenceControl {
+public:
+  virtual ~SequenceControl() {}
+
+  virtual int createSequence(const String& name, SequenceType type = SEQUENCE_MOVEMENTS,
+                             uint16_t capacity = 16) = 0;
+  virtual bool deleteSequence(int index) = 0;
+  virtual bool addMovement(int sequenceIndex, const Movement& movement) = 0;
+  virtual SequenceEditResult updateMovement(int sequenceIndex, int movementIndex, const Movement& movement,
+                                            uint32_t expectedVersion = 0) = 0;
+  virtual SequenceEditResult insertMovement(int sequenceIndex, int movementIndex, const Movement& movement,
+                                            uint32_t expectedVersion = 0) = 0;
+  virtual SequenceEditResult moveMovement(int sequenceIndex, int from, int to,
+                                          uint32_t expectedVersion = 0) = 0;
+  virtual SequenceEditResult removeMovement(int sequenceIndex, int movementIndex,
+                                            uint32_t expectedVersion = 0) = 0;
+  virtual SequenceEditResult setRepeat(int sequenceIndex, bool loop, int repeatCount,
+                                       uint32_t expectedVersion = 0) = 0;
+  virtual bool addGenerator(int sequenceIndex, const FrameGenerator& generator) = 0;
+  virtual bool setKeyframes(int sequenceIndex, const std::vector<Keyframe>& keyframes,
+                            InterpolationType interpolation) = 0;
+  virtual bool setRecording(int sequenceIndex, RecordedPath* recording) = 0;
+  virtual bool setProgram(int sequenceIndex, MotionProgram* program) = 0;
+  virtual bool setPlaybackSpeed(int sequenceIndex, int percent) = 0;
+  virtual bool setLayers(int sequenceIndex, const MotionLayer* layers, int count) = 0;
+
+  virtual void setSoftLimits(float minMm, float maxMm) = 0;
+  virtual void disableSoftLimits() = 0;
+  virtual void setSpeedCap(uint32_t stepsPerSecond) = 0;
+  virtual String getLimitsAsJson() const = 0;
+  virtual bool setFeedOverride(int percent, String& reason) = 0;
+  virtual int getFeedOverride() const = 0;
+  virtual void invalidateAnalyses() = 0;
+
+  virtual bool validateSequence(int sequenceIndex, String& reason, PlaybackMode mode = PLAY_FORWARD) = 0;
+  virtual bool executeSequence(int sequenceIndex, PlaybackMode mode = PLAY_FORWARD) = 0;
+  virtual bool armSequence(int sequenceIndex, PlaybackMode mode = PLAY_FORWARD) = 0;
+  virtual bool rapidReturn(String& reason, uint32_t& etaMs) = 0;
+  virtual bool go() = 0;
+  virtual void pause() = 0;
+  virtual void resume() = 0;
+  virtual void stop() = 0;
+  virtual bool seek(uint32_t position) = 0;
+
+  virtual bool setPlaylist(const PlaylistEntry* entries, int count, bool loop) = 0;
+  virtual bool validatePlaylist(String& reason) = 0;
+  virtual bool executePlaylist() = 0;
+
+  virtual int getMovementCount(int sequenceIndex) const = 0;
+  virtual const Sequence* getSequence(int index) const = 0;
+  virtual bool getIsExecuting() const = 0;
+  virtual String getArmStatusAsJson() const = 0;
+  virtual String getExecutorStatusAsJson() const = 0;
+  virtual String getPlaylistAsJson() const = 0;
+  virtual String getStopLatencyAsJson() const = 0;
+  virtual String getSequenceAsJson(int index, int offset = 0, int limit = SEQUENCE_JSON_PAGE) const = 0;
+  virtual String getAllSequencesAsJson() const = 0;
+  virtual String getPoolUsageAsJson() const = 0;
+};
+
+// Módulos del sistema (Backlash, PositionTriggers, EmergencyStop,
+// Checkpoint, TaskConfig, JitterBenchmark, PowerManager y Log) con los
+// drivers ya enlazados
+class SystemControl {
+public:
+  virtual ~SystemControl() {}
+
+  virtual void saveBacklashConfig() = 0;
+  virtual String getBacklashAsJson() = 0;
+
+  virtual bool setPositionTriggers(const PositionTrigger* entries, int count) = 0;
+  virtual void clearPositionTriggers() = 0;
+  virtual void setTriggerPulseWidth(uint32_t ms) = 0;
+  virtual String getPositionTriggersAsJson() = 0;
+
+  virtual void triggerEmergencyStop() = 0;
+  virtual bool resetEmergencyStop() = 0;
+  virtual bool isEmergencyLatched() = 0;
+  virtual String getEmergencyStopAsJson() = 0;
+
+  virtual void setCheckpointAutoResume(bool enabled) = 0;
+  virtual void setCheckpointInterval(uint32_t ms) = 0;
+  virtual bool resumeFromCheckpoint(String& reason) = 0;
+  virtual void discardCheckpointRun() = 0;
+  virtual String getCheckpointAsJson() = 0;
+
+  // Aplica y guarda en NVS
+  virtual bool applyTaskLayout(int index) = 0;
+  virtual String getTaskLayoutsAsJson() = 0;
+  virtual bool startJitterBenchmark(long steps, int speed) = 0;
+  virtual bool isJitterBenchmarkRunning() = 0;
+  virtual String getJitterBenchmarkAsJson() = 0;
+
+  virtual PowerConfig getPowerConfig() = 0;
+  virtual void setPowerConfig(const PowerConfig& config) = 0;
+  virtual PowerFrameReport getPowerReport() = 0;
+
+  virtual String getLogAsJson(uint32_t since) = 0;
+};
+
+#endif
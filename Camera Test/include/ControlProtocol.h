@@ -0,0 +1,93 @@
+#ifndef CONTROL_PROTOCOL_H
+#define CONTROL_PROTOCOL_H
+
+#include <stdint.h>
+
+// Protocolo binario del canal WebSocket (/ws) para control manual.
+// Todas las tramas son de tamaño fijo y little-endian (igual que ESP32 y
+// DataView en el navegador con littleEndian = true).
+
+// Códigos de operación (cliente -> ESP32)
+enum ControlOpcode : uint8_t {
+  CTRL_OP_JOG     = 0x01,  // Movimiento relativo (rail y/o pan)
+  CTRL_OP_GOTO    = 0x02,  // Movimiento a posición absoluta
+  CTRL_OP_STOP    = 0x03,  // Detener ambos motores
+  CTRL_OP_SHUTTER = 0x04,  // Disparar foto vía BLE
+  CTRL_OP_GO      = 0x05,  // Arrancar la secuencia armada
+
+  CTRL_OP_ACK     = 0x80   // Confirmación (ESP32 -> cliente)
+};
+
+// Flags de la cabecera
+enum ControlFlags : uint8_t {
+  CTRL_FLAG_RAIL     = 0x01,  // El comando afecta al stepper
+  CTRL_FLAG_PAN      = 0x02,  // El comando afecta al servo
+  CTRL_FLAG_COALESCE = 0x80   // Descartar si el eje ya tiene comandos pendientes
+};
+
+// Estado devuelto en el ACK
+enum ControlStatus : uint8_t {
+  CTRL_STATUS_OK        = 0,
+  CTRL_STATUS_BUSY      = 1,  // Comando descartado (cola ocupada, reintentar)
+  CTRL_STATUS_BAD_FRAME = 2,  // Longitud no coincide con el opcode
+  CTRL_STATUS_UNKNOWN   = 3,  // Opcode desconocido
+  CTRL_STATUS_NOT_READY = 4,  // Driver no inicializado o BLE desconectado
+  CTRL_STATUS_ERROR     = 5
+};
+
+// Flags de estado en el ACK
+enum ControlStateFlags : uint8_t {
+  CTRL_STATE_RAIL_MOVING = 0x01,
+  CTRL_STATE_PAN_MOVING  = 0x02,
+  CTRL_STATE_BLE         = 0x04,
+  CTRL_STATE_ESTOP       = 0x08   // Parada de emergencia enclavada
+};
+
+#pragma pack(push, 1)
+
+struct ControlHeader {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t commandId;   // Eco en el ACK para correlacionar respuestas
+};
+
+// CTRL_OP_JOG: desplazamiento relativo
+struct JogFrame {
+  ControlHeader header;
+  int32_t distanceUm;   // Desplazamiento del rail en micrómetros
+  int16_t angleDelta;   // Incremento de ángulo en grados
+  uint8_t speed;        // Velocidad stepper 0-100%
+  uint8_t angleSpeed;   // Velocidad servo 0-100%
+};
+
+// CTRL_OP_GOTO: posición absoluta respecto del cero
+struct GotoFrame {
+  ControlHeader header;
+  int32_t positionUm;   // Posición del rail en micrómetros
+  int16_t angle;        // Ángulo objetivo 0-180°
+  uint8_t speed;
+  uint8_t angleSpeed;
+};
+
+// CTRL_OP_STOP, CTRL_OP_SHUTTER y CTRL_OP_GO no llevan payload
+struct EmptyFrame {
+  ControlHeader header;
+};
+
+// CTRL_OP_ACK
+struct AckFrame {
+  ControlHeader header;   // opcode = CTRL_OP_ACK, flags = ControlStatus
+  int32_t positionUm;     // Posición actual del rail
+  int16_t angle;          // Ángulo actual del servo
+  uint8_t state;          // ControlStateFlags
+  uint8_t ackedOpcode;    // Opcode del comando confirmado
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(ControlHeader) == 4, "ControlHeader debe ocupar 4 bytes");
+static_assert(sizeof(JogFrame) == 12, "JogFrame debe ocupar 12 bytes");
+static_assert(sizeof(GotoFrame) == 12, "GotoFrame debe ocupar 12 bytes");
+static_assert(sizeof(AckFrame) == 12, "AckFrame debe ocupar 12 bytes");
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef EMERGENCY_STOP_H
+#define EMERGENCY_STOP_H
+
+#include <Arduino.h>
+
+// Parada de emergencia por hardware. El ISR de la entrada corta ENA del
+// TB6600 antes de hacer cualquier otra cosa, detiene los ejes del
+// MotionController y levanta el flag que las tasks de los drivers revisan
+// en cada paso. El estado queda enclavado (LED de falla encendido, los
+// drivers rechazan movimientos) hasta un reset explícito con la entrada
+// liberada. La posición del stepper puede haberse perdido: conviene
+// volver a referenciar tras el reset.
+
+class StepperDriver;
+class ServoDriver;
+class MotionController;
+class SequenceManager;
+
+// Quién confirma que dejó de mover tras el disparo
+enum EstopAck {
+  ESTOP_ACK_STEPPER,
+  ESTOP_ACK_SERVO,
+  ESTOP_ACK_COUNT
+};
+
+// Latencias del último disparo en µs medidas desde la entrada al ISR (la
+// del flanco hasta el ISR solo se mide con un osciloscopio)
+struct EmergencyStopStats {
+  uint32_t triggers;
+  bool latched;
+  bool inputActive;              // La seta sigue presionada
+  bool softwareTrigger;          // El último disparo vino de /estop/trigger
+  uint32_t lastCutUs;            // Hasta ENA desactivado
+  uint32_t maxCutUs;
+  uint32_t lastAckUs[ESTOP_ACK_COUNT];  // Hasta que la task salió del bucle (0 = estaba quieta)
+  uint32_t maxAckUs[ESTOP_ACK_COUNT];
+  uint32_t latchedMs;            // Tiempo enclavado
+};
+
+// inputPin < 0 deja solo el disparo por software. activeHigh = contacto NC
+// a GND con pull-up (un cable cortado también dispara).
+bool beginEmergencyStop(StepperDriver* stepper, ServoDriver* servo, MotionController* motion,
+                        SequenceManager* sequences, int inputPin, bool activeHigh, int faultLedPin);
+
+// Mismo camino que el ISR, para la web
+void triggerEmergencyStop();
+
+// Falla si la entrada sigue activa
+bool resetEmergencyStop();
+
+bool isEmergencyLatched();
+
+// Los drivers lo llaman al abandonar un movimiento por el flag
+void emergencyStopAck(EstopAck who);
+
+EmergencyStopStats getEmergencyStopStats();
+String getEmergencyStopAsJson();
+
+#endif
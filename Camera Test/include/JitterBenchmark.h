@@ -0,0 +1,40 @@
+#ifndef JITTER_BENCHMARK_H
+#define JITTER_BENCHMARK_H
+
+#include <Arduino.h>
+
+class StepperDriver;
+class ServoDriver;
+
+// Modo de medición: para cada layout de tasks (TaskConfig.h) mueve el
+// stepper ida y vuelta bajo distintas cargas sintéticas (HTTP contra el
+// propio servidor, tráfico BLE) y registra el jitter entre pasos.
+// El carro vuelve a la posición inicial al terminar cada prueba.
+
+enum BenchmarkLoad {
+  LOAD_IDLE,
+  LOAD_HTTP,
+  LOAD_BLE,
+  LOAD_HTTP_BLE,
+  LOAD_COUNT
+};
+
+struct JitterResult {
+  uint32_t samples;
+  float meanUs;       // Desvío medio respecto del periodo nominal
+  float stddevUs;
+  uint32_t maxUs;     // Peor desvío absoluto
+  uint32_t httpRequests;
+  uint32_t bleReports;
+};
+
+// Callback que genera un reporte BLE (definido en main.cpp)
+void setBenchmarkBleCallback(void (*callback)());
+
+// Lanza la medición en segundo plano. 'steps' por trayecto a 'speed' steps/s.
+bool startJitterBenchmark(StepperDriver* stepper, ServoDriver* servo, long steps, int speed);
+
+bool isJitterBenchmarkRunning();
+String getJitterBenchmarkAsJson();
+
+#endif
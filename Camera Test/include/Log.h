@@ -0,0 +1,144 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+// Registro asíncrono. Las macros LOG_* no formatean ni tocan el UART: copian
+// el puntero al formato (que hace de identificador), los argumentos y las
+// cadenas a un buffer circular sin locks y vuelven. Una task de baja
+// prioridad formatea los registros, los escribe por Serial y guarda las
+// últimas líneas para /system/log. Con el buffer lleno el registro se
+// descarta y se cuenta: quien registra nunca espera.
+//
+// El formato tiene que ser un literal (se guarda el puntero). Admite
+// %d %i %u %x %X %c %s %f con flags, ancho, precisión y 'l'.
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+
+// Filtro de compilación: por debajo de este nivel las macros no generan
+// código (-D LOG_LEVEL=4 para ver cada movimiento, pausa y petición)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Registros en el buffer (potencia de 2)
+#ifndef LOG_BUFFER_RECORDS
+#define LOG_BUFFER_RECORDS 64
+#endif
+
+// Prioridad de la task de vaciado (sin core fijo)
+#ifndef LOG_TASK_PRIORITY
+#define LOG_TASK_PRIORITY 0
+#endif
+
+#define LOG_MAX_ARGS 6
+#define LOG_TEXT_BYTES 40      // Todas las cadenas %s de un registro
+#define LOG_HISTORY_LINES 32   // Líneas que se guardan para la web
+#define LOG_LINE_BYTES 96
+
+union LogArg {
+  int32_t i;
+  uint32_t u;
+  float f;
+};
+
+struct LogRecord {
+  uint32_t position;     // Posición reservada en el buffer
+  const char* format;
+  uint32_t timeMs;
+  uint8_t level;
+  uint8_t argCount;
+  uint8_t textUsed;
+  uint8_t argTypes[LOG_MAX_ARGS];
+  LogArg args[LOG_MAX_ARGS];
+  char text[LOG_TEXT_BYTES];
+};
+
+struct LogStats {
+  uint32_t written;      // Registros aceptados
+  uint32_t dropped;      // Descartados con el buffer lleno
+  uint32_t maxPending;   // Mayor ocupación vista por la task de vaciado
+};
+
+bool beginLog();
+
+LogStats getLogStats();
+
+// Últimas líneas formateadas con id mayor que 'since'
+String getLogAsJson(uint32_t since);
+
+// ========== Captura de argumentos ==========
+
+enum LogArgType : uint8_t {
+  LOG_ARG_INT,
+  LOG_ARG_UINT,
+  LOG_ARG_FLOAT,
+  LOG_ARG_TEXT     // u = offset en LogRecord::text
+};
+
+// Reserva un registro; nullptr si el buffer está lleno
+LogRecord* logAcquire(uint8_t level, const char* format, uint8_t argCount);
+void logCommit(LogRecord* record);
+
+inline void logCapture(LogRecord* r, int n, int v) { r->argTypes[n] = LOG_ARG_INT; r->args[n].i = v; }
+inline void logCapture(LogRecord* r, int n, long v) { r->argTypes[n] = LOG_ARG_INT; r->args[n].i = (int32_t)v; }
+inline void logCapture(LogRecord* r, int n, long long v) { r->argTypes[n] = LOG_ARG_INT; r->args[n].i = (int32_t)v; }
+inline void logCapture(LogRecord* r, int n, unsigned int v) { r->argTypes[n] = LOG_ARG_UINT; r->args[n].u = v; }
+inline void logCapture(LogRecord* r, int n, unsigned long v) { r->argTypes[n] = LOG_ARG_UINT; r->args[n].u = (uint32_t)v; }
+inline void logCapture(LogRecord* r, int n, unsigned long long v) { r->argTypes[n] = LOG_ARG_UINT; r->args[n].u = (uint32_t)v; }
+inline void logCapture(LogRecord* r, int n, char v) { logCapture(r, n, (int)v); }
+inline void logCapture(LogRecord* r, int n, signed char v) { logCapture(r, n, (int)v); }
+inline void logCapture(LogRecord* r, int n, unsigned char v) { logCapture(r, n, (unsigned int)v); }
+inline void logCapture(LogRecord* r, int n, short v) { logCapture(r, n, (int)v); }
+inline void logCapture(LogRecord* r, int n, unsigned short v) { logCapture(r, n, (unsigned int)v); }
+inline void logCapture(LogRecord* r, int n, bool v) { logCapture(r, n, (int)v); }
+inline void logCapture(LogRecord* r, int n, float v) { r->argTypes[n] = LOG_ARG_FLOAT; r->args[n].f = v; }
+inline void logCapture(LogRecord* r, int n, double v) { logCapture(r, n, (float)v); }
+void logCapture(LogRecord* r, int n, const char* v);
+
+inline void logCaptureAll(LogRecord*, int) {}
+
+template <typename T, typename... Rest>
+inline void logCaptureAll(LogRecord* r, int n, T value, Rest... rest) {
+  logCapture(r, n, value);
+  logCaptureAll(r, n + 1, rest...);
+}
+
+template <typename... Args>
+inline void logWrite(uint8_t level, const char* format, Args... args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Demasiados argumentos para LOG_*");
+  LogRecord* record = logAcquire(level, format, sizeof...(Args));
+  if (record == nullptr) return;
+  logCaptureAll(record, 0, args...);
+  logCommit(record);
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logWrite(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logWrite(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logWrite(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logWrite(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif
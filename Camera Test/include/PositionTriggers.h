@@ -0,0 +1,81 @@
+#ifndef POSITION_TRIGGERS_H
+#define POSITION_TRIGGERS_H
+
+#include <Arduino.h>
+
+// Acciones disparadas en posiciones exactas del rail durante un movimiento
+// (fotos al vuelo, timelapse continuo). La lista de comparación está
+// ordenada por posición y un cursor apunta a la primera entrada más allá
+// del carro: el generador de pasos compara una sola posición por paso
+// (O(1)) y solo la recorre cuando hay coincidencias. El pulso GPIO y el LED
+// se encienden en el mismo paso y los apaga un esp_timer; el disparo BLE y
+// el registro van a una task aparte para no frenar los pasos.
+
+class StepperDriver;
+
+#ifndef TRIGGER_MAX_ENTRIES
+#define TRIGGER_MAX_ENTRIES 512
+#endif
+
+#define TRIGGER_HISTORY 16        // Últimos disparos para /triggers/status
+#define TRIGGER_MARKER_MS 30      // Destello del LED marcador
+
+enum TriggerAction : uint8_t {
+  TRIGGER_SHUTTER,   // Foto por BLE (takePhoto)
+  TRIGGER_PULSE,     // Pulso en la salida del optoacoplador
+  TRIGGER_MARKER,    // Destello del LED marcador
+  TRIGGER_ACTION_COUNT
+};
+
+// Sentido en el que el carro tiene que llegar a la posición
+enum TriggerDirection : uint8_t {
+  TRIGGER_BOTH,
+  TRIGGER_FORWARD,
+  TRIGGER_REVERSE
+};
+
+struct PositionTrigger {
+  int32_t position;     // Pasos absolutos
+  uint8_t action;       // TriggerAction
+  uint8_t direction;    // TriggerDirection
+};
+
+// Un disparo tal como ocurrió en el generador de pasos
+struct TriggerFiring {
+  uint32_t sequence;    // Número de disparo desde el arranque
+  int32_t position;     // Posición real del carro al disparar
+  int64_t timeUs;
+  uint16_t index;       // Entrada de la lista
+  uint8_t action;
+  uint8_t direction;    // Sentido de llegada (TRIGGER_FORWARD / TRIGGER_REVERSE)
+};
+
+// pulsePin / markerPin < 0 deshabilitan esas acciones
+bool beginPositionTriggers(StepperDriver* stepper, void (*shutter)(), int pulsePin, int markerPin);
+
+// Reemplaza la lista (se ordena aquí). Se puede llamar en pleno movimiento:
+// la lista nueva entra entera entre dos pasos.
+bool setPositionTriggers(const PositionTrigger* entries, int count);
+void clearPositionTriggers();
+int getPositionTriggerCount();
+
+// Ancho del pulso del optoacoplador (1-1000 ms)
+void setTriggerPulseWidth(uint32_t ms);
+
+// Las llama StepperDriver: sync() al empezar cada movimiento (reubica el
+// cursor, O(log n)) y step() tras cada paso contado
+void positionTriggerSync(long position);
+void positionTriggerStep(long position, bool forward);
+
+inline const char* triggerActionName(uint8_t action) {
+  switch (action) {
+    case TRIGGER_SHUTTER: return "shutter";
+    case TRIGGER_PULSE: return "pulse";
+    case TRIGGER_MARKER: return "marker";
+    default: return "?";
+  }
+}
+
+String getPositionTriggersAsJson();
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+
+// Gestión de energía: light sleep entre frames y estimación del consumo.
+// No hay sensor de corriente: el consumo se estima integrando en el tiempo
+// la corriente configurada de cada carga activa (modelo calibrable desde
+// /power con mediciones reales).
+
+enum PowerLoad {
+  POWER_STEPPER_HOLD,    // ENA activo (corriente de retención en el TB6600)
+  POWER_STEPPER_MOVING,  // Generando pasos
+  POWER_SERVO_ATTACHED,  // Servo con señal PWM (mantiene posición)
+  POWER_SERVO_MOVING,
+  POWER_LOAD_COUNT
+};
+
+struct PowerConfig {
+  bool lightSleepEnabled;
+  uint32_t lightSleepMinMs;            // Pausa mínima para dormir
+  bool radiosOffInRun;                 // Apagar WiFi y BLE en las ejecuciones
+  float baseCurrentMa;                 // ESP32 despierto con radios
+  float sleepCurrentMa;                // ESP32 en light sleep
+  float loadCurrentMa[POWER_LOAD_COUNT];
+};
+
+struct PowerFrameReport {
+  uint32_t frames;
+  uint32_t lastFrameMs;
+  float lastFrameAvgMa;
+  float totalMah;
+  float overallAvgMa;
+  uint32_t sleepMs;                    // Tiempo total en light sleep
+};
+
+void beginPowerManager();
+
+// Los drivers notifican cuándo una carga se activa o desactiva
+void powerSetLoad(PowerLoad load, bool active);
+
+// Para esperas que atienden órdenes entre tramos: powerCanSleep() dice si
+// una espera de 'ms' en total puede dormir y powerSleepSlice() duerme un
+// tramo (sin mirar el mínimo). Devuelve false si el sistema lo rechazó.
+bool powerCanSleep(uint32_t ms);
+bool powerSleepSlice(uint32_t ms);
+
+// Devuelve true si las radios permiten light sleep (definido en main.cpp)
+void setRadioSleepCheck(bool (*check)());
+
+// Apagado y encendido de WiFi y BLE (definidos en main.cpp). Con
+// 'radiosOffInRun' la primera espera que podría dormir dentro de una
+// ejecución apaga las radios, y powerEndRun() las vuelve a encender.
+// Mientras tanto solo se controla por GPIO (go, stop, parada de emergencia)
+// y el disparador BLE no funciona.
+void setRadioControl(void (*down)(), void (*up)());
+void powerBeginRun();
+void powerEndRun();
+
+// Antes de dormir y al despertar (definidos en main.cpp): el LEDC del servo
+// se detiene en light sleep y la salida quedaría congelada, así que se
+// desconecta. 'before' devuelve false si no se puede dormir ahora.
+void setSleepHooks(bool (*before)(), void (*after)());
+
+// Delimitan un frame (un movimiento de secuencia con su pausa)
+void powerBeginFrame();
+void powerEndFrame();
+
+PowerConfig getPowerConfig();
+void setPowerConfig(const PowerConfig& config);
+PowerFrameReport getPowerReport();
+
+#endif
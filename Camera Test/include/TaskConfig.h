@@ -0,0 +1,77 @@
+#ifndef TASK_CONFIG_H
+#define TASK_CONFIG_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+class StepperDriver;
+class ServoDriver;
+
+// Ubicación (core) y prioridad de todas las tasks del sistema en un solo
+// lugar. El layout 0 se define en tiempo de compilación (build_flags en
+// platformio.ini); el resto son alternativas que se pueden elegir en
+// runtime desde /system/tasks y medir con /system/benchmark.
+
+// Valores del layout de compilación (por defecto: el reparto histórico)
+#ifndef STEPPER_TASK_CORE
+#define STEPPER_TASK_CORE 0
+#endif
+#ifndef STEPPER_TASK_PRIORITY
+#define STEPPER_TASK_PRIORITY 1
+#endif
+#ifndef SERVO_TASK_CORE
+#define SERVO_TASK_CORE 1
+#endif
+#ifndef SERVO_TASK_PRIORITY
+#define SERVO_TASK_PRIORITY 2
+#endif
+#ifndef SEQUENCE_TASK_CORE
+#define SEQUENCE_TASK_CORE 1
+#endif
+#ifndef SEQUENCE_TASK_PRIORITY
+#define SEQUENCE_TASK_PRIORITY 1
+#endif
+
+// Layout activo al arrancar si no hay uno guardado en NVS
+#ifndef TASK_LAYOUT_DEFAULT
+#define TASK_LAYOUT_DEFAULT 0
+#endif
+
+enum TaskId {
+  TASK_STEPPER,
+  TASK_SERVO,
+  TASK_SEQUENCE,
+  TASK_COUNT
+};
+
+struct TaskPlacement {
+  BaseType_t core;
+  UBaseType_t priority;
+  uint32_t stackSize;
+};
+
+struct TaskLayout {
+  const char* name;
+  TaskPlacement tasks[TASK_COUNT];
+};
+
+extern const TaskLayout TASK_LAYOUTS[];
+extern const int TASK_LAYOUT_COUNT;
+
+// Carga el layout guardado en NVS (llamar antes de crear los drivers)
+void loadTaskLayout();
+
+// Ubicación de una task según el layout activo
+const TaskPlacement& getTaskPlacement(TaskId id);
+int getActiveTaskLayout();
+
+// Cambia el layout activo y recrea las tasks de los drivers. Falla si algún
+// motor se está moviendo (sin cambiar nada). Con persist = true se guarda
+// para el próximo arranque. La task de secuencias conserva la ubicación del
+// arranque hasta reiniciar: getTaskLayoutsAsJson() la informa aparte.
+bool applyTaskLayout(int index, StepperDriver* stepper, ServoDriver* servo, bool persist);
+
+String getTaskLayoutsAsJson();
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef KEYFRAME_PATH_H
+#define KEYFRAME_PATH_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Punto clave de una trayectoria: pose absoluta en un instante
+struct Keyframe {
+  uint32_t timeMs;   // Tiempo desde el inicio de la trayectoria
+  float position;    // Posición del rail en mm (absoluta respecto del cero)
+  float angle;       // Ángulo del servo 0-180°
+};
+
+enum InterpolationType {
+  INTERP_CATMULL_ROM,  // Suave, puede sobrepasar los puntos clave
+  INTERP_MONOTONE      // Fritsch-Carlson: sin sobrepasos entre puntos clave
+};
+
+// Trayectoria cúbica por tramos sobre (tiempo -> posición, ángulo).
+// Los coeficientes se calculan una sola vez en compile(); sample() solo
+// evalúa un polinomio de Horner por eje.
+class KeyframePath {
+private:
+  // Coeficientes de un tramo para un eje: p(u) = a + b·u + c·u² + d·u³, u ∈ [0,1]
+  struct Cubic {
+    float a, b, c, d;
+    float eval(float u) const { return a + u * (b + u * (c + u * d)); }
+  };
+
+  struct Segment {
+    uint32_t startMs;
+    float invDuration;   // 1 / duración en ms
+    Cubic position;
+    Cubic angle;
+  };
+
+  std::vector<Keyframe> keyframes;
+  std::vector<Segment> segments;
+  InterpolationType interpolation;
+  bool compiled;
+
+  void computeTangents(const std::vector<float>& values, std::vector<float>& tangents) const;
+
+public:
+  // Estado del muestreo: índice del tramo actual
+  typedef size_t Cursor;
+
+  KeyframePath();
+
+  // Edición (invalida los coeficientes)
+  bool addKeyframe(const Keyframe& keyframe);
+  void clear();
+  void setInterpolation(InterpolationType type);
+
+  // Precalcula los coeficientes de todos los tramos
+  bool compile();
+
+  // Evalúa la trayectoria en tMs. 'cursor' guarda el tramo actual para que
+  // un muestreo con tiempo creciente sea O(1).
+  void sample(uint32_t tMs, Cursor& cursor, float& position, float& angle) const;
+
+  bool isCompiled() const { return compiled; }
+  size_t getKeyframeCount() const { return keyframes.size(); }
+  const std::vector<Keyframe>& getKeyframes() const { return keyframes; }
+  InterpolationType getInterpolation() const { return interpolation; }
+  uint32_t getDurationMs() const { return keyframes.empty() ? 0 : keyframes.back().timeMs; }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef MOTION_CONTROLLER_H
+#define MOTION_CONTROLLER_H
+
+#include <Arduino.h>
+#include <ESP32Servo.h>
+#include <esp_timer.h>
+#include "drivers/MotionLimits.h"
+#include "CommandTargets.h"
+
+// Controlador de movimiento multi-eje. Un único timer de hardware genera
+// los pasos de todos los ejes registrados (DDA) a partir de un buffer de
+// segmentos por eje: agregar un eje (tilt, foco...) no agrega tasks.
+
+#ifndef MOTION_TICK_HZ
+#define MOTION_TICK_HZ 20000         // Frecuencia del timer compartido
+#endif
+
+#ifndef MOTION_TIMER_INDEX
+#define MOTION_TIMER_INDEX 0
+#endif
+
+#define MOTION_SEGMENT_BUFFER 16     // Segmentos en cola por eje
+#define MOTION_REFRESH_MS 20         // Refresco de salidas lentas (PWM del servo)
+#define MOTION_DECEL_MS 200          // Duración de la rampa de frenado
+#define MOTION_DECEL_STAGES 4        // Escalones de velocidad de la rampa
+
+// 'steps' unidades del eje repartidas uniformemente en 'ticks' del timer
+struct MotionSegment {
+  int32_t steps;
+  uint32_t ticks;
+};
+
+// Parte común de todos los ejes: cola de segmentos y DDA. El ISR llama a
+// tick(); las salidas concretas se implementan en Axis<Output>.
+class MotionAxis {
+private:
+  MotionSegment buffer[MOTION_SEGMENT_BUFFER];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  portMUX_TYPE bufferMux;
+
+  // Segmento en curso (solo lo toca el ISR)
+  volatile bool active;
+  bool pulseHigh;
+  uint32_t absSteps;
+  uint32_t stepsLeft;
+  uint32_t ticksLeft;
+  uint32_t totalTicks;
+  uint32_t accumulator;
+  bool forward;
+
+protected:
+  const char* name;
+  volatile int32_t position;   // Unidades del eje
+  uint32_t maxRate;            // Unidades por segundo
+  float unitsPerUser;          // Unidades del eje por unidad de usuario (grado, paso...)
+
+  // Salida del eje para el ISR. Punteros a funciones en IRAM en lugar de
+  // métodos virtuales: la vtable vive en flash y el ISR puede correr con la
+  // caché deshabilitada.
+  void* outputHandle;
+  void (*setDirectionFn)(void* output, bool forward);
+  void (*stepFn)(void* output);
+  void (*endPulseFn)(void* output);
+
+public:
+  MotionAxis(const char* axisName, uint32_t rate, float scale);
+  virtual ~MotionAxis() {}
+
+  virtual bool begin() = 0;
+  virtual void refresh() {}      // Desde el timer lento, fuera del ISR
+  virtual bool isAbsolute() const = 0;
+
+  void IRAM_ATTR tick();
+
+  bool pushSegment(const MotionSegment& segment);
+  int getFreeSegments();
+  bool isIdle();
+  void abort();
+  void IRAM_ATTR halt();         // abort() desde el ISR del timer
+  // Reemplaza lo pendiente por una rampa de bajada desde la velocidad actual
+  void decelerate(uint32_t rampMs);
+
+  const char* getName() const { return name; }
+  int32_t getPosition() const { return position; }
+  uint32_t getMaxRate() const { return maxRate; }
+  int32_t toAxisUnits(float value) const { return lroundf(value * unitsPerUser); }
+  float toUserUnits(int32_t units) const { return units / unitsPerUser; }
+};
+
+// Salida STEP/DIR/ENA (TB6600, A4988...). El pulso dura un tick del timer.
+class StepDirOutput {
+private:
+  int pinPUL;
+  int pinDIR;
+  int pinENA;
+
+public:
+  StepDirOutput(int pul, int dir, int ena) : pinPUL(pul), pinDIR(dir), pinENA(ena) {}
+
+  bool begin(int32_t) {
+    pinMode(pinPUL, OUTPUT);
+    pinMode(pinDIR, OUTPUT);
+    digitalWrite(pinPUL, LOW);
+    if (pinENA >= 0) {
+      pinMode(pinENA, OUTPUT);
+      digitalWrite(pinENA, LOW);  // LOW = habilitado
+    }
+    return true;
+  }
+  inline void IRAM_ATTR setDirection(bool forward) { digitalWrite(pinDIR, forward ? HIGH : LOW); }
+  inline void IRAM_ATTR step() { digitalWrite(pinPUL, HIGH); }
+  inline void IRAM_ATTR endPulse() { digitalWrite(pinPUL, LOW); }
+  void refresh(int32_t) {}
+  static bool isAbsolute() { return false; }
+};
+
+// Salida servo PWM. El ISR solo mueve la posición (centésimas de grado);
+// el ancho de pulso se escribe en refresh(), que no corre en el ISR.
+class ServoPwmOutput {
+private:
+  static const int MIN_PULSE_US = 500;
+  static const int MAX_PULSE_US = 2400;
+
+  Servo servo;
+  int pin;
+  int32_t lastWritten;
+
+public:
+  explicit ServoPwmOutput(int servoPin) : pin(servoPin), lastWritten(-1) {}
+
+  bool begin(int32_t position) {
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    refresh(position);
+    return true;
+  }
+  inline void IRAM_ATTR setDirection(bool) {}
+  inline void IRAM_ATTR step() {}
+  inline void IRAM_ATTR endPulse() {}
+  void refresh(int32_t position) {
+    if (position == lastWritten) return;
+    int32_t clamped = constrain(position, 0, 18000);
+    servo.writeMicroseconds(map(clamped, 0, 18000, MIN_PULSE_US, MAX_PULSE_US));
+    lastWritten = position;
+  }
+  static bool isAbsolute() { return true; }
+};
+
+// Eje concreto: la salida se resuelve en compilación y sus métodos se
+// inlinean dentro del ISR
+template <typename Output>
+class Axis : public MotionAxis {
+private:
+  Output output;
+
+  static void IRAM_ATTR setDirectionOf(void* out, bool forward) { static_cast<Output*>(out)->setDirection(forward); }
+  static void IRAM_ATTR stepOf(void* out) { static_cast<Output*>(out)->step(); }
+  static void IRAM_ATTR endPulseOf(void* out) { static_cast<Output*>(out)->endPulse(); }
+
+public:
+  Axis(const char* axisName, const Output& out, uint32_t rate, float scale, int32_t home = 0)
+    : MotionAxis(axisName, rate, scale), output(out) {
+    position = home;
+    outputHandle = &output;
+    setDirectionFn = setDirectionOf;
+    stepFn = stepOf;
+    endPulseFn = endPulseOf;
+  }
+
+  bool begin() override { return output.begin(position); }
+  void refresh() override { output.refresh(position); }
+  bool isAbsolute() const override { return Output::isAbsolute(); }
+};
+
+class MotionController : public AxesControl {
+private:
+  MotionAxis* axes[MAX_MOTION_AXES];
+  int axisCount;
+  hw_timer_t* timer;
+  esp_timer_handle_t refreshTimer;
+  volatile bool halted;          // Parada de emergencia: el ISR descarta todo
+
+  static MotionController* instance;
+  static void IRAM_ATTR onTimer();
+  static void onRefresh(void* arg);
+
+public:
+  MotionController();
+
+  // Registrar los ejes antes de begin()
+  int addAxis(MotionAxis* axis);
+  bool begin();
+
+  int getAxisCount() const override { return axisCount; }
+  MotionAxis* getAxis(int index) const;
+  int32_t toAxisUnits(int axis, float value) const override { return axes[axis]->toAxisUnits(value); }
+
+  // Movimiento relativo de un eje en unidades del eje a 'rate' unidades/s
+  bool queueMove(int axis, int32_t delta, uint32_t rate) override;
+  uint64_t estimateMoveMicros(int axis, int32_t delta, uint32_t rate) const;
+
+  // Velocidad 0-100% del máximo del eje
+  uint32_t rateForSpeed(int axis, int speed) const override;
+
+  bool isIdle() const;
+  void waitIdle();
+  void stopAll();
+  void decelerateAll(uint32_t rampMs = MOTION_DECEL_MS);
+
+  // Parada de emergencia: desde el próximo tick ningún eje genera pasos y
+  // los segmentos encolados se descartan hasta clearHalt()
+  void IRAM_ATTR halt() { halted = true; }
+  void clearHalt() { halted = false; }
+  bool isHalted() const { return halted; }
+
+  String getAxesAsJson() const override;
+};
+
+#endif
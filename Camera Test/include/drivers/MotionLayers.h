@@ -0,0 +1,82 @@
+#ifndef MOTION_LAYERS_H
+#define MOTION_LAYERS_H
+
+#include <Arduino.h>
+
+// Capas de movimiento aditivas sobre una trayectoria base (puntos clave o
+// grabada): un barrido lento del pan o una oscilación suave sobre un dolly
+// lineal sin cientos de movimientos cortos. Se suman en cada tick de
+// control del ejecutor. set() pasa todo a enteros (pasos, centésimas de
+// grado, fase de 32 bits); evaluate() no usa flotantes ni divisiones.
+
+#define MAX_MOTION_LAYERS 8
+
+#define LAYER_SINE_BITS 8            // Cuarto de onda del seno en 2^8 tramos
+#define LAYER_MIN_PERIOD_MS 100      // 5 ticks de control por periodo como mínimo
+
+enum LayerAxis : uint8_t {
+  LAYER_RAIL,        // Amplitud en mm
+  LAYER_PAN          // Amplitud en grados
+};
+
+enum LayerShape : uint8_t {
+  LAYER_SINE,
+  LAYER_TRIANGLE,
+  LAYER_CURVE        // Una sola vez: 0 -> amplitud en la ventana (smoothstep)
+};
+
+// Capa en unidades de usuario (formato de la API)
+struct MotionLayer {
+  LayerAxis axis;
+  LayerShape shape;
+  float amplitude;           // Pico de la oscilación o desplazamiento final de la curva
+  uint32_t periodMs;         // Solo periódicas
+  float phaseDeg;            // Solo periódicas
+  uint32_t startMs;          // Ventana dentro de la trayectoria base
+  uint32_t durationMs;       // 0 = hasta el final de la trayectoria
+  uint32_t fadeMs;           // Entrada y salida de la amplitud (periódicas)
+};
+
+class MotionLayers {
+private:
+  struct Compiled {
+    uint8_t axis;
+    uint8_t shape;
+    int32_t amplitude;       // Pasos o centésimas de grado
+    uint32_t phase0;         // Fase inicial (2^32 = una vuelta)
+    uint32_t phaseStep;      // Avance de fase por ms
+    uint32_t startMs;
+    uint32_t endMs;          // 0 = fin de la trayectoria
+    uint32_t invFade;        // 2^32 / fadeMs (0 = sin fundido)
+    uint32_t invDuration;    // 2^32 / duración (curvas)
+  };
+
+  MotionLayer layers[MAX_MOTION_LAYERS];
+  Compiled compiled[MAX_MOTION_LAYERS];
+  int count;
+
+  // Seno de un cuarto de onda en Q15, con el extremo incluido
+  static int16_t sineTable[(1 << LAYER_SINE_BITS) + 1];
+  static bool tableReady;
+  static void buildTable();
+  static int32_t sineQ15(uint32_t phase);
+  static int32_t triangleQ15(uint32_t phase);
+
+public:
+  MotionLayers();
+
+  // Reemplaza las capas. 'stepsPerMm' convierte las del rail. Devuelve
+  // false (sin cambios) si alguna es inválida.
+  bool set(const MotionLayer* source, int layerCount, float stepsPerMm);
+
+  int getCount() const { return count; }
+  const MotionLayer& getLayer(int index) const { return layers[index]; }
+
+  // Desplazamientos en 'tMs' del reloj de la trayectoria base, de duración
+  // 'totalMs'
+  void evaluate(uint32_t tMs, uint32_t totalMs, int32_t& railSteps, int32_t& panCdeg) const;
+
+  String getAsJson() const;
+};
+
+#endif
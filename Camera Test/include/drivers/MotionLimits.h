@@ -0,0 +1,8 @@
+#ifndef MOTION_LIMITS_H
+#define MOTION_LIMITS_H
+
+// Cantidad de ejes del MotionController. Aparte de MotionController.h para
+// que el modelo de secuencias no dependa del timer ni de ESP32Servo.
+#define MAX_MOTION_AXES 4
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef MOTION_PROGRAM_H
+#define MOTION_PROGRAM_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Programa de movimiento en bytecode: repeticiones anidadas ("estos 3
+// movimientos 20 veces, después estos 2") sin expandirlas en el pool. Cada
+// instrucción es un opcode de un byte seguido de sus argumentos en varint
+// (zigzag los que llevan signo), como en RecordedPath: un movimiento típico
+// ocupa 3-4 bytes y un programa complejo, unos cientos. El ensamblador está
+// en la interfaz web (data/script.js); el ESP32 solo verifica y ejecuta.
+
+#define MAX_PROGRAM_BYTES 1024
+#define MAX_PROGRAM_DEPTH 4          // Bucles anidados
+#define MAX_PROGRAM_LOOP 65535       // Repeticiones por bucle
+
+enum ProgramOp : uint8_t {
+  OP_END,            // Fin del programa (última instrucción)
+  OP_MOVE,           // zigzag: centésimas de mm, relativo
+  OP_TURN,           // Ángulo absoluto 0-180°
+  OP_MOVE_TURN,      // zigzag centésimas de mm + ángulo, ambos a la vez
+  OP_PAUSE,          // ms
+  OP_SHUTTER,        // Disparo de cámara
+  OP_LOOP,           // Repeticiones (1-MAX_PROGRAM_LOOP) hasta su OP_ENDLOOP
+  OP_ENDLOOP,
+  OP_WAIT,           // Espera del go (REST o GPIO); ms máximos, 0 = sin límite
+  OP_SPEED,          // Velocidad stepper y servo 1-100% de lo que sigue
+  PROGRAM_OP_COUNT
+};
+
+// Instrucción decodificada
+struct ProgramInstruction {
+  uint8_t op;
+  int32_t a;         // Centésimas de mm, ángulo, ms, repeticiones o % stepper
+  int32_t b;         // Ángulo de OP_MOVE_TURN o % servo de OP_SPEED
+};
+
+class MotionProgram {
+private:
+  std::vector<uint8_t> code;
+  uint16_t instructionCount;
+  uint8_t depth;               // Anidamiento máximo de bucles
+
+  static bool readVarint(const uint8_t* bytes, size_t length, size_t& offset, uint32_t& value);
+
+public:
+  MotionProgram();
+
+  // Copia y verifica el programa: opcodes conocidos, argumentos en rango,
+  // bucles balanceados y no vacíos, profundidad acotada y OP_END al final.
+  // 'error' describe el primer problema (con su byte).
+  bool load(const uint8_t* bytes, size_t length, String& error);
+
+  // Decodifica la instrucción en 'pc' y lo avanza. Solo para programas ya
+  // verificados: no revisa límites.
+  void decode(size_t& pc, ProgramInstruction& instruction) const;
+
+  bool isLoaded() const { return !code.empty(); }
+  size_t getByteSize() const { return code.size(); }
+  uint16_t getInstructionCount() const { return instructionCount; }
+  uint8_t getDepth() const { return depth; }
+
+  String getAsJson() const;
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef PROGRAM_ANALYSIS_H
+#define PROGRAM_ANALYSIS_H
+
+#include <Arduino.h>
+#include "drivers/SequenceTypes.h"
+
+// Análisis de un MotionProgram sin desenrollar sus bucles. El recorrido del
+// bytecode no depende del hardware: el costo de cada movimiento lo pone un
+// ProgramMovementModel (en el ESP32, SequenceManager con las estimaciones
+// de los drivers), así que se puede verificar en el host contra el
+// programa desenrollado.
+
+// Velocidades vigentes de un programa (OP_SPEED), 1-100%
+struct ProgramSpeeds {
+  uint8_t stepper = 50;
+  uint8_t servo = 50;
+};
+
+class ProgramMovementModel {
+public:
+  virtual ~ProgramMovementModel() {}
+
+  // Suma OP_MOVE / OP_TURN / OP_MOVE_TURN al análisis: duración, posición
+  // final y envolvente, ángulos, velocidad pico y sentidos del juego
+  virtual void accumulateProgramMove(SequenceAnalysis& analysis, const ProgramInstruction& instruction,
+                                     const ProgramSpeeds& speeds) const = 0;
+};
+
+// Recorre un bloque del programa (todo desde pc = 0 o el cuerpo de un bucle)
+// y devuelve el pc tras su OP_END u OP_ENDLOOP. Solo programas verificados.
+size_t analyzeProgramBlock(const MotionProgram& program, size_t pc, ProgramSpeeds& speeds,
+                           SequenceAnalysis& analysis, const ProgramMovementModel& model);
+
+#endif
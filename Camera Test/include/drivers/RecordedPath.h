@@ -0,0 +1,55 @@
+#ifndef RECORDED_PATH_H
+#define RECORDED_PATH_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Punto de una trayectoria grabada, en las unidades de los drivers
+struct RecordedPoint {
+  uint32_t timeMs;   // Tiempo desde el inicio de la grabación
+  int32_t steps;     // Posición del stepper (absoluta respecto del cero)
+  int16_t angle;     // Ángulo del servo en grados
+};
+
+// Trayectoria grabada en modo teach. Cada punto se guarda como deltas
+// respecto del anterior en varint (zigzag para los signos): un tramo de jog
+// ocupa 4-6 bytes en lugar de los 52 de un Keyframe compilado. Se reproduce
+// interpolando linealmente, el mismo criterio con que se simplificó al
+// grabar, así que el error queda acotado por la tolerancia de grabación.
+class RecordedPath {
+public:
+  // Tramo actual y byte del siguiente punto: un muestreo con tiempo
+  // creciente decodifica cada punto una sola vez
+  struct Cursor {
+    size_t next = 0;
+    RecordedPoint from = {};
+    RecordedPoint to = {};
+  };
+
+private:
+  std::vector<uint8_t> data;
+  RecordedPoint last;          // Base del próximo delta
+  uint32_t pointCount;
+  float mmPerStep;
+
+  static void writeVarint(std::vector<uint8_t>& out, uint32_t value);
+  static uint32_t readVarint(const std::vector<uint8_t>& in, size_t& offset);
+  void decode(size_t& offset, RecordedPoint& point) const;
+
+public:
+  explicit RecordedPath(float mmPerStepValue);
+
+  // Los tiempos deben ser estrictamente crecientes
+  bool append(const RecordedPoint& point);
+  void shrink() { data.shrink_to_fit(); }
+
+  // Misma interfaz que KeyframePath para el ejecutor (posición en mm)
+  void sample(uint32_t tMs, Cursor& cursor, float& position, float& angle) const;
+  bool isCompiled() const { return pointCount >= 2; }
+  uint32_t getDurationMs() const { return pointCount > 0 ? last.timeMs : 0; }
+
+  uint32_t getPointCount() const { return pointCount; }
+  size_t getByteSize() const { return data.size(); }
+};
+
+#endif
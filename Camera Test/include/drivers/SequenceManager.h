@@ -6,75 +6,422 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include "drivers/SequenceTypes.h"
+#include "drivers/ProgramAnalysis.h"
+#include "drivers/MotionController.h"
+#include "CommandTargets.h"
 
 class ServoDriver;
 class StepperDriver;
 
-// Estructura de un movimiento individual
-struct Movement {
-  // Movimiento horizontal (stepper)
-  float horizontalDistance;  // Distancia en mm
-  int horizontalSpeed;       // Velocidad 0-100%
-  
-  // Movimiento angular (servo)
-  int angle;                 // Ángulo objetivo 0-180°
-  int angleSpeed;            // Velocidad angular 0-100%
-  
-  // Control
-  bool simultaneous;         // Mover ambos motores simultáneamente
-  int pauseAfter;           // Pausa después del movimiento (ms)
+#ifndef EXECUTOR_QUEUE_LENGTH
+#define EXECUTOR_QUEUE_LENGTH 8
+#endif
+
+// Pose donde arrancó la última toma, destino de la vuelta rápida
+struct TakeStart {
+  bool valid;
+  int sequence;
+  long steps;
+  int angle;
+  int axisCount;
+  int32_t axisPosition[MAX_MOTION_AXES];
+};
+
+// Objetivos absolutos del movimiento en curso. Si una pausa lo corta a
+// mitad de camino, al reanudar cada eje recorre lo que le falta desde donde
+// frenó.
+struct MoveTargets {
+  long steps;                // Posición final del stepper
+  int stepperSpeed;          // steps/s
+  int angle;                 // Ángulo final del servo (negativo = no mover)
+  int angleSpeed;
+  int axisCount;
+  uint8_t axisIndex[MAX_MOTION_AXES];
+  int32_t axisTarget[MAX_MOTION_AXES];   // Posición final en unidades del eje
+  uint32_t axisRate[MAX_MOTION_AXES];
+  bool reverseOrder = false; // Secuencial al revés: ejes, servo y stepper
+  bool rapid = false;        // Stepper con perfil trapezoidal (rapidTo)
+};
+
+// Órdenes al ejecutor. Solo la task del ejecutor cambia su estado: las
+// llamadas públicas encolan la orden y vuelven.
+enum ExecutorOp : uint8_t {
+  EXEC_START,    // 'index' = secuencia, 'flags' = ExecutorStartFlags
+  EXEC_PAUSE,
+  EXEC_RESUME,
+  EXEC_STOP,
+  EXEC_SEEK,     // 'value' = movimiento (secuencias) o ms (trayectorias)
+  EXEC_GO        // Arranque de la secuencia armada
+};
+
+enum ExecutorStartFlags : uint8_t {
+  EXEC_FLAG_ARM      = 0x01,
+  EXEC_FLAG_PLAYLIST = 0x02,
+  EXEC_FLAG_REVERSE  = 0x04,
+  EXEC_FLAG_PINGPONG = 0x08,
+  EXEC_FLAG_RETURN   = 0x10   // Vuelta rápida a la pose inicial de la última toma
+};
+
+struct ExecutorCommand {
+  uint8_t op;
+  uint8_t flags;
+  int16_t index;
+  uint32_t value;
+  int64_t stampUs;   // Momento del pedido (latencia de control)
+};
+
+enum ExecutorState : uint8_t {
+  EXEC_IDLE,
+  EXEC_ARMED,        // En la pose inicial (o llegando) a la espera del go
+  EXEC_RUNNING,
+  EXEC_PAUSED
 };
 
-// Estructura de una secuencia completa
-struct Sequence {
-  String name;
-  std::vector<Movement> movements;
-  bool loop;
-  int repeatCount;
+// Estado publicado por el ejecutor, decodificado de una sola palabra de 32
+// bits: quien lo lee nunca ve una mezcla de dos estados
+struct ExecutorStatus {
+  ExecutorState state;
+  int sequence;      // -1 = ninguna
+  int entry;         // Entrada de la playlist
+  uint8_t run;       // Contador de ejecuciones (distingue una de la siguiente)
 };
 
-class SequenceManager {
+// Latencia desde que se encola una orden hasta que el ejecutor la aplica
+struct ControlStats {
+  uint32_t commands;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t dropped;          // Cola llena
+};
+
+// Arranque armado: desde el "go" hasta que el ejecutor despierta. La
+// latencia hasta el primer paso la mide StepperDriver (FirstStepStats).
+struct ArmStats {
+  uint32_t goCount;
+  uint32_t lastWakeUs;
+  uint32_t maxWakeUs;
+  uint32_t lastPrepareMs;    // Llegada a la pose inicial
+};
+
+// Empalme entre entradas: desde que termina una hasta que arranca la
+// siguiente (verificación de límites con el análisis ya precargado)
+struct HandoffStats {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t prefetchMisses;   // Análisis que no se alcanzó a precargar
+};
+
+class SequenceManager : public SequenceControl, private ProgramMovementModel {
 private:
   ServoDriver* servoDriver;
   StepperDriver* stepperDriver;
+  MotionController* motion;
   
-  std::vector<Sequence> sequences;
+  PackedMovement* pool;
+  uint32_t poolCapacity;       // Registros del pool (fijado en begin())
+  AnalysisBlock* blockPool;    // Un lugar por ANALYSIS_BLOCK_MOVEMENTS registros
+  Sequence sequences[MAX_SEQUENCES];
+  FrameGenerator generators[MAX_GENERATORS];
+  bool generatorUsed[MAX_GENERATORS];
+  void (*shutterCallback)();
+  
+  // Límites de seguridad verificados antes de ejecutar
+  bool softLimitsEnabled;
+  long softMinSteps;
+  long softMaxSteps;
+  uint32_t speedCap;         // steps/s (0 = máximo del driver)
+  volatile uint16_t feedPercent;   // Override de avance global
+  bool driverFeed;                 // Los drivers aplican feedPercent
+  uint64_t executionEstimateUs;
+  unsigned long executionStartMillis;
   int activeSequenceIndex;
+  
+  // Estado del ejecutor: solo lo escribe su task (las demás leen
+  // executorWord o toman el mutex)
   bool isExecuting;
   bool isPaused;
+  bool startPending;             // EXEC_START encolado y aún sin aplicar
+  bool seekPending;
+  uint32_t seekValue;
+  uint8_t runCount;
+  volatile uint32_t executorWord;
+  ControlStats controlStats;
+  
+  // Arranque armado (armSequence / go)
+  volatile bool armed;           // La task espera el go
+  volatile bool armReady;        // Ya en la pose inicial
+  bool goRequested;
+  int64_t goRequestUs;
+  ArmStats armStats;
+  
+  // Sentido de la ejecución en curso y pose de arranque de la toma
+  PlaybackMode playMode;
+  bool takeStartPending;         // Se registra al empezar la primera pasada
+  TakeStart takeStart;
+  
+  // Reanudación tras un corte (resumeSequence): la primera pasada empieza
+  // en el punto de control
+  bool resumePending;
+  int resumeIndex;
+  uint16_t resumePass;
+  uint16_t resumeRecord;
+  uint32_t resumeFrame;
+  
+  // Playlist: el ejecutor la recorre sin terminar la task
+  PlaylistEntry playlist[MAX_PLAYLIST_ENTRIES];
+  int playlistCount;
+  bool playlistLoop;
+  bool playlistActive;           // La ejecución en curso es la playlist
+  int playlistPosition;          // Entrada en curso
+  volatile bool prefetchPending; // La siguiente entrada aún no se analizó
+  uint64_t playlistEstimateUs;
+  unsigned long playlistStartMillis;
+  HandoffStats handoffStats;
   
-  TaskHandle_t executionTask;
+  TaskHandle_t executionTask;   // Task permanente, creada en begin()
+  QueueHandle_t commandQueue;
   SemaphoreHandle_t mutex;
   
   static void executionTaskFunc(void* parameter);
-  void executeMovement(const Movement& movement);
+  void runExecution(const ExecutorCommand& start);
+  bool postCommand(ExecutorOp op, uint32_t value = 0, bool urgent = false);
+  void serviceCommands(uint32_t waitMs);
+  void handleCommand(const ExecutorCommand& command);
+  void publishState();
+  void applyDriverFeed(bool enabled);
+  uint32_t feedScaled(uint32_t ms) const;
+  void sleepUntil(TickType_t& lastWake, TickType_t period);
+  void executeMovement(const PackedMovement& movement, const PackedMovement* axes, int axisCount,
+                       bool mirrored = false);
+  void holdPause(uint16_t pause);
+  bool idleFor(uint32_t& remaining);
+  bool waitFor(uint32_t ms);
+  template <typename Path> void executePath(const Path& path, uint16_t percent, const MotionLayers* layers,
+                                            bool reverse = false);
+  void executeGenerator(const FrameGenerator& generator, uint32_t firstFrame = 0);
+  void executeProgram(const MotionProgram& program);
+  bool waitForInput(uint32_t timeoutMs);
+  PackedMovement programMovement(const ProgramInstruction& instruction, const ProgramSpeeds& speeds) const;
+  bool runSequence(int sequenceIndex, int passes, bool loop);
+  void runPlaylist();
+  void prefetchNext();
+  void markTakeStart();
+  void beginCheckpointRun(int sequenceIndex);
+  void runReturn();
+  bool passReversed(int pass) const;
+  
+  bool startExecution(int sequenceIndex, bool arm, bool withPlaylist = false,
+                      PlaybackMode mode = PLAY_FORWARD);
+  bool prepareArmed(int index);
+  
+  // Pausa y frenado controlado
+  bool waitWhilePaused();
+  bool driveTo(const MoveTargets& targets, bool simultaneous, uint32_t pollMs = 50);
+  bool moveToPose(long steps, int angle);
+  bool motorsBusy(bool withAxes) const;
+  void decelerateMotors();
+  
+  // Pool (llamar con el mutex tomado)
+  bool isValidIndex(int index) const;
+  int recordIndex(const Sequence& seq, int movementIndex) const;
+  int recordSpan(const Sequence& seq, int record) const;
+  int previousRecord(const Sequence& seq, int record) const;
+  uint16_t angleBefore(const Sequence& seq, int record) const;
+  bool allocateRange(uint16_t capacity, uint16_t& offset);
+  uint32_t largestFreeRange() const;
+  void compactPool();
+  bool growSequence(Sequence& seq);
+  bool appendPacked(int sequenceIndex, const PackedMovement& packed);
+  bool reserveRecords(Sequence& seq, int extra);
+  void spliceRecords(Sequence& seq, int record, int removeCount,
+                     const PackedMovement* records, int insertCount);
+  int movementCount(const Sequence& seq) const;
+  SequenceEditResult checkEditable(int sequenceIndex, uint32_t expectedVersion, bool movements) const;
+  void releaseGenerators(const PackedMovement* movements, int count);
+  
+  bool packMovement(const Movement& movement, PackedMovement& packed);
+  int packRecords(const Movement& movement, PackedMovement* records);
+  Movement unpackMovement(const PackedMovement& packed) const;
+  Movement unpackRecords(const Sequence& seq, int record, int span) const;
+  size_t jsonBytes(const Sequence& seq, int movements) const;
+  
+  // Análisis (llamar con el mutex tomado)
+  void resetAnalysis(SequenceAnalysis& analysis) const;
+  void accumulateMovement(SequenceAnalysis& analysis, const PackedMovement& movement) const;
+  void analyzeSequence(const Sequence& seq) const;
+  void startSummary(SequenceAnalysis& summary, const SequenceAnalysis& before) const;
+  static void appendSummary(SequenceAnalysis& analysis, const SequenceAnalysis& summary);
+  AnalysisBlock* sequenceBlocks(const Sequence& seq) const;
+  void appendToBlocks(Sequence& seq, const PackedMovement& packed);
+  void spliceBlocks(Sequence& seq, int record, int recordDelta, int movementDelta);
+  void refreshBlocks(const Sequence& seq, int from, int through) const;
+  int blockPrefix(const Sequence& seq, int movementIndex, SequenceAnalysis& prefix, int& number) const;
+  void analyzePath(const Sequence& seq) const;
+  template <typename Path> void analyzeTrajectory(const Path& path, uint16_t percent,
+                                                  const MotionLayers* layers,
+                                                  SequenceAnalysis& analysis) const;
+  void applyLayers(const MotionLayers* layers, uint32_t tMs, uint32_t totalMs,
+                   long& steps, float& angle) const;
+  void accumulateProgramMove(SequenceAnalysis& analysis, const ProgramInstruction& instruction,
+                             const ProgramSpeeds& speeds) const override;
+  bool pathStartPose(const Sequence& seq, long& steps, float& angle, bool fromEnd = false) const;
+  uint64_t movementDurationUs(const PackedMovement& movement, int fromAngle, uint64_t* moveUs = nullptr) const;
+  uint64_t generatorDurationUs(const FrameGenerator& generator, int fromAngle) const;
+  uint64_t transitionUs(const Sequence& seq, long fromSteps, int fromAngle) const;
+  uint64_t startupDurationUs(const Sequence& seq) const;
+  bool checkLimits(const Sequence& seq, long start, int passes, bool loop, String& reason,
+                   PlaybackMode mode = PLAY_FORWARD) const;
+  long chainEndSteps(const Sequence& seq, long start, int passes) const;
+  bool checkPlaylist(String& reason, uint64_t* estimateUs = nullptr) const;
+  bool isSequenceBusy(int index) const;
   
 public:
-  SequenceManager(ServoDriver* servo, StepperDriver* stepper);
+  SequenceManager(ServoDriver* servo, StepperDriver* stepper, MotionController* motionController = nullptr);
   ~SequenceManager();
   
   bool begin();
   
-  // Gestión de secuencias
-  int createSequence(const String& name);
-  bool deleteSequence(int index);
-  bool addMovement(int sequenceIndex, const Movement& movement);
-  bool removeMovement(int sequenceIndex, int movementIndex);
-  bool clearSequence(int sequenceIndex);
+  // Gestión de secuencias. createSequence reserva 'capacity' movimientos
+  // y devuelve -1 si no entran en el pool (control de admisión).
+  int createSequence(const String& name, SequenceType type = SEQUENCE_MOVEMENTS,
+                     uint16_t capacity = 16) override;
+  bool deleteSequence(int index) override;
+  bool addMovement(int sequenceIndex, const Movement& movement) override;
+  
+  // Edición in situ: una sola operación sin importar el largo de la
+  // secuencia. Con expectedVersion != 0 falla (EDIT_STALE) si la secuencia
+  // cambió desde que se leyó esa versión. No se editan secuencias en uso.
+  // clearSequence vacía cualquier tipo (movimientos, puntos clave,
+  // grabación o programa) y conserva nombre, capacidad y opciones.
+  SequenceEditResult clearSequence(int sequenceIndex, uint32_t expectedVersion = 0);
+  SequenceEditResult updateMovement(int sequenceIndex, int movementIndex, const Movement& movement,
+                                    uint32_t expectedVersion = 0) override;
+  // movementIndex = cantidad de movimientos agrega al final
+  SequenceEditResult insertMovement(int sequenceIndex, int movementIndex, const Movement& movement,
+                                    uint32_t expectedVersion = 0) override;
+  // Lleva el movimiento 'from' a la posición 'to' (las demás se corren)
+  SequenceEditResult moveMovement(int sequenceIndex, int from, int to, uint32_t expectedVersion = 0) override;
+  SequenceEditResult removeMovement(int sequenceIndex, int movementIndex, uint32_t expectedVersion = 0) override;
+  // Pasadas por ejecución (1-1000) y repetición continua
+  SequenceEditResult setRepeat(int sequenceIndex, bool loop, int repeatCount, uint32_t expectedVersion = 0) override;
+  
+  // Agrega un movimiento generador (timelapse) en una sola operación
+  bool addGenerator(int sequenceIndex, const FrameGenerator& generator) override;
+  
+  // Disparo de cámara para los generadores (definido en main.cpp)
+  void setShutterCallback(void (*callback)()) { shutterCallback = callback; }
+  
+  // Carga todos los puntos clave de una vez y precalcula la trayectoria
+  bool setKeyframes(int sequenceIndex, const std::vector<Keyframe>& keyframes,
+                    InterpolationType interpolation) override;
+  
+  // Asigna una trayectoria grabada a una secuencia SEQUENCE_RECORDED. La
+  // secuencia pasa a ser dueña de 'recording' (también si falla).
+  bool setRecording(int sequenceIndex, RecordedPath* recording) override;
+  
+  // Asigna un programa ya verificado a una secuencia SEQUENCE_PROGRAM. La
+  // secuencia pasa a ser dueña de 'program' (también si falla).
+  bool setProgram(int sequenceIndex, MotionProgram* program) override;
+  
+  // Escala de tiempo de las trayectorias: 200 = doble de rápido (10-400%)
+  bool setPlaybackSpeed(int sequenceIndex, int percent) override;
   
-  // Ejecución
-  bool executeSequence(int sequenceIndex);
-  void pause();
-  void resume();
-  void stop();
+  // Capas aditivas sobre la trayectoria (puntos clave o grabada), en el
+  // reloj de la trayectoria base. count = 0 las quita.
+  bool setLayers(int sequenceIndex, const MotionLayer* layers, int count) override;
+  
+  // Límites verificados por executeSequence() con el análisis en caché
+  void setSoftLimits(float minMm, float maxMm) override;
+  void disableSoftLimits() override;
+  void setSpeedCap(uint32_t stepsPerSecond) override;
+  String getLimitsAsJson() const override;
+  
+  // Override de avance global (FEED_OVERRIDE_MIN-MAX %), válido también con
+  // la secuencia en marcha: escala las velocidades de stepper y servo, las
+  // pausas, el intervalo de los generadores y el reloj de las trayectorias.
+  // Falla si la secuencia en curso superaría el tope de velocidad.
+  bool setFeedOverride(int percent, String& reason) override;
+  int getFeedOverride() const override { return feedPercent; }
+  
+  // Recalcular los análisis tras cambiar el modelo de tiempos de los
+  // drivers (p. ej. el juego). Las secuencias en uso conservan el suyo.
+  void invalidateAnalyses() override;
+  
+  // Devuelve false y el motivo si la secuencia no debe ejecutarse
+  bool validateSequence(int sequenceIndex, String& reason, PlaybackMode mode = PLAY_FORWARD) override;
+  
+  // Ejecución. En reversa cada movimiento vuelve a la pose anterior en
+  // orden inverso (la pausa de cada pose se conserva) y las trayectorias
+  // corren con el reloj hacia atrás.
+  bool executeSequence(int sequenceIndex, PlaybackMode mode = PLAY_FORWARD) override;
+  
+  // Crea la task, lleva los ejes a la pose inicial, mantiene la corriente
+  // y espera go(). El arranque no paga la creación de la task ni la
+  // llegada a la pose.
+  bool armSequence(int sequenceIndex, PlaybackMode mode = PLAY_FORWARD) override;
+  
+  // Vuelta rápida a la pose donde arrancó la última toma: stepper a la
+  // velocidad máxima (o al tope) con perfil trapezoidal, servo y ejes
+  // adicionales a su máximo, todos a la vez. Se pausa y detiene como una
+  // secuencia. 'etaMs' = duración estimada.
+  bool rapidReturn(String& reason, uint32_t& etaMs) override;
+  bool go() override;
+  void IRAM_ATTR goFromISR();
+  // Parada de emergencia: encola el stop al frente sin esperar el mutex
+  void IRAM_ATTR stopFromISR();
+  bool getIsArmed() const { return getExecutorStatus().state == EXEC_ARMED; }
+  String getArmStatusAsJson() const override;
+  void pause() override;
+  void resume() override;
+  void stop() override;
+  
+  // Salta a un movimiento (secuencias de movimientos, índice desde 0) o a
+  // un instante en ms (trayectorias) de la ejecución en curso
+  bool seek(uint32_t position) override;
+  
+  // Copia serializada de una secuencia de movimientos para el punto de
+  // control (Checkpoint): cabecera, registros del pool y sus generadores.
+  // false si no es de movimientos o no entra en 'maxBytes'.
+  bool exportSnapshot(int sequenceIndex, std::vector<uint8_t>& out, size_t maxBytes) const;
+  // Recrea la secuencia de una copia; devuelve su índice o -1
+  int importSnapshot(const uint8_t* data, size_t length);
+  // Ejecuta hacia adelante desde una pasada, un registro del pool y, si ese
+  // registro es un generador, desde uno de sus frames
+  bool resumeSequence(int sequenceIndex, uint16_t pass, uint16_t record, uint32_t frame);
+  
+  ExecutorStatus getExecutorStatus() const;
+  String getExecutorStatusAsJson() const override;
+  
+  // Playlist: las entradas se encadenan en la misma task. El análisis de la
+  // siguiente se precarga mientras los motores ejecutan la actual.
+  bool setPlaylist(const PlaylistEntry* entries, int count, bool loop) override;
+  bool validatePlaylist(String& reason) override;
+  bool executePlaylist() override;
+  String getPlaylistAsJson() const override;
   
   // Información
-  int getSequenceCount() const { return sequences.size(); }
-  const Sequence* getSequence(int index) const;
-  bool getIsExecuting() const { return isExecuting; }
-  bool getIsPaused() const { return isPaused; }
-  String getSequenceAsJson(int index) const;
-  String getAllSequencesAsJson() const;
+  int getSequenceCount() const;
+  int getMovementCount(int sequenceIndex) const override;
+  const Sequence* getSequence(int index) const override;
+  bool getMovement(int sequenceIndex, int movementIndex, Movement& movement) const;
+  bool getGenerator(int sequenceIndex, int movementIndex, FrameGenerator& generator) const;
+  SequenceAnalysis getAnalysis(int sequenceIndex) const;
+  PoolUsage getPoolUsage() const;
+  bool getIsExecuting() const override { return getExecutorStatus().state != EXEC_IDLE; }
+  bool getIsPaused() const { return getExecutorStatus().state == EXEC_PAUSED; }
+  String getStopLatencyAsJson() const override;
+  // Cabecera, análisis y los movimientos [offset, offset + limit) con su
+  // duración y posición acumulada desde el inicio ("count" y "more" dicen
+  // si hay más). Vacío si no hay memoria para armarlo: nunca se trunca.
+  String getSequenceAsJson(int index, int offset = 0, int limit = SEQUENCE_JSON_PAGE) const override;
+  // Sin movimientos (pedirlos con getSequenceAsJson); vacío sin memoria
+  String getAllSequencesAsJson() const override;
+  String getPoolUsageAsJson() const override;
+  
+  static float applyEasing(EasingType easing, float u);
 };
 
 #endif
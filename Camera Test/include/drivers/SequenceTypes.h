@@ -0,0 +1,238 @@
+#ifndef SEQUENCE_TYPES_H
+#define SEQUENCE_TYPES_H
+
+#include <Arduino.h>
+#include <vector>
+#include "drivers/MotionLimits.h"
+#include "drivers/KeyframePath.h"
+#include "drivers/RecordedPath.h"
+#include "drivers/MotionLayers.h"
+#include "drivers/MotionProgram.h"
+
+// Modelo de datos de las secuencias, sin dependencias de FreeRTOS: lo
+// comparten SequenceManager, CommandRouter y el build native de test/.
+
+// Pool de movimientos: se reserva una sola vez en begin() con lo que deje
+// el heap libre en ese momento menos SEQUENCE_POOL_HEAP_RESERVE (WiFi, el
+// servidor web y NimBLE arrancan después), acotado por el mayor bloque
+// contiguo. SEQUENCE_POOL_MOVEMENTS es el mínimo: si no entra, begin()
+// falla. Los tramos usan offsets de 16 bits: a lo sumo 65535 registros.
+//
+// Capacidad: un PackedMovement ocupa 11 bytes contra 24 de Movement, 2,2×
+// por registro; el std::vector<Movement> anterior además crecía al doble,
+// así que con holgura la ganancia llega a ~4×, no a 5-10×. Los bloques del
+// análisis suman 2 bytes por registro (13 en total). En un ESP32 WROOM sin
+// PSRAM el mayor bloque libre al iniciar ronda los 110 KB: unos 8 600
+// movimientos (el log de arranque y /sequence/pool dan el valor real). Una codificación de longitud variable ganaría más pero perdería
+// el acceso directo por índice que usan el ejecutor, el salto y las
+// páginas de /sequence/get.
+#ifndef SEQUENCE_POOL_MOVEMENTS
+#define SEQUENCE_POOL_MOVEMENTS 4096
+#endif
+
+#define SEQUENCE_POOL_MAX_MOVEMENTS 65535
+
+#ifndef SEQUENCE_POOL_HEAP_RESERVE
+#define SEQUENCE_POOL_HEAP_RESERVE (96 * 1024)
+#endif
+
+#ifndef MAX_SEQUENCES
+#define MAX_SEQUENCES 16
+#endif
+
+#ifndef MAX_GENERATORS
+#define MAX_GENERATORS 32
+#endif
+
+#ifndef MAX_PLAYLIST_ENTRIES
+#define MAX_PLAYLIST_ENTRIES 32
+#endif
+
+#define SEQUENCE_NAME_LENGTH 24
+
+// Movimientos por página de getSequenceAsJson (/sequence/get). El JSON de
+// la secuencia entera puede pasar de 600 KB: se pide por páginas.
+#define SEQUENCE_JSON_PAGE 64
+#define SEQUENCE_JSON_MOVEMENT_BYTES 400   // Cota del JSON de un movimiento
+
+// Rango del override de avance global (%)
+#define FEED_OVERRIDE_MIN 10
+#define FEED_OVERRIDE_MAX 200
+
+// Movimiento de un eje adicional del MotionController (tilt, foco...)
+struct AxisMove {
+  bool active = false;
+  float value = 0;           // Desplazamiento relativo en unidades del eje (°, pasos...)
+  int speed = 50;            // Velocidad 0-100%
+};
+
+// Estructura de un movimiento individual (formato de la API)
+struct Movement {
+  // Movimiento horizontal (stepper)
+  float horizontalDistance;  // Distancia en mm
+  int horizontalSpeed;       // Velocidad 0-100%
+  
+  // Movimiento angular (servo)
+  int angle;                 // Ángulo objetivo 0-180° (negativo = no mover)
+  int angleSpeed;            // Velocidad angular 0-100%
+  
+  // Control
+  bool simultaneous;         // Mover ambos motores simultáneamente
+  int pauseAfter;           // Pausa después del movimiento (ms)
+  
+  // Ejes adicionales, por índice del MotionController
+  AxisMove axes[MAX_MOTION_AXES];
+};
+
+// Flags de PackedMovement
+enum MovementFlags : uint8_t {
+  MOVE_SIMULTANEOUS = 0x01,
+  MOVE_GENERATOR    = 0x02,  // 'steps' es el índice del FrameGenerator
+  MOVE_AXIS_EXT     = 0x04   // Extensión del movimiento anterior para un eje
+                             // adicional: 'steps' = delta, 'speed' = velocidad,
+                             // 'angleSpeed' = índice del eje
+};
+
+static const uint16_t ANGLE_KEEP = 0xFFFF;      // No mover el servo
+static const uint32_t PAUSE_UNIT_MS = 10;       // Resolución de la pausa
+static const uint32_t MAX_PAUSE_MS = 0xFFFF * PAUSE_UNIT_MS;
+
+// Formato almacenado: 11 bytes en lugar de los 24 de Movement
+#pragma pack(push, 1)
+struct PackedMovement {
+  int32_t steps;         // Desplazamiento relativo en micropasos
+  uint16_t angleCdeg;    // Ángulo en centésimas de grado (ANGLE_KEEP = no mover)
+  uint16_t pause;        // Pausa en unidades de PAUSE_UNIT_MS
+  uint8_t speed;         // Velocidad stepper 0-100%
+  uint8_t angleSpeed;    // Velocidad servo 0-100%
+  uint8_t flags;         // MovementFlags
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PackedMovement) == 11, "PackedMovement debe ocupar 11 bytes");
+
+enum EasingType : uint8_t {
+  EASE_LINEAR,
+  EASE_IN,
+  EASE_OUT,
+  EASE_IN_OUT
+};
+
+// Movimiento generador: N frames de A a B que el ejecutor expande de a uno.
+// Ocupa una sola entrada del pool sin importar la cantidad de frames.
+struct FrameGenerator {
+  uint32_t frames;           // Cantidad de frames (incluye A y B)
+  float distance;            // Recorrido total en mm (relativo)
+  int startAngle;            // Ángulo en el primer frame (negativo = no mover)
+  int endAngle;              // Ángulo en el último frame
+  uint8_t speed;             // Velocidad stepper 0-100%
+  uint8_t angleSpeed;        // Velocidad servo 0-100%
+  EasingType easing;
+  bool shutter;              // Disparar la cámara en cada frame
+  uint32_t intervalMs;       // Periodo entre inicios de frame
+  uint32_t settleMs;         // Espera tras el movimiento antes del disparo
+  uint32_t exposureMs;       // Espera tras el disparo
+};
+
+enum SequenceType {
+  SEQUENCE_MOVEMENTS,  // Lista de movimientos lineales con parada en cada uno
+  SEQUENCE_KEYFRAMES,  // Trayectoria suave interpolada entre puntos clave
+  SEQUENCE_RECORDED,   // Trayectoria grabada en modo teach
+  SEQUENCE_PROGRAM     // Programa en bytecode con bucles anidados
+};
+
+// Análisis de una secuencia, en caché en su cabecera. Se actualiza en O(1)
+// al agregar movimientos y por bloques en las demás ediciones (ver
+// AnalysisBlock); si no, se recalcula al consultarlo. Las posiciones son
+// relativas al inicio (absolutas en trayectorias con puntos clave).
+struct SequenceAnalysis {
+  bool valid;
+  uint64_t durationUs;       // Una pasada, sin la llegada a la pose inicial
+  int32_t endSteps;          // Posición al terminar la pasada
+  int32_t minSteps;          // Envolvente de posición
+  int32_t maxSteps;
+  int16_t firstAngle;        // Primer ángulo comandado (-1 = ninguno)
+  int16_t lastAngle;
+  int16_t minAngle;
+  int16_t maxAngle;
+  uint32_t peakStepRate;     // Mayor velocidad pedida al stepper (steps/s)
+  uint64_t lastMoveUs;       // Tramo en movimiento del último movimiento (para
+                             // sumarle sus ejes adicionales)
+  int8_t lastStepDir;        // Sentido del último tramo del stepper y del
+  int8_t lastAngleDir;       // servo (0 = ninguno): las inversiones suman
+                             // la recuperación de juego
+};
+
+// Movimientos por bloque del análisis al reconstruirlo. Los tramos del pool
+// se reservan en múltiplos de este valor: cada secuencia tiene un lugar de
+// bloque por cada ANALYSIS_BLOCK_MOVEMENTS registros de capacidad.
+#define ANALYSIS_BLOCK_MOVEMENTS 32
+
+// Resumen de un tramo de movimientos enteros (nunca empieza en una
+// extensión de eje) de una secuencia de movimientos. 'summary' se acumula
+// desde el estado con que termina el bloque anterior (ángulo y sentidos),
+// con posiciones relativas al inicio del bloque: el análisis de la
+// secuencia es la suma de los bloques. Editar un movimiento recalcula su
+// bloque y, si cambió ese estado de salida, el siguiente; el resto solo se
+// suma. Un bloque se parte al pasar de 2·ANALYSIS_BLOCK_MOVEMENTS.
+struct AnalysisBlock {
+  uint16_t record;           // Primer registro, relativo a la secuencia
+  uint16_t records;
+  uint16_t movements;
+  SequenceAnalysis summary;
+};
+
+// Cabecera de una secuencia. Los movimientos viven en un tramo contiguo
+// del pool [offset, offset + capacity).
+struct Sequence {
+  bool used;
+  char name[SEQUENCE_NAME_LENGTH];
+  SequenceType type;
+  uint16_t offset;
+  uint16_t capacity;
+  uint16_t count;
+  KeyframePath* path;        // Solo SEQUENCE_KEYFRAMES
+  RecordedPath* recording;   // Solo SEQUENCE_RECORDED
+  MotionLayers* layers;      // Capas aditivas de las trayectorias (nullptr = ninguna)
+  MotionProgram* program;    // Solo SEQUENCE_PROGRAM
+  uint16_t playbackPercent;  // Velocidad de reproducción de trayectorias (100 = original)
+  bool loop;
+  int repeatCount;
+  uint32_t version;          // Sube con cada cambio (If-Match en las ediciones)
+  mutable SequenceAnalysis analysis;  // Caché (se recalcula en consultas const)
+  mutable uint16_t blockCount;        // Bloques del análisis (válidos con él)
+};
+
+// Resultado de las ediciones in situ
+enum SequenceEditResult {
+  EDIT_OK,
+  EDIT_NOT_FOUND,            // Secuencia o movimiento inexistente
+  EDIT_STALE,                // La versión esperada no coincide
+  EDIT_BUSY,                 // La secuencia se está ejecutando
+  EDIT_INVALID,
+  EDIT_NO_SPACE              // Sin lugar en el pool
+};
+
+// Sentido de la reproducción
+enum PlaybackMode : uint8_t {
+  PLAY_FORWARD,
+  PLAY_REVERSE,      // Movimientos y tiempos espejados: vuelve a la pose inicial
+  PLAY_PINGPONG      // Alterna ida y vuelta en cada pasada (empieza por la ida)
+};
+
+// Entrada de la playlist: secuencia y cantidad de pasadas (reemplaza al
+// repeatCount y al loop de la secuencia mientras suena en la playlist)
+struct PlaylistEntry {
+  uint8_t sequence;
+  uint16_t repeat;
+};
+
+struct PoolUsage {
+  uint32_t capacity;         // Movimientos totales del pool
+  uint32_t reserved;         // Reservados por secuencias
+  uint32_t used;             // Ocupados por movimientos
+  uint32_t largestFree;      // Mayor tramo contiguo libre
+  int sequences;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include "CommandTargets.h"
 
 // Estructura para comandos del servo
 struct ServoCommand {
@@ -14,21 +15,57 @@ struct ServoCommand {
   bool waitCompletion;  // Esperar a que termine el movimiento
 };
 
-class ServoDriver {
+class ServoDriver : public ServoControl {
 private:
+  // Ancho de pulso para 0° y 180°
+  static const int MIN_PULSE_US = 500;
+  static const int MAX_PULSE_US = 2400;
+
   Servo servo;
   int pin;
   int currentAngle;
   int defaultSpeed;
+  volatile uint16_t feedPercent;   // Override de avance (100 = velocidad pedida)
   bool isMoving;
   bool servoAttached;
+  bool angleKnown;             // false hasta el primer comando tras el arranque
+  bool holdLocked;             // No desconectar por inactividad (secuencia armada)
+  bool sleepDetached;          // Desconectado por suspendForSleep()
+  uint32_t idleTimeoutMs;      // 0 = no desconectar nunca
+  unsigned long lastActivityMillis;
+  
+  // Frenado controlado (decelerateStop)
+  volatile bool decelRequested;
+  int64_t decelRequestUs;
+  uint32_t lastStopLatencyUs;
+  uint32_t maxStopLatencyUs;
+  
+  // Compensación de juego: moviéndose hacia ángulos menores el PWM se
+  // adelanta backlashDeg para que la salida llegue al ángulo pedido
+  int backlashDeg;
+  bool lastForward;            // Sentido del último movimiento
+  float backlashOffset;        // Corrección aplicada ahora (0 o -backlashDeg)
+  
+  // Esclavo del SubjectTracker: solo trackAngle() mueve el servo
+  volatile bool slaved;
+  
+  // Flag de parada de emergencia (EmergencyStop)
+  volatile bool* emergencyStopFlag;
+  portMUX_TYPE* emergencyMutex;
   
   QueueHandle_t commandQueue;
   TaskHandle_t taskHandle;
   SemaphoreHandle_t mutex;
+  volatile bool taskExitRequested;
   
+  bool createTask();
   static void servoTask(void* parameter);
   void processCommand(ServoCommand cmd);
+  void checkIdle();
+  bool emergencyActive() const { return emergencyStopFlag != nullptr && *emergencyStopFlag; }
+  void writeAngle(float angle);
+  void applyAngle(float angle);
+  void takeUp(bool forward);
   
 public:
   ServoDriver(int servoPin);
@@ -37,18 +74,80 @@ public:
   // Inicializar el driver
   bool begin();
   
+  // Con el flag levantado el servo se congela en el último ángulo escrito
+  // (el PWM sigue: detach no es seguro desde un ISR y soltarlo dejaría
+  // caer la carga) y se rechazan movimientos
+  void setEmergencyFlag(volatile bool* flag, portMUX_TYPE* mutex);
+  
+  // Recrea la task con la ubicación del layout activo (solo en reposo)
+  bool restartTask();
+  
   // Enviar comando de movimiento
-  bool moveTo(int angle, int speed = -1, bool wait = false);
+  bool moveTo(int angle, int speed = -1, bool wait = false) override;
+  
+  // Escribir un ángulo directamente, sin rampa ni cola (para trayectorias
+  // muestreadas a tasa fija). Admite fracciones de grado.
+  void setAngleImmediate(float angle);
+  
+  // Modo esclavo: moveTo() y setAngleImmediate() se descartan (moveTo
+  // devuelve true para no cortar una secuencia que mueve el carro) y
+  // trackAngle() es el único que escribe. Al entrar se corta la rampa en
+  // curso y se vacía la cola.
+  void setSlaved(bool on);
+  bool getIsSlaved() const { return slaved; }
+  void trackAngle(float angle);
+  
+  // Ángulo conocido sin mover (punto de control tras un corte): el primer
+  // comando conecta el PWM ahí y hace la rampa en lugar de saltar
+  void restoreAngle(int angle);
   
   // Obtener información
-  int getCurrentAngle() const { return currentAngle; }
-  bool getIsMoving() const { return isMoving; }
+  int getCurrentAngle() const override { return currentAngle; }
+  bool getIsMoving() const override { return isMoving; }
+  int getQueuedCommands() const override;
+  
+  // Duración estimada de una rampa de 'fromAngle' a 'toAngle'
+  uint32_t estimateMoveMs(int fromAngle, int toAngle, int speed) const;
   
   // Configuración
   void setDefaultSpeed(int speed);
   
+  // Escala la velocidad de las rampas, también la que está en curso (se
+  // aplica en la iteración siguiente)
+  void setFeedOverride(int percent);
+  int getFeedOverride() const { return feedPercent; }
+  
+  // Juego de la transmisión en grados (0 = sin compensar). Al invertir el
+  // sentido se recupera a un grado cada SERVO_TAKEUP_MS antes de la rampa.
+  void setBacklash(int degrees) override;
+  int getBacklash() const { return backlashDeg; }
+  uint32_t getTakeUpMs() const;
+  
+  // Desconecta el PWM tras 'ms' sin movimiento (0 = nunca). El siguiente
+  // comando lo reconecta en el último ángulo antes de moverse.
+  void setIdleTimeout(uint32_t ms) override;
+  uint32_t getIdleTimeout() const override { return idleTimeoutMs; }
+  bool getIsAttached() const override { return servoAttached; }
+  
+  // Mantiene el PWM conectado (y lo reconecta en el último ángulo si se
+  // había desconectado)
+  void setHoldLock(bool locked);
+  
+  // Light sleep: el LEDC se detiene y la señal quedaría congelada (alta
+  // sería un pulso infinito). Antes de dormir se desconecta y la línea
+  // queda en bajo; al despertar se reconecta en el mismo ángulo. Devuelve
+  // false si el servo se está moviendo.
+  bool suspendForSleep();
+  void resumeAfterSleep();
+  
   // Detener movimiento
-  void stop();
+  void stop() override;
+  
+  // Frena en los próximos SERVO_DECEL_DEGREES con iteraciones cada vez más
+  // lentas y descarta la cola
+  void decelerateStop();
+  uint32_t getLastStopLatencyUs() const { return lastStopLatencyUs; }
+  uint32_t getMaxStopLatencyUs() const { return maxStopLatencyUs; }
 };
 
 #endif
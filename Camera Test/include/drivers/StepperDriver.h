@@ -5,17 +5,45 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include "CommandTargets.h"
 
 class LimitSwitchDriver;
 
+// Estadísticas de timing entre pasos (desvío respecto del periodo nominal)
+struct StepTimingStats {
+  uint32_t samples;
+  int64_t sumDeviationUs;
+  int64_t sumSquaredUs;
+  uint32_t maxDeviationUs;
+};
+
+// Frenados controlados (decelerateStop): latencia desde el pedido hasta el
+// primer paso de la rampa
+struct DecelStats {
+  uint32_t requests;
+  uint32_t ramps;              // Pedidos que encontraron el motor en marcha
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+  uint32_t lastRampSteps;
+};
+
+// Arranque armado: latencia desde el go hasta el primer pulso de STEP
+struct FirstStepStats {
+  uint32_t count;
+  uint32_t lastLatencyUs;
+  uint32_t maxLatencyUs;
+};
+
 struct StepperCommand {
   long targetPosition;  
   int speed;            
   bool relative;        
   bool waitCompletion;  
+  bool calibrate;       // Calibración de juego (ignora los demás campos)
+  bool profiled;        // Trapecio: acelera desde parado y frena en el objetivo
 };
 
-class StepperDriver {
+class StepperDriver : public StepperControl {
 private:
   // Pines TB6600
   int pinPUL;    
@@ -39,22 +67,61 @@ private:
   int currentSpeed;
   bool isMoving;
   bool isEnabled;
+  bool holdReleased;           // ENA liberado por inactividad (sigue "habilitado")
+  bool holdLocked;             // No liberar por inactividad (secuencia armada)
+  uint32_t idleTimeoutMs;      // 0 = mantener corriente siempre
+  unsigned long lastActivityMillis;
   volatile bool shouldAbort;
-  portMUX_TYPE abortMux;
+  volatile bool decelRequested;
+  volatile uint16_t feedPercent;   // Override de avance (100 = velocidad pedida)
+  int64_t decelRequestUs;
+  DecelStats decelStats;
+  volatile bool firstStepPending;
+  int64_t firstStepFromUs;
+  FirstStepStats firstStepStats;
+  mutable portMUX_TYPE abortMux;
   
   // Configuración
   int stepsPerRevolution;
   int maxSpeed;
   int acceleration;
   
+  // Compensación de juego: al invertir el sentido se dan backlashSteps
+  // pasos a takeUpSpeed que no cuentan en currentPosition
+  int backlashSteps;
+  int takeUpSpeed;
+  int8_t lastDirection;        // Sentido del último movimiento (0 = desconocido)
+  BacklashCalibration calibration;
+  int calibrationSpeed;
+  
   // FreeRTOS
   QueueHandle_t commandQueue;
   TaskHandle_t taskHandle;
   SemaphoreHandle_t mutex;
+  volatile bool taskExitRequested;
+  
+  // Medición de jitter
+  volatile bool timingCapture;
+  StepTimingStats timingStats;
   
+  bool createTask();
   static void stepperTask(void* parameter);
   void processCommand(StepperCommand cmd);
-  void stepMotor(long steps, int speed);
+  void stepMotor(long steps, int speed, bool profiled = false);
+  bool takeUp();
+  bool pulseStep(unsigned long delayMicros);
+  void stampFirstStep();
+  float feedSpeed(int speed, uint16_t feed) const;
+  float approachSpeed(float current, float target) const;
+  int readLimit(int pin) const;
+  bool calibrationStep(bool forward, long i);
+  long stepUntilLimit(int pin, bool forward, bool wantHit, long maxSteps);
+  bool stepExactly(bool forward, long steps);
+  void runBacklashCalibration();
+  void checkIdle();
+  void restoreHold();
+  bool emergencyActive() const { return emergencyStopFlag != nullptr && *emergencyStopFlag; }
+  void releaseForEmergency();
   
   friend class LimitSwitchDriver;
 
@@ -65,26 +132,95 @@ public:
   
   void setEmergencyFlag(volatile bool* flag, portMUX_TYPE* mutex);
   
+  // Parada de emergencia (desde el ISR): ENA desactivado y PUL en bajo. La
+  // task abandona el movimiento en el paso siguiente al ver el flag y la
+  // corriente vuelve como tras la liberación por inactividad.
+  void IRAM_ATTR emergencyCut();
+  
   bool begin(int stepsPerRev = 200);
   
-  bool moveTo(long position, int speed = -1, bool wait = false);
-  bool moveRelative(long steps, int speed = -1, bool wait = false);
-  void stop();
-  void enable();
-  void disable();
+  // Recrea la task con la ubicación del layout activo (solo en reposo)
+  bool restartTask();
+  
+  bool moveTo(long position, int speed = -1, bool wait = false) override;
+  bool moveRelative(long steps, int speed = -1, bool wait = false) override;
+  // Movimiento rápido con perfil trapezoidal (speed -1 = maxSpeed): acelera
+  // y frena con 'acceleration' y llega al objetivo sin golpe. No aplica el
+  // override de avance.
+  bool rapidTo(long position, int speed = -1, bool wait = false);
+  void stop() override;
+  
+  // Frena con la rampa de 'acceleration' desde la velocidad actual y
+  // descarta la cola. Nunca pasa del objetivo del movimiento en curso.
+  void decelerateStop();
+  DecelStats getDecelStats() const;
+  
+  // Mide hasta el próximo pulso de STEP (juego incluido) desde 'sinceUs'
+  // (esp_timer). cancelFirstStep() descarta la marca si no hubo pasos.
+  void markFirstStep(int64_t sinceUs);
+  void cancelFirstStep();
+  FirstStepStats getFirstStepStats() const;
+  // Peor latencia de decelerateStop() moviéndose a 'speed' steps/s
+  uint32_t getStopLatencyBoundUs(int speed) const;
+  
+  void enable() override;
+  void disable() override;
   
   void setSpeed(int speed);
   void setMaxSpeed(int speed);
+  
+  // Escala la velocidad de los movimientos (también el que está en curso):
+  // el cambio se alcanza con la rampa de 'acceleration', sin saltos
+  void setFeedOverride(int percent);
+  int getFeedOverride() const { return feedPercent; }
   void setAcceleration(int accel);
   void setStepsPerRevolution(int steps);
-  void zero(); 
+  void zero() override; 
+  // Posición conocida sin mover (punto de control tras un corte). El juego
+  // queda sin referencia como tras la parada de emergencia.
+  void restorePosition(long position);
+  
+  // Libera la corriente de retención tras 'ms' sin movimiento (0 = nunca).
+  // Se restaura automáticamente antes del siguiente movimiento.
+  void setIdleTimeout(uint32_t ms) override;
+  uint32_t getIdleTimeout() const override { return idleTimeoutMs; }
+  bool getIsHoldReleased() const override { return holdReleased; }
   
-  long getCurrentPosition() const { return currentPosition; }
-  bool getIsMoving() const { return isMoving; }
+  // Mantiene la corriente de retención (y la restaura si estaba liberada)
+  // para que el próximo movimiento arranque sin HOLD_RESTORE_MS
+  void setHoldLock(bool locked);
+  
+  long getCurrentPosition() const override { return currentPosition; }
+  bool getIsMoving() const override { return isMoving; }
   bool getIsEnabled() const { return isEnabled; }
+  int getQueuedCommands() const override;
+  int getMaxSpeed() const { return maxSpeed; }
+  int getAcceleration() const { return acceleration; }
+  
+  // Duración estimada de un movimiento de 'steps' a 'speed' steps/s
+  uint64_t estimateMoveMicros(long steps, int speed) const;
+  // Lo mismo para rapidTo() (trapecio o triángulo si no llega al crucero)
+  uint64_t estimateRapidMicros(long steps, int speed = -1) const;
+  
+  // Juego del eje en pasos (0 = sin compensar) y velocidad de recuperación
+  void setBacklash(int steps, int speed = -1) override;
+  int getBacklashSteps() const override { return backlashSteps; }
+  int getTakeUpSpeed() const { return takeUpSpeed; }
+  // Tiempo extra de una inversión de sentido
+  uint64_t getTakeUpMicros() const;
+  
+  // Mide el juego con el final de carrera 1 en la task del stepper. Termina
+  // apoyado en ese final de carrera y lo toma como cero. El resultado no se
+  // aplica solo: ver setBacklash().
+  bool startBacklashCalibration(int cycles, int speed, long hysteresisSteps) override;
+  BacklashCalibration getBacklashCalibration() const override;
+  
+  // Medición de jitter entre pasos
+  void setTimingCapture(bool enabled);
+  StepTimingStats getTimingStats() const;
   
-  long mmToSteps(float mm, float mmPerRevolution);
-  float stepsToMm(long steps, float mmPerRevolution);
+  long mmToSteps(float mm, float mmPerRevolution) override;
+  float stepsToMm(long steps, float mmPerRevolution) override;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef SUBJECT_TRACKER_H
+#define SUBJECT_TRACKER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "CommandTargets.h"
+
+class StepperDriver;
+class ServoDriver;
+
+// Modo seguimiento: mantiene la cámara apuntada a un sujeto mientras el
+// carro se desplaza. A la tasa de refresco del servo lee la posición real
+// del stepper y calcula el pan como atan(dx / distancia) con una tabla y
+// aritmética de punto fijo; no importa quién mueva el carro (jog, secuencia
+// o trayectoria) ni a qué velocidad. Mientras está activo el servo queda
+// esclavo: ignora cualquier otro comando.
+
+#ifndef TRACK_PERIOD_MS
+#define TRACK_PERIOD_MS 20           // Un cuadro de PWM del servo (50 Hz)
+#endif
+
+#define TRACK_ATAN_BITS 8            // Tabla de atan en [0,1] con 2^8 tramos
+#define TRACK_ANGLE_SHIFT 10         // Ángulos en grados Q10 (1/1024°)
+#define TRACK_ACQUIRE_DEG 2          // Giro máximo por cuadro hasta enganchar
+
+class SubjectTracker : public TrackerControl {
+private:
+  StepperDriver* stepperDriver;
+  ServoDriver* servoDriver;
+  esp_timer_handle_t tickTimer;
+  SemaphoreHandle_t mutex;
+
+  // Tabla atan(i / 2^TRACK_ATAN_BITS) en grados Q10, con el extremo incluido
+  static uint16_t atanTable[(1 << TRACK_ATAN_BITS) + 1];
+
+  // Geometría en pasos: el sujeto está en subjectSteps a lo largo del rail
+  // y a distanceSteps de él. centerQ es el ángulo del servo que mira
+  // perpendicular al rail y direction el sentido de giro hacia +x.
+  bool active;
+  bool locked;                 // Alcanzó el ángulo del sujeto tras arrancar
+  int32_t subjectSteps;
+  int32_t distanceSteps;
+  int32_t centerQ;
+  int8_t direction;
+  int32_t angleQ;              // Último ángulo escrito
+
+  uint32_t ticks;
+  uint32_t writes;
+  uint32_t lastUs;
+  uint32_t maxUs;
+
+  static void onTick(void* arg);
+  void update();
+  static int32_t lookupAtan(uint32_t ratio);
+
+public:
+  SubjectTracker(StepperDriver* stepper, ServoDriver* servo);
+  ~SubjectTracker();
+
+  bool begin();
+
+  // alongMm: posición del sujeto sobre el eje del rail (desde el cero);
+  // distanceMm: distancia perpendicular al rail (> 0); centerDeg: ángulo
+  // del servo que mira perpendicular; invert: el servo gira al revés.
+  // Llamarlo con el seguimiento activo cambia el sujeto sin cortarlo.
+  bool start(float alongMm, float distanceMm, float centerDeg = 90, bool invert = false) override;
+  void stop() override;
+
+  bool isActive() const { return active; }
+
+  // atan(y / x) en grados Q10 para x > 0 (resultado en (-90°, 90°))
+  static int32_t atanQ10(int32_t y, int32_t x);
+
+  String getStatusAsJson() const override;
+};
+
+#endif
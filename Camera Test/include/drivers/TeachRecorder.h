@@ -0,0 +1,66 @@
+#ifndef TEACH_RECORDER_H
+#define TEACH_RECORDER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "drivers/RecordedPath.h"
+#include "CommandTargets.h"
+
+class StepperDriver;
+class ServoDriver;
+
+// Modo teach: muestrea la posición del stepper y el ángulo del servo a tasa
+// fija mientras el operador mueve el slider a mano (jog) y guarda solo los
+// puntos necesarios para reproducir el recorrido dentro de una tolerancia.
+
+#ifndef TEACH_SAMPLE_MS
+#define TEACH_SAMPLE_MS 50           // Periodo de muestreo (20 Hz)
+#endif
+
+#define TEACH_WINDOW 64              // Muestras máximas entre dos puntos guardados
+#define TEACH_MAX_BYTES 32768        // Tope de una grabación codificada
+
+class TeachRecorder : public TeachControl {
+private:
+  StepperDriver* stepperDriver;
+  ServoDriver* servoDriver;
+  esp_timer_handle_t sampleTimer;
+  SemaphoreHandle_t mutex;
+
+  // Grabación en curso (nullptr = sin grabar)
+  RecordedPath* path;
+  RecordedPoint anchor;                  // Último punto guardado
+  RecordedPoint window[TEACH_WINDOW];    // Muestras desde el ancla
+  int windowCount;
+  uint32_t samples;
+  int64_t startUs;
+  int32_t toleranceSteps;
+  int toleranceAngle;
+  bool full;                             // Se alcanzó TEACH_MAX_BYTES
+
+  static void onSample(void* arg);
+  void addSample(const RecordedPoint& point);
+  bool fitsLine(const RecordedPoint& end) const;
+  void emit(const RecordedPoint& point);
+
+public:
+  TeachRecorder(StepperDriver* stepper, ServoDriver* servo);
+  ~TeachRecorder();
+
+  bool begin();
+
+  // Tolerancias de la simplificación: desvío máximo de un punto descartado
+  // respecto de la recta entre los puntos guardados vecinos
+  bool start(float toleranceMm = 0.2f, int toleranceDeg = 1) override;
+
+  // Termina la grabación y entrega la trayectoria (el llamador la libera).
+  // nullptr si no se estaba grabando.
+  RecordedPath* stop() override;
+
+  bool isRecording() const { return path != nullptr; }
+  String getStatusAsJson() const override;
+};
+
+#endif
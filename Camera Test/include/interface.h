@@ -15,6 +15,13 @@ class SequenceManager;
 // Función para inicializar el servidor web
 void setupWebServer();
 
+// Mantenimiento periódico del servidor (llamar desde loop)
+void serviceWebServer();
+
+// Apaga el WiFi y lo vuelve a conectar (radios apagadas en ejecución)
+void suspendWiFi();
+void resumeWiFi();
+
 // Función para manejar el disparo de foto (callback)
 void setPhotoCallback(void (*callback)());
 
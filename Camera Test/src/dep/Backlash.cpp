@@ -0,0 +1,56 @@
+#include "Backlash.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "Log.h"
+#include <Preferences.h>
+
+void loadBacklashConfig(StepperDriver* stepper, ServoDriver* servo) {
+  Preferences prefs;
+  if (!prefs.begin("backlash", true)) {
+    return;
+  }
+  int steps = prefs.getUShort("steps", 0);
+  int speed = prefs.getUShort("takeUp", stepper->getTakeUpSpeed());
+  int degrees = prefs.getUChar("servo", 0);
+  prefs.end();
+
+  stepper->setBacklash(steps, speed);
+  servo->setBacklash(degrees);
+  if (steps > 0 || degrees > 0) {
+    LOG_INFO("↔️ Juego: stepper %d pasos a %d pasos/s, servo %d°", steps, speed, degrees);
+  }
+}
+
+void saveBacklashConfig(StepperDriver* stepper, ServoDriver* servo) {
+  Preferences prefs;
+  if (prefs.begin("backlash", false)) {
+    prefs.putUShort("steps", stepper->getBacklashSteps());
+    prefs.putUShort("takeUp", stepper->getTakeUpSpeed());
+    prefs.putUChar("servo", servo->getBacklash());
+    prefs.end();
+  }
+}
+
+String getBacklashAsJson(StepperDriver* stepper, ServoDriver* servo) {
+  BacklashCalibration cal = stepper->getBacklashCalibration();
+  String json = "{";
+  json += "\"stepperSteps\":" + String(stepper->getBacklashSteps()) + ",";
+  json += "\"stepperMm\":" + String(stepper->stepsToMm(stepper->getBacklashSteps(), MM_PER_REVOLUTION), 3) + ",";
+  json += "\"takeUpSpeed\":" + String(stepper->getTakeUpSpeed()) + ",";
+  json += "\"servoDeg\":" + String(servo->getBacklash()) + ",";
+  json += "\"calibration\":{";
+  json += "\"running\":" + String(cal.running ? "true" : "false") + ",";
+  json += "\"valid\":" + String(cal.valid ? "true" : "false");
+  if (cal.valid) {
+    json += ",\"samples\":" + String(cal.samples);
+    json += ",\"deadBandSteps\":" + String(cal.deadBandSteps);
+    json += ",\"spreadSteps\":" + String(cal.spreadSteps);
+    json += ",\"hysteresisSteps\":" + String(cal.hysteresisSteps);
+    json += ",\"backlashSteps\":" + String(cal.backlashSteps);
+  }
+  if (cal.error != nullptr) {
+    json += ",\"error\":\"" + String(cal.error) + "\"";
+  }
+  json += "}}";
+  return json;
+}
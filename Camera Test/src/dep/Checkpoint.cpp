@@ -0,0 +1,377 @@
+#include "Checkpoint.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "drivers/SequenceManager.h"
+#include "Log.h"
+#include <Preferences.h>
+#include <rom/crc.h>
+#include <vector>
+
+#define CHECKPOINT_VERSION 1
+
+static StepperDriver* stepperDriver = nullptr;
+static ServoDriver* servoDriver = nullptr;
+static SemaphoreHandle_t mutex = nullptr;
+static Preferences prefs;
+
+// Lo guardado en NVS y lo que había al arrancar
+static Checkpoint saved;
+static Checkpoint boot;
+static bool pendingResume = false;     // La ejecución de 'boot' aún se puede retomar
+
+// Ejecución en curso. Con una reanudable solo se guarda tras settled().
+static CheckpointProgress progress;
+static bool runResumable = false;
+static bool settled = true;
+static uint32_t snapshotCrc = 0;       // Copia guardada en "snap"
+static uint32_t snapshotBytes = 0;
+
+static bool autoResume = true;
+static uint32_t intervalMs = CHECKPOINT_INTERVAL_DEFAULT_MS;
+static uint32_t lastRestMillis = 0;
+static uint32_t lastMotionMillis = 0;  // Último checkpointMotionStart()
+static bool armedHold = false;         // MOVING adelantado a la espera del go
+static uint32_t restWrites = 0;
+static uint32_t movingWrites = 0;
+
+static const CheckpointProgress NO_PROGRESS = { -1, 0, 0, 0, 0 };
+
+static const char* stateName(uint8_t state) {
+  switch (state) {
+    case CHECKPOINT_REST: return "rest";
+    case CHECKPOINT_MOVING: return "moving";
+    default: return "none";
+  }
+}
+
+// Llamar con el mutex tomado
+static void writeCheckpoint(const Checkpoint& checkpoint) {
+  if (prefs.putBytes("state", &checkpoint, sizeof(checkpoint)) != sizeof(checkpoint)) {
+    LOG_WARN("⚠️ Punto de control: error de escritura en NVS");
+    return;
+  }
+  saved = checkpoint;
+}
+
+static bool motorsIdle() {
+  return !stepperDriver->getIsMoving() && stepperDriver->getQueuedCommands() == 0 &&
+         !servoDriver->getIsMoving() && servoDriver->getQueuedCommands() == 0;
+}
+
+// Pose y avance actuales (memset: el padding también se compara)
+static Checkpoint restCheckpoint() {
+  Checkpoint checkpoint;
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  checkpoint.version = CHECKPOINT_VERSION;
+  checkpoint.state = CHECKPOINT_REST;
+  checkpoint.angle = servoDriver->getCurrentAngle();
+  checkpoint.steps = stepperDriver->getCurrentPosition();
+  checkpoint.targetSteps = checkpoint.steps;
+  checkpoint.progress = progress;
+  return checkpoint;
+}
+
+// Guarda la pose cuando cambió, con los motores quietos y en un límite de
+// movimiento, a lo sumo una vez por intervalo. Si el intervalo no se
+// cumplió, se reintenta en el siguiente sondeo de la misma espera. Tras un
+// checkpointMotionStart() espera un sondeo entero: el movimiento anunciado
+// puede no estar todavía en la cola del stepper.
+static void checkpointTask(void* parameter) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(CHECKPOINT_POLL_MS));
+
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (settled && !armedHold && millis() - lastMotionMillis >= CHECKPOINT_POLL_MS && motorsIdle()) {
+      Checkpoint checkpoint = restCheckpoint();
+      bool due = saved.state == CHECKPOINT_NONE || millis() - lastRestMillis >= intervalMs;
+      if (due && memcmp(&checkpoint, &saved, sizeof(checkpoint)) != 0) {
+        writeCheckpoint(checkpoint);
+        lastRestMillis = millis();
+        restWrites++;
+      }
+    }
+    xSemaphoreGive(mutex);
+  }
+}
+
+bool beginCheckpoints(StepperDriver* stepper, ServoDriver* servo) {
+  stepperDriver = stepper;
+  servoDriver = servo;
+  progress = NO_PROGRESS;
+  memset(&saved, 0, sizeof(saved));
+
+  mutex = xSemaphoreCreateMutex();
+  if (mutex == nullptr || !prefs.begin("checkpoint", false)) {
+    LOG_ERROR("❌ Punto de control: NVS no disponible");
+    return false;
+  }
+  autoResume = prefs.getUChar("auto", 1) != 0;
+  intervalMs = constrain(prefs.getUInt("interval", CHECKPOINT_INTERVAL_DEFAULT_MS),
+                         CHECKPOINT_INTERVAL_MIN_MS, CHECKPOINT_INTERVAL_MAX_MS);
+  snapshotCrc = prefs.getUInt("snapCrc", 0);
+  snapshotBytes = prefs.getBytesLength("snap");
+  if (prefs.getBytesLength("state") == sizeof(Checkpoint)) {
+    prefs.getBytes("state", &saved, sizeof(saved));
+    if (saved.version != CHECKPOINT_VERSION) memset(&saved, 0, sizeof(saved));
+  }
+  boot = saved;
+
+  if (saved.state == CHECKPOINT_REST) {
+    stepper->restorePosition(saved.steps);
+    servo->restoreAngle(saved.angle);
+    progress = saved.progress;
+    pendingResume = progress.sequence >= 0;
+    LOG_INFO("📍 Pose restaurada: %ld pasos, %d°", (long)saved.steps, saved.angle);
+  } else if (saved.state == CHECKPOINT_MOVING) {
+    LOG_WARN("⚠️ Corte de energía en marcha (de %ld a %ld pasos): posición incierta, volver a referenciar",
+             (long)saved.steps, (long)saved.targetSteps);
+  }
+
+  BaseType_t result = xTaskCreatePinnedToCore(
+    checkpointTask, "CheckpointTask", 3072, nullptr, 1, nullptr, tskNO_AFFINITY);
+  if (result != pdPASS) {
+    LOG_ERROR("❌ Punto de control: Error creando task");
+    return false;
+  }
+
+  LOG_INFO("✅ Punto de control (cada %lu ms como mínimo)", (unsigned long)intervalMs);
+  return true;
+}
+
+// ========== Reanudación ==========
+
+bool resumeFromCheckpoint(SequenceManager* sequences, String& reason) {
+  if (mutex == nullptr) {
+    reason = "Punto de control no inicializado";
+    return false;
+  }
+  if (boot.state == CHECKPOINT_MOVING) {
+    reason = "Posición incierta: la energía se cortó en marcha";
+    return false;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool pending = pendingResume;
+  CheckpointProgress resume = boot.progress;
+  std::vector<uint8_t> snapshot;
+  if (pending && snapshotBytes > 0 && snapshotBytes <= CHECKPOINT_SNAPSHOT_BYTES) {
+    snapshot.resize(snapshotBytes);
+    if (prefs.getBytes("snap", snapshot.data(), snapshotBytes) != snapshotBytes) snapshot.clear();
+  }
+  xSemaphoreGive(mutex);
+
+  if (!pending) {
+    reason = "No hay ejecución interrumpida";
+    return false;
+  }
+  // Los movimientos son relativos: el resto se desplazaría con el carro
+  if (stepperDriver->getCurrentPosition() != boot.steps) {
+    reason = "El carro se movió desde el punto de control";
+    return false;
+  }
+  if (snapshot.empty() || crc32_le(0, snapshot.data(), snapshot.size()) != resume.snapshotCrc) {
+    reason = "La copia de la secuencia no coincide con el punto de control";
+    return false;
+  }
+
+  int index = sequences->importSnapshot(snapshot.data(), snapshot.size());
+  if (index < 0) {
+    reason = "Sin lugar para recrear la secuencia";
+    return false;
+  }
+  if (!sequences->resumeSequence(index, resume.pass, resume.record, resume.frame)) {
+    sequences->deleteSequence(index);
+    reason = "Ejecución rechazada";
+    return false;
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  pendingResume = false;
+  xSemaphoreGive(mutex);
+
+  LOG_INFO("🔁 Retomando secuencia %d: pasada %u, registro %u, frame %lu", index,
+           resume.pass, resume.record, (unsigned long)resume.frame);
+  return true;
+}
+
+void autoResumeCheckpoint(SequenceManager* sequences) {
+  if (!autoResume || !pendingResume) {
+    return;
+  }
+  String reason;
+  if (!resumeFromCheckpoint(sequences, reason)) {
+    LOG_WARN("⚠️ No se pudo retomar la ejecución: %s", reason.c_str());
+  }
+}
+
+void discardCheckpointRun() {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  pendingResume = false;
+  if (!runResumable) progress = NO_PROGRESS;
+  xSemaphoreGive(mutex);
+  LOG_INFO("🗑️ Ejecución interrumpida descartada");
+}
+
+void setCheckpointAutoResume(bool enabled) {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  autoResume = enabled;
+  prefs.putUChar("auto", enabled ? 1 : 0);
+  xSemaphoreGive(mutex);
+}
+
+void setCheckpointInterval(uint32_t ms) {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  intervalMs = constrain(ms, (uint32_t)CHECKPOINT_INTERVAL_MIN_MS, (uint32_t)CHECKPOINT_INTERVAL_MAX_MS);
+  prefs.putUInt("interval", intervalMs);
+  xSemaphoreGive(mutex);
+}
+
+// ========== Ejecución ==========
+
+void checkpointBeginRun(int sequence, const uint8_t* snapshot, size_t length) {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  pendingResume = false;
+  progress = NO_PROGRESS;
+  runResumable = sequence >= 0 && snapshot != nullptr && length > 0 &&
+                 length <= CHECKPOINT_SNAPSHOT_BYTES;
+
+  if (runResumable) {
+    // Repetir la misma secuencia no vuelve a escribir la copia
+    uint32_t crc = crc32_le(0, snapshot, length);
+    if (crc != snapshotCrc || length != snapshotBytes) {
+      if (prefs.putBytes("snap", snapshot, length) == length) {
+        prefs.putUInt("snapCrc", crc);
+        snapshotCrc = crc;
+        snapshotBytes = length;
+      } else {
+        runResumable = false;
+        LOG_WARN("⚠️ Punto de control: no se pudo guardar la copia de la secuencia");
+      }
+    }
+    if (runResumable) {
+      progress.sequence = sequence;
+      progress.snapshotCrc = crc;
+    }
+  }
+  settled = true;
+  xSemaphoreGive(mutex);
+}
+
+void checkpointProgress(uint16_t pass, uint16_t record, uint32_t frame) {
+  if (!runResumable) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  progress.pass = pass;
+  progress.record = record;
+  progress.frame = frame;
+  settled = false;
+  xSemaphoreGive(mutex);
+}
+
+void checkpointFrame(uint32_t frame) {
+  if (!runResumable) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  progress.frame = frame;
+  settled = false;
+  xSemaphoreGive(mutex);
+}
+
+void checkpointSettled() {
+  if (!runResumable) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  settled = true;
+  xSemaphoreGive(mutex);
+}
+
+void checkpointEndRun() {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  armedHold = false;
+  runResumable = false;
+  progress = NO_PROGRESS;
+  settled = true;
+  xSemaphoreGive(mutex);
+}
+
+// Desde la task que encola el movimiento (nunca la del stepper), antes de
+// encolarlo. Solo escribe si lo guardado es una pose exacta: una vez por
+// REST como mucho.
+void checkpointMotionStart(long from, long to) {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (saved.state == CHECKPOINT_REST) {
+    Checkpoint checkpoint = saved;
+    checkpoint.state = CHECKPOINT_MOVING;
+    checkpoint.targetSteps = to;
+    writeCheckpoint(checkpoint);
+    movingWrites++;
+  }
+  lastMotionMillis = millis();
+  armedHold = false;
+  xSemaphoreGive(mutex);
+}
+
+void checkpointArm() {
+  if (mutex == nullptr) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (saved.state == CHECKPOINT_REST) {
+    Checkpoint checkpoint = saved;
+    checkpoint.state = CHECKPOINT_MOVING;
+    writeCheckpoint(checkpoint);
+    movingWrites++;
+  }
+  armedHold = true;
+  xSemaphoreGive(mutex);
+}
+
+// ========== Estado ==========
+
+static String checkpointJson(const Checkpoint& checkpoint) {
+  String json = "{\"state\":\"" + String(stateName(checkpoint.state)) + "\"";
+  if (checkpoint.state != CHECKPOINT_NONE) {
+    json += ",\"steps\":" + String((long)checkpoint.steps);
+    json += ",\"mm\":" + String(stepperDriver->stepsToMm(checkpoint.steps, MM_PER_REVOLUTION), 2);
+    json += ",\"angle\":" + String(checkpoint.angle);
+    if (checkpoint.state == CHECKPOINT_MOVING) {
+      json += ",\"targetSteps\":" + String((long)checkpoint.targetSteps);
+    }
+    json += ",\"sequence\":" + String(checkpoint.progress.sequence);
+    if (checkpoint.progress.sequence >= 0) {
+      json += ",\"pass\":" + String(checkpoint.progress.pass);
+      json += ",\"record\":" + String(checkpoint.progress.record);
+      json += ",\"frame\":" + String((unsigned long)checkpoint.progress.frame);
+    }
+  }
+  json += "}";
+  return json;
+}
+
+String getCheckpointAsJson() {
+  if (mutex == nullptr) {
+    return "{\"enabled\":false}";
+  }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  Checkpoint current = saved;
+  bool pending = pendingResume;
+  bool resumable = runResumable;
+  uint32_t sinceMs = millis() - lastRestMillis;
+  uint32_t rests = restWrites;
+  uint32_t movings = movingWrites;
+  xSemaphoreGive(mutex);
+
+  String json = "{\"enabled\":true";
+  json += ",\"autoResume\":" + String(autoResume ? "true" : "false");
+  json += ",\"intervalMs\":" + String(intervalMs);
+  json += ",\"boot\":" + checkpointJson(boot);
+  json += ",\"saved\":" + checkpointJson(current);
+  json += ",\"pendingResume\":" + String(pending ? "true" : "false");
+  json += ",\"runResumable\":" + String(resumable ? "true" : "false");
+  json += ",\"snapshotBytes\":" + String(snapshotBytes);
+  json += ",\"restWrites\":" + String(rests);
+  json += ",\"movingWrites\":" + String(movings);
+  if (rests > 0) json += ",\"lastRestAgoMs\":" + String(sinceMs);
+  json += "}";
+  return json;
+}
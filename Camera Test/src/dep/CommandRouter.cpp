@@ -0,0 +1,1345 @@
+#include "CommandRouter.h"
+#include "Checkpoint.h"
+#include "Log.h"
+#include <vector>
+
+// Reloj y sección crítica de las estadísticas: esp_timer y portMUX en el
+// ESP32, la biblioteca estándar en el build native de test/
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_timer.h>
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+static inline int64_t nowUs() { return esp_timer_get_time(); }
+static inline void lockStats() { portENTER_CRITICAL(&statsMux); }
+static inline void unlockStats() { portEXIT_CRITICAL(&statsMux); }
+#else
+#include <chrono>
+#include <mutex>
+static std::mutex statsMutex;
+static inline int64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static inline void lockStats() { statsMutex.lock(); }
+static inline void unlockStats() { statsMutex.unlock(); }
+#endif
+
+static CommandContext ctx = {};
+
+void setCommandContext(const CommandContext& context) {
+  ctx = context;
+}
+
+void CommandResponse::fail(int code, const char* message) {
+  send(code, "{\"success\":false,\"message\":\"" + String(message) + "\"}");
+}
+
+// ========== Control Manual ==========
+
+static void cmdPhoto(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  LOG_DEBUG("📸 GET /photo");
+  if (c.bleConnected != nullptr && c.bleConnected() && c.takePhoto != nullptr && c.takePhoto()) {
+    res.ok();
+  } else {
+    res.send(200, "{\"success\":false,\"message\":\"Bluetooth no conectado\"}");
+  }
+}
+
+static void cmdStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  bool connected = c.bleConnected != nullptr && c.bleConnected();
+  res.send(200, "{\"connected\":" + String(connected ? "true" : "false") + "}");
+}
+
+static void cmdServo(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("angle") || !p.has("speed")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int angle = p.getInt("angle", 90);
+  int speed = p.getInt("speed", 50);
+  if (c.servo->moveTo(angle, speed, false)) {
+    res.send(200, "{\"success\":true,\"angle\":" + String(angle) + ",\"speed\":" + String(speed) + "}");
+  } else {
+    res.fail(500, "Error moviendo servo");
+  }
+}
+
+static void cmdStepper(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("distance") || !p.has("speed")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  float distance = p.getFloat("distance", 0);
+  int speed = p.getInt("speed", 50);
+
+  // Convertir velocidad de 0-100% a steps/segundo
+  int stepsPerSec = map(speed, 0, 100, 100, 2000);
+  long steps = c.stepper->mmToSteps(distance, MM_PER_REVOLUTION); // 8mm por revolución
+
+  if (c.stepper->moveRelative(steps, stepsPerSec, false)) {
+    res.send(200, "{\"success\":true,\"distance\":" + String(distance) + ",\"speed\":" + String(speed) + "}");
+  } else {
+    res.fail(500, "Error moviendo stepper");
+  }
+}
+
+static void cmdStepperEnable(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("value")) {
+    res.fail(400);
+    return;
+  }
+  bool enable = p.get("value") == "true";
+  if (enable) c.stepper->enable();
+  else c.stepper->disable();
+  res.send(200, "{\"success\":true,\"enabled\":" + String(enable ? "true" : "false") + "}");
+}
+
+static void cmdStepperZero(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.stepper->zero();
+  res.ok();
+}
+
+// Juego por eje: sin parámetros devuelve configuración y última
+// calibración. stepperMm o stepperSteps, takeUpSpeed (pasos/s), servoDeg,
+// apply=1 (aplica la última calibración) y save=1 (guarda en NVS)
+static void cmdBacklashConfig(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  bool changed = false;
+  int steps = c.stepper->getBacklashSteps();
+  int speed = -1;
+  if (p.has("stepperMm")) {
+    steps = c.stepper->mmToSteps(p.getFloat("stepperMm", 0), MM_PER_REVOLUTION);
+    changed = true;
+  }
+  if (p.has("stepperSteps")) {
+    steps = p.getInt("stepperSteps", 0);
+    changed = true;
+  }
+  if (p.has("apply")) {
+    BacklashCalibration cal = c.stepper->getBacklashCalibration();
+    if (!cal.valid) {
+      res.fail(409, "Sin calibración válida");
+      return;
+    }
+    steps = cal.backlashSteps;
+    changed = true;
+  }
+  if (p.has("takeUpSpeed")) {
+    speed = p.getInt("takeUpSpeed", -1);
+    changed = true;
+  }
+  if (changed) c.stepper->setBacklash(steps, speed);
+  if (p.has("servoDeg")) {
+    c.servo->setBacklash(p.getInt("servoDeg", 0));
+    changed = true;
+  }
+
+  // Las duraciones estimadas incluyen la recuperación de juego
+  if (changed && c.sequences) c.sequences->invalidateAnalyses();
+  if (p.has("save")) c.system->saveBacklashConfig();
+  res.send(200, c.system->getBacklashAsJson());
+}
+
+// Medición del juego del stepper con el final de carrera 1:
+// ?cycles=3&speed=200&hysteresisMm=0.05. El carro termina en ese final
+// de carrera con la posición en cero.
+static void cmdBacklashCalibrate(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (c.sequences && c.sequences->getIsExecuting()) {
+    res.fail(409, "Secuencia en ejecución");
+    return;
+  }
+  int cycles = p.getInt("cycles", 3);
+  int speed = p.getInt("speed", 200);
+  float hysteresisMm = p.getFloat("hysteresisMm", 0.0f);
+  if (!c.stepper->startBacklashCalibration(cycles, speed, c.stepper->mmToSteps(hysteresisMm, MM_PER_REVOLUTION))) {
+    res.fail(409, "Stepper ocupado o deshabilitado");
+    return;
+  }
+  res.ok();
+}
+
+// ========== Ejes adicionales (MotionController) ==========
+
+static void cmdAxes(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.motion->getAxesAsJson());
+}
+
+// Movimiento relativo manual: ?index=0&value=-10&speed=50
+static void cmdAxis(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("index") || !p.has("value")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int index = p.getInt("index", -1);
+  if (index < 0 || index >= c.motion->getAxisCount()) {
+    res.fail(404, "Eje inexistente");
+    return;
+  }
+  int speed = p.getInt("speed", 50);
+  int32_t delta = c.motion->toAxisUnits(index, p.getFloat("value", 0));
+  if (c.motion->queueMove(index, delta, c.motion->rateForSpeed(index, speed))) {
+    res.ok();
+  } else {
+    res.fail(503, "Buffer lleno");
+  }
+}
+
+// ========== Gestión de Secuencias ==========
+
+static void cmdSequenceCreate(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("name")) {
+    res.fail(400);
+    return;
+  }
+  String typeName = p.get("type");
+  SequenceType type = typeName == "keyframes" ? SEQUENCE_KEYFRAMES :
+                      typeName == "program" ? SEQUENCE_PROGRAM : SEQUENCE_MOVEMENTS;
+  // capacity = movimientos a reservar (crece sola si se agregan más)
+  long capacity = p.getInt("capacity", 16);
+  if (capacity < 0 || capacity > SEQUENCE_POOL_MAX_MOVEMENTS) {
+    res.fail(400, "Capacidad inválida");
+    return;
+  }
+  int index = c.sequences->createSequence(p.get("name"), type, capacity);
+  if (index < 0) {
+    res.fail(507, "Sin espacio para la secuencia");
+    return;
+  }
+  res.send(200, "{\"success\":true,\"index\":" + String(index) + "}");
+}
+
+// Campos de un movimiento: distance, speed, angle, angleSpeed, simultaneous,
+// pause y ejes adicionales axisN=valor relativo, axisNSpeed=0-100
+static bool parseMovement(const CommandParams& p, Movement& mov) {
+  if (!p.has("distance") || !p.has("speed") || !p.has("angle") || !p.has("angleSpeed")) {
+    return false;
+  }
+  mov.horizontalDistance = p.getFloat("distance", 0);
+  mov.horizontalSpeed = p.getInt("speed", 50);
+  mov.angle = p.getInt("angle", 90);
+  mov.angleSpeed = p.getInt("angleSpeed", 50);
+  mov.simultaneous = p.get("simultaneous") == "true";
+  mov.pauseAfter = p.getInt("pause", 0);
+
+  for (int axis = 0; axis < MAX_MOTION_AXES; axis++) {
+    String key = "axis" + String(axis);
+    String speedKey = key + "Speed";
+    if (!p.has(key.c_str())) continue;
+    mov.axes[axis].active = true;
+    mov.axes[axis].value = p.getFloat(key.c_str(), 0);
+    if (p.has(speedKey.c_str())) {
+      mov.axes[axis].speed = p.getInt(speedKey.c_str(), 50);
+    }
+  }
+  return true;
+}
+
+static void cmdSequenceAdd(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  Movement mov;
+  if (!p.has("seq") || !parseMovement(p, mov)) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  int seqIndex = p.getInt("seq", -1);
+  const Sequence* seq = c.sequences->getSequence(seqIndex);
+  if (seq == nullptr) {
+    res.fail(404, "Secuencia inexistente");
+  } else if (c.sequences->addMovement(seqIndex, mov)) {
+    res.ok();
+  } else if (seq->count >= seq->capacity) {
+    res.fail(507, "Pool de movimientos lleno");
+  } else {
+    res.fail(400, "Movimiento inválido");
+  }
+}
+
+// Versión esperada para la concurrencia optimista: cabecera If-Match
+// (admite comillas y W/) o parámetro version. 0 = no verificar.
+static uint32_t expectedVersion(const CommandParams& p) {
+  String tag = p.header("If-Match");
+  if (tag.length() == 0) tag = p.get("version");
+  if (tag.startsWith("W/")) tag = tag.substring(2);
+  tag.replace("\"", "");
+  return tag == "*" ? 0 : (uint32_t)tag.toInt();
+}
+
+static void sendEditResult(const CommandContext& c, int seqIndex, SequenceEditResult result,
+                           CommandResponse& res) {
+  const Sequence* seq = c.sequences->getSequence(seqIndex);
+  uint32_t version = seq != nullptr ? seq->version : 0;
+  switch (result) {
+    case EDIT_OK:
+      res.send(200, "{\"success\":true,\"version\":" + String(version) +
+                    ",\"count\":" + String(c.sequences->getMovementCount(seqIndex)) + "}");
+      break;
+    case EDIT_NOT_FOUND:
+      res.fail(404, "Secuencia o movimiento inexistente");
+      break;
+    case EDIT_STALE:
+      res.send(412, "{\"success\":false,\"message\":\"La secuencia cambió\",\"version\":" +
+                    String(version) + "}");
+      break;
+    case EDIT_BUSY:
+      res.fail(409, "Secuencia en ejecución");
+      break;
+    case EDIT_NO_SPACE:
+      res.fail(507, "Pool de movimientos lleno");
+      break;
+    default:
+      res.fail(400, "Movimiento inválido");
+      break;
+  }
+}
+
+// Reemplazar un movimiento: seq, index y los campos de /sequence/add
+static void cmdSequenceUpdate(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  Movement mov;
+  if (!p.has("seq") || !p.has("index") || !parseMovement(p, mov)) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int seqIndex = p.getInt("seq", -1);
+  SequenceEditResult result = c.sequences->updateMovement(seqIndex, p.getInt("index", -1), mov,
+                                                          expectedVersion(p));
+  sendEditResult(c, seqIndex, result, res);
+}
+
+// Insertar antes del movimiento 'index' (index = cantidad agrega al final)
+static void cmdSequenceInsert(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  Movement mov;
+  if (!p.has("seq") || !p.has("index") || !parseMovement(p, mov)) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int seqIndex = p.getInt("seq", -1);
+  SequenceEditResult result = c.sequences->insertMovement(seqIndex, p.getInt("index", -1), mov,
+                                                          expectedVersion(p));
+  sendEditResult(c, seqIndex, result, res);
+}
+
+// Reordenar: seq, from, to
+static void cmdSequenceMove(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("from") || !p.has("to")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int seqIndex = p.getInt("seq", -1);
+  SequenceEditResult result = c.sequences->moveMovement(seqIndex, p.getInt("from", -1),
+                                                        p.getInt("to", -1), expectedVersion(p));
+  sendEditResult(c, seqIndex, result, res);
+}
+
+static void cmdSequenceRemove(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("index")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  int seqIndex = p.getInt("seq", -1);
+  SequenceEditResult result = c.sequences->removeMovement(seqIndex, p.getInt("index", -1),
+                                                          expectedVersion(p));
+  sendEditResult(c, seqIndex, result, res);
+}
+
+// Repetición: seq, repeat (pasadas, 1-1000) y loop=true|false. Lo que no
+// se envía conserva su valor.
+static void cmdSequenceOptions(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  int seqIndex = p.getInt("seq", -1);
+  const Sequence* seq = c.sequences->getSequence(seqIndex);
+  if (seq == nullptr) {
+    res.fail(404, "Secuencia inexistente");
+    return;
+  }
+  bool loop = p.has("loop") ? p.get("loop") == "true" : seq->loop;
+  int repeat = p.getInt("repeat", seq->repeatCount);
+  SequenceEditResult result = c.sequences->setRepeat(seqIndex, loop, repeat, expectedVersion(p));
+  if (result == EDIT_INVALID) {
+    res.fail(400, "Repeticiones inválidas");
+    return;
+  }
+  sendEditResult(c, seqIndex, result, res);
+}
+
+// Agregar movimiento generador (timelapse): N frames en una sola petición
+static void cmdSequenceGenerator(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("frames") || !p.has("distance")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  int seqIndex = p.getInt("seq", -1);
+  long frames = p.getInt("frames", 0);
+  FrameGenerator gen;
+  gen.frames = frames > 0 ? frames : 0;
+  gen.distance = p.getFloat("distance", 0);
+  gen.startAngle = p.getInt("startAngle", -1);
+  gen.endAngle = p.getInt("endAngle", gen.startAngle);
+  gen.speed = constrain(p.getInt("speed", 50), 0, 100);
+  gen.angleSpeed = constrain(p.getInt("angleSpeed", 50), 0, 100);
+  gen.shutter = p.has("shutter") ? p.get("shutter") == "true" : true;
+  gen.intervalMs = max(p.getInt("interval", 0), 0L);
+  gen.settleMs = max(p.getInt("settle", 0), 0L);
+  gen.exposureMs = max(p.getInt("exposure", 0), 0L);
+
+  String easing = p.get("easing");
+  if (easing == "in") gen.easing = EASE_IN;
+  else if (easing == "out") gen.easing = EASE_OUT;
+  else if (easing == "inout") gen.easing = EASE_IN_OUT;
+  else gen.easing = EASE_LINEAR;
+
+  if (c.sequences->addGenerator(seqIndex, gen)) {
+    res.send(200, "{\"success\":true,\"frames\":" + String(gen.frames) + "}");
+  } else {
+    res.fail(400, "Generador inválido o sin espacio");
+  }
+}
+
+// Palabra hasta ':' / ';' / fin; avanza 's'
+static String nextWord(const char*& s) {
+  const char* start = s;
+  while (*s && *s != ':' && *s != ';') s++;
+  return String(start).substring(0, s - start);
+}
+
+// Cargar puntos clave de una trayectoria (todos en una sola petición)
+// keys = "t,pos,angle;t,pos,angle;..." con t en ms, pos en mm y angle en grados
+static void cmdSequenceKeyframes(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("keys")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  int seqIndex = p.getInt("seq", -1);
+  InterpolationType interp = p.get("interp") == "catmull" ? INTERP_CATMULL_ROM : INTERP_MONOTONE;
+
+  std::vector<Keyframe> keyframes;
+  String keys = p.get("keys");
+  const char* s = keys.c_str();
+  while (*s) {
+    char* end;
+    Keyframe k;
+    k.timeMs = strtoul(s, &end, 10);
+    if (end == s || *end != ',') break;
+    s = end + 1;
+    k.position = strtof(s, &end);
+    if (end == s || *end != ',') break;
+    s = end + 1;
+    k.angle = strtof(s, &end);
+    if (end == s) break;
+    keyframes.push_back(k);
+    s = end;
+    if (*s == ';') s++;
+  }
+
+  if (*s != '\0') {
+    res.fail(400, "Formato de puntos clave inválido");
+    return;
+  }
+
+  if (c.sequences->setKeyframes(seqIndex, keyframes, interp)) {
+    res.send(200, "{\"success\":true,\"count\":" + String((int)keyframes.size()) + "}");
+  } else {
+    res.fail(500);
+  }
+}
+
+// Capas aditivas de una trayectoria: seq=0&layers=eje:forma:amplitud:periodo:fase[:inicio:duración:fundido];...
+// eje rail (mm) | pan (grados), forma sine | triangle | curve, tiempos en
+// ms del reloj de la trayectoria. layers vacío las quita.
+static void cmdSequenceLayers(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("layers")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  MotionLayer layers[MAX_MOTION_LAYERS];
+  int count = 0;
+  String text = p.get("layers");
+  const char* s = text.c_str();
+  while (*s && count < MAX_MOTION_LAYERS) {
+    String axis = nextWord(s);
+    if (*s != ':') break;
+    s++;
+    String shape = nextWord(s);
+    if (*s != ':') break;
+    s++;
+
+    if ((axis != "rail" && axis != "pan") || (shape != "sine" && shape != "triangle" && shape != "curve")) break;
+
+    MotionLayer& layer = layers[count];
+    layer.axis = axis == "pan" ? LAYER_PAN : LAYER_RAIL;
+    layer.shape = shape == "triangle" ? LAYER_TRIANGLE : (shape == "curve" ? LAYER_CURVE : LAYER_SINE);
+
+    char* end;
+    float values[6] = { 0, 0, 0, 0, 0, 0 };
+    int fields = 0;
+    while (fields < 6) {
+      values[fields] = strtof(s, &end);
+      if (end == s) break;
+      fields++;
+      s = end;
+      if (*s != ':') break;
+      s++;
+    }
+    if (fields < 3 || *s == ':') break;
+    layer.amplitude = values[0];
+    layer.periodMs = (uint32_t)max(values[1], 0.0f);
+    layer.phaseDeg = values[2];
+    layer.startMs = (uint32_t)max(values[3], 0.0f);
+    layer.durationMs = (uint32_t)max(values[4], 0.0f);
+    layer.fadeMs = (uint32_t)max(values[5], 0.0f);
+    count++;
+    if (*s == ';') s++;
+  }
+
+  if (*s != '\0') {
+    res.fail(400, "Formato de capas inválido");
+    return;
+  }
+
+  if (c.sequences->setLayers(p.getInt("seq", -1), layers, count)) {
+    res.send(200, "{\"success\":true,\"count\":" + String(count) + "}");
+  } else {
+    res.fail(400, "Capas inválidas o secuencia sin trayectoria");
+  }
+}
+
+// Cargar un programa de movimiento ya ensamblado: seq=0&code=<bytecode en
+// hexadecimal> (el ensamblador está en la interfaz web). Se verifica entero
+// antes de reemplazar el anterior.
+static void cmdSequenceProgram(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("seq") || !p.has("code")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  String hex = p.get("code");
+  if (hex.length() % 2 != 0 || hex.length() / 2 > MAX_PROGRAM_BYTES) {
+    res.fail(400, "Código de largo inválido");
+    return;
+  }
+  std::vector<uint8_t> code(hex.length() / 2);
+  for (size_t i = 0; i < code.size(); i++) {
+    char pair[3] = { hex[2 * i], hex[2 * i + 1], '\0' };
+    char* end;
+    code[i] = (uint8_t)strtoul(pair, &end, 16);
+    if (*end != '\0') {
+      res.fail(400, "Código no hexadecimal");
+      return;
+    }
+  }
+
+  MotionProgram* program = new MotionProgram();
+  String error;
+  if (!program->load(code.data(), code.size(), error)) {
+    delete program;
+    res.send(400, "{\"success\":false,\"message\":\"" + error + "\"}");
+    return;
+  }
+  uint16_t instructions = program->getInstructionCount();
+  if (c.sequences->setProgram(p.getInt("seq", -1), program)) {
+    res.send(200, "{\"success\":true,\"bytes\":" + String((int)code.size()) +
+                  ",\"instructions\":" + String(instructions) + "}");
+  } else {
+    res.fail(409, "Secuencia inexistente, en uso o no es un programa");
+  }
+}
+
+// Cargar playlist: entries=índice:repeticiones;... (loop=1 para repetirla entera)
+static void cmdPlaylistSet(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("entries")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  PlaylistEntry entries[MAX_PLAYLIST_ENTRIES];
+  int count = 0;
+  String text = p.get("entries");
+  const char* s = text.c_str();
+  while (*s && count < MAX_PLAYLIST_ENTRIES) {
+    char* end;
+    long index = strtol(s, &end, 10);
+    if (end == s) break;
+    s = end;
+    long repeat = 1;
+    if (*s == ':') {
+      s++;
+      repeat = strtol(s, &end, 10);
+      if (end == s) break;
+      s = end;
+    }
+    if (index < 0 || index > 255 || repeat < 1 || repeat > 0xFFFF) break;
+    entries[count].sequence = index;
+    entries[count].repeat = repeat;
+    count++;
+    if (*s == ';') s++;
+  }
+
+  if (*s != '\0') {
+    res.fail(400, "Formato de playlist inválido");
+    return;
+  }
+
+  bool loop = p.get("loop") == "1";
+  if (c.sequences->setPlaylist(entries, count, loop)) {
+    res.send(200, "{\"success\":true,\"count\":" + String(count) + "}");
+  } else {
+    res.fail(409, "Secuencia inexistente o playlist en ejecución");
+  }
+}
+
+static void cmdPlaylistStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.sequences->getPlaylistAsJson());
+}
+
+// Ejecutar la playlist (pausa y stop son los de /sequence)
+static void cmdPlaylistExecute(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  String reason;
+  if (!c.sequences->validatePlaylist(reason)) {
+    res.fail(409, reason.c_str());
+    return;
+  }
+  if (c.sequences->executePlaylist()) {
+    res.ok();
+  } else {
+    res.fail(500);
+  }
+}
+
+// ?mode=forward (por defecto) | reverse | pingpong
+static bool parsePlaybackMode(const CommandParams& p, PlaybackMode& mode) {
+  String name = p.get("mode");
+  if (name.length() == 0 || name == "forward") mode = PLAY_FORWARD;
+  else if (name == "reverse") mode = PLAY_REVERSE;
+  else if (name == "pingpong") mode = PLAY_PINGPONG;
+  else return false;
+  return true;
+}
+
+// ?index=0&mode=reverse
+static void cmdSequenceExecute(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  PlaybackMode mode;
+  if (!p.has("index") || !parsePlaybackMode(p, mode)) {
+    res.fail(400);
+    return;
+  }
+  int index = p.getInt("index", -1);
+  String reason;
+  if (!c.sequences->validateSequence(index, reason, mode)) {
+    res.fail(409, reason.c_str());
+    return;
+  }
+  if (c.sequences->executeSequence(index, mode)) {
+    res.ok();
+  } else {
+    res.fail(500);
+  }
+}
+
+// Armar secuencia: pose inicial y motores retenidos a la espera del go
+static void cmdSequenceArm(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  PlaybackMode mode;
+  if (!p.has("index") || !parsePlaybackMode(p, mode)) {
+    res.fail(400);
+    return;
+  }
+  int index = p.getInt("index", -1);
+  String reason;
+  if (!c.sequences->validateSequence(index, reason, mode)) {
+    res.fail(409, reason.c_str());
+    return;
+  }
+  if (c.sequences->armSequence(index, mode)) {
+    res.ok();
+  } else {
+    res.fail(500);
+  }
+}
+
+// Vuelta rápida a la pose donde arrancó la última toma
+static void cmdSequenceReturn(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  String reason;
+  uint32_t etaMs = 0;
+  if (!c.sequences->rapidReturn(reason, etaMs)) {
+    res.fail(409, reason.c_str());
+    return;
+  }
+  res.send(200, "{\"success\":true,\"etaMs\":" + String(etaMs) + "}");
+}
+
+// Arrancar la secuencia armada
+static void cmdSequenceGo(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (c.sequences->go()) {
+    res.ok();
+  } else {
+    res.fail(409, "No hay secuencia armada");
+  }
+}
+
+// Estado del armado y latencia del go
+static void cmdSequenceArmStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.sequences->getArmStatusAsJson());
+}
+
+static void cmdSequencePause(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.sequences->pause();
+  res.ok();
+}
+
+static void cmdSequenceResume(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.sequences->resume();
+  res.ok();
+}
+
+static void cmdSequenceStop(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.sequences->stop();
+  res.ok();
+}
+
+// Velocidad de reproducción de trayectorias (puntos clave o grabadas)
+// ?index=0&speed=150 (10-400%, 100 = velocidad original)
+static void cmdSequencePlayback(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("index") || !p.has("speed")) {
+    res.fail(400);
+    return;
+  }
+  if (c.sequences->setPlaybackSpeed(p.getInt("index", -1), p.getInt("speed", 100))) {
+    res.ok();
+  } else {
+    res.fail(400, "Secuencia o velocidad inválida");
+  }
+}
+
+// Avance global, también con la secuencia en marcha
+// ?percent=150 (10-200%) | sin parámetros devuelve el actual
+static void cmdSequenceFeed(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("percent")) {
+    long percent = p.getInt("percent", 100);
+    if (percent < FEED_OVERRIDE_MIN || percent > FEED_OVERRIDE_MAX) {
+      res.fail(400, "Avance fuera de rango");
+      return;
+    }
+    String reason;
+    if (!c.sequences->setFeedOverride(percent, reason)) {
+      res.fail(409, reason.c_str());
+      return;
+    }
+  }
+  res.send(200, "{\"success\":true,\"feed\":" + String(c.sequences->getFeedOverride()) + "}");
+}
+
+// Saltar a un movimiento (índice desde 0) o a un instante en ms de una trayectoria
+static void cmdSequenceSeek(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("position")) {
+    res.fail(400);
+    return;
+  }
+  long position = p.getInt("position", -1);
+  if (position >= 0 && c.sequences->seek(position)) {
+    res.ok();
+  } else {
+    res.fail(409, "No hay secuencia en ejecución o no admite saltos");
+  }
+}
+
+// Estado publicado por el ejecutor y latencia de sus órdenes
+static void cmdSequenceExecutor(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.sequences->getExecutorStatusAsJson());
+}
+
+// Latencia desde el pedido de pausa/stop hasta el inicio del frenado
+static void cmdSequenceStopLatency(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.sequences->getStopLatencyAsJson());
+}
+
+// Cabeceras y análisis, sin movimientos (se piden con /sequence/get)
+static void cmdSequenceList(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  String json = c.sequences->getAllSequencesAsJson();
+  if (json.length() == 0) {
+    res.fail(503, "Sin memoria para la respuesta");
+    return;
+  }
+  res.send(200, json);
+}
+
+// Límites blandos del riel y velocidad máxima, verificados antes de ejecutar
+// ?min=0&max=600 (mm) | ?off=1 | ?speedCap=1500 (steps/s, 0 = máximo del driver)
+static void cmdSequenceLimits(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("off")) {
+    c.sequences->disableSoftLimits();
+  } else if (p.has("min") && p.has("max")) {
+    c.sequences->setSoftLimits(p.getFloat("min", 0), p.getFloat("max", 0));
+  }
+  if (p.has("speedCap")) {
+    c.sequences->setSpeedCap(max(0L, p.getInt("speedCap", 0)));
+  }
+  res.send(200, c.sequences->getLimitsAsJson());
+}
+
+// Borrar secuencia (libera su tramo del pool)
+static void cmdSequenceDelete(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("index")) {
+    res.fail(400);
+    return;
+  }
+  if (c.sequences->deleteSequence(p.getInt("index", -1))) {
+    res.ok();
+  } else {
+    res.fail(409);
+  }
+}
+
+// Ocupación del pool de movimientos
+static void cmdSequencePool(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.sequences->getPoolUsageAsJson());
+}
+
+// index=0 & offset=0 & limit=64: una página de movimientos ("count" y
+// "more" dicen si faltan); 503 si no hay memoria para armarla
+static void cmdSequenceGet(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("index")) {
+    res.send(400, "{}");
+    return;
+  }
+  long offset = p.getInt("offset", 0);
+  long limit = p.getInt("limit", SEQUENCE_JSON_PAGE);
+  if (offset < 0 || offset > 0xFFFF || limit < 1 || limit > SEQUENCE_JSON_PAGE) {
+    res.fail(400, "Página inválida");
+    return;
+  }
+  String json = c.sequences->getSequenceAsJson(p.getInt("index", -1), offset, limit);
+  if (json.length() == 0) {
+    res.fail(503, "Sin memoria para la respuesta");
+    return;
+  }
+  res.send(200, json);
+}
+
+// ========== Modo teach ==========
+
+// Grabar el recorrido de un jog manual: tolerance=0.2 (mm) & angleTolerance=1 (°)
+static void cmdTeachStart(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (c.sequences->getIsExecuting()) {
+    res.fail(409, "Hay una secuencia en ejecución");
+    return;
+  }
+  if (c.teach->start(p.getFloat("tolerance", 0.2f), p.getInt("angleTolerance", 1))) {
+    res.ok();
+  } else {
+    res.fail(409, "Ya se está grabando");
+  }
+}
+
+// Termina la grabación y la guarda como secuencia 'recorded' (name)
+static void cmdTeachStop(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  RecordedPath* recording = c.teach->stop();
+  if (recording == nullptr) {
+    res.fail(409, "No se estaba grabando");
+    return;
+  }
+  String name = p.has("name") ? p.get("name") : String("Grabación");
+  uint32_t points = recording->getPointCount();
+  uint32_t bytes = recording->getByteSize();
+  uint32_t durationMs = recording->getDurationMs();
+  int index = c.sequences->createSequence(name, SEQUENCE_RECORDED);
+  if (index < 0) {
+    delete recording;
+    res.fail(507, "Sin lugar para la secuencia");
+    return;
+  }
+  if (!c.sequences->setRecording(index, recording)) {
+    c.sequences->deleteSequence(index);
+    res.fail(400, "Grabación vacía");
+    return;
+  }
+  String json = "{\"success\":true,\"index\":" + String(index);
+  json += ",\"points\":" + String(points);
+  json += ",\"bytes\":" + String(bytes);
+  json += ",\"durationMs\":" + String(durationMs) + "}";
+  res.send(200, json);
+}
+
+static void cmdTeachStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.teach->getStatusAsJson());
+}
+
+// ========== Seguimiento de sujeto ==========
+
+// along (mm sobre el rail, desde el cero), distance (mm perpendicular al
+// rail), center (° del servo que mira perpendicular) e invert=true|false.
+// Con el seguimiento activo cambia el sujeto sin cortarlo.
+static void cmdTrackStart(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("along") || !p.has("distance")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+  if (c.tracker->start(p.getFloat("along", 0), p.getFloat("distance", 0),
+                       p.getFloat("center", 90), p.get("invert") == "true")) {
+    res.ok();
+  } else {
+    res.fail(400, "Geometría inválida");
+  }
+}
+
+static void cmdTrackStop(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.tracker->stop();
+  res.ok();
+}
+
+static void cmdTrackStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.tracker->getStatusAsJson());
+}
+
+// ========== Disparos por posición ==========
+
+static int parseTriggerAction(const String& name) {
+  for (int action = 0; action < TRIGGER_ACTION_COUNT; action++) {
+    if (name == triggerActionName(action)) return action;
+  }
+  return -1;
+}
+
+static int parseTriggerDirection(const String& name) {
+  if (name.length() == 0 || name == "both") return TRIGGER_BOTH;
+  if (name == "forward") return TRIGGER_FORWARD;
+  if (name == "reverse") return TRIGGER_REVERSE;
+  return -1;
+}
+
+static void sendTriggersLoaded(bool loaded, int count, CommandResponse& res) {
+  if (loaded) {
+    res.send(200, "{\"success\":true,\"count\":" + String(count) + "}");
+  } else {
+    res.fail(400, "Demasiados disparos");
+  }
+}
+
+// entries=100:shutter;150.5:pulse:forward;200:marker:reverse (mm absolutos
+// desde el cero; acción shutter | pulse | marker; sentido opcional) y
+// pulse=ancho del pulso en ms. Reemplaza la lista.
+static void cmdTriggersSet(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!p.has("entries")) {
+    res.fail(400, "Faltan parámetros");
+    return;
+  }
+
+  std::vector<PositionTrigger> entries;
+  String text = p.get("entries");
+  const char* s = text.c_str();
+  while (*s) {
+    char* end;
+    float mm = strtof(s, &end);
+    if (end == s || *end != ':') break;
+    s = end + 1;
+    int action = parseTriggerAction(nextWord(s));
+    int direction = TRIGGER_BOTH;
+    if (*s == ':') {
+      s++;
+      direction = parseTriggerDirection(nextWord(s));
+    }
+    if (action < 0 || direction < 0 || entries.size() >= TRIGGER_MAX_ENTRIES) break;
+    entries.push_back({ (int32_t)c.stepper->mmToSteps(mm, MM_PER_REVOLUTION), (uint8_t)action, (uint8_t)direction });
+    if (*s == ';') s++;
+  }
+
+  if (*s != '\0') {
+    res.fail(400, "Formato de disparos inválido");
+    return;
+  }
+  if (p.has("pulse")) c.system->setTriggerPulseWidth(p.getInt("pulse", 100));
+  sendTriggersLoaded(c.system->setPositionTriggers(entries.data(), entries.size()), entries.size(), res);
+}
+
+// Serie equiespaciada (timelapse continuo): start y spacing en mm, count,
+// action, direction y pulse como en /triggers/set
+static void cmdTriggersSeries(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  int count = p.getInt("count", 0);
+  float spacing = p.getFloat("spacing", 0);
+  int action = parseTriggerAction(p.has("action") ? p.get("action") : String("shutter"));
+  int direction = parseTriggerDirection(p.get("direction"));
+  if (!p.has("start") || count < 1 || spacing == 0 || action < 0 || direction < 0) {
+    res.fail(400, "Parámetros inválidos");
+    return;
+  }
+  if (count > TRIGGER_MAX_ENTRIES) {
+    res.fail(400, "Demasiados disparos");
+    return;
+  }
+
+  std::vector<PositionTrigger> entries(count);
+  float start = p.getFloat("start", 0);
+  for (int i = 0; i < count; i++) {
+    entries[i] = { (int32_t)c.stepper->mmToSteps(start + spacing * i, MM_PER_REVOLUTION), (uint8_t)action, (uint8_t)direction };
+  }
+  if (p.has("pulse")) c.system->setTriggerPulseWidth(p.getInt("pulse", 100));
+  sendTriggersLoaded(c.system->setPositionTriggers(entries.data(), count), count, res);
+}
+
+static void cmdTriggersClear(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.system->clearPositionTriggers();
+  res.ok();
+}
+
+static void cmdTriggersStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.system->getPositionTriggersAsJson());
+}
+
+// ========== Parada de emergencia ==========
+
+// Estado y latencias del último disparo
+static void cmdEstopStatus(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.system->getEmergencyStopAsJson());
+}
+
+// Mismo camino que la entrada de hardware
+static void cmdEstopTrigger(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.system->triggerEmergencyStop();
+  res.send(200, c.system->getEmergencyStopAsJson());
+}
+
+// Solo con la entrada liberada
+static void cmdEstopReset(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (!c.system->resetEmergencyStop()) {
+    res.fail(409, "Entrada de emergencia aún activa");
+    return;
+  }
+  res.ok();
+}
+
+// ========== Punto de control ==========
+
+// Pose guardada, la del arranque y la ejecución interrumpida. autoResume=0|1
+// e intervalMs (mínimo entre escrituras) se guardan en NVS.
+static void cmdRecovery(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("autoResume")) c.system->setCheckpointAutoResume(p.getInt("autoResume", 1) != 0);
+  if (p.has("intervalMs")) c.system->setCheckpointInterval(p.getInt("intervalMs", CHECKPOINT_INTERVAL_DEFAULT_MS));
+  res.send(200, c.system->getCheckpointAsJson());
+}
+
+// Recrea la secuencia interrumpida y la sigue desde el punto de control
+static void cmdRecoveryResume(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  String reason;
+  if (!c.system->resumeFromCheckpoint(reason)) {
+    res.fail(409, reason.c_str());
+    return;
+  }
+  res.ok();
+}
+
+static void cmdRecoveryDiscard(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  c.system->discardCheckpointRun();
+  res.ok();
+}
+
+// ========== Sistema ==========
+
+// Layouts de tasks: listar o aplicar (?layout=N, se guarda en NVS)
+static void cmdSystemTasks(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("layout")) {
+    int layout = p.getInt("layout", -1);
+    if (c.system->isJitterBenchmarkRunning() || !c.system->applyTaskLayout(layout)) {
+      res.fail(409);
+      return;
+    }
+  }
+  res.send(200, c.system->getTaskLayoutsAsJson());
+}
+
+// Medición de jitter por layout: ?start=1&steps=1600&speed=800 la lanza,
+// sin parámetros devuelve el estado y los resultados
+static void cmdSystemBenchmark(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("start")) {
+    long steps = p.getInt("steps", 1600);
+    int speed = p.getInt("speed", 800);
+    if (!c.system->startJitterBenchmark(steps, speed)) {
+      res.fail(409, "Stepper ocupado o deshabilitado");
+      return;
+    }
+  }
+  res.send(200, c.system->getJitterBenchmarkAsJson());
+}
+
+// Tiempo de cada comando sin el transporte
+static void cmdSystemCommands(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, getCommandStatsAsJson());
+}
+
+// Últimas líneas del registro: ?since=<id> devuelve solo las nuevas
+static void cmdSystemLog(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  res.send(200, c.system->getLogAsJson(p.getInt("since", 0)));
+}
+
+// Energía: sin parámetros devuelve configuración y consumo estimado.
+// Parámetros opcionales: stepperIdle, servoIdle (ms, 0 = nunca),
+// lightSleep (true/false), sleepMin (ms), radiosOff (true/false: WiFi y BLE
+// apagados en las ejecuciones para poder dormir) y corrientes del modelo en mA
+// (baseMa, sleepMa, holdMa, moveMa, servoMa, servoMoveMa)
+static void cmdPower(const CommandContext& c, const CommandParams& p, CommandResponse& res) {
+  if (p.has("stepperIdle")) c.stepper->setIdleTimeout(p.getInt("stepperIdle", 0));
+  if (p.has("servoIdle")) c.servo->setIdleTimeout(p.getInt("servoIdle", 0));
+
+  PowerConfig cfg = c.system->getPowerConfig();
+  if (p.has("lightSleep")) cfg.lightSleepEnabled = p.get("lightSleep") == "true";
+  cfg.lightSleepMinMs = p.getInt("sleepMin", cfg.lightSleepMinMs);
+  if (p.has("radiosOff")) cfg.radiosOffInRun = p.get("radiosOff") == "true";
+  cfg.baseCurrentMa = p.getFloat("baseMa", cfg.baseCurrentMa);
+  cfg.sleepCurrentMa = p.getFloat("sleepMa", cfg.sleepCurrentMa);
+  cfg.loadCurrentMa[POWER_STEPPER_HOLD] = p.getFloat("holdMa", cfg.loadCurrentMa[POWER_STEPPER_HOLD]);
+  cfg.loadCurrentMa[POWER_STEPPER_MOVING] = p.getFloat("moveMa", cfg.loadCurrentMa[POWER_STEPPER_MOVING]);
+  cfg.loadCurrentMa[POWER_SERVO_ATTACHED] = p.getFloat("servoMa", cfg.loadCurrentMa[POWER_SERVO_ATTACHED]);
+  cfg.loadCurrentMa[POWER_SERVO_MOVING] = p.getFloat("servoMoveMa", cfg.loadCurrentMa[POWER_SERVO_MOVING]);
+  c.system->setPowerConfig(cfg);
+
+  PowerFrameReport report = c.system->getPowerReport();
+  String json = "{";
+  json += "\"stepperIdle\":" + String(c.stepper->getIdleTimeout()) + ",";
+  json += "\"servoIdle\":" + String(c.servo->getIdleTimeout()) + ",";
+  json += "\"holdReleased\":" + String(c.stepper->getIsHoldReleased() ? "true" : "false") + ",";
+  json += "\"servoAttached\":" + String(c.servo->getIsAttached() ? "true" : "false") + ",";
+  json += "\"lightSleep\":" + String(cfg.lightSleepEnabled ? "true" : "false") + ",";
+  json += "\"sleepMin\":" + String(cfg.lightSleepMinMs) + ",";
+  json += "\"radiosOff\":" + String(cfg.radiosOffInRun ? "true" : "false") + ",";
+  json += "\"frames\":" + String(report.frames) + ",";
+  json += "\"lastFrameMs\":" + String(report.lastFrameMs) + ",";
+  json += "\"lastFrameAvgMa\":" + String(report.lastFrameAvgMa, 1) + ",";
+  json += "\"overallAvgMa\":" + String(report.overallAvgMa, 1) + ",";
+  json += "\"totalMah\":" + String(report.totalMah, 2) + ",";
+  json += "\"sleepMs\":" + String(report.sleepMs);
+  json += "}";
+  res.send(200, json);
+}
+
+// ========== Tabla de rutas ==========
+
+static const uint8_t NEEDS_DRIVERS = NEEDS_STEPPER | NEEDS_SERVO;
+
+static const CommandRoute ROUTES[] = {
+  { "/photo",              COMMAND_GET,  NEEDS_NOTHING,   cmdPhoto },
+  { "/status",             COMMAND_GET,  NEEDS_NOTHING,   cmdStatus },
+  { "/servo",              COMMAND_GET,  NEEDS_SERVO,     cmdServo },
+  { "/stepper/enable",     COMMAND_GET,  NEEDS_STEPPER,   cmdStepperEnable },
+  { "/stepper/zero",       COMMAND_GET,  NEEDS_STEPPER,   cmdStepperZero },
+  { "/stepper",            COMMAND_GET,  NEEDS_STEPPER,   cmdStepper },
+  { "/backlash/config",    COMMAND_GET,  NEEDS_DRIVERS | NEEDS_SYSTEM, cmdBacklashConfig },
+  { "/backlash/calibrate", COMMAND_POST, NEEDS_DRIVERS,   cmdBacklashCalibrate },
+  { "/axes",               COMMAND_GET,  NEEDS_MOTION,    cmdAxes },
+  { "/axis",               COMMAND_GET,  NEEDS_MOTION,    cmdAxis },
+  { "/sequence/create",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceCreate },
+  { "/sequence/add",       COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceAdd },
+  { "/sequence/update",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceUpdate },
+  { "/sequence/insert",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceInsert },
+  { "/sequence/move",      COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceMove },
+  { "/sequence/remove",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceRemove },
+  { "/sequence/options",   COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceOptions },
+  { "/sequence/generator", COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceGenerator },
+  { "/sequence/keyframes", COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceKeyframes },
+  { "/sequence/layers",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceLayers },
+  { "/sequence/program",   COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceProgram },
+  { "/playlist/set",       COMMAND_POST, NEEDS_SEQUENCES, cmdPlaylistSet },
+  { "/playlist/status",    COMMAND_GET,  NEEDS_SEQUENCES, cmdPlaylistStatus },
+  { "/playlist/execute",   COMMAND_GET,  NEEDS_SEQUENCES, cmdPlaylistExecute },
+  { "/sequence/execute",   COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceExecute },
+  { "/sequence/arm",       COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceArm },
+  { "/sequence/go",        COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceGo },
+  { "/sequence/return",    COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceReturn },
+  { "/sequence/armStatus", COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceArmStatus },
+  { "/sequence/pause",     COMMAND_GET,  NEEDS_SEQUENCES, cmdSequencePause },
+  { "/sequence/resume",    COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceResume },
+  { "/sequence/stop",      COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceStop },
+  { "/sequence/playback",  COMMAND_GET,  NEEDS_SEQUENCES, cmdSequencePlayback },
+  { "/sequence/feed",      COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceFeed },
+  { "/teach/start",        COMMAND_POST, NEEDS_SEQUENCES | NEEDS_TEACH, cmdTeachStart },
+  { "/teach/stop",         COMMAND_POST, NEEDS_SEQUENCES | NEEDS_TEACH, cmdTeachStop },
+  { "/teach/status",       COMMAND_GET,  NEEDS_TEACH,     cmdTeachStatus },
+  { "/triggers/set",       COMMAND_POST, NEEDS_STEPPER | NEEDS_SYSTEM, cmdTriggersSet },
+  { "/triggers/series",    COMMAND_POST, NEEDS_STEPPER | NEEDS_SYSTEM, cmdTriggersSeries },
+  { "/triggers/clear",     COMMAND_POST, NEEDS_STEPPER | NEEDS_SYSTEM, cmdTriggersClear },
+  { "/triggers/status",    COMMAND_GET,  NEEDS_STEPPER | NEEDS_SYSTEM, cmdTriggersStatus },
+  { "/track/start",        COMMAND_POST, NEEDS_TRACKER,   cmdTrackStart },
+  { "/track/stop",         COMMAND_POST, NEEDS_TRACKER,   cmdTrackStop },
+  { "/track/status",       COMMAND_GET,  NEEDS_TRACKER,   cmdTrackStatus },
+  { "/sequence/seek",      COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceSeek },
+  { "/sequence/executor",  COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceExecutor },
+  { "/sequence/stopLatency", COMMAND_GET, NEEDS_SEQUENCES, cmdSequenceStopLatency },
+  { "/estop/status",       COMMAND_GET,  NEEDS_SYSTEM,    cmdEstopStatus },
+  { "/estop/trigger",      COMMAND_GET,  NEEDS_SYSTEM,    cmdEstopTrigger },
+  { "/estop/reset",        COMMAND_POST, NEEDS_SYSTEM,    cmdEstopReset },
+  { "/recovery",           COMMAND_GET,  NEEDS_SYSTEM,    cmdRecovery },
+  { "/recovery/resume",    COMMAND_POST, NEEDS_SYSTEM,    cmdRecoveryResume },
+  { "/recovery/discard",   COMMAND_POST, NEEDS_SYSTEM,    cmdRecoveryDiscard },
+  { "/sequence/list",      COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceList },
+  { "/sequence/limits",    COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceLimits },
+  { "/sequence/delete",    COMMAND_POST, NEEDS_SEQUENCES, cmdSequenceDelete },
+  { "/sequence/pool",      COMMAND_GET,  NEEDS_SEQUENCES, cmdSequencePool },
+  { "/sequence/get",       COMMAND_GET,  NEEDS_SEQUENCES, cmdSequenceGet },
+  { "/system/tasks",       COMMAND_GET,  NEEDS_SYSTEM,    cmdSystemTasks },
+  { "/system/benchmark",   COMMAND_GET,  NEEDS_SYSTEM,    cmdSystemBenchmark },
+  { "/system/commands",    COMMAND_GET,  NEEDS_NOTHING,   cmdSystemCommands },
+  { "/system/log",         COMMAND_GET,  NEEDS_SYSTEM,    cmdSystemLog },
+  { "/power",              COMMAND_GET,  NEEDS_DRIVERS | NEEDS_SYSTEM, cmdPower },
+};
+
+static const int ROUTE_COUNT = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+static CommandStats stats[ROUTE_COUNT];
+
+int getCommandRouteCount() {
+  return ROUTE_COUNT;
+}
+
+const CommandRoute& getCommandRoute(int index) {
+  return ROUTES[index];
+}
+
+static bool available(uint8_t needs) {
+  return (!(needs & NEEDS_STEPPER) || ctx.stepper) &&
+         (!(needs & NEEDS_SERVO) || ctx.servo) &&
+         (!(needs & NEEDS_SEQUENCES) || ctx.sequences) &&
+         (!(needs & NEEDS_MOTION) || ctx.motion) &&
+         (!(needs & NEEDS_TEACH) || ctx.teach) &&
+         (!(needs & NEEDS_TRACKER) || ctx.tracker) &&
+         (!(needs & NEEDS_SYSTEM) || ctx.system);
+}
+
+void dispatchCommand(int routeIndex, const CommandParams& params, CommandResponse& res) {
+  const CommandRoute& route = ROUTES[routeIndex];
+  if (!available(route.needs)) {
+    res.fail(500, "Driver no inicializado");
+    return;
+  }
+
+  int64_t startUs = nowUs();
+  route.handler(ctx, params, res);
+  uint32_t elapsed = (uint32_t)(nowUs() - startUs);
+
+  lockStats();
+  CommandStats& s = stats[routeIndex];
+  s.calls++;
+  s.lastUs = elapsed;
+  s.totalUs += elapsed;
+  if (elapsed > s.maxUs) s.maxUs = elapsed;
+  if (res.body.length() > s.maxBodyBytes) s.maxBodyBytes = res.body.length();
+  unlockStats();
+}
+
+String getCommandStatsAsJson() {
+  String json = "[";
+  bool first = true;
+  for (int i = 0; i < ROUTE_COUNT; i++) {
+    lockStats();
+    CommandStats s = stats[i];
+    unlockStats();
+    if (s.calls == 0) continue;
+
+    if (!first) json += ",";
+    first = false;
+    json += "{\"path\":\"" + String(ROUTES[i].path) + "\"";
+    json += ",\"calls\":" + String(s.calls);
+    json += ",\"avgUs\":" + String((uint32_t)(s.totalUs / s.calls));
+    json += ",\"lastUs\":" + String(s.lastUs);
+    json += ",\"maxUs\":" + String(s.maxUs);
+    json += ",\"maxBodyBytes\":" + String(s.maxBodyBytes) + "}";
+  }
+  json += "]";
+  return json;
+}
+
+// ========== Canal binario ==========
+
+// Los comandos con CTRL_FLAG_COALESCE se descartan si el eje ya tiene un
+// comando en cola: así un mando a 50 Hz nunca acumula retraso.
+static bool axisBusy(int queued, uint8_t flags) {
+  return (flags & CTRL_FLAG_COALESCE) && queued > 0;
+}
+
+static uint8_t handleJog(const JogFrame& frame) {
+  bool moveRail = (frame.header.flags & CTRL_FLAG_RAIL) && frame.distanceUm != 0;
+  bool movePan = (frame.header.flags & CTRL_FLAG_PAN) && frame.angleDelta != 0;
+
+  if ((moveRail && !ctx.stepper) || (movePan && !ctx.servo)) return CTRL_STATUS_NOT_READY;
+  if (moveRail && axisBusy(ctx.stepper->getQueuedCommands(), frame.header.flags)) return CTRL_STATUS_BUSY;
+  if (movePan && axisBusy(ctx.servo->getQueuedCommands(), frame.header.flags)) return CTRL_STATUS_BUSY;
+
+  if (moveRail) {
+    int stepsPerSec = map(frame.speed, 0, 100, 100, 2000);
+    long steps = ctx.stepper->mmToSteps(frame.distanceUm / 1000.0f, MM_PER_REVOLUTION); // 8mm por revolución
+    if (!ctx.stepper->moveRelative(steps, stepsPerSec, false)) return CTRL_STATUS_ERROR;
+  }
+  if (movePan) {
+    int target = constrain(ctx.servo->getCurrentAngle() + frame.angleDelta, 0, 180);
+    if (!ctx.servo->moveTo(target, frame.angleSpeed, false)) return CTRL_STATUS_ERROR;
+  }
+  return CTRL_STATUS_OK;
+}
+
+static uint8_t handleGoto(const GotoFrame& frame) {
+  bool moveRail = frame.header.flags & CTRL_FLAG_RAIL;
+  bool movePan = frame.header.flags & CTRL_FLAG_PAN;
+
+  if ((moveRail && !ctx.stepper) || (movePan && !ctx.servo)) return CTRL_STATUS_NOT_READY;
+  if (moveRail && axisBusy(ctx.stepper->getQueuedCommands(), frame.header.flags)) return CTRL_STATUS_BUSY;
+  if (movePan && axisBusy(ctx.servo->getQueuedCommands(), frame.header.flags)) return CTRL_STATUS_BUSY;
+
+  if (moveRail) {
+    int stepsPerSec = map(frame.speed, 0, 100, 100, 2000);
+    long position = ctx.stepper->mmToSteps(frame.positionUm / 1000.0f, MM_PER_REVOLUTION);
+    if (!ctx.stepper->moveTo(position, stepsPerSec, false)) return CTRL_STATUS_ERROR;
+  }
+  if (movePan) {
+    if (!ctx.servo->moveTo(frame.angle, frame.angleSpeed, false)) return CTRL_STATUS_ERROR;
+  }
+  return CTRL_STATUS_OK;
+}
+
+uint8_t dispatchControlFrame(const uint8_t* data, size_t len, ControlHeader& header) {
+  memcpy(&header, data, sizeof(header));
+
+  switch (header.opcode) {
+    case CTRL_OP_JOG: {
+      if (len != sizeof(JogFrame)) return CTRL_STATUS_BAD_FRAME;
+      JogFrame frame;
+      memcpy(&frame, data, sizeof(frame));
+      return handleJog(frame);
+    }
+    case CTRL_OP_GOTO: {
+      if (len != sizeof(GotoFrame)) return CTRL_STATUS_BAD_FRAME;
+      GotoFrame frame;
+      memcpy(&frame, data, sizeof(frame));
+      return handleGoto(frame);
+    }
+    case CTRL_OP_STOP:
+      if (len != sizeof(EmptyFrame)) return CTRL_STATUS_BAD_FRAME;
+      if (ctx.stepper) ctx.stepper->stop();
+      if (ctx.servo) ctx.servo->stop();
+      return CTRL_STATUS_OK;
+    case CTRL_OP_SHUTTER:
+      if (len != sizeof(EmptyFrame)) return CTRL_STATUS_BAD_FRAME;
+      if (ctx.bleConnected != nullptr && ctx.bleConnected() && ctx.takePhoto != nullptr && ctx.takePhoto()) {
+        return CTRL_STATUS_OK;
+      }
+      return CTRL_STATUS_NOT_READY;
+    case CTRL_OP_GO:
+      if (len != sizeof(EmptyFrame)) return CTRL_STATUS_BAD_FRAME;
+      return (ctx.sequences && ctx.sequences->go()) ? CTRL_STATUS_OK : CTRL_STATUS_NOT_READY;
+    default:
+      return CTRL_STATUS_UNKNOWN;
+  }
+}
+
+void fillAck(AckFrame& ack, const ControlHeader& header, uint8_t status) {
+  ack.header.opcode = CTRL_OP_ACK;
+  ack.header.flags = status;
+  ack.header.commandId = header.commandId;
+  ack.ackedOpcode = header.opcode;
+  ack.positionUm = 0;
+  ack.angle = 0;
+  ack.state = (ctx.bleConnected != nullptr && ctx.bleConnected()) ? CTRL_STATE_BLE : 0;
+
+  if (ctx.stepper) {
+    ack.positionUm = (int32_t)(ctx.stepper->stepsToMm(ctx.stepper->getCurrentPosition(), MM_PER_REVOLUTION) * 1000.0f);
+    if (ctx.stepper->getIsMoving()) ack.state |= CTRL_STATE_RAIL_MOVING;
+  }
+  if (ctx.servo) {
+    ack.angle = ctx.servo->getCurrentAngle();
+    if (ctx.servo->getIsMoving()) ack.state |= CTRL_STATE_PAN_MOVING;
+  }
+  if (ctx.system && ctx.system->isEmergencyLatched()) ack.state |= CTRL_STATE_ESTOP;
+}
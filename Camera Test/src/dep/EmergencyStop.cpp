@@ -0,0 +1,171 @@
+#include "EmergencyStop.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "drivers/MotionController.h"
+#include "drivers/SequenceManager.h"
+#include "Log.h"
+#include <esp_timer.h>
+
+// Flag compartido con los drivers (setEmergencyFlag)
+static volatile bool emergencyFlag = false;
+static portMUX_TYPE estopMux = portMUX_INITIALIZER_UNLOCKED;
+
+static StepperDriver* stepperDriver = nullptr;
+static ServoDriver* servoDriver = nullptr;
+static MotionController* motionController = nullptr;
+static SequenceManager* sequenceManager = nullptr;
+static int inputPin = -1;
+static bool inputActiveHigh = true;
+static int faultLedPin = -1;
+
+static EmergencyStopStats stats = {};
+static int64_t triggerUs = 0;
+
+static bool inputActive() {
+  if (inputPin < 0) return false;
+  return digitalRead(inputPin) == (inputActiveHigh ? HIGH : LOW);
+}
+
+// Orden fijo: primero la potencia, luego los generadores de pasos, después
+// el estado y la secuencia. Nada aquí bloquea ni reserva memoria.
+static void IRAM_ATTR engage(bool fromIsr) {
+  int64_t startUs = esp_timer_get_time();
+  if (stepperDriver) stepperDriver->emergencyCut();
+  int64_t cutUs = esp_timer_get_time();
+  if (motionController) motionController->halt();
+
+  portENTER_CRITICAL_ISR(&estopMux);
+  bool wasLatched = emergencyFlag;
+  emergencyFlag = true;
+  if (!wasLatched) {
+    triggerUs = startUs;
+    stats.triggers++;
+    stats.softwareTrigger = !fromIsr;
+    stats.lastCutUs = (uint32_t)(cutUs - startUs);
+    if (stats.lastCutUs > stats.maxCutUs) stats.maxCutUs = stats.lastCutUs;
+    for (int i = 0; i < ESTOP_ACK_COUNT; i++) stats.lastAckUs[i] = 0;
+  }
+  portEXIT_CRITICAL_ISR(&estopMux);
+
+  if (wasLatched) return;
+  if (faultLedPin >= 0) digitalWrite(faultLedPin, HIGH);
+  if (sequenceManager) {
+    if (fromIsr) sequenceManager->stopFromISR();
+    else sequenceManager->stop();
+  }
+}
+
+static void IRAM_ATTR onEmergencyInput() {
+  engage(true);
+}
+
+bool beginEmergencyStop(StepperDriver* stepper, ServoDriver* servo, MotionController* motion,
+                        SequenceManager* sequences, int pin, bool activeHigh, int ledPin) {
+  stepperDriver = stepper;
+  servoDriver = servo;
+  motionController = motion;
+  sequenceManager = sequences;
+  inputPin = pin;
+  inputActiveHigh = activeHigh;
+
+  if (stepperDriver) stepperDriver->setEmergencyFlag(&emergencyFlag, &estopMux);
+  if (servoDriver) servoDriver->setEmergencyFlag(&emergencyFlag, &estopMux);
+
+  // GPIO34-39 son solo entrada en el ESP32
+  if (ledPin >= 34) {
+    LOG_WARN("⚠️ E-stop: GPIO%d es solo entrada, LED de falla deshabilitado", ledPin);
+    ledPin = -1;
+  }
+  faultLedPin = ledPin;
+  if (faultLedPin >= 0) {
+    pinMode(faultLedPin, OUTPUT);
+    digitalWrite(faultLedPin, LOW);
+  }
+
+  if (inputPin < 0) {
+    LOG_WARN("⚠️ E-stop: sin entrada de hardware (solo /estop/trigger)");
+    return true;
+  }
+
+  pinMode(inputPin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(inputPin), onEmergencyInput, activeHigh ? RISING : FALLING);
+
+  // Seta ya presionada (o cable cortado) al arrancar: se arranca enclavado
+  if (inputActive()) {
+    engage(false);
+    LOG_WARN("🛑 E-stop activo al arrancar");
+  }
+
+  LOG_INFO("✅ E-stop en GPIO%d (%s)", inputPin, activeHigh ? "NC" : "NA");
+  return true;
+}
+
+void triggerEmergencyStop() {
+  engage(false);
+  LOG_WARN("🛑 Parada de emergencia (software)");
+}
+
+bool resetEmergencyStop() {
+  if (!emergencyFlag) return true;
+  if (inputActive()) {
+    LOG_ERROR("❌ E-stop: liberar la entrada antes del reset");
+    return false;
+  }
+
+  // Los segmentos que hayan quedado se descartan antes de soltar el timer
+  if (motionController) {
+    motionController->stopAll();
+    motionController->clearHalt();
+  }
+
+  portENTER_CRITICAL(&estopMux);
+  emergencyFlag = false;
+  portEXIT_CRITICAL(&estopMux);
+
+  if (faultLedPin >= 0) digitalWrite(faultLedPin, LOW);
+  LOG_INFO("✅ E-stop reseteado: la posición puede haberse perdido, conviene referenciar");
+  return true;
+}
+
+bool isEmergencyLatched() {
+  return emergencyFlag;
+}
+
+void emergencyStopAck(EstopAck who) {
+  uint32_t latency = (uint32_t)(esp_timer_get_time() - triggerUs);
+  portENTER_CRITICAL(&estopMux);
+  stats.lastAckUs[who] = latency;
+  if (latency > stats.maxAckUs[who]) stats.maxAckUs[who] = latency;
+  portEXIT_CRITICAL(&estopMux);
+}
+
+EmergencyStopStats getEmergencyStopStats() {
+  portENTER_CRITICAL(&estopMux);
+  EmergencyStopStats copy = stats;
+  copy.latched = emergencyFlag;
+  int64_t since = triggerUs;
+  portEXIT_CRITICAL(&estopMux);
+
+  copy.inputActive = inputActive();
+  copy.latchedMs = copy.latched ? (uint32_t)((esp_timer_get_time() - since) / 1000) : 0;
+  return copy;
+}
+
+String getEmergencyStopAsJson() {
+  EmergencyStopStats s = getEmergencyStopStats();
+  String json = "{";
+  json += "\"latched\":" + String(s.latched ? "true" : "false") + ",";
+  json += "\"inputPin\":" + String(inputPin) + ",";
+  json += "\"inputActive\":" + String(s.inputActive ? "true" : "false") + ",";
+  json += "\"triggers\":" + String(s.triggers) + ",";
+  json += "\"software\":" + String(s.softwareTrigger ? "true" : "false") + ",";
+  json += "\"latchedMs\":" + String(s.latchedMs) + ",";
+  json += "\"cutUs\":" + String(s.lastCutUs) + ",";
+  json += "\"maxCutUs\":" + String(s.maxCutUs) + ",";
+  json += "\"stepperAckUs\":" + String(s.lastAckUs[ESTOP_ACK_STEPPER]) + ",";
+  json += "\"maxStepperAckUs\":" + String(s.maxAckUs[ESTOP_ACK_STEPPER]) + ",";
+  json += "\"servoAckUs\":" + String(s.lastAckUs[ESTOP_ACK_SERVO]) + ",";
+  json += "\"maxServoAckUs\":" + String(s.maxAckUs[ESTOP_ACK_SERVO]);
+  json += "}";
+  return json;
+}
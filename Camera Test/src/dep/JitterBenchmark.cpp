@@ -0,0 +1,203 @@
+#include "JitterBenchmark.h"
+#include "TaskConfig.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "Log.h"
+#include <WiFi.h>
+
+static const int MAX_LAYOUTS = 8;
+static const char* LOAD_NAMES[LOAD_COUNT] = { "idle", "http", "ble", "http+ble" };
+
+static JitterResult results[MAX_LAYOUTS][LOAD_COUNT];
+static int measuredLayouts = 0;
+
+static volatile bool running = false;
+static volatile int loadTasksAlive = 0;
+static portMUX_TYPE loadMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool httpLoad = false;
+static volatile bool bleLoad = false;
+static volatile uint32_t httpCount = 0;
+static volatile uint32_t bleCount = 0;
+
+static void (*bleCallbackFunc)() = nullptr;
+
+static StepperDriver* benchStepper = nullptr;
+static ServoDriver* benchServo = nullptr;
+static long benchSteps = 0;
+static int benchSpeed = 0;
+
+void setBenchmarkBleCallback(void (*callback)()) {
+  bleCallbackFunc = callback;
+}
+
+static void loadTaskDone() {
+  portENTER_CRITICAL(&loadMux);
+  loadTasksAlive--;
+  portEXIT_CRITICAL(&loadMux);
+  vTaskDelete(NULL);
+}
+
+// Peticiones HTTP en bucle contra el propio servidor (loopback)
+static void httpLoadTask(void* parameter) {
+  while (running) {
+    if (!httpLoad || WiFi.status() != WL_CONNECTED) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+
+    WiFiClient client;
+    if (client.connect(WiFi.localIP(), 80)) {
+      client.print("GET /status HTTP/1.1\r\nHost: slider\r\nConnection: close\r\n\r\n");
+      unsigned long start = millis();
+      while (client.connected() && millis() - start < 500) {
+        while (client.available()) client.read();
+        vTaskDelay(1);
+      }
+      client.stop();
+      httpCount++;
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }
+
+  loadTaskDone();
+}
+
+// Reportes BLE a 100 Hz
+static void bleLoadTask(void* parameter) {
+  while (running) {
+    if (bleLoad && bleCallbackFunc != nullptr) {
+      bleCallbackFunc();
+      bleCount++;
+    }
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+
+  loadTaskDone();
+}
+
+static JitterResult measure(BenchmarkLoad load) {
+  httpCount = 0;
+  bleCount = 0;
+  httpLoad = (load == LOAD_HTTP || load == LOAD_HTTP_BLE);
+  bleLoad = (load == LOAD_BLE || load == LOAD_HTTP_BLE);
+  vTaskDelay(pdMS_TO_TICKS(200));  // Dejar que la carga arranque
+
+  benchStepper->setTimingCapture(true);
+  benchStepper->moveRelative(benchSteps, benchSpeed, true);
+  benchStepper->moveRelative(-benchSteps, benchSpeed, true);
+  benchStepper->setTimingCapture(false);
+
+  httpLoad = false;
+  bleLoad = false;
+
+  StepTimingStats stats = benchStepper->getTimingStats();
+  JitterResult r;
+  r.samples = stats.samples;
+  r.meanUs = 0;
+  r.stddevUs = 0;
+  r.maxUs = stats.maxDeviationUs;
+  r.httpRequests = httpCount;
+  r.bleReports = bleCount;
+
+  if (stats.samples > 0) {
+    float mean = (float)stats.sumDeviationUs / stats.samples;
+    float variance = (float)stats.sumSquaredUs / stats.samples - mean * mean;
+    r.meanUs = mean;
+    r.stddevUs = variance > 0 ? sqrtf(variance) : 0;
+  }
+  return r;
+}
+
+static void benchmarkTask(void* parameter) {
+  int original = getActiveTaskLayout();
+  measuredLayouts = 0;
+
+  LOG_INFO("⏱️ Medición de jitter iniciada");
+
+  int layouts = min(TASK_LAYOUT_COUNT, MAX_LAYOUTS);
+  for (int l = 0; l < layouts; l++) {
+    if (!applyTaskLayout(l, benchStepper, benchServo, false)) {
+      memset(results[l], 0, sizeof(results[l]));
+      measuredLayouts = l + 1;
+      continue;
+    }
+
+    for (int load = 0; load < LOAD_COUNT; load++) {
+      results[l][load] = measure((BenchmarkLoad)load);
+      const JitterResult& r = results[l][load];
+      LOG_INFO("  %-20s %-9s n=%u media=%.1fus σ=%.1fus max=%uus",
+                    TASK_LAYOUTS[l].name, LOAD_NAMES[load], r.samples,
+                    r.meanUs, r.stddevUs, r.maxUs);
+    }
+    measuredLayouts = l + 1;
+  }
+
+  applyTaskLayout(original, benchStepper, benchServo, false);
+
+  LOG_INFO("✅ Medición de jitter completada");
+  running = false;
+  vTaskDelete(NULL);
+}
+
+bool startJitterBenchmark(StepperDriver* stepper, ServoDriver* servo, long steps, int speed) {
+  if (running || loadTasksAlive > 0 || stepper == nullptr) {
+    return false;
+  }
+  if (!stepper->getIsEnabled() || stepper->getIsMoving() || steps <= 0 || speed <= 0) {
+    return false;
+  }
+
+  benchStepper = stepper;
+  benchServo = servo;
+  benchSteps = steps;
+  benchSpeed = speed;
+  running = true;
+
+  // Las cargas no se fijan a un core: compiten como lo haría el tráfico real
+  loadTasksAlive = 2;
+  if (xTaskCreate(httpLoadTask, "BenchHttp", 4096, nullptr, 1, nullptr) != pdPASS) {
+    portENTER_CRITICAL(&loadMux);
+    loadTasksAlive--;
+    portEXIT_CRITICAL(&loadMux);
+  }
+  if (xTaskCreate(bleLoadTask, "BenchBle", 4096, nullptr, 1, nullptr) != pdPASS) {
+    portENTER_CRITICAL(&loadMux);
+    loadTasksAlive--;
+    portEXIT_CRITICAL(&loadMux);
+  }
+
+  if (xTaskCreate(benchmarkTask, "BenchTask", 4096, nullptr, 1, nullptr) != pdPASS) {
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+bool isJitterBenchmarkRunning() {
+  return running;
+}
+
+String getJitterBenchmarkAsJson() {
+  String json = "{\"running\":" + String(running ? "true" : "false") + ",\"results\":[";
+
+  for (int l = 0; l < measuredLayouts; l++) {
+    if (l > 0) json += ",";
+    json += "{\"layout\":\"" + String(TASK_LAYOUTS[l].name) + "\",\"loads\":[";
+    for (int load = 0; load < LOAD_COUNT; load++) {
+      const JitterResult& r = results[l][load];
+      if (load > 0) json += ",";
+      json += "{\"load\":\"" + String(LOAD_NAMES[load]) + "\",";
+      json += "\"samples\":" + String(r.samples) + ",";
+      json += "\"meanUs\":" + String(r.meanUs, 1) + ",";
+      json += "\"stddevUs\":" + String(r.stddevUs, 1) + ",";
+      json += "\"maxUs\":" + String(r.maxUs) + ",";
+      json += "\"httpRequests\":" + String(r.httpRequests) + ",";
+      json += "\"bleReports\":" + String(r.bleReports) + "}";
+    }
+    json += "]}";
+  }
+
+  json += "]}";
+  return json;
+}
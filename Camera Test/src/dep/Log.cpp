@@ -0,0 +1,291 @@
+#include "Log.h"
+#include <atomic>
+#include <freertos/semphr.h>
+
+static_assert((LOG_BUFFER_RECORDS & (LOG_BUFFER_RECORDS - 1)) == 0, "LOG_BUFFER_RECORDS debe ser potencia de 2");
+
+#define LOG_BUFFER_MASK (LOG_BUFFER_RECORDS - 1)
+#define LOG_DRAIN_PERIOD_MS 20
+
+// Cola acotada de varios productores y un consumidor: cada casilla lleva
+// un número de secuencia que dice si está libre para la posición 'p'
+// (seq == p), escrita (seq == p + 1) o todavía ocupada por la vuelta
+// anterior. Los productores se reservan la casilla con un CAS sobre head;
+// la task de vaciado es la única que avanza tail.
+struct LogSlot {
+  std::atomic<uint32_t> sequence;
+  LogRecord record;
+};
+
+static LogSlot slots[LOG_BUFFER_RECORDS];
+static std::atomic<uint32_t> head(0);
+static uint32_t tail = 0;
+
+static std::atomic<uint32_t> writtenCount(0);
+static std::atomic<uint32_t> droppedCount(0);
+static uint32_t maxPending = 0;
+
+struct LogLine {
+  uint32_t id;
+  uint32_t timeMs;
+  uint8_t level;
+  char text[LOG_LINE_BYTES];
+};
+
+static LogLine history[LOG_HISTORY_LINES];
+static uint32_t nextLineId = 1;
+static SemaphoreHandle_t historyMutex = nullptr;
+
+// ========== Productores ==========
+
+LogRecord* logAcquire(uint8_t level, const char* format, uint8_t argCount) {
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  LogSlot* slot;
+  for (;;) {
+    slot = &slots[pos & LOG_BUFFER_MASK];
+    int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      droppedCount.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+  LogRecord* record = &slot->record;
+  record->position = pos;
+  record->format = format;
+  record->timeMs = millis();
+  record->level = level;
+  record->argCount = argCount;
+  record->textUsed = 0;
+  return record;
+}
+
+void logCommit(LogRecord* record) {
+  LogSlot* slot = &slots[record->position & LOG_BUFFER_MASK];
+  slot->sequence.store(record->position + 1, std::memory_order_release);
+  writtenCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Las cadenas se copian (pueden ser temporales) y se recortan si no entran
+void logCapture(LogRecord* r, int n, const char* v) {
+  r->argTypes[n] = LOG_ARG_TEXT;
+  r->args[n].u = r->textUsed;
+  if (r->textUsed >= LOG_TEXT_BYTES) return;
+
+  if (v == nullptr) v = "(null)";
+  size_t room = LOG_TEXT_BYTES - r->textUsed - 1;
+  size_t len = strnlen(v, room);
+  memcpy(r->text + r->textUsed, v, len);
+  r->text[r->textUsed + len] = '\0';
+  r->textUsed += len + 1;
+}
+
+// ========== Task de vaciado ==========
+
+static bool popRecord(LogRecord& out) {
+  LogSlot* slot = &slots[tail & LOG_BUFFER_MASK];
+  if (slot->sequence.load(std::memory_order_acquire) != tail + 1) return false;
+  out = slot->record;
+  slot->sequence.store(tail + LOG_BUFFER_RECORDS, std::memory_order_release);
+  tail++;
+  return true;
+}
+
+static const char* argText(const LogRecord& r, int n) {
+  if (r.argTypes[n] != LOG_ARG_TEXT) return "?";
+  if (r.args[n].u >= LOG_TEXT_BYTES) return "";
+  return r.text + r.args[n].u;
+}
+
+static int32_t argInt(const LogRecord& r, int n) {
+  switch (r.argTypes[n]) {
+    case LOG_ARG_FLOAT: return (int32_t)r.args[n].f;
+    case LOG_ARG_TEXT: return 0;
+    default: return r.args[n].i;
+  }
+}
+
+static float argFloat(const LogRecord& r, int n) {
+  switch (r.argTypes[n]) {
+    case LOG_ARG_INT: return (float)r.args[n].i;
+    case LOG_ARG_UINT: return (float)r.args[n].u;
+    case LOG_ARG_FLOAT: return r.args[n].f;
+    default: return 0;
+  }
+}
+
+// printf reducido sobre los argumentos capturados: cada conversión se
+// vuelve a armar sin el modificador de longitud y se pasa con su tipo real
+static void formatRecord(const LogRecord& r, char* out, size_t size) {
+  size_t used = 0;
+  int arg = 0;
+  const char* p = r.format;
+
+  while (*p && used + 1 < size) {
+    if (*p != '%') {
+      out[used++] = *p++;
+      continue;
+    }
+    p++;
+    if (*p == '%') {
+      out[used++] = *p++;
+      continue;
+    }
+
+    char spec[16] = "%";
+    size_t specLen = 1;
+    while (*p && strchr("-+ #0123456789.", *p) && specLen < sizeof(spec) - 2) spec[specLen++] = *p++;
+    while (*p == 'l' || *p == 'h' || *p == 'z') p++;
+    char conversion = *p;
+    if (conversion == '\0') break;
+    p++;
+    spec[specLen++] = conversion;
+    spec[specLen] = '\0';
+
+    int written = 0;
+    size_t room = size - used;
+    if (arg >= r.argCount) {
+      written = snprintf(out + used, room, "?");
+    } else if (conversion == 'd' || conversion == 'i' || conversion == 'c') {
+      written = snprintf(out + used, room, spec, (int)argInt(r, arg));
+    } else if (conversion == 'u' || conversion == 'x' || conversion == 'X' || conversion == 'o') {
+      written = snprintf(out + used, room, spec, (unsigned int)argInt(r, arg));
+    } else if (conversion == 'f' || conversion == 'e' || conversion == 'g') {
+      written = snprintf(out + used, room, spec, (double)argFloat(r, arg));
+    } else if (conversion == 's') {
+      written = snprintf(out + used, room, spec, argText(r, arg));
+    }
+    arg++;
+    if (written > 0) used += min((size_t)written, room - 1);
+  }
+  out[used] = '\0';
+}
+
+static void storeLine(const LogRecord& r, const char* text) {
+  if (xSemaphoreTake(historyMutex, pdMS_TO_TICKS(10)) != pdTRUE) return;
+  LogLine& line = history[nextLineId % LOG_HISTORY_LINES];
+  line.id = nextLineId++;
+  line.timeMs = r.timeMs;
+  line.level = r.level;
+  strncpy(line.text, text, LOG_LINE_BYTES - 1);
+  line.text[LOG_LINE_BYTES - 1] = '\0';
+  xSemaphoreGive(historyMutex);
+}
+
+static void drainTask(void* parameter) {
+  uint32_t reportedDrops = 0;
+  char text[160];
+  LogRecord record;
+
+  for (;;) {
+    uint32_t pending = head.load(std::memory_order_relaxed) - tail;
+    if (pending > maxPending) maxPending = pending;
+
+    while (popRecord(record)) {
+      formatRecord(record, text, sizeof(text));
+      Serial.println(text);
+      storeLine(record, text);
+    }
+
+    uint32_t drops = droppedCount.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      Serial.printf("⚠️ Log: %lu registros descartados\n", (unsigned long)(drops - reportedDrops));
+      reportedDrops = drops;
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_PERIOD_MS));
+  }
+}
+
+// Llamar antes que nada: lo registrado antes se pierde
+bool beginLog() {
+  head.store(0, std::memory_order_relaxed);
+  tail = 0;
+  for (int i = 0; i < LOG_BUFFER_RECORDS; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  historyMutex = xSemaphoreCreateMutex();
+  if (historyMutex == nullptr) {
+    Serial.println("❌ Log: Error creando mutex");
+    return false;
+  }
+
+  // Sin core fijo: corre donde haya tiempo libre
+  BaseType_t result = xTaskCreatePinnedToCore(
+    drainTask, "LogTask", 4096, nullptr, LOG_TASK_PRIORITY, nullptr, tskNO_AFFINITY);
+  if (result != pdPASS) {
+    Serial.println("❌ Log: Error creando task");
+    return false;
+  }
+
+  Serial.printf("✅ Log asíncrono (%d registros, nivel %d)\n", LOG_BUFFER_RECORDS, LOG_LEVEL);
+  return true;
+}
+
+LogStats getLogStats() {
+  LogStats stats;
+  stats.written = writtenCount.load(std::memory_order_relaxed);
+  stats.dropped = droppedCount.load(std::memory_order_relaxed);
+  stats.maxPending = maxPending;
+  return stats;
+}
+
+static const char* levelName(uint8_t level) {
+  switch (level) {
+    case LOG_LEVEL_ERROR: return "error";
+    case LOG_LEVEL_WARN: return "warn";
+    case LOG_LEVEL_INFO: return "info";
+    default: return "debug";
+  }
+}
+
+static void appendEscaped(String& json, const char* text) {
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      json += '\\';
+      json += *c;
+    } else if ((uint8_t)*c < 0x20) {
+      json += ' ';
+    } else {
+      json += *c;
+    }
+  }
+}
+
+String getLogAsJson(uint32_t since) {
+  LogStats stats = getLogStats();
+  String json = "{";
+  json += "\"level\":" + String(LOG_LEVEL) + ",";
+  json += "\"written\":" + String(stats.written) + ",";
+  json += "\"dropped\":" + String(stats.dropped) + ",";
+  json += "\"maxPending\":" + String(stats.maxPending) + ",";
+  json += "\"capacity\":" + String(LOG_BUFFER_RECORDS) + ",";
+
+  json += "\"lastId\":" + String(nextLineId - 1) + ",";
+  json += "\"lines\":[";
+
+  if (historyMutex != nullptr && xSemaphoreTake(historyMutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+    bool first = true;
+    uint32_t oldest = nextLineId > LOG_HISTORY_LINES ? nextLineId - LOG_HISTORY_LINES : 1;
+    for (uint32_t id = max(oldest, since + 1); id < nextLineId; id++) {
+      const LogLine& line = history[id % LOG_HISTORY_LINES];
+      if (!first) json += ",";
+      first = false;
+      json += "{\"id\":" + String(line.id);
+      json += ",\"ms\":" + String(line.timeMs);
+      json += ",\"level\":\"" + String(levelName(line.level)) + "\"";
+      json += ",\"text\":\"";
+      appendEscaped(json, line.text);
+      json += "\"}";
+    }
+    xSemaphoreGive(historyMutex);
+  }
+
+  json += "]}";
+  return json;
+}
@@ -0,0 +1,268 @@
+#include "PositionTriggers.h"
+#include "drivers/StepperDriver.h"
+#include "Log.h"
+#include <algorithm>
+#include <esp_timer.h>
+#include <freertos/queue.h>
+
+#define TRIGGER_MAX_PER_STEP 8    // Disparos en una misma posición
+#define TRIGGER_QUEUE_LENGTH 32
+
+// Dos buffers: la edición escribe el libre, lo ordena y lo publica con un
+// intercambio de punteros bajo el spinlock, así el generador de pasos
+// nunca ve una lista a medio armar
+static PositionTrigger buffers[2][TRIGGER_MAX_ENTRIES];
+static PositionTrigger* list = buffers[0];
+static int listCount = 0;
+static int cursor = 0;            // Primera entrada con posición > carro
+static long lastPosition = 0;
+static portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t editMutex = nullptr;
+
+static StepperDriver* stepperDriver = nullptr;
+static void (*shutterCallback)() = nullptr;
+static int pulsePin = -1;
+static int markerPin = -1;
+static uint32_t pulseWidthMs = 100;
+static esp_timer_handle_t pulseTimer = nullptr;
+static esp_timer_handle_t markerTimer = nullptr;
+
+static QueueHandle_t firingQueue = nullptr;
+static uint32_t firedCount = 0;
+static uint32_t droppedCount = 0;
+static TriggerFiring history[TRIGGER_HISTORY];
+static portMUX_TYPE historyMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Primera entrada con posición > 'position'
+static int upperBound(const PositionTrigger* entries, int count, long position) {
+  int low = 0, high = count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (entries[mid].position <= position) low = mid + 1;
+    else high = mid;
+  }
+  return low;
+}
+
+// ========== Salidas ==========
+
+static void onPulseEnd(void* arg) {
+  digitalWrite((int)(intptr_t)arg, LOW);
+}
+
+static bool createOffTimer(int pin, const char* name, esp_timer_handle_t& timer) {
+  if (pin < 0) return true;
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  esp_timer_create_args_t args = {};
+  args.callback = &onPulseEnd;
+  args.arg = (void*)(intptr_t)pin;
+  args.name = name;
+  return esp_timer_create(&args, &timer) == ESP_OK;
+}
+
+// Un disparo con el pulso todavía alto lo extiende desde ahora
+static void startPulse(int pin, esp_timer_handle_t timer, uint32_t ms) {
+  if (pin < 0 || timer == nullptr) return;
+  digitalWrite(pin, HIGH);
+  esp_timer_stop(timer);
+  esp_timer_start_once(timer, (uint64_t)ms * 1000);
+}
+
+// ========== Generador de pasos ==========
+
+void positionTriggerSync(long position) {
+  portENTER_CRITICAL(&triggerMux);
+  lastPosition = position;
+  cursor = upperBound(list, listCount, position);
+  portEXIT_CRITICAL(&triggerMux);
+}
+
+// Hacia adelante el cursor avanza sobre las entradas alcanzadas; hacia
+// atrás retrocede sobre las que se dejaron y dispara las de la posición
+// nueva. Las entradas de una misma posición son contiguas.
+void positionTriggerStep(long position, bool forward) {
+  if (listCount == 0) {
+    lastPosition = position;
+    return;
+  }
+
+  int64_t nowUs = esp_timer_get_time();
+  TriggerFiring fired[TRIGGER_MAX_PER_STEP];
+  int firedNow = 0;
+  uint8_t wanted = forward ? TRIGGER_FORWARD : TRIGGER_REVERSE;
+
+  portENTER_CRITICAL(&triggerMux);
+  lastPosition = position;
+  if (forward) {
+    while (cursor < listCount && list[cursor].position <= position) {
+      const PositionTrigger& entry = list[cursor];
+      if (entry.position == position && (entry.direction == TRIGGER_BOTH || entry.direction == wanted) &&
+          firedNow < TRIGGER_MAX_PER_STEP) {
+        fired[firedNow++] = { 0, (int32_t)position, nowUs, (uint16_t)cursor, entry.action, wanted };
+      }
+      cursor++;
+    }
+  } else {
+    while (cursor > 0 && list[cursor - 1].position > position) cursor--;
+    for (int i = cursor - 1; i >= 0 && list[i].position == position; i--) {
+      const PositionTrigger& entry = list[i];
+      if ((entry.direction == TRIGGER_BOTH || entry.direction == wanted) &&
+          firedNow < TRIGGER_MAX_PER_STEP) {
+        fired[firedNow++] = { 0, (int32_t)position, nowUs, (uint16_t)i, entry.action, wanted };
+      }
+    }
+  }
+  portEXIT_CRITICAL(&triggerMux);
+
+  for (int i = 0; i < firedNow; i++) {
+    if (fired[i].action == TRIGGER_PULSE) startPulse(pulsePin, pulseTimer, pulseWidthMs);
+    else if (fired[i].action == TRIGGER_MARKER) startPulse(markerPin, markerTimer, TRIGGER_MARKER_MS);
+    fired[i].sequence = ++firedCount;
+    if (xQueueSend(firingQueue, &fired[i], 0) != pdTRUE) droppedCount++;
+  }
+}
+
+// ========== Task de disparos ==========
+
+// Foto BLE y registro fuera del generador de pasos
+static void firingTask(void* parameter) {
+  TriggerFiring firing;
+  for (;;) {
+    if (xQueueReceive(firingQueue, &firing, portMAX_DELAY) != pdTRUE) continue;
+
+    if (firing.action == TRIGGER_SHUTTER && shutterCallback != nullptr) {
+      shutterCallback();
+    }
+
+    portENTER_CRITICAL(&historyMux);
+    history[firing.sequence % TRIGGER_HISTORY] = firing;
+    portEXIT_CRITICAL(&historyMux);
+
+    LOG_INFO("📍 Disparo #%lu %s en %.2f mm (%ld pasos, %s) t=%lu ms",
+             (unsigned long)firing.sequence, triggerActionName(firing.action),
+             stepperDriver->stepsToMm(firing.position, MM_PER_REVOLUTION), (long)firing.position,
+             firing.direction == TRIGGER_FORWARD ? "avance" : "retroceso",
+             (unsigned long)(firing.timeUs / 1000));
+  }
+}
+
+bool beginPositionTriggers(StepperDriver* stepper, void (*shutter)(), int pulse, int marker) {
+  stepperDriver = stepper;
+  shutterCallback = shutter;
+
+  // GPIO34-39 son solo entrada en el ESP32
+  pulsePin = pulse >= 34 ? -1 : pulse;
+  markerPin = marker >= 34 ? -1 : marker;
+  if (pulsePin != pulse || markerPin != marker) {
+    LOG_WARN("⚠️ Disparos: salida en GPIO solo de entrada, deshabilitada");
+  }
+
+  editMutex = xSemaphoreCreateMutex();
+  firingQueue = xQueueCreate(TRIGGER_QUEUE_LENGTH, sizeof(TriggerFiring));
+  if (editMutex == nullptr || firingQueue == nullptr) {
+    LOG_ERROR("❌ Disparos: Error creando mutex/queue");
+    return false;
+  }
+  if (!createOffTimer(pulsePin, "TriggerPulse", pulseTimer) ||
+      !createOffTimer(markerPin, "TriggerMarker", markerTimer)) {
+    LOG_ERROR("❌ Disparos: Error creando timers");
+    return false;
+  }
+
+  BaseType_t result = xTaskCreatePinnedToCore(
+    firingTask, "TriggerTask", 4096, nullptr, 1, nullptr, tskNO_AFFINITY);
+  if (result != pdPASS) {
+    LOG_ERROR("❌ Disparos: Error creando task");
+    return false;
+  }
+
+  LOG_INFO("✅ Disparos por posición (%d entradas, pulso GPIO%d, LED GPIO%d)",
+           TRIGGER_MAX_ENTRIES, pulsePin, markerPin);
+  return true;
+}
+
+// ========== Edición ==========
+
+bool setPositionTriggers(const PositionTrigger* entries, int count) {
+  if (editMutex == nullptr || count < 0 || count > TRIGGER_MAX_ENTRIES) return false;
+  for (int i = 0; i < count; i++) {
+    if (entries[i].action >= TRIGGER_ACTION_COUNT || entries[i].direction > TRIGGER_REVERSE) return false;
+  }
+
+  xSemaphoreTake(editMutex, portMAX_DELAY);
+  PositionTrigger* next = list == buffers[0] ? buffers[1] : buffers[0];
+  memcpy(next, entries, count * sizeof(PositionTrigger));
+  // Estable: avanzando, las entradas de una misma posición disparan en el
+  // orden dado
+  std::stable_sort(next, next + count, [](const PositionTrigger& a, const PositionTrigger& b) {
+    return a.position < b.position;
+  });
+
+  portENTER_CRITICAL(&triggerMux);
+  list = next;
+  listCount = count;
+  cursor = upperBound(list, listCount, lastPosition);
+  portEXIT_CRITICAL(&triggerMux);
+  xSemaphoreGive(editMutex);
+
+  LOG_INFO("📍 %d disparos por posición cargados", count);
+  return true;
+}
+
+void clearPositionTriggers() {
+  setPositionTriggers(nullptr, 0);
+}
+
+int getPositionTriggerCount() {
+  return listCount;
+}
+
+void setTriggerPulseWidth(uint32_t ms) {
+  pulseWidthMs = constrain(ms, 1UL, 1000UL);
+}
+
+String getPositionTriggersAsJson() {
+  portENTER_CRITICAL(&triggerMux);
+  int count = listCount;
+  int next = cursor;
+  long nextPosition = cursor < listCount ? list[cursor].position : 0;
+  portEXIT_CRITICAL(&triggerMux);
+
+  String json = "{";
+  json += "\"count\":" + String(count) + ",";
+  json += "\"max\":" + String(TRIGGER_MAX_ENTRIES) + ",";
+  json += "\"ahead\":" + String(count - next) + ",";
+  if (next < count) {
+    json += "\"nextMm\":" + String(stepperDriver->stepsToMm(nextPosition, MM_PER_REVOLUTION), 2) + ",";
+  }
+  json += "\"pulseMs\":" + String(pulseWidthMs) + ",";
+  json += "\"pulsePin\":" + String(pulsePin) + ",";
+  json += "\"markerPin\":" + String(markerPin) + ",";
+  json += "\"fired\":" + String(firedCount) + ",";
+  json += "\"dropped\":" + String(droppedCount) + ",";
+
+  TriggerFiring recent[TRIGGER_HISTORY];
+  portENTER_CRITICAL(&historyMux);
+  memcpy(recent, history, sizeof(history));
+  portEXIT_CRITICAL(&historyMux);
+
+  // Del más reciente al más viejo
+  json += "\"last\":[";
+  bool first = true;
+  for (int i = 0; i < TRIGGER_HISTORY; i++) {
+    const TriggerFiring& f = recent[(firedCount - i) % TRIGGER_HISTORY];
+    if (f.sequence == 0 || f.sequence + TRIGGER_HISTORY <= firedCount) continue;
+    if (!first) json += ",";
+    first = false;
+    json += "{\"n\":" + String(f.sequence);
+    json += ",\"index\":" + String(f.index);
+    json += ",\"action\":\"" + String(triggerActionName(f.action)) + "\"";
+    json += ",\"mm\":" + String(stepperDriver->stepsToMm(f.position, MM_PER_REVOLUTION), 2);
+    json += ",\"steps\":" + String(f.position);
+    json += ",\"ms\":" + String((uint32_t)(f.timeUs / 1000));
+    json += ",\"reverse\":" + String(f.direction == TRIGGER_REVERSE ? "true" : "false") + "}";
+  }
+  json += "]}";
+  return json;
+}
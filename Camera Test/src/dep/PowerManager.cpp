@@ -0,0 +1,198 @@
+#include "PowerManager.h"
+#include "Log.h"
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <esp_task_wdt.h>
+
+// Valores de referencia a calibrar con un amperímetro en la batería
+static PowerConfig config = {
+  false,    // lightSleepEnabled
+  2000,     // lightSleepMinMs
+  false,    // radiosOffInRun
+  110.0f,   // baseCurrentMa
+  1.5f,     // sleepCurrentMa
+  { 400.0f, 650.0f, 15.0f, 180.0f }
+};
+
+static portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+static bool loadActive[POWER_LOAD_COUNT] = { false };
+static bool sleeping = false;
+static int64_t lastUpdateUs = 0;
+
+static double totalChargeMaUs = 0;   // mA·µs acumulados
+static int64_t startUs = 0;
+static int64_t totalSleepUs = 0;
+
+static double frameStartCharge = 0;
+static int64_t frameStartUs = 0;
+static uint32_t frameCount = 0;
+static uint32_t lastFrameMs = 0;
+static float lastFrameAvgMa = 0;
+
+static bool (*radioSleepCheck)() = nullptr;
+static void (*radioDown)() = nullptr;
+static void (*radioUp)() = nullptr;
+static bool (*beforeSleep)() = nullptr;
+static void (*afterWake)() = nullptr;
+static bool runActive = false;       // Solo la task del ejecutor lo toca
+static bool radiosDown = false;
+
+// Corriente total con el estado actual (llamar dentro de powerMux)
+static float currentDrawMa() {
+  float ma = sleeping ? config.sleepCurrentMa : config.baseCurrentMa;
+  for (int i = 0; i < POWER_LOAD_COUNT; i++) {
+    if (loadActive[i]) ma += config.loadCurrentMa[i];
+  }
+  return ma;
+}
+
+// Integra la carga desde la última actualización (llamar dentro de powerMux)
+static void integrate() {
+  int64_t now = esp_timer_get_time();
+  totalChargeMaUs += (double)currentDrawMa() * (double)(now - lastUpdateUs);
+  lastUpdateUs = now;
+}
+
+void beginPowerManager() {
+  portENTER_CRITICAL(&powerMux);
+  startUs = esp_timer_get_time();
+  lastUpdateUs = startUs;
+  frameStartUs = startUs;
+  portEXIT_CRITICAL(&powerMux);
+}
+
+void powerSetLoad(PowerLoad load, bool active) {
+  portENTER_CRITICAL(&powerMux);
+  if (loadActive[load] != active) {
+    integrate();
+    loadActive[load] = active;
+  }
+  portEXIT_CRITICAL(&powerMux);
+}
+
+void setRadioSleepCheck(bool (*check)()) {
+  radioSleepCheck = check;
+}
+
+void setRadioControl(void (*down)(), void (*up)()) {
+  radioDown = down;
+  radioUp = up;
+}
+
+void setSleepHooks(bool (*before)(), void (*after)()) {
+  beforeSleep = before;
+  afterWake = after;
+}
+
+void powerBeginRun() {
+  runActive = true;
+}
+
+void powerEndRun() {
+  runActive = false;
+  if (radiosDown && radioUp != nullptr) {
+    radioUp();
+    LOG_INFO("📡 Radios encendidas de nuevo");
+  }
+  radiosDown = false;
+}
+
+// Con 'radiosOffInRun' apaga las radios en la primera espera larga de la
+// ejecución y no en el go: apagar el WiFi tarda decenas de ms
+bool powerCanSleep(uint32_t ms) {
+  if (!config.lightSleepEnabled || ms < config.lightSleepMinMs) {
+    return false;
+  }
+  if (runActive && config.radiosOffInRun && !radiosDown && radioDown != nullptr) {
+    radioDown();
+    radiosDown = true;
+    LOG_INFO("📴 Radios apagadas hasta el final de la ejecución");
+  }
+  return radioSleepCheck != nullptr && radioSleepCheck();
+}
+
+// Light sleep con despertador por timer; devuelve los ms dormidos o -1 si
+// el hook o el sistema lo rechazaron. Puede despertar antes por otra fuente.
+static int32_t lightSleep(uint32_t ms) {
+  if (beforeSleep != nullptr && !beforeSleep()) {
+    return -1;
+  }
+
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  sleeping = true;
+  portEXIT_CRITICAL(&powerMux);
+
+  int64_t before = esp_timer_get_time();
+  esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000ULL);
+  esp_err_t err = esp_light_sleep_start();
+  int64_t slept = esp_timer_get_time() - before;
+
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  sleeping = false;
+  if (err == ESP_OK) totalSleepUs += slept;
+  portEXIT_CRITICAL(&powerMux);
+
+  if (afterWake != nullptr) afterWake();
+
+  return err == ESP_OK ? (int32_t)(slept / 1000) : -1;
+}
+
+bool powerSleepSlice(uint32_t ms) {
+  return lightSleep(ms) >= 0;
+}
+
+void powerBeginFrame() {
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  frameStartCharge = totalChargeMaUs;
+  frameStartUs = lastUpdateUs;
+  portEXIT_CRITICAL(&powerMux);
+}
+
+void powerEndFrame() {
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  int64_t elapsed = lastUpdateUs - frameStartUs;
+  if (elapsed > 0) {
+    lastFrameAvgMa = (totalChargeMaUs - frameStartCharge) / (double)elapsed;
+    lastFrameMs = elapsed / 1000;
+    frameCount++;
+  }
+  portEXIT_CRITICAL(&powerMux);
+
+  LOG_DEBUG("🔋 Frame %u: %.1f mA promedio en %lums",
+                frameCount, lastFrameAvgMa, (unsigned long)lastFrameMs);
+}
+
+PowerConfig getPowerConfig() {
+  portENTER_CRITICAL(&powerMux);
+  PowerConfig copy = config;
+  portEXIT_CRITICAL(&powerMux);
+  return copy;
+}
+
+void setPowerConfig(const PowerConfig& newConfig) {
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  config = newConfig;
+  portEXIT_CRITICAL(&powerMux);
+}
+
+PowerFrameReport getPowerReport() {
+  PowerFrameReport report;
+
+  portENTER_CRITICAL(&powerMux);
+  integrate();
+  int64_t elapsed = lastUpdateUs - startUs;
+  report.frames = frameCount;
+  report.lastFrameMs = lastFrameMs;
+  report.lastFrameAvgMa = lastFrameAvgMa;
+  report.totalMah = totalChargeMaUs / 3.6e9;
+  report.overallAvgMa = elapsed > 0 ? totalChargeMaUs / (double)elapsed : 0;
+  report.sleepMs = totalSleepUs / 1000;
+  portEXIT_CRITICAL(&powerMux);
+
+  return report;
+}
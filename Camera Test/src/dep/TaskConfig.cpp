@@ -0,0 +1,127 @@
+#include "TaskConfig.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "Log.h"
+#include <Preferences.h>
+
+// WiFi (prioridad 23) y el controlador BLE viven en el core 0; AsyncTCP
+// corre con prioridad 10 en cualquier core; loop() en el core 1 con prioridad 1.
+const TaskLayout TASK_LAYOUTS[] = {
+  { "build", {
+    { STEPPER_TASK_CORE, STEPPER_TASK_PRIORITY, 8192 },
+    { SERVO_TASK_CORE, SERVO_TASK_PRIORITY, 8192 },
+    { SEQUENCE_TASK_CORE, SEQUENCE_TASK_PRIORITY, 8192 } } },
+  // Lo documentado originalmente: stepper con radios pero prioridad 3
+  { "stepper-core0-p3", {
+    { 0, 3, 8192 },
+    { 1, 2, 8192 },
+    { 1, 1, 8192 } } },
+  // Stepper fuera del core de las radios
+  { "stepper-core1-p4", {
+    { 1, 4, 8192 },
+    { 1, 2, 8192 },
+    { 1, 1, 8192 } } },
+  // Stepper en el core 1 por encima de AsyncTCP; servo y secuencias al core 0
+  { "stepper-core1-p12", {
+    { 1, 12, 8192 },
+    { 0, 2, 8192 },
+    { 0, 1, 8192 } } },
+};
+
+const int TASK_LAYOUT_COUNT = sizeof(TASK_LAYOUTS) / sizeof(TASK_LAYOUTS[0]);
+
+static int activeLayout = TASK_LAYOUT_DEFAULT;
+// La task de secuencias se crea una vez al arrancar y no se recrea
+static int bootLayout = TASK_LAYOUT_DEFAULT;
+
+void loadTaskLayout() {
+  Preferences prefs;
+  if (prefs.begin("tasks", true)) {
+    int saved = prefs.getUChar("layout", TASK_LAYOUT_DEFAULT);
+    prefs.end();
+    if (saved >= 0 && saved < TASK_LAYOUT_COUNT) {
+      activeLayout = saved;
+    }
+  }
+  bootLayout = activeLayout;
+  LOG_INFO("🧵 Layout de tasks: %s", TASK_LAYOUTS[activeLayout].name);
+}
+
+const TaskPlacement& getTaskPlacement(TaskId id) {
+  return TASK_LAYOUTS[activeLayout].tasks[id];
+}
+
+int getActiveTaskLayout() {
+  return activeLayout;
+}
+
+static bool samePlacement(const TaskPlacement& a, const TaskPlacement& b) {
+  return a.core == b.core && a.priority == b.priority;
+}
+
+bool applyTaskLayout(int index, StepperDriver* stepper, ServoDriver* servo, bool persist) {
+  if (index < 0 || index >= TASK_LAYOUT_COUNT) {
+    return false;
+  }
+
+  int previous = activeLayout;
+  activeLayout = index;
+
+  // Las tasks de los drivers se recrean ahora. Si el servo falla después
+  // de mover el stepper, el stepper vuelve al layout anterior: nunca
+  // quedan repartidos entre dos layouts.
+  if (stepper && !stepper->restartTask()) {
+    activeLayout = previous;
+    LOG_WARN("⚠️ No se pudo cambiar el layout (stepper en movimiento)");
+    return false;
+  }
+  if (servo && !servo->restartTask()) {
+    activeLayout = previous;
+    if (stepper && !stepper->restartTask()) {
+      LOG_ERROR("❌ No se pudo devolver el stepper al layout %s", TASK_LAYOUTS[previous].name);
+    }
+    LOG_WARN("⚠️ No se pudo cambiar el layout (servo en movimiento)");
+    return false;
+  }
+
+  if (persist) {
+    Preferences prefs;
+    if (prefs.begin("tasks", false)) {
+      prefs.putUChar("layout", index);
+      prefs.end();
+    }
+  }
+
+  LOG_INFO("🧵 Layout de tasks aplicado: %s", TASK_LAYOUTS[index].name);
+  if (!samePlacement(TASK_LAYOUTS[index].tasks[TASK_SEQUENCE], TASK_LAYOUTS[bootLayout].tasks[TASK_SEQUENCE])) {
+    LOG_INFO("🧵 La task de secuencias sigue en core %d, prioridad %d hasta reiniciar",
+             (int)TASK_LAYOUTS[bootLayout].tasks[TASK_SEQUENCE].core,
+             (int)TASK_LAYOUTS[bootLayout].tasks[TASK_SEQUENCE].priority);
+  }
+  return true;
+}
+
+String getTaskLayoutsAsJson() {
+  static const char* taskNames[TASK_COUNT] = { "stepper", "servo", "sequence" };
+
+  String json = "{\"active\":" + String(activeLayout) + ",\"layouts\":[";
+  for (int i = 0; i < TASK_LAYOUT_COUNT; i++) {
+    if (i > 0) json += ",";
+    json += "{\"index\":" + String(i) + ",\"name\":\"" + TASK_LAYOUTS[i].name + "\"";
+    for (int t = 0; t < TASK_COUNT; t++) {
+      json += ",\"" + String(taskNames[t]) + "\":{";
+      json += "\"core\":" + String((int)TASK_LAYOUTS[i].tasks[t].core) + ",";
+      json += "\"priority\":" + String((int)TASK_LAYOUTS[i].tasks[t].priority) + "}";
+    }
+    json += "}";
+  }
+  // Dónde corre de verdad la task de secuencias: el layout con que arrancó
+  const TaskPlacement& sequence = TASK_LAYOUTS[bootLayout].tasks[TASK_SEQUENCE];
+  json += "],\"sequenceTask\":{";
+  json += "\"core\":" + String((int)sequence.core) + ",";
+  json += "\"priority\":" + String((int)sequence.priority) + ",";
+  json += "\"untilReboot\":" + String(samePlacement(sequence, TASK_LAYOUTS[activeLayout].tasks[TASK_SEQUENCE]) ?
+                                         "false" : "true");
+  json += "}}";
+  return json;
+}
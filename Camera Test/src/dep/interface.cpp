@@ -1,10 +1,19 @@
 #include "interface.h"
+#include "CommandRouter.h"
 #include "drivers/ServoDriver.h"
 #include "drivers/StepperDriver.h"
 #include "drivers/SequenceManager.h"
+#include "drivers/TeachRecorder.h"
+#include "drivers/SubjectTracker.h"
+#include "TaskConfig.h"
+#include "JitterBenchmark.h"
+#include "EmergencyStop.h"
+#include "Checkpoint.h"
+#include "Log.h"
 #include <LittleFS.h>
 
 AsyncWebServer server(80);
+AsyncWebSocket ws("/ws");
 
 // Credenciales WiFi
 const char* ssid = "Mariano";
@@ -14,6 +23,9 @@ const char* password = "hola1234";
 extern ServoDriver* servoDriver;
 extern StepperDriver* stepperDriver;
 extern SequenceManager* sequenceManager;
+extern MotionController* motionController;
+extern TeachRecorder* teachRecorder;
+extern SubjectTracker* subjectTracker;
 
 // Callback para disparar foto
 void (*photoCallbackFunc)() = nullptr;
@@ -27,6 +39,165 @@ void updateBLEStatus(bool connected) {
   bleConnected = connected;
 }
 
+static bool takePhoto() {
+  if (photoCallbackFunc == nullptr) return false;
+  photoCallbackFunc();
+  return true;
+}
+
+static bool isBleConnected() {
+  return bleConnected;
+}
+
+void serviceWebServer() {
+  // Liberar clientes WebSocket desconectados
+  ws.cleanupClients();
+}
+
+void suspendWiFi() {
+  ws.closeAll();
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+}
+
+// Sin esperar la conexión: el servidor sigue escuchando y atiende en
+// cuanto hay IP
+void resumeWiFi() {
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+}
+
+// ========== Canal WebSocket binario ==========
+
+static void handleControlFrame(AsyncWebSocketClient *client, const uint8_t *data, size_t len) {
+  ControlHeader header;
+  if (len < sizeof(header)) return;  // Sin cabecera no hay a quién responder
+
+  uint8_t status = dispatchControlFrame(data, len, header);
+
+  AckFrame ack;
+  fillAck(ack, header, status);
+  client->binary((const uint8_t*)&ack, sizeof(ack));
+}
+
+static void onWsEvent(AsyncWebSocket *socket, AsyncWebSocketClient *client,
+                      AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  switch (type) {
+    case WS_EVT_CONNECT:
+      LOG_INFO("🔌 WS cliente #%u conectado", client->id());
+      break;
+    case WS_EVT_DISCONNECT:
+      LOG_INFO("🔌 WS cliente #%u desconectado", client->id());
+      break;
+    case WS_EVT_DATA: {
+      // Solo tramas binarias completas en un único fragmento
+      AwsFrameInfo *info = (AwsFrameInfo*)arg;
+      if (info->final && info->index == 0 && info->len == len && info->opcode == WS_BINARY) {
+        handleControlFrame(client, data, len);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// ========== Comandos REST ==========
+
+// Módulos del sistema para CommandRouter, con los drivers de main.cpp
+class FirmwareSystem : public SystemControl {
+public:
+  void saveBacklashConfig() override { ::saveBacklashConfig(stepperDriver, servoDriver); }
+  String getBacklashAsJson() override { return ::getBacklashAsJson(stepperDriver, servoDriver); }
+
+  bool setPositionTriggers(const PositionTrigger* entries, int count) override {
+    return ::setPositionTriggers(entries, count);
+  }
+  void clearPositionTriggers() override { ::clearPositionTriggers(); }
+  void setTriggerPulseWidth(uint32_t ms) override { ::setTriggerPulseWidth(ms); }
+  String getPositionTriggersAsJson() override { return ::getPositionTriggersAsJson(); }
+
+  void triggerEmergencyStop() override { ::triggerEmergencyStop(); }
+  bool resetEmergencyStop() override { return ::resetEmergencyStop(); }
+  bool isEmergencyLatched() override { return ::isEmergencyLatched(); }
+  String getEmergencyStopAsJson() override { return ::getEmergencyStopAsJson(); }
+
+  void setCheckpointAutoResume(bool enabled) override { ::setCheckpointAutoResume(enabled); }
+  void setCheckpointInterval(uint32_t ms) override { ::setCheckpointInterval(ms); }
+  bool resumeFromCheckpoint(String& reason) override {
+    if (sequenceManager == nullptr) {
+      reason = "Secuencias no inicializadas";
+      return false;
+    }
+    return ::resumeFromCheckpoint(sequenceManager, reason);
+  }
+  void discardCheckpointRun() override { ::discardCheckpointRun(); }
+  String getCheckpointAsJson() override { return ::getCheckpointAsJson(); }
+
+  bool applyTaskLayout(int index) override {
+    return ::applyTaskLayout(index, stepperDriver, servoDriver, true);
+  }
+  String getTaskLayoutsAsJson() override { return ::getTaskLayoutsAsJson(); }
+  bool startJitterBenchmark(long steps, int speed) override {
+    return ::startJitterBenchmark(stepperDriver, servoDriver, steps, speed);
+  }
+  bool isJitterBenchmarkRunning() override { return ::isJitterBenchmarkRunning(); }
+  String getJitterBenchmarkAsJson() override { return ::getJitterBenchmarkAsJson(); }
+
+  PowerConfig getPowerConfig() override { return ::getPowerConfig(); }
+  void setPowerConfig(const PowerConfig& config) override { ::setPowerConfig(config); }
+  PowerFrameReport getPowerReport() override { return ::getPowerReport(); }
+
+  String getLogAsJson(uint32_t since) override { return ::getLogAsJson(since); }
+};
+
+static FirmwareSystem firmwareSystem;
+
+// Parámetros de AsyncWebServerRequest. En POST se aceptan los del cuerpo y
+// también los de la query.
+class WebParams : public CommandParams {
+public:
+  WebParams(AsyncWebServerRequest *request, bool post) : request(request), post(post) {}
+
+  bool has(const char* name) const override {
+    return (post && request->hasParam(name, true)) || request->hasParam(name);
+  }
+
+  String get(const char* name) const override {
+    if (post && request->hasParam(name, true)) return request->getParam(name, true)->value();
+    if (request->hasParam(name)) return request->getParam(name)->value();
+    return String();
+  }
+
+  String header(const char* name) const override {
+    const AsyncWebHeader* h = request->getHeader(name);
+    return h != nullptr ? h->value() : String();
+  }
+
+private:
+  AsyncWebServerRequest *request;
+  bool post;
+};
+
+static void registerCommandRoutes() {
+  CommandContext context = {
+    stepperDriver, servoDriver, sequenceManager, motionController, teachRecorder,
+    subjectTracker, &firmwareSystem, takePhoto, isBleConnected
+  };
+  setCommandContext(context);
+
+  for (int i = 0; i < getCommandRouteCount(); i++) {
+    const CommandRoute& route = getCommandRoute(i);
+    bool post = route.method == COMMAND_POST;
+    server.on(route.path, post ? HTTP_POST : HTTP_GET, [i, post](AsyncWebServerRequest *request){
+      WebParams params(request, post);
+      CommandResponse res;
+      dispatchCommand(i, params, res);
+      request->send(res.status, "application/json", res.body);
+    });
+  }
+}
+
 void setupWebServer() {
   // Inicializar LittleFS (no SPIFFS)
   if(!LittleFS.begin(true)){
@@ -69,9 +240,13 @@ void setupWebServer() {
     return;
   }
 
+  // Canal WebSocket binario para control manual
+  ws.onEvent(onWsEvent);
+  server.addHandler(&ws);
+
   // Ruta principal - servir index.html
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("📄 GET /");
+    LOG_DEBUG("📄 GET /");
     if(LittleFS.exists("/index.html")){
       request->send(LittleFS, "/index.html", "text/html");
     } else {
@@ -81,7 +256,7 @@ void setupWebServer() {
 
   // Servir CSS
   server.on("/style.css", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("📄 GET /style.css");
+    LOG_DEBUG("📄 GET /style.css");
     if(LittleFS.exists("/style.css")){
       request->send(LittleFS, "/style.css", "text/css");
     } else {
@@ -91,7 +266,7 @@ void setupWebServer() {
 
   // Servir JS
   server.on("/script.js", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("📄 GET /script.js");
+    LOG_DEBUG("📄 GET /script.js");
     if(LittleFS.exists("/script.js")){
       request->send(LittleFS, "/script.js", "application/javascript");
     } else {
@@ -99,224 +274,12 @@ void setupWebServer() {
     }
   });
 
-  // Ruta para disparar foto
-  server.on("/photo", HTTP_GET, [](AsyncWebServerRequest *request){
-    Serial.println("📸 GET /photo");
-    if (bleConnected && photoCallbackFunc != nullptr) {
-      photoCallbackFunc();
-      request->send(200, "application/json", "{\"success\":true}");
-    } else {
-      request->send(200, "application/json", 
-        "{\"success\":false,\"message\":\"Bluetooth no conectado\"}");
-    }
-  });
-
-  // Ruta para estado BLE
-  server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request){
-    String json = "{\"connected\":";
-    json += bleConnected ? "true" : "false";
-    json += "}";
-    request->send(200, "application/json", json);
-  });
-
-  // ========== Control Manual ==========
-  
-  // Controlar servo
-  server.on("/servo", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!servoDriver) {
-      request->send(500, "application/json", "{\"success\":false,\"message\":\"Driver no inicializado\"}");
-      return;
-    }
-    if(request->hasParam("angle") && request->hasParam("speed")) {
-      int angle = request->getParam("angle")->value().toInt();
-      int speed = request->getParam("speed")->value().toInt();
-      
-      if(servoDriver->moveTo(angle, speed, false)) {
-        request->send(200, "application/json", "{\"success\":true,\"angle\":" + String(angle) + ",\"speed\":" + String(speed) + "}");
-      } else {
-        request->send(500, "application/json", "{\"success\":false,\"message\":\"Error moviendo servo\"}");
-      }
-    } else {
-      request->send(400, "application/json", "{\"success\":false,\"message\":\"Faltan parámetros\"}");
-    }
-  });
-
-  // Controlar stepper
-  server.on("/stepper", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!stepperDriver) {
-      request->send(500, "application/json", "{\"success\":false,\"message\":\"Driver no inicializado\"}");
-      return;
-    }
-    if(request->hasParam("distance") && request->hasParam("speed")) {
-      float distance = request->getParam("distance")->value().toFloat();
-      int speed = request->getParam("speed")->value().toInt();
-      
-      // Convertir velocidad de 0-100% a steps/segundo
-      int stepsPerSec = map(speed, 0, 100, 100, 2000);
-      long steps = stepperDriver->mmToSteps(distance, 8.0); // 8mm por revolución
-      
-      if(stepperDriver->moveRelative(steps, stepsPerSec, false)) {
-        request->send(200, "application/json", "{\"success\":true,\"distance\":" + String(distance) + ",\"speed\":" + String(speed) + "}");
-      } else {
-        request->send(500, "application/json", "{\"success\":false,\"message\":\"Error moviendo stepper\"}");
-      }
-    } else {
-      request->send(400, "application/json", "{\"success\":false,\"message\":\"Faltan parámetros\"}");
-    }
-  });
-
-  // Habilitar/deshabilitar stepper
-  server.on("/stepper/enable", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!stepperDriver) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    if(request->hasParam("value")) {
-      bool enable = request->getParam("value")->value() == "true";
-      if(enable) stepperDriver->enable();
-      else stepperDriver->disable();
-      request->send(200, "application/json", "{\"success\":true,\"enabled\":" + String(enable ? "true" : "false") + "}");
-    } else {
-      request->send(400, "application/json", "{\"success\":false}");
-    }
-  });
-
-  // Resetear posición stepper
-  server.on("/stepper/zero", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!stepperDriver) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    stepperDriver->zero();
-    request->send(200, "application/json", "{\"success\":true}");
-  });
-
-  // ========== Gestión de Secuencias ==========
-  
-  // Crear secuencia
-  server.on("/sequence/create", HTTP_POST, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    if(request->hasParam("name", true)) {
-      String name = request->getParam("name", true)->value();
-      int index = sequenceManager->createSequence(name);
-      request->send(200, "application/json", "{\"success\":true,\"index\":" + String(index) + "}");
-    } else {
-      request->send(400, "application/json", "{\"success\":false}");
-    }
-  });
-
-  // Agregar movimiento a secuencia
-  server.on("/sequence/add", HTTP_POST, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    
-    if(request->hasParam("seq", true) && request->hasParam("distance", true) && 
-       request->hasParam("speed", true) && request->hasParam("angle", true) &&
-       request->hasParam("angleSpeed", true)) {
-      
-      int seqIndex = request->getParam("seq", true)->value().toInt();
-      
-      Movement mov;
-      mov.horizontalDistance = request->getParam("distance", true)->value().toFloat();
-      mov.horizontalSpeed = request->getParam("speed", true)->value().toInt();
-      mov.angle = request->getParam("angle", true)->value().toInt();
-      mov.angleSpeed = request->getParam("angleSpeed", true)->value().toInt();
-      mov.simultaneous = request->hasParam("simultaneous", true) ? 
-                         request->getParam("simultaneous", true)->value() == "true" : false;
-      mov.pauseAfter = request->hasParam("pause", true) ? 
-                       request->getParam("pause", true)->value().toInt() : 0;
-      
-      if(sequenceManager->addMovement(seqIndex, mov)) {
-        request->send(200, "application/json", "{\"success\":true}");
-      } else {
-        request->send(500, "application/json", "{\"success\":false}");
-      }
-    } else {
-      request->send(400, "application/json", "{\"success\":false,\"message\":\"Faltan parámetros\"}");
-    }
-  });
-
-  // Ejecutar secuencia
-  server.on("/sequence/execute", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    if(request->hasParam("index")) {
-      int index = request->getParam("index")->value().toInt();
-      if(sequenceManager->executeSequence(index)) {
-        request->send(200, "application/json", "{\"success\":true}");
-      } else {
-        request->send(500, "application/json", "{\"success\":false}");
-      }
-    } else {
-      request->send(400, "application/json", "{\"success\":false}");
-    }
-  });
-
-  // Pausar/reanudar secuencia
-  server.on("/sequence/pause", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    sequenceManager->pause();
-    request->send(200, "application/json", "{\"success\":true}");
-  });
-
-  server.on("/sequence/resume", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    sequenceManager->resume();
-    request->send(200, "application/json", "{\"success\":true}");
-  });
-
-  // Detener secuencia
-  server.on("/sequence/stop", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{\"success\":false}");
-      return;
-    }
-    sequenceManager->stop();
-    request->send(200, "application/json", "{\"success\":true}");
-  });
-
-  // Listar secuencias
-  server.on("/sequence/list", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "[]");
-      return;
-    }
-    String json = sequenceManager->getAllSequencesAsJson();
-    request->send(200, "application/json", json);
-  });
-
-  // Obtener info de una secuencia
-  server.on("/sequence/get", HTTP_GET, [](AsyncWebServerRequest *request){
-    if(!sequenceManager) {
-      request->send(500, "application/json", "{}");
-      return;
-    }
-    if(request->hasParam("index")) {
-      int index = request->getParam("index")->value().toInt();
-      String json = sequenceManager->getSequenceAsJson(index);
-      request->send(200, "application/json", json);
-    } else {
-      request->send(400, "application/json", "{}");
-    }
-  });
+  // Comandos (CommandRouter)
+  registerCommandRoutes();
 
   // Capturar 404
   server.onNotFound([](AsyncWebServerRequest *request){
-    Serial.print("❌ 404: ");
-    Serial.println(request->url());
+    LOG_WARN("❌ 404: %s", request->url().c_str());
     request->send(404, "text/plain", "Archivo no encontrado: " + request->url());
   });
 
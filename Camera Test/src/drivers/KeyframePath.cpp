@@ -0,0 +1,152 @@
+#include "drivers/KeyframePath.h"
+
+KeyframePath::KeyframePath()
+  : interpolation(INTERP_MONOTONE), compiled(false) {
+}
+
+bool KeyframePath::addKeyframe(const Keyframe& keyframe) {
+  // Los tiempos deben ser estrictamente crecientes
+  if (!keyframes.empty() && keyframe.timeMs <= keyframes.back().timeMs) {
+    return false;
+  }
+  keyframes.push_back(keyframe);
+  compiled = false;
+  return true;
+}
+
+void KeyframePath::clear() {
+  keyframes.clear();
+  segments.clear();
+  compiled = false;
+}
+
+void KeyframePath::setInterpolation(InterpolationType type) {
+  interpolation = type;
+  compiled = false;
+}
+
+void KeyframePath::computeTangents(const std::vector<float>& values,
+                                   std::vector<float>& tangents) const {
+  size_t n = values.size();
+  tangents.assign(n, 0.0f);
+
+  // Pendientes de cada tramo (unidades por ms)
+  std::vector<float> secants(n - 1);
+  for (size_t i = 0; i + 1 < n; i++) {
+    float h = keyframes[i + 1].timeMs - keyframes[i].timeMs;
+    secants[i] = (values[i + 1] - values[i]) / h;
+  }
+
+  tangents[0] = secants[0];
+  tangents[n - 1] = secants[n - 2];
+
+  if (interpolation == INTERP_CATMULL_ROM) {
+    // Catmull-Rom no uniforme: diferencia centrada respecto del tiempo
+    for (size_t i = 1; i + 1 < n; i++) {
+      float span = keyframes[i + 1].timeMs - keyframes[i - 1].timeMs;
+      tangents[i] = (values[i + 1] - values[i - 1]) / span;
+    }
+    return;
+  }
+
+  // Fritsch-Carlson: tangente nula en extremos locales y limitada para
+  // que cada tramo sea monótono
+  for (size_t i = 1; i + 1 < n; i++) {
+    if (secants[i - 1] * secants[i] <= 0.0f) {
+      tangents[i] = 0.0f;
+    } else {
+      tangents[i] = (secants[i - 1] + secants[i]) * 0.5f;
+    }
+  }
+
+  for (size_t i = 0; i + 1 < n; i++) {
+    if (secants[i] == 0.0f) {
+      tangents[i] = 0.0f;
+      tangents[i + 1] = 0.0f;
+      continue;
+    }
+    float alpha = tangents[i] / secants[i];
+    float beta = tangents[i + 1] / secants[i];
+    float norm = alpha * alpha + beta * beta;
+    if (norm > 9.0f) {
+      float tau = 3.0f / sqrtf(norm);
+      tangents[i] = tau * alpha * secants[i];
+      tangents[i + 1] = tau * beta * secants[i];
+    }
+  }
+}
+
+bool KeyframePath::compile() {
+  segments.clear();
+  compiled = false;
+
+  if (keyframes.size() < 2) {
+    return false;
+  }
+
+  size_t n = keyframes.size();
+  std::vector<float> positions(n), angles(n);
+  for (size_t i = 0; i < n; i++) {
+    positions[i] = keyframes[i].position;
+    angles[i] = keyframes[i].angle;
+  }
+
+  std::vector<float> posTangents, angleTangents;
+  computeTangents(positions, posTangents);
+  computeTangents(angles, angleTangents);
+
+  // Forma de Hermite normalizada a u ∈ [0,1]: las tangentes se escalan por h
+  auto hermite = [](float p0, float p1, float m0, float m1, float h) {
+    Cubic c;
+    c.a = p0;
+    c.b = m0 * h;
+    c.c = 3.0f * (p1 - p0) - h * (2.0f * m0 + m1);
+    c.d = 2.0f * (p0 - p1) + h * (m0 + m1);
+    return c;
+  };
+
+  segments.reserve(n - 1);
+  for (size_t i = 0; i + 1 < n; i++) {
+    float h = keyframes[i + 1].timeMs - keyframes[i].timeMs;
+    Segment seg;
+    seg.startMs = keyframes[i].timeMs;
+    seg.invDuration = 1.0f / h;
+    seg.position = hermite(positions[i], positions[i + 1], posTangents[i], posTangents[i + 1], h);
+    seg.angle = hermite(angles[i], angles[i + 1], angleTangents[i], angleTangents[i + 1], h);
+    segments.push_back(seg);
+  }
+
+  compiled = true;
+  return true;
+}
+
+void KeyframePath::sample(uint32_t tMs, Cursor& cursor, float& position, float& angle) const {
+  if (!compiled) {
+    position = keyframes.empty() ? 0.0f : keyframes[0].position;
+    angle = keyframes.empty() ? 90.0f : keyframes[0].angle;
+    return;
+  }
+
+  if (tMs >= getDurationMs()) {
+    position = keyframes.back().position;
+    angle = keyframes.back().angle;
+    cursor = segments.size() - 1;
+    return;
+  }
+
+  if (cursor >= segments.size()) {
+    cursor = 0;
+  }
+  // Tiempo hacia atrás (reproducción en reversa): retroceder tramo a tramo
+  while (cursor > 0 && tMs < segments[cursor].startMs) {
+    cursor--;
+  }
+  while (cursor + 1 < segments.size() && tMs >= segments[cursor + 1].startMs) {
+    cursor++;
+  }
+
+  const Segment& seg = segments[cursor];
+  float u = (tMs - seg.startMs) * seg.invDuration;
+  position = seg.position.eval(u);
+  angle = seg.angle.eval(u);
+}
@@ -0,0 +1,306 @@
+#include "drivers/MotionController.h"
+#include "Log.h"
+
+MotionController* MotionController::instance = nullptr;
+
+// ========== MotionAxis ==========
+
+MotionAxis::MotionAxis(const char* axisName, uint32_t rate, float scale)
+  : head(0), tail(0), active(false), pulseHigh(false), absSteps(0), stepsLeft(0), ticksLeft(0),
+    totalTicks(0), accumulator(0), forward(true),
+    name(axisName), position(0), maxRate(rate), unitsPerUser(scale),
+    outputHandle(nullptr), setDirectionFn(nullptr), stepFn(nullptr), endPulseFn(nullptr) {
+  bufferMux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+// DDA (Bresenham): reparte absSteps pasos en totalTicks ticks sin divisiones
+void IRAM_ATTR MotionAxis::tick() {
+  if (pulseHigh) {
+    endPulseFn(outputHandle);
+    pulseHigh = false;
+  }
+  
+  if (!active) {
+    portENTER_CRITICAL_ISR(&bufferMux);
+    bool available = head != tail;
+    MotionSegment segment;
+    if (available) {
+      segment = buffer[tail];
+      tail = (tail + 1) % MOTION_SEGMENT_BUFFER;
+    }
+    portEXIT_CRITICAL_ISR(&bufferMux);
+    
+    if (!available) return;
+    
+    forward = segment.steps >= 0;
+    absSteps = forward ? segment.steps : -segment.steps;
+    stepsLeft = absSteps;
+    totalTicks = segment.ticks;
+    ticksLeft = totalTicks;
+    accumulator = 0;
+    active = totalTicks > 0;
+    
+    // DIR se asienta un tick antes del primer pulso
+    setDirectionFn(outputHandle, forward);
+    return;
+  }
+  
+  accumulator += absSteps;
+  if (accumulator >= totalTicks) {
+    accumulator -= totalTicks;
+    stepFn(outputHandle);
+    pulseHigh = true;
+    stepsLeft--;
+    position += forward ? 1 : -1;
+  }
+  
+  if (--ticksLeft == 0) {
+    active = false;
+  }
+}
+
+bool MotionAxis::pushSegment(const MotionSegment& segment) {
+  portENTER_CRITICAL(&bufferMux);
+  uint8_t next = (head + 1) % MOTION_SEGMENT_BUFFER;
+  bool full = next == tail;
+  if (!full) {
+    buffer[head] = segment;
+    head = next;
+  }
+  portEXIT_CRITICAL(&bufferMux);
+  return !full;
+}
+
+int MotionAxis::getFreeSegments() {
+  portENTER_CRITICAL(&bufferMux);
+  int used = (head - tail + MOTION_SEGMENT_BUFFER) % MOTION_SEGMENT_BUFFER;
+  portEXIT_CRITICAL(&bufferMux);
+  return MOTION_SEGMENT_BUFFER - 1 - used;
+}
+
+bool MotionAxis::isIdle() {
+  portENTER_CRITICAL(&bufferMux);
+  bool idle = !active && head == tail;
+  portEXIT_CRITICAL(&bufferMux);
+  return idle;
+}
+
+void MotionAxis::abort() {
+  portENTER_CRITICAL(&bufferMux);
+  head = tail;
+  active = false;
+  portEXIT_CRITICAL(&bufferMux);
+}
+
+// Termina el pulso en curso (si lo hay) para no dejar STEP en alto
+void IRAM_ATTR MotionAxis::halt() {
+  if (pulseHigh) {
+    endPulseFn(outputHandle);
+    pulseHigh = false;
+  }
+  portENTER_CRITICAL_ISR(&bufferMux);
+  tail = head;
+  active = false;
+  portEXIT_CRITICAL_ISR(&bufferMux);
+}
+
+// Corta el segmento en curso y descarta los encolados; en su lugar encola
+// escalones de 7/8, 5/8, 3/8 y 1/8 de la velocidad actual. Nunca recorre
+// más de lo que faltaba del segmento cortado.
+void MotionAxis::decelerate(uint32_t rampMs) {
+  portENTER_CRITICAL(&bufferMux);
+  bool wasActive = active;
+  bool direction = forward;
+  uint32_t left = stepsLeft;
+  uint32_t rate = totalTicks > 0 ? (uint64_t)absSteps * MOTION_TICK_HZ / totalTicks : 0;
+  head = tail;
+  active = false;
+  portEXIT_CRITICAL(&bufferMux);
+  
+  if (!wasActive || rate == 0) {
+    return;
+  }
+  
+  uint32_t stageMs = rampMs / MOTION_DECEL_STAGES;
+  for (int k = 0; k < MOTION_DECEL_STAGES && left > 0; k++) {
+    uint32_t stageRate = (uint64_t)rate * (2 * (MOTION_DECEL_STAGES - k) - 1) / (2 * MOTION_DECEL_STAGES);
+    uint32_t steps = min<uint32_t>(left, (uint64_t)stageRate * stageMs / 1000);
+    if (steps == 0) continue;
+    left -= steps;
+    MotionSegment segment = { direction ? (int32_t)steps : -(int32_t)steps,
+                              (uint32_t)((uint64_t)steps * MOTION_TICK_HZ / stageRate) };
+    pushSegment(segment);
+  }
+}
+
+// ========== MotionController ==========
+
+MotionController::MotionController()
+  : axisCount(0), timer(nullptr), refreshTimer(nullptr), halted(false) {
+  memset(axes, 0, sizeof(axes));
+}
+
+int MotionController::addAxis(MotionAxis* axis) {
+  if (axis == nullptr || axisCount >= MAX_MOTION_AXES || timer != nullptr) {
+    return -1;
+  }
+  axes[axisCount] = axis;
+  return axisCount++;
+}
+
+bool MotionController::begin() {
+  for (int i = 0; i < axisCount; i++) {
+    if (!axes[i]->begin()) {
+      LOG_ERROR("❌ MotionController: Error inicializando eje %s", axes[i]->getName());
+      return false;
+    }
+  }
+  
+  // Sin ejes registrados no se arranca el timer (cero carga)
+  if (axisCount == 0) {
+    LOG_INFO("✅ MotionController inicializado (sin ejes adicionales)");
+    return true;
+  }
+  
+  instance = this;
+  
+  // Timer de hardware a 1 MHz con alarma periódica
+  timer = timerBegin(MOTION_TIMER_INDEX, 80, true);
+  if (timer == nullptr) {
+    LOG_ERROR("❌ MotionController: Error creando timer");
+    return false;
+  }
+  timerAttachInterrupt(timer, &MotionController::onTimer, true);
+  timerAlarmWrite(timer, 1000000 / MOTION_TICK_HZ, true);
+  timerAlarmEnable(timer);
+  
+  esp_timer_create_args_t args = {};
+  args.callback = &MotionController::onRefresh;
+  args.arg = this;
+  args.name = "MotionRefresh";
+  if (esp_timer_create(&args, &refreshTimer) != ESP_OK ||
+      esp_timer_start_periodic(refreshTimer, MOTION_REFRESH_MS * 1000) != ESP_OK) {
+    LOG_ERROR("❌ MotionController: Error creando timer de refresco");
+    return false;
+  }
+  
+  LOG_INFO("✅ MotionController inicializado (%d ejes, %d Hz)", axisCount, MOTION_TICK_HZ);
+  return true;
+}
+
+void IRAM_ATTR MotionController::onTimer() {
+  MotionController* controller = instance;
+  if (controller->halted) {
+    for (int i = 0; i < controller->axisCount; i++) {
+      controller->axes[i]->halt();
+    }
+    return;
+  }
+  for (int i = 0; i < controller->axisCount; i++) {
+    controller->axes[i]->tick();
+  }
+}
+
+void MotionController::onRefresh(void* arg) {
+  MotionController* controller = static_cast<MotionController*>(arg);
+  for (int i = 0; i < controller->axisCount; i++) {
+    controller->axes[i]->refresh();
+  }
+}
+
+MotionAxis* MotionController::getAxis(int index) const {
+  if (index < 0 || index >= axisCount) {
+    return nullptr;
+  }
+  return axes[index];
+}
+
+// Un pulso ocupa un tick en alto: como máximo un paso cada 2 ticks
+static uint32_t clampRate(const MotionAxis* axis, uint32_t rate) {
+  return constrain(rate, 1u, min(axis->getMaxRate(), (uint32_t)(MOTION_TICK_HZ / 2)));
+}
+
+bool MotionController::queueMove(int axis, int32_t delta, uint32_t rate) {
+  MotionAxis* a = getAxis(axis);
+  if (a == nullptr || halted) {
+    return false;
+  }
+  if (delta == 0) {
+    return true;
+  }
+  
+  rate = clampRate(a, rate);
+  uint64_t ticks = (uint64_t)abs(delta) * MOTION_TICK_HZ / rate;
+  MotionSegment segment = { delta, (uint32_t)min<uint64_t>(ticks, UINT32_MAX) };
+  
+  // Esperar lugar en el buffer como se espera en la queue de los drivers
+  unsigned long start = millis();
+  while (!a->pushSegment(segment)) {
+    if (millis() - start > 100) {
+      LOG_ERROR("❌ MotionController: Buffer lleno en eje %s", a->getName());
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+uint64_t MotionController::estimateMoveMicros(int axis, int32_t delta, uint32_t rate) const {
+  MotionAxis* a = getAxis(axis);
+  if (a == nullptr || delta == 0) {
+    return 0;
+  }
+  rate = clampRate(a, rate);
+  uint64_t ticks = (uint64_t)abs(delta) * MOTION_TICK_HZ / rate + 1;  // +1 tick de carga
+  return ticks * 1000000 / MOTION_TICK_HZ;
+}
+
+uint32_t MotionController::rateForSpeed(int axis, int speed) const {
+  MotionAxis* a = getAxis(axis);
+  if (a == nullptr) {
+    return 1;
+  }
+  // Mismo criterio que el stepper principal: 0% = 5% del máximo
+  uint32_t maxRate = a->getMaxRate();
+  return map(constrain(speed, 0, 100), 0, 100, max(1u, maxRate / 20), maxRate);
+}
+
+bool MotionController::isIdle() const {
+  for (int i = 0; i < axisCount; i++) {
+    if (!axes[i]->isIdle()) return false;
+  }
+  return true;
+}
+
+void MotionController::waitIdle() {
+  while (!isIdle()) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+void MotionController::stopAll() {
+  for (int i = 0; i < axisCount; i++) {
+    axes[i]->abort();
+  }
+}
+
+void MotionController::decelerateAll(uint32_t rampMs) {
+  for (int i = 0; i < axisCount; i++) {
+    axes[i]->decelerate(rampMs);
+  }
+}
+
+String MotionController::getAxesAsJson() const {
+  String json = "[";
+  for (int i = 0; i < axisCount; i++) {
+    if (i > 0) json += ",";
+    json += "{\"index\":" + String(i) + ",";
+    json += "\"name\":\"" + String(axes[i]->getName()) + "\",";
+    json += "\"position\":" + String(axes[i]->toUserUnits(axes[i]->getPosition()), 2) + ",";
+    json += "\"absolute\":" + String(axes[i]->isAbsolute() ? "true" : "false") + ",";
+    json += "\"maxRate\":" + String(axes[i]->getMaxRate()) + ",";
+    json += "\"idle\":" + String(axes[i]->isIdle() ? "true" : "false") + "}";
+  }
+  json += "]";
+  return json;
+}
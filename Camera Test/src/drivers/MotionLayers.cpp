@@ -0,0 +1,157 @@
+#include "drivers/MotionLayers.h"
+
+#define SINE_SEGMENTS (1 << LAYER_SINE_BITS)
+#define QUARTER_SHIFT 16                   // Posición dentro del cuarto en Q16
+#define FRACTION_BITS (QUARTER_SHIFT - LAYER_SINE_BITS)
+#define Q15_ONE 32767
+#define Q16_ONE 65536
+
+int16_t MotionLayers::sineTable[SINE_SEGMENTS + 1];
+bool MotionLayers::tableReady = false;
+
+MotionLayers::MotionLayers() : count(0) {
+  memset(layers, 0, sizeof(layers));
+  memset(compiled, 0, sizeof(compiled));
+}
+
+void MotionLayers::buildTable() {
+  if (tableReady) return;
+  for (int i = 0; i <= SINE_SEGMENTS; i++) {
+    sineTable[i] = (int16_t)lroundf(sinf(HALF_PI * i / SINE_SEGMENTS) * Q15_ONE);
+  }
+  tableReady = true;
+}
+
+// Cuadrante en los 2 bits altos de la fase; el resto se lleva al primer
+// cuadrante por simetría y se interpola entre las dos entradas vecinas
+int32_t MotionLayers::sineQ15(uint32_t phase) {
+  uint32_t quadrant = phase >> 30;
+  uint32_t pos = (phase >> (30 - QUARTER_SHIFT)) & (Q16_ONE - 1);
+  if (quadrant & 1) {
+    pos = Q16_ONE - pos;
+  }
+
+  int32_t value;
+  uint32_t index = pos >> FRACTION_BITS;
+  if (index >= SINE_SEGMENTS) {
+    value = sineTable[SINE_SEGMENTS];
+  } else {
+    int32_t fraction = pos & ((1 << FRACTION_BITS) - 1);
+    int32_t base = sineTable[index];
+    int32_t span = sineTable[index + 1] - base;
+    value = base + ((span * fraction + (1 << (FRACTION_BITS - 1))) >> FRACTION_BITS);
+  }
+  return quadrant & 2 ? -value : value;
+}
+
+int32_t MotionLayers::triangleQ15(uint32_t phase) {
+  uint32_t quadrant = phase >> 30;
+  int32_t value = ((phase >> (30 - QUARTER_SHIFT)) & (Q16_ONE - 1)) >> 1;
+  if (quadrant & 1) {
+    value = Q15_ONE - value;
+  }
+  return quadrant & 2 ? -value : value;
+}
+
+// 2^32 / n saturado a 32 bits
+static uint32_t inverseQ32(uint32_t n) {
+  if (n <= 1) return 0xFFFFFFFF;
+  return (uint32_t)((1ULL << 32) / n);
+}
+
+bool MotionLayers::set(const MotionLayer* source, int layerCount, float stepsPerMm) {
+  if (layerCount < 0 || layerCount > MAX_MOTION_LAYERS || (layerCount > 0 && source == nullptr)) {
+    return false;
+  }
+
+  Compiled next[MAX_MOTION_LAYERS];
+  for (int i = 0; i < layerCount; i++) {
+    const MotionLayer& layer = source[i];
+    bool periodic = layer.shape != LAYER_CURVE;
+    float limit = layer.axis == LAYER_RAIL ? 2000.0f : 180.0f;
+    if (layer.axis > LAYER_PAN || layer.shape > LAYER_CURVE || isnan(layer.amplitude) ||
+        fabsf(layer.amplitude) > limit || isnan(layer.phaseDeg) ||
+        (periodic && layer.periodMs < LAYER_MIN_PERIOD_MS) ||
+        (!periodic && layer.durationMs == 0)) {
+      return false;
+    }
+
+    Compiled& c = next[i];
+    c.axis = layer.axis;
+    c.shape = layer.shape;
+    float scale = layer.axis == LAYER_RAIL ? stepsPerMm : 100.0f;
+    c.amplitude = lroundf(layer.amplitude * scale);
+    double turns = layer.phaseDeg / 360.0;
+    turns -= floor(turns);
+    c.phase0 = (uint32_t)((uint64_t)(turns * 4294967296.0) & 0xFFFFFFFF);
+    c.phaseStep = periodic ? inverseQ32(layer.periodMs) : 0;
+    c.startMs = layer.startMs;
+    c.endMs = layer.durationMs > 0 ? layer.startMs + layer.durationMs : 0;
+    c.invFade = periodic && layer.fadeMs > 0 ? inverseQ32(layer.fadeMs) : 0;
+    c.invDuration = periodic ? 0 : inverseQ32(layer.durationMs);
+  }
+
+  buildTable();
+  memcpy(layers, source, layerCount * sizeof(MotionLayer));
+  memcpy(compiled, next, layerCount * sizeof(Compiled));
+  count = layerCount;
+  return true;
+}
+
+// Solo enteros: la fase avanza con un producto de 32x32 bits, las formas
+// salen en Q15 y los fundidos y la curva en Q16
+void MotionLayers::evaluate(uint32_t tMs, uint32_t totalMs, int32_t& railSteps, int32_t& panCdeg) const {
+  railSteps = 0;
+  panCdeg = 0;
+
+  for (int i = 0; i < count; i++) {
+    const Compiled& c = compiled[i];
+    if (tMs < c.startMs) continue;
+    uint32_t local = tMs - c.startMs;
+    uint32_t end = c.endMs > 0 ? c.endMs : totalMs;
+    int32_t value;
+
+    if (c.shape == LAYER_CURVE) {
+      // smoothstep 3u² - 2u³; pasada la ventana queda en la amplitud
+      uint32_t u = tMs >= end ? Q16_ONE : min<uint64_t>(Q16_ONE, ((uint64_t)local * c.invDuration) >> 16);
+      int64_t u2 = ((int64_t)u * u) >> 16;
+      int64_t u3 = (u2 * u) >> 16;
+      value = (int32_t)(((int64_t)c.amplitude * (3 * u2 - 2 * u3)) >> 16);
+    } else {
+      if (tMs >= end) continue;
+      uint32_t phase = c.phase0 + local * c.phaseStep;
+      int32_t wave = c.shape == LAYER_SINE ? sineQ15(phase) : triangleQ15(phase);
+      value = (int32_t)(((int64_t)c.amplitude * wave) >> 15);
+      if (c.invFade != 0) {
+        uint32_t edge = min(local, end - tMs);
+        uint32_t envelope = min<uint64_t>(Q16_ONE, ((uint64_t)edge * c.invFade) >> 16);
+        value = (int32_t)(((int64_t)value * envelope) >> 16);
+      }
+    }
+
+    if (c.axis == LAYER_RAIL) {
+      railSteps += value;
+    } else {
+      panCdeg += value;
+    }
+  }
+}
+
+String MotionLayers::getAsJson() const {
+  static const char* const SHAPE_NAMES[] = { "sine", "triangle", "curve" };
+  String json = "[";
+  for (int i = 0; i < count; i++) {
+    const MotionLayer& layer = layers[i];
+    if (i > 0) json += ",";
+    json += "{\"axis\":\"" + String(layer.axis == LAYER_RAIL ? "rail" : "pan") + "\",";
+    json += "\"shape\":\"" + String(SHAPE_NAMES[layer.shape]) + "\",";
+    json += "\"amplitude\":" + String(layer.amplitude, 2) + ",";
+    json += "\"periodMs\":" + String(layer.periodMs) + ",";
+    json += "\"phase\":" + String(layer.phaseDeg, 1) + ",";
+    json += "\"startMs\":" + String(layer.startMs) + ",";
+    json += "\"durationMs\":" + String(layer.durationMs) + ",";
+    json += "\"fadeMs\":" + String(layer.fadeMs) + "}";
+  }
+  json += "]";
+  return json;
+}
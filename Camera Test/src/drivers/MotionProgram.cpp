@@ -0,0 +1,169 @@
+#include "drivers/MotionProgram.h"
+
+#define MAX_PROGRAM_CENTIMM 200000   // ±2 m por movimiento
+#define MAX_PROGRAM_MS 3600000       // Pausas y esperas de hasta 1 h
+
+static inline int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// En zigzag |v| <= n equivale a valor <= 2n
+static inline bool distanceInRange(uint32_t zigzagged) {
+  return zigzagged <= 2 * MAX_PROGRAM_CENTIMM;
+}
+
+MotionProgram::MotionProgram() : instructionCount(0), depth(0) {
+}
+
+// Varint de hasta 5 bytes; false si se corta, no termina o no cabe en 32
+// bits (el quinto byte solo aporta los 4 bits altos)
+bool MotionProgram::readVarint(const uint8_t* bytes, size_t length, size_t& offset, uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (offset >= length) return false;
+    uint8_t byte = bytes[offset++];
+    if (shift == 28 && (byte & 0x70)) return false;
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+bool MotionProgram::load(const uint8_t* bytes, size_t length, String& error) {
+  if (length == 0 || length > MAX_PROGRAM_BYTES) {
+    error = "Tamaño inválido (1-" + String(MAX_PROGRAM_BYTES) + " bytes)";
+    return false;
+  }
+
+  // Por cada bucle abierto, si su cuerpo ya tiene alguna instrucción
+  bool bodyUsed[MAX_PROGRAM_DEPTH];
+  int open = 0;
+  int maxOpen = 0;
+  uint16_t count = 0;
+  size_t offset = 0;
+
+  while (offset < length) {
+    size_t at = offset;
+    uint8_t op = bytes[offset++];
+    uint32_t a = 0, b = 0;
+    bool ok = true;
+    count++;
+
+    switch (op) {
+      case OP_END:
+        if (open > 0) {
+          error = "Bucle sin cerrar";
+          return false;
+        }
+        if (offset != length) {
+          error = "Bytes después de OP_END (byte " + String((int)offset) + ")";
+          return false;
+        }
+        break;
+      case OP_MOVE:
+        ok = readVarint(bytes, length, offset, a) && distanceInRange(a);
+        break;
+      case OP_TURN:
+        ok = readVarint(bytes, length, offset, a) && a <= 180;
+        break;
+      case OP_MOVE_TURN:
+        ok = readVarint(bytes, length, offset, a) && distanceInRange(a) &&
+             readVarint(bytes, length, offset, b) && b <= 180;
+        break;
+      case OP_PAUSE:
+      case OP_WAIT:
+        ok = readVarint(bytes, length, offset, a) && a <= MAX_PROGRAM_MS;
+        break;
+      case OP_SHUTTER:
+        break;
+      case OP_LOOP:
+        if (open >= MAX_PROGRAM_DEPTH) {
+          error = "Más de " + String(MAX_PROGRAM_DEPTH) + " bucles anidados (byte " + String((int)at) + ")";
+          return false;
+        }
+        ok = readVarint(bytes, length, offset, a) && a >= 1 && a <= MAX_PROGRAM_LOOP;
+        break;
+      case OP_ENDLOOP:
+        if (open == 0 || !bodyUsed[open - 1]) {
+          error = String(open == 0 ? "OP_ENDLOOP sin bucle" : "Bucle vacío") + " (byte " + String((int)at) + ")";
+          return false;
+        }
+        break;
+      case OP_SPEED:
+        ok = readVarint(bytes, length, offset, a) && a >= 1 && a <= 100 &&
+             readVarint(bytes, length, offset, b) && b >= 1 && b <= 100;
+        break;
+      default:
+        ok = false;
+        break;
+    }
+
+    if (!ok) {
+      error = "Instrucción inválida (byte " + String((int)at) + ")";
+      return false;
+    }
+    if (op == OP_END) {
+      code.assign(bytes, bytes + length);
+      instructionCount = count;
+      depth = maxOpen;
+      return true;
+    }
+
+    if (open > 0) bodyUsed[open - 1] = true;
+    if (op == OP_LOOP) {
+      bodyUsed[open++] = false;
+      maxOpen = max(maxOpen, open);
+    } else if (op == OP_ENDLOOP) {
+      open--;
+    }
+  }
+
+  error = "Falta OP_END";
+  return false;
+}
+
+void MotionProgram::decode(size_t& pc, ProgramInstruction& instruction) const {
+  const uint8_t* bytes = code.data();
+  size_t length = code.size();
+  uint32_t a = 0, b = 0;
+
+  instruction.op = bytes[pc++];
+  switch (instruction.op) {
+    case OP_MOVE:
+      readVarint(bytes, length, pc, a);
+      a = unzigzag(a);
+      break;
+    case OP_MOVE_TURN:
+      readVarint(bytes, length, pc, a);
+      a = unzigzag(a);
+      readVarint(bytes, length, pc, b);
+      break;
+    case OP_SPEED:
+      readVarint(bytes, length, pc, a);
+      readVarint(bytes, length, pc, b);
+      break;
+    case OP_TURN:
+    case OP_PAUSE:
+    case OP_WAIT:
+    case OP_LOOP:
+      readVarint(bytes, length, pc, a);
+      break;
+  }
+  instruction.a = (int32_t)a;
+  instruction.b = (int32_t)b;
+}
+
+String MotionProgram::getAsJson() const {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  String json = "{";
+  json += "\"bytes\":" + String((uint32_t)code.size()) + ",";
+  json += "\"instructions\":" + String(instructionCount) + ",";
+  json += "\"depth\":" + String(depth) + ",";
+  json += "\"code\":\"";
+  for (uint8_t byte : code) {
+    json += HEX_DIGITS[byte >> 4];
+    json += HEX_DIGITS[byte & 0x0F];
+  }
+  json += "\"}";
+  return json;
+}
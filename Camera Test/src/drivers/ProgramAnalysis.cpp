@@ -0,0 +1,56 @@
+#include "drivers/ProgramAnalysis.h"
+
+// Un bucle no se desenrolla: desde la segunda vuelta el estado (ángulo,
+// velocidades, sentido del juego) se repite y solo la posición se corre,
+// así que basta analizar dos vueltas y extrapolar la segunda. El costo es
+// O(bytes · 2^profundidad), acotado por MAX_PROGRAM_DEPTH.
+size_t analyzeProgramBlock(const MotionProgram& program, size_t pc, ProgramSpeeds& speeds,
+                           SequenceAnalysis& analysis, const ProgramMovementModel& model) {
+  ProgramInstruction instruction;
+  for (;;) {
+    program.decode(pc, instruction);
+    switch (instruction.op) {
+      case OP_END:
+      case OP_ENDLOOP:
+        return pc;
+      case OP_MOVE:
+      case OP_TURN:
+      case OP_MOVE_TURN:
+        model.accumulateProgramMove(analysis, instruction, speeds);
+        break;
+      case OP_PAUSE:
+      case OP_WAIT:
+        // Una espera sin tiempo máximo no suma: el ETA no la incluye
+        analysis.durationUs += (uint64_t)instruction.a * 1000;
+        analysis.lastMoveUs = 0;
+        break;
+      case OP_SPEED:
+        speeds.stepper = instruction.a;
+        speeds.servo = instruction.b;
+        break;
+      case OP_LOOP: {
+        size_t body = pc;
+        pc = analyzeProgramBlock(program, body, speeds, analysis, model);
+        if (instruction.a < 2) break;
+        
+        SequenceAnalysis second = analysis;
+        second.minSteps = analysis.endSteps;
+        second.maxSteps = analysis.endSteps;
+        analyzeProgramBlock(program, body, speeds, second, model);
+        uint64_t passUs = second.durationUs - analysis.durationUs;
+        int64_t shift = (int64_t)second.endSteps - analysis.endSteps;
+        int64_t drift = (int64_t)(instruction.a - 2) * shift;
+        second.minSteps = constrain(min<int64_t>(analysis.minSteps, second.minSteps + min<int64_t>(0, drift)),
+                                    INT32_MIN, INT32_MAX);
+        second.maxSteps = constrain(max<int64_t>(analysis.maxSteps, second.maxSteps + max<int64_t>(0, drift)),
+                                    INT32_MIN, INT32_MAX);
+        second.endSteps = constrain(second.endSteps + drift, INT32_MIN, INT32_MAX);
+        second.durationUs += (uint64_t)(instruction.a - 2) * passUs;
+        analysis = second;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+}
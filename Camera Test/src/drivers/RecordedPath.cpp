@@ -0,0 +1,87 @@
+#include "drivers/RecordedPath.h"
+
+// Zigzag: intercala positivos y negativos para que los deltas chicos de
+// cualquier signo ocupen un solo byte
+static inline uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+RecordedPath::RecordedPath(float mmPerStepValue)
+  : last({0, 0, 0}), pointCount(0), mmPerStep(mmPerStepValue) {
+}
+
+void RecordedPath::writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+uint32_t RecordedPath::readVarint(const std::vector<uint8_t>& in, size_t& offset) {
+  uint32_t value = 0;
+  for (int shift = 0; offset < in.size() && shift < 35; shift += 7) {
+    uint8_t byte = in[offset++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  return value;
+}
+
+// El primer punto se codifica respecto de {0, 0, 0}
+bool RecordedPath::append(const RecordedPoint& point) {
+  if (pointCount > 0 && point.timeMs <= last.timeMs) {
+    return false;
+  }
+  writeVarint(data, point.timeMs - last.timeMs);
+  writeVarint(data, zigzag(point.steps - last.steps));
+  writeVarint(data, zigzag(point.angle - last.angle));
+  last = point;
+  pointCount++;
+  return true;
+}
+
+// Aplica al punto anterior los deltas que empiezan en 'offset'
+void RecordedPath::decode(size_t& offset, RecordedPoint& point) const {
+  point.timeMs += readVarint(data, offset);
+  point.steps += unzigzag(readVarint(data, offset));
+  point.angle += unzigzag(readVarint(data, offset));
+}
+
+void RecordedPath::sample(uint32_t tMs, Cursor& cursor, float& position, float& angle) const {
+  if (pointCount == 0) {
+    position = 0.0f;
+    angle = 90.0f;
+    return;
+  }
+
+  // Primer uso o tiempo hacia atrás: decodificar desde el principio. Los
+  // deltas solo se leen hacia adelante, así que en reversa pasa una vez por
+  // tramo (dentro de un tramo el cursor sirve igual).
+  if (cursor.next == 0 || tMs < cursor.from.timeMs) {
+    cursor.next = 0;
+    cursor.from = {0, 0, 0};
+    decode(cursor.next, cursor.from);
+    cursor.to = cursor.from;
+  }
+  while (tMs >= cursor.to.timeMs && cursor.next < data.size()) {
+    cursor.from = cursor.to;
+    decode(cursor.next, cursor.to);
+  }
+
+  const RecordedPoint& a = cursor.from;
+  const RecordedPoint& b = cursor.to;
+  if (tMs >= b.timeMs || b.timeMs == a.timeMs) {
+    position = b.steps * mmPerStep;
+    angle = b.angle;
+    return;
+  }
+
+  float u = (float)(tMs - a.timeMs) / (b.timeMs - a.timeMs);
+  position = (a.steps + (b.steps - a.steps) * u) * mmPerStep;
+  angle = a.angle + (b.angle - a.angle) * u;
+}
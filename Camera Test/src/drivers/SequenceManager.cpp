@@ -1,314 +1,3498 @@
 #include "drivers/SequenceManager.h"
 #include "drivers/ServoDriver.h"
 #include "drivers/StepperDriver.h"
+#include "TaskConfig.h"
+#include "PowerManager.h"
+#include "EmergencyStop.h"
+#include "Checkpoint.h"
+#include "Log.h"
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
 
-SequenceManager::SequenceManager(ServoDriver* servo, StepperDriver* stepper)
-  : servoDriver(servo), stepperDriver(stepper),
+// Periodo de muestreo de las trayectorias con puntos clave (50 Hz)
+static const uint32_t PATH_CONTROL_PERIOD_MS = 20;
+
+// Copia de una secuencia para el punto de control. Le siguen los registros
+// del pool (el de un generador apunta a su orden en la copia) y los
+// generadores.
+#define SNAPSHOT_VERSION 1
+
+#pragma pack(push, 1)
+struct SnapshotHeader {
+  uint8_t version;
+  char name[SEQUENCE_NAME_LENGTH];
+  uint8_t loop;
+  uint16_t repeatCount;
+  uint16_t count;
+  uint8_t generatorCount;
+};
+#pragma pack(pop)
+
+// Puntos clave o grabada: posiciones absolutas y reloj propio. Movimientos
+// y programas son relativos a donde arrancan.
+static bool isTrajectory(const Sequence& seq) {
+  return seq.type == SEQUENCE_KEYFRAMES || seq.type == SEQUENCE_RECORDED;
+}
+
+SequenceManager::SequenceManager(ServoDriver* servo, StepperDriver* stepper, MotionController* motionController)
+  : servoDriver(servo), stepperDriver(stepper), motion(motionController), pool(nullptr), poolCapacity(0), blockPool(nullptr),
     activeSequenceIndex(-1), isExecuting(false), isPaused(false) {
   executionTask = nullptr;
+  commandQueue = nullptr;
   mutex = nullptr;
+  memset(sequences, 0, sizeof(sequences));
+  memset(generatorUsed, 0, sizeof(generatorUsed));
+  shutterCallback = nullptr;
+  softLimitsEnabled = false;
+  softMinSteps = 0;
+  softMaxSteps = 0;
+  speedCap = 0;
+  feedPercent = 100;
+  driverFeed = false;
+  executionEstimateUs = 0;
+  executionStartMillis = 0;
+  armed = false;
+  armReady = false;
+  goRequested = false;
+  goRequestUs = 0;
+  memset(&armStats, 0, sizeof(armStats));
+  playMode = PLAY_FORWARD;
+  takeStartPending = false;
+  memset(&takeStart, 0, sizeof(takeStart));
+  resumePending = false;
+  resumeIndex = -1;
+  resumePass = 0;
+  resumeRecord = 0;
+  resumeFrame = 0;
+  memset(playlist, 0, sizeof(playlist));
+  playlistCount = 0;
+  playlistLoop = false;
+  playlistActive = false;
+  playlistPosition = 0;
+  prefetchPending = false;
+  playlistEstimateUs = 0;
+  playlistStartMillis = 0;
+  memset(&handoffStats, 0, sizeof(handoffStats));
+  startPending = false;
+  seekPending = false;
+  seekValue = 0;
+  runCount = 0;
+  memset(&controlStats, 0, sizeof(controlStats));
+  publishState();
 }
 
 SequenceManager::~SequenceManager() {
-  stop();
   if (executionTask != nullptr) {
     vTaskDelete(executionTask);
   }
-  if (mutex != nullptr) {
-    vSemaphoreDelete(mutex);
+  if (commandQueue != nullptr) {
+    vQueueDelete(commandQueue);
+  }
+  if (mutex != nullptr) {
+    vSemaphoreDelete(mutex);
+  }
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    delete sequences[i].path;
+    delete sequences[i].recording;
+    delete sequences[i].layers;
+    delete sequences[i].program;
+  }
+  free(pool);
+  free(blockPool);
+}
+
+bool SequenceManager::begin() {
+  mutex = xSemaphoreCreateMutex();
+  if (mutex == nullptr) {
+    LOG_ERROR("❌ SequenceManager: Error creando mutex");
+    return false;
+  }
+  
+  // Un único bloque al arrancar, del tamaño que permita el heap, más los
+  // bloques del análisis: las secuencias nunca vuelven a pedir heap
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t budget = freeHeap > SEQUENCE_POOL_HEAP_RESERVE ? freeHeap - SEQUENCE_POOL_HEAP_RESERVE : 0;
+  budget = min<uint32_t>(budget, ESP.getMaxAllocHeap());
+  uint32_t recordBytes = sizeof(PackedMovement) + sizeof(AnalysisBlock) / ANALYSIS_BLOCK_MOVEMENTS;
+  poolCapacity = budget / recordBytes;
+  poolCapacity = max<uint32_t>(poolCapacity, SEQUENCE_POOL_MOVEMENTS);
+  poolCapacity = min<uint32_t>(poolCapacity, SEQUENCE_POOL_MAX_MOVEMENTS);
+  poolCapacity -= poolCapacity % ANALYSIS_BLOCK_MOVEMENTS;
+  pool = (PackedMovement*)malloc(poolCapacity * sizeof(PackedMovement));
+  blockPool = (AnalysisBlock*)malloc(poolCapacity / ANALYSIS_BLOCK_MOVEMENTS * sizeof(AnalysisBlock));
+  if (pool == nullptr || blockPool == nullptr) {
+    LOG_ERROR("❌ SequenceManager: Error reservando pool de movimientos");
+    return false;
+  }
+  
+  // Ejecutor permanente: arrancar una secuencia no crea tasks
+  commandQueue = xQueueCreate(EXECUTOR_QUEUE_LENGTH, sizeof(ExecutorCommand));
+  if (commandQueue == nullptr) {
+    LOG_ERROR("❌ SequenceManager: Error creando cola de órdenes");
+    return false;
+  }
+  
+  const TaskPlacement& placement = getTaskPlacement(TASK_SEQUENCE);
+  BaseType_t result = xTaskCreatePinnedToCore(
+    executionTaskFunc,
+    "SequenceTask",
+    placement.stackSize,
+    this,
+    placement.priority,
+    &executionTask,
+    placement.core
+  );
+  if (result != pdPASS) {
+    LOG_ERROR("❌ SequenceManager: Error creando task de ejecución");
+    return false;
+  }
+  
+  LOG_INFO("✅ SequenceManager inicializado (pool: %lu movimientos, %lu bytes de %lu libres)",
+           (unsigned long)poolCapacity, (unsigned long)(poolCapacity * recordBytes),
+           (unsigned long)freeHeap);
+  return true;
+}
+
+// ========== Pool de movimientos ==========
+
+bool SequenceManager::isValidIndex(int index) const {
+  return index >= 0 && index < MAX_SEQUENCES && sequences[index].used;
+}
+
+// Un movimiento ocupa su registro más uno de extensión por eje adicional.
+// Devuelve el registro del movimiento 'movementIndex' o -1.
+int SequenceManager::recordIndex(const Sequence& seq, int movementIndex) const {
+  if (movementIndex < 0) return -1;
+  int r = 0;
+  if (seq.analysis.valid && seq.blockCount > 0) {
+    SequenceAnalysis prefix;
+    int number;
+    r = blockPrefix(seq, movementIndex, prefix, number);
+    movementIndex -= number;
+  }
+  for (; r < seq.count; r++) {
+    if (pool[seq.offset + r].flags & MOVE_AXIS_EXT) continue;
+    if (movementIndex-- == 0) return r;
+  }
+  return -1;
+}
+
+int SequenceManager::recordSpan(const Sequence& seq, int record) const {
+  int span = 1;
+  while (record + span < seq.count && (pool[seq.offset + record + span].flags & MOVE_AXIS_EXT)) {
+    span++;
+  }
+  return span;
+}
+
+// Registro del movimiento anterior a 'record' (-1 si es el primero)
+int SequenceManager::previousRecord(const Sequence& seq, int record) const {
+  int r = record - 1;
+  while (r >= 0 && (pool[seq.offset + r].flags & MOVE_AXIS_EXT)) {
+    r--;
+  }
+  return r;
+}
+
+// Último ángulo comandado antes de 'record' en centésimas (ANGLE_KEEP si
+// ninguno): el destino del servo al deshacer ese movimiento
+uint16_t SequenceManager::angleBefore(const Sequence& seq, int record) const {
+  for (int r = previousRecord(seq, record); r >= 0; r = previousRecord(seq, r)) {
+    const PackedMovement& movement = pool[seq.offset + r];
+    if (movement.flags & MOVE_GENERATOR) {
+      const FrameGenerator& generator = generators[movement.steps];
+      if (generator.startAngle >= 0) return generator.endAngle * 100;
+    } else if (movement.angleCdeg != ANGLE_KEEP) {
+      return movement.angleCdeg;
+    }
+  }
+  return ANGLE_KEEP;
+}
+
+// Secuencias ordenadas por offset dentro del pool
+static int sortedByOffset(const Sequence* sequences, int* order) {
+  int n = 0;
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (sequences[i].used && sequences[i].capacity > 0) order[n++] = i;
+  }
+  std::sort(order, order + n, [sequences](int a, int b) {
+    return sequences[a].offset < sequences[b].offset;
+  });
+  return n;
+}
+
+bool SequenceManager::allocateRange(uint16_t capacity, uint16_t& offset) {
+  if (capacity == 0) {
+    offset = 0;
+    return true;
+  }
+  
+  // First-fit entre los tramos ocupados
+  int order[MAX_SEQUENCES];
+  int n = sortedByOffset(sequences, order);
+  uint32_t cursor = 0;
+  for (int i = 0; i <= n; i++) {
+    uint32_t end = (i < n) ? sequences[order[i]].offset : poolCapacity;
+    if (end - cursor >= capacity) {
+      offset = cursor;
+      return true;
+    }
+    if (i < n) cursor = sequences[order[i]].offset + sequences[order[i]].capacity;
+  }
+  return false;
+}
+
+uint32_t SequenceManager::largestFreeRange() const {
+  int order[MAX_SEQUENCES];
+  int n = sortedByOffset(sequences, order);
+  uint32_t cursor = 0;
+  uint32_t largest = 0;
+  for (int i = 0; i <= n; i++) {
+    uint32_t end = (i < n) ? sequences[order[i]].offset : poolCapacity;
+    largest = max(largest, end - cursor);
+    if (i < n) cursor = sequences[order[i]].offset + sequences[order[i]].capacity;
+  }
+  return largest;
+}
+
+// Junta todos los tramos al principio del pool. El ejecutor accede por
+// (secuencia, índice) con el mutex tomado, así que es seguro en ejecución.
+void SequenceManager::compactPool() {
+  int order[MAX_SEQUENCES];
+  int n = sortedByOffset(sequences, order);
+  uint16_t cursor = 0;
+  for (int i = 0; i < n; i++) {
+    Sequence& seq = sequences[order[i]];
+    if (seq.offset != cursor) {
+      memmove(&pool[cursor], &pool[seq.offset], seq.count * sizeof(PackedMovement));
+      memmove(&blockPool[cursor / ANALYSIS_BLOCK_MOVEMENTS], sequenceBlocks(seq),
+              seq.blockCount * sizeof(AnalysisBlock));
+      seq.offset = cursor;
+    }
+    cursor += seq.capacity;
+  }
+}
+
+// Duplica la capacidad de una secuencia llena, reubicándola si hace falta
+bool SequenceManager::growSequence(Sequence& seq) {
+  uint32_t wanted = max<uint32_t>(seq.capacity * 2, ANALYSIS_BLOCK_MOVEMENTS);
+  wanted = min<uint32_t>(wanted, poolCapacity);
+  if (wanted <= seq.capacity) {
+    return false;
+  }
+  
+  // Liberar temporalmente el tramo propio para poder reutilizarlo
+  uint16_t oldOffset = seq.offset;
+  uint16_t oldCapacity = seq.capacity;
+  seq.capacity = 0;
+  
+  uint16_t newOffset;
+  if (!allocateRange(wanted, newOffset)) {
+    // Reintentar tras compactar (el tramo propio queda donde esté)
+    seq.capacity = oldCapacity;
+    compactPool();
+    oldOffset = seq.offset;
+    seq.capacity = 0;
+    if (!allocateRange(wanted, newOffset)) {
+      seq.capacity = oldCapacity;
+      return false;
+    }
+  }
+  
+  memmove(&pool[newOffset], &pool[oldOffset], seq.count * sizeof(PackedMovement));
+  memmove(&blockPool[newOffset / ANALYSIS_BLOCK_MOVEMENTS], &blockPool[oldOffset / ANALYSIS_BLOCK_MOVEMENTS],
+          seq.blockCount * sizeof(AnalysisBlock));
+  seq.offset = newOffset;
+  seq.capacity = wanted;
+  return true;
+}
+
+bool SequenceManager::packMovement(const Movement& movement, PackedMovement& packed) {
+  long steps = stepperDriver->mmToSteps(movement.horizontalDistance, MM_PER_REVOLUTION); // 8mm por revolución
+  if (movement.pauseAfter < 0 || (uint32_t)movement.pauseAfter > MAX_PAUSE_MS) {
+    return false;
+  }
+  if (movement.angle > 180) {
+    return false;
+  }
+  
+  packed.steps = steps;
+  packed.angleCdeg = movement.angle < 0 ? ANGLE_KEEP : movement.angle * 100;
+  packed.pause = (movement.pauseAfter + PAUSE_UNIT_MS / 2) / PAUSE_UNIT_MS;
+  packed.speed = constrain(movement.horizontalSpeed, 0, 100);
+  packed.angleSpeed = constrain(movement.angleSpeed, 0, 100);
+  packed.flags = movement.simultaneous ? MOVE_SIMULTANEOUS : 0;
+  return true;
+}
+
+Movement SequenceManager::unpackMovement(const PackedMovement& packed) const {
+  Movement m;
+  m.horizontalDistance = stepperDriver->stepsToMm(packed.steps, MM_PER_REVOLUTION);
+  m.horizontalSpeed = packed.speed;
+  m.angle = packed.angleCdeg == ANGLE_KEEP ? -1 : (packed.angleCdeg + 50) / 100;
+  m.angleSpeed = packed.angleSpeed;
+  m.simultaneous = packed.flags & MOVE_SIMULTANEOUS;
+  m.pauseAfter = packed.pause * PAUSE_UNIT_MS;
+  return m;
+}
+
+// El movimiento del registro 'record' con los ejes de sus 'span - 1'
+// registros de extensión
+Movement SequenceManager::unpackRecords(const Sequence& seq, int record, int span) const {
+  Movement m = unpackMovement(pool[seq.offset + record]);
+  for (int k = 1; k < span; k++) {
+    const PackedMovement& ext = pool[seq.offset + record + k];
+    MotionAxis* axis = motion != nullptr ? motion->getAxis(ext.angleSpeed) : nullptr;
+    if (axis == nullptr) continue;
+    m.axes[ext.angleSpeed].active = true;
+    m.axes[ext.angleSpeed].value = axis->toUserUnits(ext.steps);
+    m.axes[ext.angleSpeed].speed = ext.speed;
+  }
+  return m;
+}
+
+// ========== Análisis ==========
+
+static uint64_t roundUpTo(uint64_t value, uint64_t period) {
+  return (value + period - 1) / period * period;
+}
+
+// Periodos de sondeo con que el ejecutor espera a los drivers
+static const uint64_t WAIT_POLL_US = 10000;
+static const uint64_t SIMULTANEOUS_POLL_US = 50000;
+// Tramo máximo de una pausa sin mirar la cola (light sleep)
+static const uint32_t IDLE_SLICE_MS = 250;
+
+void SequenceManager::resetAnalysis(SequenceAnalysis& analysis) const {
+  memset(&analysis, 0, sizeof(analysis));
+  analysis.valid = true;
+  analysis.firstAngle = -1;
+  analysis.lastAngle = -1;
+  analysis.minAngle = -1;
+  analysis.maxAngle = -1;
+}
+
+static void includeAngle(SequenceAnalysis& analysis, int angle) {
+  if (analysis.firstAngle < 0) {
+    analysis.firstAngle = angle;
+    analysis.minAngle = angle;
+    analysis.maxAngle = angle;
+  }
+  analysis.minAngle = min<int>(analysis.minAngle, angle);
+  analysis.maxAngle = max<int>(analysis.maxAngle, angle);
+  analysis.lastAngle = angle;
+}
+
+// Mismo modelo que executeMovement(). Con fromAngle < 0 (primer ángulo de la
+// secuencia) el servo se considera ya en posición: esa llegada se estima
+// aparte con el ángulo real al ejecutar (startupDurationUs).
+uint64_t SequenceManager::movementDurationUs(const PackedMovement& movement, int fromAngle, uint64_t* moveUs) const {
+  int stepperSpeed = map(movement.speed, 0, 100, 100, 2000);
+  uint64_t stepperUs = stepperDriver->estimateMoveMicros(movement.steps, stepperSpeed);
+  uint64_t servoUs = 0;
+  if (movement.angleCdeg != ANGLE_KEEP && fromAngle >= 0) {
+    int angle = (movement.angleCdeg + 50) / 100;
+    servoUs = (uint64_t)servoDriver->estimateMoveMs(fromAngle, angle, movement.angleSpeed) * 1000;
+  }
+  
+  uint64_t us;
+  if (movement.flags & MOVE_SIMULTANEOUS) {
+    us = roundUpTo(max(stepperUs, servoUs), SIMULTANEOUS_POLL_US);
+    if (moveUs != nullptr) *moveUs = max(stepperUs, servoUs);
+  } else {
+    if (moveUs != nullptr) *moveUs = 0;
+    us = roundUpTo(stepperUs, WAIT_POLL_US) + roundUpTo(servoUs, WAIT_POLL_US);
+  }
+  return us + (uint64_t)movement.pause * PAUSE_UNIT_MS * 1000;
+}
+
+// Recorre los frames como executeGenerator(), sin mover nada
+uint64_t SequenceManager::generatorDurationUs(const FrameGenerator& generator, int fromAngle) const {
+  int stepperSpeed = map(generator.speed, 0, 100, 100, 2000);
+  long totalSteps = stepperDriver->mmToSteps(generator.distance, MM_PER_REVOLUTION);
+  long doneSteps = 0;
+  int angle = fromAngle;
+  uint64_t total = 0;
+  
+  for (uint32_t frame = 0; frame < generator.frames; frame++) {
+    float u = generator.frames > 1 ? (float)frame / (generator.frames - 1) : 1.0f;
+    float eased = applyEasing(generator.easing, u);
+    long targetSteps = lroundf(eased * totalSteps);
+    uint64_t moveUs = stepperDriver->estimateMoveMicros(targetSteps - doneSteps, stepperSpeed);
+    doneSteps = targetSteps;
+    
+    if (generator.startAngle >= 0) {
+      int target = lroundf(generator.startAngle + (generator.endAngle - generator.startAngle) * eased);
+      if (angle >= 0) {
+        moveUs = max(moveUs, (uint64_t)servoDriver->estimateMoveMs(angle, target, generator.angleSpeed) * 1000);
+      }
+      angle = target;
+    }
+    
+    uint64_t frameUs = roundUpTo(moveUs, WAIT_POLL_US) +
+                       ((uint64_t)generator.settleMs + generator.exposureMs) * 1000;
+    if (frame + 1 < generator.frames) {
+      frameUs = max(frameUs, (uint64_t)generator.intervalMs * 1000);
+    }
+    total += frameUs;
+  }
+  return total;
+}
+
+// Tiempo de recuperación de juego si el tramo invierte el sentido anterior
+static uint64_t reversalUs(int8_t& lastDir, long delta, uint64_t takeUpUs) {
+  if (delta == 0) {
+    return 0;
+  }
+  int8_t dir = delta > 0 ? 1 : -1;
+  bool reversed = lastDir != 0 && dir != lastDir;
+  lastDir = dir;
+  return reversed ? takeUpUs : 0;
+}
+
+void SequenceManager::accumulateMovement(SequenceAnalysis& analysis, const PackedMovement& movement) const {
+  if (movement.flags & MOVE_AXIS_EXT) {
+    // Los ejes adicionales arrancan juntos: en simultáneo se suman al tramo
+    // de stepper y servo, en secuencial forman un tramo propio al final
+    uint64_t axisUs = motion != nullptr ?
+      motion->estimateMoveMicros(movement.angleSpeed, movement.steps,
+                                 motion->rateForSpeed(movement.angleSpeed, movement.speed)) : 0;
+    uint64_t poll = (movement.flags & MOVE_SIMULTANEOUS) ? SIMULTANEOUS_POLL_US : WAIT_POLL_US;
+    analysis.durationUs -= roundUpTo(analysis.lastMoveUs, poll);
+    analysis.lastMoveUs = max(analysis.lastMoveUs, axisUs);
+    analysis.durationUs += roundUpTo(analysis.lastMoveUs, poll);
+    return;
+  }
+  
+  if (movement.flags & MOVE_GENERATOR) {
+    const FrameGenerator& generator = generators[movement.steps];
+    analysis.durationUs += generatorDurationUs(generator, analysis.lastAngle);
+    analysis.durationUs += reversalUs(analysis.lastStepDir, (generator.distance > 0) - (generator.distance < 0),
+                                      stepperDriver->getTakeUpMicros());
+    if (generator.startAngle >= 0) {
+      analysis.durationUs += reversalUs(analysis.lastAngleDir, generator.endAngle - generator.startAngle,
+                                        (uint64_t)servoDriver->getTakeUpMs() * 1000);
+    }
+    
+    // Todas las curvas son monótonas: la envolvente está en los extremos
+    int32_t endSteps = analysis.endSteps + stepperDriver->mmToSteps(generator.distance, MM_PER_REVOLUTION);
+    analysis.minSteps = min(analysis.minSteps, endSteps);
+    analysis.maxSteps = max(analysis.maxSteps, endSteps);
+    analysis.endSteps = endSteps;
+    
+    if (generator.startAngle >= 0) {
+      includeAngle(analysis, generator.startAngle);
+      includeAngle(analysis, generator.endAngle);
+    }
+    if (generator.distance != 0) {
+      analysis.peakStepRate = max<uint32_t>(analysis.peakStepRate, map(generator.speed, 0, 100, 100, 2000));
+    }
+    analysis.lastMoveUs = 0;
+    return;
+  }
+  
+  analysis.durationUs += movementDurationUs(movement, analysis.lastAngle, &analysis.lastMoveUs);
+  analysis.durationUs += reversalUs(analysis.lastStepDir, movement.steps, stepperDriver->getTakeUpMicros());
+  if (movement.angleCdeg != ANGLE_KEEP && analysis.lastAngle >= 0) {
+    analysis.durationUs += reversalUs(analysis.lastAngleDir, (movement.angleCdeg + 50) / 100 - analysis.lastAngle,
+                                      (uint64_t)servoDriver->getTakeUpMs() * 1000);
+  }
+  
+  // Suma de prefijos de la posición y su envolvente
+  analysis.endSteps += movement.steps;
+  analysis.minSteps = min(analysis.minSteps, analysis.endSteps);
+  analysis.maxSteps = max(analysis.maxSteps, analysis.endSteps);
+  
+  if (movement.angleCdeg != ANGLE_KEEP) {
+    includeAngle(analysis, (movement.angleCdeg + 50) / 100);
+  }
+  if (movement.steps != 0) {
+    analysis.peakStepRate = max<uint32_t>(analysis.peakStepRate, map(movement.speed, 0, 100, 100, 2000));
+  }
+}
+
+void SequenceManager::analyzeSequence(const Sequence& seq) const {
+  if (isTrajectory(seq)) {
+    analyzePath(seq);
+    return;
+  }
+  if (seq.type == SEQUENCE_PROGRAM) {
+    resetAnalysis(seq.analysis);
+    if (seq.program != nullptr) {
+      ProgramSpeeds speeds;
+      analyzeProgramBlock(*seq.program, 0, speeds, seq.analysis, *this);
+    }
+    return;
+  }
+  
+  // Bloques de ANALYSIS_BLOCK_MOVEMENTS: entran siempre en los lugares
+  // de la secuencia porque count <= capacity
+  resetAnalysis(seq.analysis);
+  AnalysisBlock* blocks = sequenceBlocks(seq);
+  int b = -1;
+  for (int r = 0; r < seq.count; r++) {
+    const PackedMovement& movement = pool[seq.offset + r];
+    bool head = !(movement.flags & MOVE_AXIS_EXT);
+    if (b < 0 || (head && blocks[b].movements == ANALYSIS_BLOCK_MOVEMENTS)) {
+      if (b >= 0) appendSummary(seq.analysis, blocks[b].summary);
+      b++;
+      blocks[b].record = r;
+      blocks[b].records = 0;
+      blocks[b].movements = 0;
+      startSummary(blocks[b].summary, seq.analysis);
+    }
+    blocks[b].records++;
+    if (head) blocks[b].movements++;
+    accumulateMovement(blocks[b].summary, movement);
+  }
+  if (b >= 0) appendSummary(seq.analysis, blocks[b].summary);
+  seq.blockCount = b + 1;
+}
+
+// Un bloque arranca con el ángulo y los sentidos con que terminó el
+// anterior: de ellos dependen la duración del servo y el juego
+void SequenceManager::startSummary(SequenceAnalysis& summary, const SequenceAnalysis& before) const {
+  resetAnalysis(summary);
+  summary.lastAngle = before.lastAngle;
+  summary.lastStepDir = before.lastStepDir;
+  summary.lastAngleDir = before.lastAngleDir;
+}
+
+// Suma un bloque al análisis acumulado hasta su inicio. Da lo mismo que
+// acumular sus movimientos uno a uno.
+void SequenceManager::appendSummary(SequenceAnalysis& analysis, const SequenceAnalysis& summary) {
+  analysis.durationUs += summary.durationUs;
+  analysis.minSteps = min(analysis.minSteps, analysis.endSteps + summary.minSteps);
+  analysis.maxSteps = max(analysis.maxSteps, analysis.endSteps + summary.maxSteps);
+  analysis.endSteps += summary.endSteps;
+  if (summary.firstAngle >= 0) {
+    if (analysis.firstAngle < 0) {
+      analysis.firstAngle = summary.firstAngle;
+      analysis.minAngle = summary.minAngle;
+      analysis.maxAngle = summary.maxAngle;
+    }
+    analysis.minAngle = min(analysis.minAngle, summary.minAngle);
+    analysis.maxAngle = max(analysis.maxAngle, summary.maxAngle);
+  }
+  analysis.lastAngle = summary.lastAngle;
+  analysis.peakStepRate = max(analysis.peakStepRate, summary.peakStepRate);
+  analysis.lastMoveUs = summary.lastMoveUs;
+  analysis.lastStepDir = summary.lastStepDir;
+  analysis.lastAngleDir = summary.lastAngleDir;
+}
+
+AnalysisBlock* SequenceManager::sequenceBlocks(const Sequence& seq) const {
+  return &blockPool[seq.offset / ANALYSIS_BLOCK_MOVEMENTS];
+}
+
+// Agrega el registro recién guardado al último bloque o abre uno nuevo.
+// Llamar antes de acumularlo en el análisis de la secuencia.
+void SequenceManager::appendToBlocks(Sequence& seq, const PackedMovement& packed) {
+  AnalysisBlock* blocks = sequenceBlocks(seq);
+  bool head = !(packed.flags & MOVE_AXIS_EXT);
+  int b = seq.blockCount - 1;
+  if (b < 0 || (head && blocks[b].movements >= ANALYSIS_BLOCK_MOVEMENTS)) {
+    if (seq.blockCount >= seq.capacity / ANALYSIS_BLOCK_MOVEMENTS) {
+      seq.analysis.valid = false;
+      return;
+    }
+    b++;
+    blocks[b].record = seq.count - 1;
+    blocks[b].records = 0;
+    blocks[b].movements = 0;
+    startSummary(blocks[b].summary, seq.analysis);
+    seq.blockCount++;
+  }
+  blocks[b].records++;
+  if (head) blocks[b].movements++;
+  accumulateMovement(blocks[b].summary, packed);
+}
+
+// Tras reemplazar registros desde 'record': ajusta el bloque que los
+// contiene (lo borra si quedó vacío, lo parte si creció de más), corre el
+// inicio de los siguientes y recalcula solo los bloques afectados
+void SequenceManager::spliceBlocks(Sequence& seq, int record, int recordDelta, int movementDelta) {
+  if (!seq.analysis.valid || seq.blockCount == 0) {
+    seq.analysis.valid = false;
+    return;
+  }
+  
+  AnalysisBlock* blocks = sequenceBlocks(seq);
+  int b = seq.blockCount - 1;
+  while (b > 0 && blocks[b].record > record) {
+    b--;
+  }
+  blocks[b].records += recordDelta;
+  blocks[b].movements += movementDelta;
+  for (int k = b + 1; k < seq.blockCount; k++) {
+    blocks[k].record += recordDelta;
+  }
+  
+  int through = b;
+  if (blocks[b].movements == 0) {
+    memmove(&blocks[b], &blocks[b + 1], (seq.blockCount - b - 1) * sizeof(AnalysisBlock));
+    seq.blockCount--;
+  } else if (blocks[b].movements > 2 * ANALYSIS_BLOCK_MOVEMENTS) {
+    if (seq.blockCount >= seq.capacity / ANALYSIS_BLOCK_MOVEMENTS) {
+      seq.analysis.valid = false;
+      return;
+    }
+    // Partir por la mitad en el inicio de un movimiento
+    int half = blocks[b].movements / 2;
+    int r = blocks[b].record;
+    for (int heads = 0; ; r++) {
+      if (!(pool[seq.offset + r].flags & MOVE_AXIS_EXT) && heads++ == half) break;
+    }
+    memmove(&blocks[b + 2], &blocks[b + 1], (seq.blockCount - b - 1) * sizeof(AnalysisBlock));
+    seq.blockCount++;
+    blocks[b + 1].record = r;
+    blocks[b + 1].records = blocks[b].record + blocks[b].records - r;
+    blocks[b + 1].movements = blocks[b].movements - half;
+    blocks[b].records = r - blocks[b].record;
+    blocks[b].movements = half;
+    through = b + 1;
+  }
+  refreshBlocks(seq, b, through);
+}
+
+// Recalcula los bloques [from, through] y los siguientes mientras cambie
+// el estado con que termina el anterior; el resto solo se suma
+void SequenceManager::refreshBlocks(const Sequence& seq, int from, int through) const {
+  AnalysisBlock* blocks = sequenceBlocks(seq);
+  SequenceAnalysis analysis;
+  resetAnalysis(analysis);
+  for (int b = 0; b < from; b++) {
+    appendSummary(analysis, blocks[b].summary);
+  }
+  
+  bool changed = true;
+  for (int b = from; b < seq.blockCount; b++) {
+    if (b <= through || changed) {
+      SequenceAnalysis before = blocks[b].summary;
+      startSummary(blocks[b].summary, analysis);
+      for (int r = 0; r < blocks[b].records; r++) {
+        accumulateMovement(blocks[b].summary, pool[seq.offset + blocks[b].record + r]);
+      }
+      const SequenceAnalysis& after = blocks[b].summary;
+      changed = after.lastAngle != before.lastAngle || after.lastStepDir != before.lastStepDir ||
+                after.lastAngleDir != before.lastAngleDir;
+    }
+    appendSummary(analysis, blocks[b].summary);
+  }
+  seq.analysis = analysis;
+}
+
+// Análisis de los movimientos anteriores a 'movementIndex' y su primer
+// registro, desde el bloque que lo contiene (análisis válido)
+int SequenceManager::blockPrefix(const Sequence& seq, int movementIndex, SequenceAnalysis& prefix,
+                                 int& number) const {
+  const AnalysisBlock* blocks = sequenceBlocks(seq);
+  resetAnalysis(prefix);
+  number = 0;
+  int b = 0;
+  for (; b + 1 < seq.blockCount && number + blocks[b].movements <= movementIndex; b++) {
+    appendSummary(prefix, blocks[b].summary);
+    number += blocks[b].movements;
+  }
+  return seq.blockCount > 0 ? blocks[b].record : 0;
+}
+
+void SequenceManager::analyzePath(const Sequence& seq) const {
+  if (seq.type == SEQUENCE_KEYFRAMES && seq.path != nullptr) {
+    analyzeTrajectory(*seq.path, seq.playbackPercent, seq.layers, seq.analysis);
+  } else if (seq.type == SEQUENCE_RECORDED && seq.recording != nullptr) {
+    analyzeTrajectory(*seq.recording, seq.playbackPercent, seq.layers, seq.analysis);
+  } else {
+    resetAnalysis(seq.analysis);
+  }
+}
+
+// Los movimientos de un programa cuestan lo mismo que los del pool
+void SequenceManager::accumulateProgramMove(SequenceAnalysis& analysis, const ProgramInstruction& instruction,
+                                            const ProgramSpeeds& speeds) const {
+  accumulateMovement(analysis, programMovement(instruction, speeds));
+}
+
+// Muestrea la trayectoria con el mismo periodo, escala y capas que
+// executePath()
+template <typename Path>
+void SequenceManager::analyzeTrajectory(const Path& path, uint16_t percent,
+                                        const MotionLayers* layers,
+                                        SequenceAnalysis& analysis) const {
+  resetAnalysis(analysis);
+  if (!path.isCompiled()) {
+    return;
+  }
+  
+  uint32_t durationMs = path.getDurationMs();
+  typename Path::Cursor cursor = typename Path::Cursor();
+  float position, angle;
+  path.sample(0, cursor, position, angle);
+  long last = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+  applyLayers(layers, 0, durationMs, last, angle);
+  analysis.minSteps = last;
+  analysis.maxSteps = last;
+  includeAngle(analysis, (int)(angle + 0.5f));
+  
+  // Reloj de la trayectoria en centésimas de ms para escalas no enteras
+  uint64_t pathCenti = 0;
+  uint32_t elapsedMs = 0;
+  uint32_t ticks = 0;
+  while (elapsedMs < durationMs) {
+    pathCenti += PATH_CONTROL_PERIOD_MS * percent;
+    elapsedMs = pathCenti / 100;
+    ticks++;
+    path.sample(elapsedMs, cursor, position, angle);
+    
+    long target = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+    applyLayers(layers, elapsedMs, durationMs, target, angle);
+    uint32_t rate = (labs(target - last) * 1000 + PATH_CONTROL_PERIOD_MS - 1) / PATH_CONTROL_PERIOD_MS;
+    analysis.peakStepRate = max(analysis.peakStepRate, rate);
+    analysis.minSteps = min<int32_t>(analysis.minSteps, target);
+    analysis.maxSteps = max<int32_t>(analysis.maxSteps, target);
+    includeAngle(analysis, (int)(angle + 0.5f));
+    last = target;
+  }
+  
+  analysis.endSteps = last;
+  analysis.durationUs = (uint64_t)ticks * PATH_CONTROL_PERIOD_MS * 1000;
+}
+
+// Suma las capas en 'tMs' del reloj de la trayectoria a una muestra ya
+// pasada a pasos. El ángulo queda dentro del rango del servo.
+void SequenceManager::applyLayers(const MotionLayers* layers, uint32_t tMs, uint32_t totalMs,
+                                  long& steps, float& angle) const {
+  if (layers == nullptr || layers->getCount() == 0) {
+    return;
+  }
+  int32_t railSteps, panCdeg;
+  layers->evaluate(tMs, totalMs, railSteps, panCdeg);
+  steps += railSteps;
+  angle = constrain(angle + panCdeg * 0.01f, 0.0f, 180.0f);
+}
+
+// Pose inicial en pasos, con las capas. 'fromEnd': la de la reproducción
+// en reversa.
+bool SequenceManager::pathStartPose(const Sequence& seq, long& steps, float& angle, bool fromEnd) const {
+  float position;
+  uint32_t durationMs;
+  if (seq.type == SEQUENCE_KEYFRAMES && seq.path != nullptr && seq.path->isCompiled()) {
+    KeyframePath::Cursor cursor = 0;
+    durationMs = seq.path->getDurationMs();
+    seq.path->sample(fromEnd ? durationMs : 0, cursor, position, angle);
+  } else if (seq.type == SEQUENCE_RECORDED && seq.recording != nullptr && seq.recording->isCompiled()) {
+    RecordedPath::Cursor cursor;
+    durationMs = seq.recording->getDurationMs();
+    seq.recording->sample(fromEnd ? durationMs : 0, cursor, position, angle);
+  } else {
+    return false;
+  }
+  steps = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+  applyLayers(seq.layers, fromEnd ? durationMs : 0, durationMs, steps, angle);
+  return true;
+}
+
+// Llegada al primer ángulo (y a la pose inicial en trayectorias) desde una
+// posición y un ángulo dados (ángulo negativo = desconocido). Si ese primer
+// giro es simultáneo con el stepper es una cota superior.
+uint64_t SequenceManager::transitionUs(const Sequence& seq, long fromSteps, int fromAngle) const {
+  uint64_t us = 0;
+  if (seq.analysis.firstAngle >= 0 && fromAngle >= 0) {
+    uint32_t ms = servoDriver->estimateMoveMs(fromAngle, seq.analysis.firstAngle, -1);
+    us += roundUpTo((uint64_t)ms * 1000, WAIT_POLL_US);
+  }
+  long steps;
+  float angle;
+  if (pathStartPose(seq, steps, angle)) {
+    long distance = steps - fromSteps;
+    us += roundUpTo(stepperDriver->estimateMoveMicros(distance, -1), WAIT_POLL_US);
+  }
+  return us;
+}
+
+// Desde el estado actual de los drivers
+uint64_t SequenceManager::startupDurationUs(const Sequence& seq) const {
+  return transitionUs(seq, stepperDriver->getCurrentPosition(), servoDriver->getCurrentAngle());
+}
+
+// ========== Gestión de secuencias ==========
+
+int SequenceManager::createSequence(const String& name, SequenceType type, uint16_t capacity) {
+  if (type != SEQUENCE_MOVEMENTS) {
+    capacity = 0;
+  }
+  // Tramos en múltiplos de bloque (ver AnalysisBlock)
+  uint32_t rounded = (capacity + ANALYSIS_BLOCK_MOVEMENTS - 1) / ANALYSIS_BLOCK_MOVEMENTS * ANALYSIS_BLOCK_MOVEMENTS;
+  if (rounded > poolCapacity) {
+    LOG_ERROR("❌ Secuencia '%s' rechazada: %d movimientos no entran en el pool", name.c_str(), capacity);
+    return -1;
+  }
+  capacity = rounded;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  int index = -1;
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (!sequences[i].used) {
+      index = i;
+      break;
+    }
+  }
+  
+  uint16_t offset = 0;
+  bool fits = index >= 0 && allocateRange(capacity, offset);
+  if (index >= 0 && !fits) {
+    compactPool();
+    fits = allocateRange(capacity, offset);
+  }
+  
+  if (!fits) {
+    xSemaphoreGive(mutex);
+    LOG_ERROR("❌ Secuencia '%s' rechazada: sin espacio para %d movimientos",
+                  name.c_str(), capacity);
+    return -1;
+  }
+  
+  Sequence& seq = sequences[index];
+  seq.used = true;
+  strlcpy(seq.name, name.c_str(), sizeof(seq.name));
+  seq.type = type;
+  seq.offset = offset;
+  seq.capacity = capacity;
+  seq.count = 0;
+  seq.path = nullptr;
+  seq.recording = nullptr;
+  seq.layers = nullptr;
+  seq.program = nullptr;
+  seq.playbackPercent = 100;
+  seq.loop = false;
+  seq.repeatCount = 1;
+  seq.version = 1;
+  resetAnalysis(seq.analysis);
+  seq.blockCount = 0;
+  
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("✅ Secuencia '%s' creada (index: %d, capacidad: %d)", name.c_str(), index, capacity);
+  return index;
+}
+
+bool SequenceManager::deleteSequence(int index) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(index) || isSequenceBusy(index)) {
+    xSemaphoreGive(mutex);
+    return false;
+  }
+  
+  releaseGenerators(&pool[sequences[index].offset], sequences[index].count);
+  delete sequences[index].path;
+  delete sequences[index].recording;
+  delete sequences[index].layers;
+  delete sequences[index].program;
+  memset(&sequences[index], 0, sizeof(Sequence));
+  
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+// Registro del movimiento más uno de extensión por cada eje adicional que
+// se mueve. Devuelve la cantidad de registros o 0 si no es válido.
+int SequenceManager::packRecords(const Movement& movement, PackedMovement* records) {
+  if (!packMovement(movement, records[0])) {
+    return 0;
+  }
+  
+  int recordCount = 1;
+  for (int axis = 0; axis < MAX_MOTION_AXES; axis++) {
+    const AxisMove& move = movement.axes[axis];
+    if (!move.active) continue;
+    if (motion == nullptr || motion->getAxis(axis) == nullptr) {
+      LOG_ERROR("❌ Eje adicional %d inexistente", axis);
+      return 0;
+    }
+    PackedMovement& ext = records[recordCount++];
+    ext.steps = motion->getAxis(axis)->toAxisUnits(move.value);
+    ext.angleCdeg = 0;
+    ext.pause = 0;
+    ext.speed = constrain(move.speed, 0, 100);
+    ext.angleSpeed = axis;
+    ext.flags = MOVE_AXIS_EXT | (records[0].flags & MOVE_SIMULTANEOUS);
+  }
+  return recordCount;
+}
+
+bool SequenceManager::addMovement(int sequenceIndex, const Movement& movement) {
+  PackedMovement records[1 + MAX_MOTION_AXES];
+  int recordCount = packRecords(movement, records);
+  if (recordCount == 0) {
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool added = true;
+  int before = isValidIndex(sequenceIndex) ? sequences[sequenceIndex].count : 0;
+  for (int i = 0; i < recordCount && added; i++) {
+    added = appendPacked(sequenceIndex, records[i]);
+  }
+  if (!added && isValidIndex(sequenceIndex)) {
+    // Sin lugar para todos los registros: deshacer los agregados
+    sequences[sequenceIndex].count = before;
+    sequences[sequenceIndex].analysis.valid = false;
+  }
+  if (added) sequences[sequenceIndex].version++;
+  xSemaphoreGive(mutex);
+  
+  if (added) {
+    LOG_DEBUG("✅ Movimiento agregado a secuencia %d", sequenceIndex);
+  }
+  return added;
+}
+
+bool SequenceManager::appendPacked(int sequenceIndex, const PackedMovement& packed) {
+  if (!isValidIndex(sequenceIndex) || sequences[sequenceIndex].type != SEQUENCE_MOVEMENTS) {
+    return false;
+  }
+  
+  Sequence& seq = sequences[sequenceIndex];
+  if (seq.count >= seq.capacity && !growSequence(seq)) {
+    LOG_ERROR("❌ Secuencia %d llena y sin espacio en el pool", sequenceIndex);
+    return false;
+  }
+  
+  pool[seq.offset + seq.count] = packed;
+  seq.count++;
+  if (seq.analysis.valid) appendToBlocks(seq, packed);
+  if (seq.analysis.valid) accumulateMovement(seq.analysis, packed);
+  return true;
+}
+
+bool SequenceManager::addGenerator(int sequenceIndex, const FrameGenerator& generator) {
+  if (generator.frames == 0 || generator.startAngle > 180 || generator.endAngle > 180) {
+    return false;
+  }
+  if ((generator.startAngle < 0) != (generator.endAngle < 0)) {
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  int slot = -1;
+  for (int i = 0; i < MAX_GENERATORS; i++) {
+    if (!generatorUsed[i]) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    xSemaphoreGive(mutex);
+    LOG_ERROR("❌ No quedan generadores libres");
+    return false;
+  }
+  
+  PackedMovement packed;
+  packed.steps = slot;
+  packed.angleCdeg = ANGLE_KEEP;
+  packed.pause = 0;
+  packed.speed = generator.speed;
+  packed.angleSpeed = generator.angleSpeed;
+  packed.flags = MOVE_GENERATOR;
+  
+  generators[slot] = generator;
+  bool added = appendPacked(sequenceIndex, packed);
+  generatorUsed[slot] = added;
+  if (added) sequences[sequenceIndex].version++;
+  
+  xSemaphoreGive(mutex);
+  
+  if (added) {
+    LOG_INFO("✅ Generador de %lu frames agregado a secuencia %d",
+                  (unsigned long)generator.frames, sequenceIndex);
+  }
+  return added;
+}
+
+void SequenceManager::releaseGenerators(const PackedMovement* movements, int count) {
+  for (int i = 0; i < count; i++) {
+    if (movements[i].flags & MOVE_GENERATOR) {
+      generatorUsed[movements[i].steps] = false;
+    }
+  }
+}
+
+// ========== Edición in situ ==========
+
+int SequenceManager::movementCount(const Sequence& seq) const {
+  int count = 0;
+  if (seq.analysis.valid && seq.blockCount > 0) {
+    const AnalysisBlock* blocks = sequenceBlocks(seq);
+    for (int b = 0; b < seq.blockCount; b++) count += blocks[b].movements;
+    return count;
+  }
+  for (int r = 0; r < seq.count; r++) {
+    if (!(pool[seq.offset + r].flags & MOVE_AXIS_EXT)) count++;
+  }
+  return count;
+}
+
+// Llamar con el mutex tomado. 'movements' exige una secuencia de movimientos.
+SequenceEditResult SequenceManager::checkEditable(int sequenceIndex, uint32_t expectedVersion,
+                                                  bool movements) const {
+  if (!isValidIndex(sequenceIndex)) return EDIT_NOT_FOUND;
+  const Sequence& seq = sequences[sequenceIndex];
+  if (expectedVersion != 0 && seq.version != expectedVersion) return EDIT_STALE;
+  if (movements && seq.type != SEQUENCE_MOVEMENTS) return EDIT_INVALID;
+  if (isSequenceBusy(sequenceIndex)) return EDIT_BUSY;
+  return EDIT_OK;
+}
+
+// Asegura lugar para 'extra' registros más (puede reubicar la secuencia)
+bool SequenceManager::reserveRecords(Sequence& seq, int extra) {
+  while (seq.count + extra > seq.capacity) {
+    if (!growSequence(seq)) return false;
+  }
+  return true;
+}
+
+// Reemplaza 'removeCount' registros desde 'record' por 'records'. Solo
+// mueve la cola de la secuencia; el lugar ya tiene que estar reservado.
+void SequenceManager::spliceRecords(Sequence& seq, int record, int removeCount,
+                                    const PackedMovement* records, int insertCount) {
+  PackedMovement* base = &pool[seq.offset];
+  int movementDelta = 0;
+  for (int r = 0; r < removeCount; r++) {
+    if (!(base[record + r].flags & MOVE_AXIS_EXT)) movementDelta--;
+  }
+  for (int r = 0; r < insertCount; r++) {
+    if (!(records[r].flags & MOVE_AXIS_EXT)) movementDelta++;
+  }
+  if (insertCount != removeCount) {
+    memmove(&base[record + insertCount], &base[record + removeCount],
+            (seq.count - record - removeCount) * sizeof(PackedMovement));
+  }
+  if (insertCount > 0) {
+    memcpy(&base[record], records, insertCount * sizeof(PackedMovement));
+  }
+  seq.count += insertCount - removeCount;
+  spliceBlocks(seq, record, insertCount - removeCount, movementDelta);
+}
+
+SequenceEditResult SequenceManager::updateMovement(int sequenceIndex, int movementIndex,
+                                                   const Movement& movement, uint32_t expectedVersion) {
+  PackedMovement records[1 + MAX_MOTION_AXES];
+  int recordCount = packRecords(movement, records);
+  if (recordCount == 0) {
+    return EDIT_INVALID;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, true);
+  if (result != EDIT_OK) {
+    xSemaphoreGive(mutex);
+    return result;
+  }
+  
+  Sequence& seq = sequences[sequenceIndex];
+  int record = recordIndex(seq, movementIndex);
+  if (record < 0) {
+    result = EDIT_NOT_FOUND;
+  } else if (!reserveRecords(seq, recordCount - recordSpan(seq, record))) {
+    result = EDIT_NO_SPACE;
+  } else {
+    releaseGenerators(&pool[seq.offset + record], 1);
+    spliceRecords(seq, record, recordSpan(seq, record), records, recordCount);
+    seq.version++;
+  }
+  
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+SequenceEditResult SequenceManager::insertMovement(int sequenceIndex, int movementIndex,
+                                                   const Movement& movement, uint32_t expectedVersion) {
+  PackedMovement records[1 + MAX_MOTION_AXES];
+  int recordCount = packRecords(movement, records);
+  if (recordCount == 0) {
+    return EDIT_INVALID;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, true);
+  if (result != EDIT_OK) {
+    xSemaphoreGive(mutex);
+    return result;
+  }
+  
+  // Insertar en la posición 'cantidad' es agregar al final
+  Sequence& seq = sequences[sequenceIndex];
+  int record = movementIndex == movementCount(seq) ? seq.count : recordIndex(seq, movementIndex);
+  if (record < 0) {
+    result = EDIT_NOT_FOUND;
+  } else if (!reserveRecords(seq, recordCount)) {
+    result = EDIT_NO_SPACE;
+  } else {
+    spliceRecords(seq, record, 0, records, recordCount);
+    seq.version++;
+  }
+  
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+SequenceEditResult SequenceManager::moveMovement(int sequenceIndex, int from, int to,
+                                                 uint32_t expectedVersion) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, true);
+  if (result != EDIT_OK) {
+    xSemaphoreGive(mutex);
+    return result;
+  }
+  
+  Sequence& seq = sequences[sequenceIndex];
+  int record = recordIndex(seq, from);
+  if (record < 0 || to < 0 || to >= movementCount(seq)) {
+    xSemaphoreGive(mutex);
+    return EDIT_NOT_FOUND;
+  }
+  
+  if (from != to) {
+    // Sacar el movimiento con sus extensiones y volver a insertarlo: el
+    // destino se cuenta sobre la lista sin él
+    PackedMovement moved[1 + MAX_MOTION_AXES];
+    int span = min(recordSpan(seq, record), 1 + MAX_MOTION_AXES);
+    memcpy(moved, &pool[seq.offset + record], span * sizeof(PackedMovement));
+    spliceRecords(seq, record, span, nullptr, 0);
+    
+    int target = recordIndex(seq, to);
+    spliceRecords(seq, target < 0 ? seq.count : target, 0, moved, span);
+    seq.version++;
+  }
+  
+  xSemaphoreGive(mutex);
+  return EDIT_OK;
+}
+
+SequenceEditResult SequenceManager::removeMovement(int sequenceIndex, int movementIndex,
+                                                   uint32_t expectedVersion) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, true);
+  if (result != EDIT_OK) {
+    xSemaphoreGive(mutex);
+    return result;
+  }
+  
+  Sequence& seq = sequences[sequenceIndex];
+  int record = recordIndex(seq, movementIndex);
+  if (record < 0) {
+    result = EDIT_NOT_FOUND;
+  } else {
+    releaseGenerators(&pool[seq.offset + record], 1);
+    spliceRecords(seq, record, recordSpan(seq, record), nullptr, 0);
+    seq.version++;
+  }
+  
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+SequenceEditResult SequenceManager::setRepeat(int sequenceIndex, bool loop, int repeatCount,
+                                              uint32_t expectedVersion) {
+  if (repeatCount < 1 || repeatCount > 1000) {
+    return EDIT_INVALID;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, false);
+  if (result == EDIT_OK) {
+    sequences[sequenceIndex].loop = loop;
+    sequences[sequenceIndex].repeatCount = repeatCount;
+    sequences[sequenceIndex].version++;
+  }
+  
+  xSemaphoreGive(mutex);
+  return result;
+}
+
+SequenceEditResult SequenceManager::clearSequence(int sequenceIndex, uint32_t expectedVersion) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  // Lo que se libera acá puede estar usándolo el ejecutor o la playlist
+  SequenceEditResult result = checkEditable(sequenceIndex, expectedVersion, false);
+  if (result != EDIT_OK) {
+    xSemaphoreGive(mutex);
+    return result;
+  }
+  
+  Sequence& seq = sequences[sequenceIndex];
+  releaseGenerators(&pool[seq.offset], seq.count);
+  seq.count = 0;
+  if (seq.path != nullptr) {
+    seq.path->clear();
+  }
+  delete seq.recording;
+  seq.recording = nullptr;
+  delete seq.program;
+  seq.program = nullptr;
+  resetAnalysis(seq.analysis);
+  seq.blockCount = 0;
+  seq.version++;
+  
+  xSemaphoreGive(mutex);
+  return EDIT_OK;
+}
+
+bool SequenceManager::setKeyframes(int sequenceIndex, const std::vector<Keyframe>& keyframes,
+                                   InterpolationType interpolation) {
+  // Se construye fuera del mutex y se reemplaza de una vez
+  KeyframePath* path = new KeyframePath();
+  path->setInterpolation(interpolation);
+  for (const Keyframe& k : keyframes) {
+    if (!path->addKeyframe(k)) {
+      LOG_ERROR("❌ Puntos clave con tiempos no crecientes");
+      delete path;
+      return false;
+    }
+  }
+  if (!path->compile()) {
+    LOG_ERROR("❌ Se necesitan al menos 2 puntos clave");
+    delete path;
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex) || sequences[sequenceIndex].type != SEQUENCE_KEYFRAMES ||
+      isSequenceBusy(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    delete path;
+    return false;
+  }
+  
+  delete sequences[sequenceIndex].path;
+  sequences[sequenceIndex].path = path;
+  sequences[sequenceIndex].version++;
+  analyzePath(sequences[sequenceIndex]);
+  
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("✅ Trayectoria cargada en secuencia %d (%d puntos, %lums)",
+                sequenceIndex, (int)keyframes.size(), (unsigned long)path->getDurationMs());
+  return true;
+}
+
+bool SequenceManager::setRecording(int sequenceIndex, RecordedPath* recording) {
+  if (recording == nullptr || !recording->isCompiled()) {
+    LOG_ERROR("❌ La grabación necesita al menos 2 puntos");
+    delete recording;
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex) || sequences[sequenceIndex].type != SEQUENCE_RECORDED ||
+      isSequenceBusy(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    delete recording;
+    return false;
+  }
+  
+  delete sequences[sequenceIndex].recording;
+  sequences[sequenceIndex].recording = recording;
+  sequences[sequenceIndex].version++;
+  analyzePath(sequences[sequenceIndex]);
+  
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("✅ Grabación cargada en secuencia %d (%lu puntos, %u bytes, %lums)",
+                sequenceIndex, (unsigned long)recording->getPointCount(),
+                (unsigned)recording->getByteSize(), (unsigned long)recording->getDurationMs());
+  return true;
+}
+
+bool SequenceManager::setProgram(int sequenceIndex, MotionProgram* program) {
+  if (program == nullptr || !program->isLoaded()) {
+    delete program;
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex) || sequences[sequenceIndex].type != SEQUENCE_PROGRAM ||
+      isSequenceBusy(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    delete program;
+    return false;
+  }
+  
+  delete sequences[sequenceIndex].program;
+  sequences[sequenceIndex].program = program;
+  sequences[sequenceIndex].version++;
+  analyzeSequence(sequences[sequenceIndex]);
+  
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("✅ Programa cargado en secuencia %d (%u instrucciones, %u bytes)",
+                sequenceIndex, (unsigned)program->getInstructionCount(), (unsigned)program->getByteSize());
+  return true;
+}
+
+bool SequenceManager::setPlaybackSpeed(int sequenceIndex, int percent) {
+  if (percent < 10 || percent > 400) {
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex) || !isTrajectory(sequences[sequenceIndex]) ||
+      isSequenceBusy(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    return false;
+  }
+  
+  sequences[sequenceIndex].playbackPercent = percent;
+  sequences[sequenceIndex].version++;
+  analyzePath(sequences[sequenceIndex]);
+  
+  xSemaphoreGive(mutex);
+  return true;
+}
+
+bool SequenceManager::setLayers(int sequenceIndex, const MotionLayer* layers, int count) {
+  // Se compilan fuera del mutex y se reemplazan de una vez
+  MotionLayers* compiled = nullptr;
+  if (count > 0) {
+    compiled = new MotionLayers();
+    if (!compiled->set(layers, count, stepperDriver->mmToSteps(100.0, MM_PER_REVOLUTION) / 100.0f)) {
+      LOG_ERROR("❌ Capas de movimiento inválidas");
+      delete compiled;
+      return false;
+    }
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex) || !isTrajectory(sequences[sequenceIndex]) ||
+      isSequenceBusy(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    delete compiled;
+    return false;
+  }
+  
+  delete sequences[sequenceIndex].layers;
+  sequences[sequenceIndex].layers = compiled;
+  sequences[sequenceIndex].version++;
+  analyzePath(sequences[sequenceIndex]);
+  
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("🌊 Secuencia %d: %d capas de movimiento", sequenceIndex, count);
+  return true;
+}
+
+void SequenceManager::invalidateAnalyses() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (sequences[i].used && !isSequenceBusy(i)) {
+      sequences[i].analysis.valid = false;
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+// ========== Ejecutor ==========
+
+// Task permanente: en reposo bloqueada en la cola; EXEC_START la pone a
+// ejecutar y durante la ejecución atiende las demás órdenes en sus esperas
+void SequenceManager::executionTaskFunc(void* parameter) {
+  SequenceManager* manager = static_cast<SequenceManager*>(parameter);
+  ExecutorCommand command;
+  int64_t stopUs = 0;
+  
+  for (;;) {
+    if (xQueueReceive(manager->commandQueue, &command, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    // Fuera de una ejecución solo cuentan EXEC_START y un EXEC_STOP que se
+    // adelantó (va al frente de la cola) a un arranque anterior a él
+    if (command.op == EXEC_STOP) {
+      stopUs = command.stampUs;
+    } else if (command.op == EXEC_START && stopUs >= command.stampUs) {
+      xSemaphoreTake(manager->mutex, portMAX_DELAY);
+      manager->startPending = false;
+      manager->playlistActive = false;
+      xSemaphoreGive(manager->mutex);
+      LOG_INFO("⏹️ Arranque cancelado");
+    } else if (command.op == EXEC_START) {
+      manager->runExecution(command);
+    }
+  }
+}
+
+void SequenceManager::runExecution(const ExecutorCommand& start) {
+  // Suscribir task al watchdog mientras dura la ejecución
+  esp_task_wdt_add(NULL);
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  int index = start.index;
+  bool returning = start.flags & EXEC_FLAG_RETURN;
+  startPending = false;
+  isExecuting = returning || isValidIndex(index);
+  isPaused = false;
+  seekPending = false;
+  armed = isExecuting && (start.flags & EXEC_FLAG_ARM);
+  armReady = false;
+  goRequested = false;
+  playlistActive = isExecuting && (start.flags & EXEC_FLAG_PLAYLIST);
+  playlistPosition = 0;
+  prefetchPending = false;
+  playMode = (start.flags & EXEC_FLAG_PINGPONG) ? PLAY_PINGPONG :
+             (start.flags & EXEC_FLAG_REVERSE) ? PLAY_REVERSE : PLAY_FORWARD;
+  takeStartPending = !returning;
+  runCount++;
+  publishState();
+  xSemaphoreGive(mutex);
+  
+  if (isExecuting && returning) {
+    // La vuelta rápida va a la velocidad máxima, sin override de avance
+    runReturn();
+  } else if (isExecuting) {
+    applyDriverFeed(true);
+    
+    // Armada: pose inicial y espera del go antes del primer movimiento. El
+    // punto de control de la armada se escribe antes del go (prepareArmed).
+    bool wasArmed = armed;
+    bool started = !wasArmed || prepareArmed(index);
+    if (started && !wasArmed) beginCheckpointRun(index);
+    if (started) powerBeginRun();
+    
+    if (started && playlistActive) {
+      runPlaylist();
+    } else if (started) {
+      const Sequence& seq = sequences[index];
+      runSequence(index, seq.repeatCount, seq.loop);
+    }
+    
+    if (wasArmed) {
+      stepperDriver->cancelFirstStep();
+      stepperDriver->setHoldLock(false);
+      servoDriver->setHoldLock(false);
+    }
+    LOG_INFO("✅ Secuencia completada");
+  }
+  powerEndRun();
+  checkpointEndRun();
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  resumePending = false;
+  armed = false;
+  armReady = false;
+  playlistActive = false;
+  prefetchPending = false;
+  isExecuting = false;
+  isPaused = false;
+  publishState();
+  xSemaphoreGive(mutex);
+  applyDriverFeed(false);
+  
+  esp_task_wdt_delete(NULL);
+}
+
+// Encola una orden sin bloquear. Las urgentes (stop, go) pasan al frente.
+bool SequenceManager::postCommand(ExecutorOp op, uint32_t value, bool urgent) {
+  if (commandQueue == nullptr) {
+    return false;
+  }
+  ExecutorCommand command = { (uint8_t)op, 0, 0, value, esp_timer_get_time() };
+  BaseType_t queued = urgent ? xQueueSendToFront(commandQueue, &command, 0)
+                             : xQueueSend(commandQueue, &command, 0);
+  if (queued != pdTRUE) {
+    controlStats.dropped++;
+    LOG_WARN("⚠️ Cola del ejecutor llena: orden descartada");
+    return false;
+  }
+  return true;
+}
+
+// Espera del ejecutor: bloquea en la cola hasta 'waitMs' y aplica todas las
+// órdenes pendientes. Una orden despierta a la task en el acto, sin esperar
+// al sondeo de los motores.
+void SequenceManager::serviceCommands(uint32_t waitMs) {
+  ExecutorCommand command;
+  TickType_t wait = pdMS_TO_TICKS(waitMs);
+  while (xQueueReceive(commandQueue, &command, wait) == pdTRUE) {
+    handleCommand(command);
+    wait = 0;
+  }
+}
+
+void SequenceManager::handleCommand(const ExecutorCommand& command) {
+  uint32_t latency = esp_timer_get_time() - command.stampUs;
+  controlStats.commands++;
+  controlStats.lastUs = latency;
+  if (latency > controlStats.maxUs) controlStats.maxUs = latency;
+  
+  switch (command.op) {
+    case EXEC_START:
+      // startExecution() no encola un segundo arranque; por si acaso
+      LOG_WARN("⚠️ Ya hay una secuencia en ejecución");
+      break;
+    case EXEC_PAUSE:
+      if (!isPaused) {
+        isPaused = true;
+        decelerateMotors();
+        LOG_INFO("⏸️ Secuencia pausada");
+      }
+      break;
+    case EXEC_RESUME:
+      if (isPaused) {
+        isPaused = false;
+        LOG_INFO("▶️ Secuencia reanudada");
+      }
+      break;
+    case EXEC_STOP:
+      isExecuting = false;
+      isPaused = false;
+      decelerateMotors();
+      LOG_INFO("⏹️ Secuencia detenida");
+      break;
+    case EXEC_SEEK:
+      // El movimiento en curso frena; el bucle del ejecutor salta
+      seekPending = true;
+      seekValue = command.value;
+      decelerateMotors();
+      LOG_INFO("⏩ Salto a %lu", (unsigned long)command.value);
+      break;
+    case EXEC_GO:
+      if (armed && !goRequested) {
+        goRequestUs = command.stampUs;
+        goRequested = true;
+      }
+      break;
+  }
+  publishState();
+}
+
+// Estado, secuencia, entrada de la playlist y número de ejecución en una
+// sola escritura de 32 bits
+void SequenceManager::publishState() {
+  ExecutorState state = !isExecuting ? EXEC_IDLE :
+                        armed ? EXEC_ARMED :
+                        isPaused ? EXEC_PAUSED : EXEC_RUNNING;
+  executorWord = (uint32_t)state |
+                 ((uint32_t)(activeSequenceIndex & 0xFF) << 8) |
+                 ((uint32_t)(playlistPosition & 0xFF) << 16) |
+                 ((uint32_t)runCount << 24);
+}
+
+ExecutorStatus SequenceManager::getExecutorStatus() const {
+  uint32_t word = executorWord;
+  ExecutorStatus status;
+  status.state = (ExecutorState)(word & 0xFF);
+  status.sequence = (word >> 8) & 0xFF;
+  if (status.sequence == 0xFF) status.sequence = -1;
+  status.entry = (word >> 16) & 0xFF;
+  status.run = word >> 24;
+  return status;
+}
+
+// vTaskDelayUntil atendiendo órdenes mientras tanto
+void SequenceManager::sleepUntil(TickType_t& lastWake, TickType_t period) {
+  TickType_t wake = lastWake + period;
+  for (;;) {
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) <= 0) break;
+    serviceCommands((wake - now) * portTICK_PERIOD_MS);
+  }
+  lastWake = wake;
+}
+
+// Generador recorrido al revés: mismo camino de B a A. La curva espejada de
+// una aceleración es un frenado (1 - f(1 - u)), así que IN y OUT se cambian.
+static FrameGenerator mirrorGenerator(const FrameGenerator& generator) {
+  FrameGenerator mirrored = generator;
+  mirrored.distance = -generator.distance;
+  if (generator.startAngle >= 0) {
+    mirrored.startAngle = generator.endAngle;
+    mirrored.endAngle = generator.startAngle;
+  }
+  if (generator.easing == EASE_IN) mirrored.easing = EASE_OUT;
+  else if (generator.easing == EASE_OUT) mirrored.easing = EASE_IN;
+  return mirrored;
+}
+
+// Ejecuta las pasadas de una secuencia en la task actual. Devuelve false si
+// se detuvo.
+bool SequenceManager::runSequence(int sequenceIndex, int passes, bool loop) {
+  // La cabecera vive en una tabla fija; los movimientos se leen uno a uno
+  // con el mutex porque el pool puede compactarse durante la ejecución
+  const Sequence& seq = sequences[sequenceIndex];
+  LOG_INFO("▶️ Ejecutando secuencia: %s", seq.name);
+  
+  // Retomada tras un corte: la primera pasada sigue desde el punto de control
+  int firstPass = 0;
+  int resumeAt = -1;
+  uint32_t firstFrame = 0;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (resumePending && resumeIndex == sequenceIndex) {
+    firstPass = resumePass;
+    resumeAt = resumeRecord;
+    firstFrame = resumeFrame;
+  }
+  resumePending = false;
+  xSemaphoreGive(mutex);
+  
+  for (int repeat = firstPass; repeat < passes || loop; repeat++) {
+    bool reverse = passReversed(repeat);
+    
+    // Las trayectorias aplican el avance en su reloj, no en los drivers
+    if (seq.type == SEQUENCE_KEYFRAMES && seq.path != nullptr) {
+      applyDriverFeed(false);
+      executePath(*seq.path, seq.playbackPercent, seq.layers, reverse);
+      applyDriverFeed(true);
+    } else if (seq.type == SEQUENCE_RECORDED && seq.recording != nullptr) {
+      applyDriverFeed(false);
+      executePath(*seq.recording, seq.playbackPercent, seq.layers, reverse);
+      applyDriverFeed(true);
+    } else if (seq.type == SEQUENCE_PROGRAM && seq.program != nullptr) {
+      executeProgram(*seq.program);
+    } else {
+      markTakeStart();
+    }
+    
+    // En reversa se recorre desde el último registro hacia atrás
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    int i = reverse ? previousRecord(seq, seq.count) : 0;
+    int firstNumber = 1;
+    if (resumeAt >= 0) {
+      for (int r = 0; r < resumeAt; r += recordSpan(seq, r)) firstNumber++;
+      i = resumeAt;
+      resumeAt = -1;
+    }
+    xSemaphoreGive(mutex);
+    
+    for (int number = firstNumber; ; number++) {
+      // Resetear watchdog cada movimiento
+      esp_task_wdt_reset();
+      
+      // Verificar pausa o si se detuvo
+      if (!waitWhilePaused()) {
+        break;
+      }
+      
+      // El movimiento y sus extensiones de ejes adicionales
+      xSemaphoreTake(mutex, portMAX_DELAY);
+      if (seekPending && seq.type == SEQUENCE_MOVEMENTS) {
+        seekPending = false;
+        int record = recordIndex(seq, seekValue);
+        if (record >= 0) {
+          i = record;
+          number = seekValue + 1;
+          firstFrame = 0;
+        } else {
+          LOG_WARN("⚠️ Movimiento %lu fuera de rango", (unsigned long)seekValue);
+        }
+      }
+      int count = seq.count;
+      PackedMovement movement;
+      PackedMovement axes[MAX_MOTION_AXES];
+      FrameGenerator generator;
+      int axisCount = 0;
+      int next = count;
+      if (i >= 0 && i < count) {
+        movement = pool[seq.offset + i];
+        if (movement.flags & MOVE_GENERATOR) generator = generators[movement.steps];
+        int span = recordSpan(seq, i);
+        axisCount = min(span - 1, MAX_MOTION_AXES);
+        memcpy(axes, &pool[seq.offset + i + 1], axisCount * sizeof(PackedMovement));
+        next = i + span;
+        if (reverse) {
+          // Deshacer el movimiento: vuelve al ángulo anterior y espera la
+          // pausa que en la ida se hacía en esa misma pose
+          next = previousRecord(seq, i);
+          movement.angleCdeg = angleBefore(seq, i);
+          movement.pause = next >= 0 ? pool[seq.offset + next].pause : 0;
+        }
+      }
+      xSemaphoreGive(mutex);
+      
+      if (i < 0 || i >= count) {
+        break;
+      }
+      
+      // Punto desde donde seguir si se corta la energía una vez que los
+      // motores llegan (solo ejecuciones reanudables)
+      LOG_DEBUG("📍 Movimiento %d", number);
+      if (movement.flags & MOVE_GENERATOR) {
+        checkpointProgress(repeat, i, firstFrame);
+        executeGenerator(reverse ? mirrorGenerator(generator) : generator, firstFrame);
+        if (reverse && !seekPending) holdPause(movement.pause);
+      } else {
+        checkpointProgress(repeat, next, 0);
+        powerBeginFrame();
+        executeMovement(movement, axes, axisCount, reverse);
+        powerEndFrame();
+      }
+      firstFrame = 0;
+      i = next;
+    }
+    
+    if (!isExecuting) {
+      return false;
+    }
+    
+    if (loop) {
+      LOG_INFO("🔄 Repitiendo secuencia (loop)...");
+    }
+  }
+  return isExecuting;
+}
+
+// Recorre la playlist sin salir de la task. En el empalme solo queda
+// verificar los límites desde la posición real (O(1) con el análisis en
+// caché): el análisis de la entrada siguiente ya se hizo en prefetchNext()
+// durante las esperas de la actual.
+void SequenceManager::runPlaylist() {
+  playlistStartMillis = millis();
+  int64_t finishedUs = 0;
+  
+  do {
+    for (int entry = 0; entry < playlistCount && isExecuting; entry++) {
+      xSemaphoreTake(mutex, portMAX_DELAY);
+      int index = playlist[entry].sequence;
+      int passes = playlist[entry].repeat;
+      const Sequence& seq = sequences[index];
+      String reason = "secuencia borrada";
+      bool allowed = seq.used;
+      if (allowed) {
+        // Editada durante la entrada anterior (o sin tiempo para precargar)
+        if (!seq.analysis.valid) {
+          analyzeSequence(seq);
+          if (finishedUs != 0) handoffStats.prefetchMisses++;
+        }
+        allowed = checkLimits(seq, stepperDriver->getCurrentPosition(), passes, false, reason);
+      }
+      if (allowed) {
+        playlistPosition = entry;
+        activeSequenceIndex = index;
+        seekPending = false;
+        executionEstimateUs = startupDurationUs(seq) + seq.analysis.durationUs * passes;
+        executionStartMillis = millis();
+        prefetchPending = entry + 1 < playlistCount || playlistLoop;
+      }
+      xSemaphoreGive(mutex);
+      
+      if (!allowed) {
+        LOG_ERROR("❌ Playlist detenida en la entrada %d: %s", entry + 1, reason.c_str());
+        isExecuting = false;
+        return;
+      }
+      publishState();
+      
+      if (finishedUs != 0) {
+        uint32_t gapUs = esp_timer_get_time() - finishedUs;
+        handoffStats.count++;
+        handoffStats.lastUs = gapUs;
+        if (gapUs > handoffStats.maxUs) handoffStats.maxUs = gapUs;
+      }
+      
+      LOG_INFO("📜 Playlist %d/%d", entry + 1, playlistCount);
+      if (!runSequence(index, passes, false)) {
+        return;
+      }
+      finishedUs = esp_timer_get_time();
+    }
+    
+    if (playlistLoop && isExecuting) {
+      LOG_INFO("🔄 Repitiendo playlist (loop)...");
+    }
+  } while (playlistLoop && isExecuting);
+}
+
+// Analiza la entrada siguiente de la playlist una sola vez por entrada. Se
+// llama desde las esperas del ejecutor, mientras los motores se mueven solos.
+void SequenceManager::prefetchNext() {
+  if (!prefetchPending) {
+    return;
+  }
+  prefetchPending = false;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  int entry = playlistPosition + 1 < playlistCount ? playlistPosition + 1 : 0;
+  const Sequence& next = sequences[playlist[entry].sequence];
+  if (next.used && !next.analysis.valid) {
+    analyzeSequence(next);
+  }
+  xSemaphoreGive(mutex);
+}
+
+// 'mirrored': el movimiento se deshace (reproducción en reversa). Los
+// desplazamientos cambian de signo y el secuencial invierte el orden de los
+// ejes; el llamador ya puso el ángulo y la pausa de la pose anterior.
+void SequenceManager::executeMovement(const PackedMovement& movement, const PackedMovement* axes, int axisCount,
+                                      bool mirrored) {
+  bool simultaneous = movement.flags & MOVE_SIMULTANEOUS;
+  int sign = mirrored ? -1 : 1;
+  
+  // Convertir velocidad de 0-100% a steps/segundo
+  MoveTargets targets;
+  targets.reverseOrder = mirrored;
+  targets.steps = stepperDriver->getCurrentPosition() + sign * movement.steps;
+  targets.stepperSpeed = map(movement.speed, 0, 100, 100, 2000);
+  targets.angle = movement.angleCdeg != ANGLE_KEEP ? (movement.angleCdeg + 50) / 100 : -1;
+  targets.angleSpeed = movement.angleSpeed;
+  targets.axisCount = 0;
+  for (int i = 0; i < axisCount; i++) {
+    MotionAxis* axis = motion != nullptr ? motion->getAxis(axes[i].angleSpeed) : nullptr;
+    if (axis == nullptr) continue;
+    int n = targets.axisCount++;
+    targets.axisIndex[n] = axes[i].angleSpeed;
+    targets.axisTarget[n] = axis->getPosition() + sign * axes[i].steps;
+    targets.axisRate[n] = motion->rateForSpeed(axes[i].angleSpeed, axes[i].speed);
+  }
+  
+  LOG_DEBUG(simultaneous ? "⚙️ Movimiento simultáneo" : "⚙️ Movimiento secuencial");
+  if (!driveTo(targets, simultaneous)) {
+    return;
+  }
+  
+  // Pausa después del movimiento (un salto la descarta)
+  if (!seekPending) {
+    checkpointSettled();
+    holdPause(movement.pause);
+  }
+}
+
+void SequenceManager::holdPause(uint16_t pause) {
+  if (pause == 0) {
+    return;
+  }
+  uint32_t pauseMs = feedScaled(pause * PAUSE_UNIT_MS);
+  LOG_DEBUG("⏸️ Pausa: %lums", (unsigned long)pauseMs);
+  waitFor(pauseMs);
+}
+
+// Espera 'remaining' ms atendiendo la cola y lo descuenta a medida que
+// pasa. Devuelve false en cuanto hay stop, pausa o salto pendiente, con lo
+// que falta en 'remaining'. Con la cola vacía duerme en tramos de
+// IDLE_SLICE_MS, así una orden que llega durante el light sleep espera
+// como mucho un tramo.
+bool SequenceManager::idleFor(uint32_t& remaining) {
+  uint32_t last = millis();
+  for (;;) {
+    serviceCommands(0);
+    uint32_t now = millis();
+    uint32_t waited = now - last;
+    last = now;
+    remaining = waited >= remaining ? 0 : remaining - waited;
+    if (!isExecuting || isPaused || seekPending) {
+      return false;
+    }
+    if (remaining == 0) {
+      return true;
+    }
+    esp_task_wdt_reset();
+    uint32_t slice = min<uint32_t>(remaining, IDLE_SLICE_MS);
+    bool slept = uxQueueMessagesWaiting(commandQueue) == 0 &&
+                 powerCanSleep(remaining) && powerSleepSlice(slice);
+    if (!slept) {
+      serviceCommands(slice);
+    }
+  }
+}
+
+// Espera 'ms' enteros: una pausa la congela y al reanudar sigue con lo
+// que faltaba. Devuelve false si hubo stop o salto.
+bool SequenceManager::waitFor(uint32_t ms) {
+  uint32_t remaining = ms;
+  while (!idleFor(remaining)) {
+    if (!waitWhilePaused() || seekPending) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Pasada 'pass' (desde 0) en reversa según el modo de la ejecución
+bool SequenceManager::passReversed(int pass) const {
+  return playMode == PLAY_REVERSE || (playMode == PLAY_PINGPONG && (pass & 1));
+}
+
+// Registra la pose al empezar la primera pasada de la ejecución (en las
+// trayectorias, ya en su pose inicial): destino de rapidReturn()
+void SequenceManager::markTakeStart() {
+  if (!takeStartPending) {
+    return;
+  }
+  takeStartPending = false;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  takeStart.valid = true;
+  takeStart.sequence = activeSequenceIndex;
+  takeStart.steps = stepperDriver->getCurrentPosition();
+  takeStart.angle = servoDriver->getCurrentAngle();
+  takeStart.axisCount = motion != nullptr ? min(motion->getAxisCount(), MAX_MOTION_AXES) : 0;
+  for (int i = 0; i < takeStart.axisCount; i++) {
+    MotionAxis* axis = motion->getAxis(i);
+    takeStart.axisPosition[i] = axis != nullptr ? axis->getPosition() : 0;
+  }
+  xSemaphoreGive(mutex);
+}
+
+// Solo las secuencias de movimientos hacia adelante y fuera de la playlist
+// se pueden retomar tras un corte; las demás ejecuciones guardan la pose
+void SequenceManager::beginCheckpointRun(int sequenceIndex) {
+  std::vector<uint8_t> snapshot;
+  bool resumable = !playlistActive && playMode == PLAY_FORWARD &&
+                   exportSnapshot(sequenceIndex, snapshot, CHECKPOINT_SNAPSHOT_BYTES);
+  checkpointBeginRun(resumable ? sequenceIndex : -1, snapshot.data(), snapshot.size());
+}
+
+// Espera la reanudación atendiendo la cola: EXEC_RESUME y EXEC_STOP la
+// cortan en el acto. Devuelve false si la secuencia se detuvo.
+bool SequenceManager::waitWhilePaused() {
+  serviceCommands(0);
+  while (isPaused && isExecuting) {
+    esp_task_wdt_reset();
+    serviceCommands(100);
+  }
+  return isExecuting;
+}
+
+bool SequenceManager::motorsBusy(bool withAxes) const {
+  return stepperDriver->getIsMoving() || servoDriver->getIsMoving() ||
+         stepperDriver->getQueuedCommands() > 0 || servoDriver->getQueuedCommands() > 0 ||
+         (withAxes && !motion->isIdle());
+}
+
+void SequenceManager::decelerateMotors() {
+  stepperDriver->decelerateStop();
+  servoDriver->decelerateStop();
+  if (motion != nullptr) {
+    motion->decelerateAll();
+  }
+}
+
+// Lleva cada motor a su objetivo absoluto. EXEC_PAUSE y EXEC_STOP frenan
+// los motores con rampa desde donde estén; tras una pausa se retoma lo que
+// falta y tras un salto se abandona. 'pollMs' es el sondeo de la espera
+// simultánea (las órdenes no esperan al sondeo). Devuelve false si la
+// secuencia se detuvo.
+bool SequenceManager::driveTo(const MoveTargets& targets, bool simultaneous, uint32_t pollMs) {
+  bool firstPass = true;
+  
+  while (waitWhilePaused()) {
+    long steps = targets.steps - stepperDriver->getCurrentPosition();
+    // El primer comando siempre se envía: conecta el servo aunque ya esté ahí
+    bool moveServo = targets.angle >= 0 &&
+                     (firstPass || targets.angle != servoDriver->getCurrentAngle());
+    
+    if (simultaneous) {
+      // Iniciar movimientos sin esperar
+      if (steps != 0 && targets.rapid) {
+        stepperDriver->rapidTo(targets.steps, targets.stepperSpeed, false);
+      } else if (steps != 0) {
+        stepperDriver->moveRelative(steps, targets.stepperSpeed, false);
+      }
+      if (moveServo) {
+        servoDriver->moveTo(targets.angle, targets.angleSpeed, false);
+      }
+      for (int i = 0; i < targets.axisCount; i++) {
+        MotionAxis* axis = motion->getAxis(targets.axisIndex[i]);
+        motion->queueMove(targets.axisIndex[i], targets.axisTarget[i] - axis->getPosition(), targets.axisRate[i]);
+      }
+      
+      // Esperar a que todos terminen (tiempo libre para precargar)
+      while (motorsBusy(targets.axisCount > 0)) {
+        prefetchNext();
+        serviceCommands(pollMs);
+      }
+    } else {
+      // Stepper, servo y ejes adicionales (todos juntos), uno tras otro; en
+      // orden inverso al deshacer un movimiento
+      for (int n = 0; n < 3; n++) {
+        int phase = targets.reverseOrder ? 2 - n : n;
+        if (n > 0 && (isPaused || seekPending || !isExecuting)) {
+          break;
+        }
+        
+        if (phase == 0 && steps != 0) {
+          stepperDriver->moveRelative(steps, targets.stepperSpeed, false);
+          while (stepperDriver->getIsMoving() || stepperDriver->getQueuedCommands() > 0) {
+            prefetchNext();
+            serviceCommands(WAIT_POLL_US / 1000);
+          }
+        } else if (phase == 1 && moveServo) {
+          servoDriver->moveTo(targets.angle, targets.angleSpeed, false);
+          while (servoDriver->getIsMoving() || servoDriver->getQueuedCommands() > 0) {
+            prefetchNext();
+            serviceCommands(WAIT_POLL_US / 1000);
+          }
+        } else if (phase == 2 && targets.axisCount > 0) {
+          for (int i = 0; i < targets.axisCount; i++) {
+            MotionAxis* axis = motion->getAxis(targets.axisIndex[i]);
+            motion->queueMove(targets.axisIndex[i], targets.axisTarget[i] - axis->getPosition(), targets.axisRate[i]);
+          }
+          while (!motion->isIdle()) {
+            serviceCommands(WAIT_POLL_US / 1000);
+          }
+        }
+      }
+    }
+    
+    if (seekPending) {
+      return isExecuting;
+    }
+    if (!isPaused) {
+      return isExecuting;
+    }
+    firstPass = false;
+    LOG_INFO("⏸️ Movimiento interrumpido: se retoma desde aquí al reanudar");
+  }
+  return false;
+}
+
+float SequenceManager::applyEasing(EasingType easing, float u) {
+  switch (easing) {
+    case EASE_IN:     return u * u;
+    case EASE_OUT:    return u * (2.0f - u);
+    case EASE_IN_OUT: return u * u * (3.0f - 2.0f * u);
+    default:          return u;
+  }
+}
+
+// Expande el generador frame a frame: solo guarda el frame actual y los
+// pasos ya recorridos, así que la memoria no depende de la cantidad de frames
+void SequenceManager::executeGenerator(const FrameGenerator& generator, uint32_t firstFrame) {
+  long totalSteps = stepperDriver->mmToSteps(generator.distance, MM_PER_REVOLUTION);
+  long origin = stepperDriver->getCurrentPosition();
+  bool moveServo = generator.startAngle >= 0;
+  
+  // Retomado: el carro está en el último frame hecho
+  if (firstFrame > 0 && firstFrame <= generator.frames) {
+    float u = generator.frames > 1 ? (float)(firstFrame - 1) / (generator.frames - 1) : 1.0f;
+    origin -= lroundf(applyEasing(generator.easing, u) * totalSteps);
+  }
+  
+  MoveTargets targets;
+  targets.stepperSpeed = map(generator.speed, 0, 100, 100, 2000);
+  targets.angleSpeed = generator.angleSpeed;
+  targets.axisCount = 0;
+  
+  LOG_INFO("🎞️ Generador: %lu frames, %.1fmm",
+                (unsigned long)generator.frames, generator.distance);
+  
+  for (uint32_t frame = firstFrame; frame < generator.frames; frame++) {
+    esp_task_wdt_reset();
+    
+    if (!waitWhilePaused() || seekPending) {
+      return;
+    }
+    
+    uint32_t frameStart = millis();
+    powerBeginFrame();
+    
+    // Posición acumulada redondeada: sin deriva aunque haya miles de frames
+    float u = generator.frames > 1 ? (float)frame / (generator.frames - 1) : 1.0f;
+    float eased = applyEasing(generator.easing, u);
+    targets.steps = origin + lroundf(eased * totalSteps);
+    targets.angle = moveServo ?
+      lroundf(generator.startAngle + (generator.endAngle - generator.startAngle) * eased) : -1;
+    
+    // Un frame cortado por una pausa se completa antes del disparo
+    checkpointFrame(frame + 1);
+    if (!driveTo(targets, true, WAIT_POLL_US / 1000)) {
+      powerEndFrame();
+      return;
+    }
+    
+    // Una pausa durante el asentamiento o la exposición espera aquí y el
+    // frame sigue; stop y salto lo cortan
+    if (generator.settleMs > 0 && !waitFor(generator.settleMs)) {
+      powerEndFrame();
+      return;
+    }
+    if (generator.shutter && shutterCallback != nullptr) {
+      shutterCallback();
+    }
+    if (!seekPending) checkpointSettled();
+    if (generator.exposureMs > 0 && !waitFor(generator.exposureMs)) {
+      powerEndFrame();
+      return;
+    }
+    
+    powerEndFrame();
+    
+    // Completar el intervalo contado desde el inicio del frame
+    uint32_t elapsed = millis() - frameStart;
+    uint32_t interval = feedScaled(generator.intervalMs);
+    if (interval > elapsed && frame + 1 < generator.frames) {
+      waitFor(interval - elapsed);
+    }
+  }
+}
+
+// Movimiento del pool equivalente a OP_MOVE / OP_TURN / OP_MOVE_TURN, con
+// las velocidades vigentes del programa
+PackedMovement SequenceManager::programMovement(const ProgramInstruction& instruction,
+                                                const ProgramSpeeds& speeds) const {
+  PackedMovement movement = {};
+  movement.steps = instruction.op != OP_TURN ? stepperDriver->mmToSteps(instruction.a * 0.01f, MM_PER_REVOLUTION) : 0;
+  int angle = instruction.op == OP_TURN ? instruction.a :
+              instruction.op == OP_MOVE_TURN ? instruction.b : -1;
+  movement.angleCdeg = angle >= 0 ? angle * 100 : ANGLE_KEEP;
+  movement.speed = speeds.stepper;
+  movement.angleSpeed = speeds.servo;
+  movement.flags = instruction.op == OP_MOVE_TURN ? MOVE_SIMULTANEOUS : 0;
+  return movement;
+}
+
+// Intérprete acotado: el programa ya se verificó al cargarlo y los bucles
+// usan una pila fija de MAX_PROGRAM_DEPTH. Entre instrucciones atiende el
+// watchdog, la pausa y el stop como entre movimientos de una secuencia.
+void SequenceManager::executeProgram(const MotionProgram& program) {
+  struct LoopFrame {
+    size_t body;         // pc de la primera instrucción del cuerpo
+    uint16_t remaining;  // Vueltas que faltan, la actual incluida
+  };
+  LoopFrame stack[MAX_PROGRAM_DEPTH];
+  int depth = 0;
+  ProgramSpeeds speeds;
+  ProgramInstruction instruction;
+  size_t pc = 0;
+  
+  markTakeStart();
+  LOG_INFO("🧩 Programa: %u instrucciones, %u bytes",
+           (unsigned)program.getInstructionCount(), (unsigned)program.getByteSize());
+  
+  for (;;) {
+    esp_task_wdt_reset();
+    if (!waitWhilePaused()) {
+      return;
+    }
+    // seek() no acepta programas; un salto que se coló se descarta
+    seekPending = false;
+  
+    program.decode(pc, instruction);
+    switch (instruction.op) {
+      case OP_END:
+        return;
+      case OP_MOVE:
+      case OP_TURN:
+      case OP_MOVE_TURN:
+        powerBeginFrame();
+        executeMovement(programMovement(instruction, speeds), nullptr, 0);
+        powerEndFrame();
+        break;
+      case OP_PAUSE:
+        if (instruction.a > 0) {
+          waitFor(feedScaled(instruction.a));
+        }
+        break;
+      case OP_SHUTTER:
+        if (shutterCallback != nullptr) {
+          shutterCallback();
+        }
+        break;
+      case OP_LOOP:
+        stack[depth++] = { pc, (uint16_t)instruction.a };
+        break;
+      case OP_ENDLOOP:
+        if (--stack[depth - 1].remaining > 0) {
+          pc = stack[depth - 1].body;
+        } else {
+          depth--;
+        }
+        break;
+      case OP_WAIT:
+        if (!waitForInput(instruction.a)) {
+          return;
+        }
+        break;
+      case OP_SPEED:
+        speeds.stepper = instruction.a;
+        speeds.servo = instruction.b;
+        break;
+    }
+  }
+}
+
+// OP_WAIT: el ejecutor se publica armado, así que lo libera el mismo go de
+// un arranque armado (/sequence/go o el GPIO). Con 'timeoutMs' > 0 sigue
+// solo al vencer. Devuelve false si se detuvo.
+bool SequenceManager::waitForInput(uint32_t timeoutMs) {
+  armed = true;
+  armReady = true;
+  goRequested = false;
+  publishState();
+  LOG_INFO("⏳ Programa esperando go");
+  
+  uint32_t startMs = millis();
+  while (isExecuting && !goRequested) {
+    esp_task_wdt_reset();
+    uint32_t waited = millis() - startMs;
+    if (timeoutMs > 0 && waited >= timeoutMs) {
+      LOG_INFO("⌛ Sin go: el programa sigue");
+      break;
+    }
+    serviceCommands(timeoutMs > 0 ? min<uint32_t>(timeoutMs - waited, 1000) : 1000);
+  }
+  
+  armed = false;
+  publishState();
+  return isExecuting;
+}
+
+// 'percent' escala el reloj de la trayectoria: el muestreo sigue siendo cada
+// PATH_CONTROL_PERIOD_MS pero avanza PATH_CONTROL_PERIOD_MS · percent / 100.
+// En reversa se muestrea en duración - t: mismo camino y mismos tiempos
+// espejados. El salto sigue contando ms desde el inicio de la reproducción.
+// Las capas se suman en cada tick en el mismo instante de la trayectoria
+// base, así que también se espejan.
+//
+// Los tramos por tick van con moveTo() sin rampa: cada uno arranca a su
+// velocidad. Por eso el avance efectivo ('feed') no salta al feedPercent
+// pedido ni, tras una pausa o un salto, de 0 a la velocidad del camino:
+// cambia por tick a lo sumo lo que lleva el riel de v a v ± acceleration ·
+// PATH_CONTROL_PERIOD_MS, la misma cota que approachSpeed() aplica en el
+// stepper. La velocidad nominal (avance al 100%) sale de muestrear un tick
+// por delante en la trayectoria base; sin aceleración no hay rampa.
+template <typename Path>
+void SequenceManager::executePath(const Path& path, uint16_t percent, const MotionLayers* layers,
+                                  bool reverse) {
+  if (!path.isCompiled()) {
+    LOG_WARN("⚠️ Trayectoria sin compilar");
+    return;
+  }
+  
+  uint32_t durationMs = path.getDurationMs();
+  typename Path::Cursor cursor = typename Path::Cursor();
+  float position, angle;
+  path.sample(reverse ? durationMs : 0, cursor, position, angle);
+  
+  // Llevar ambos ejes a la pose inicial antes de arrancar el reloj (una
+  // secuencia armada ya está ahí y arranca sin esperas)
+  long lastTarget = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+  applyLayers(layers, reverse ? durationMs : 0, durationMs, lastTarget, angle);
+  int startAngle = (int)(angle + 0.5f);
+  if (stepperDriver->getCurrentPosition() != lastTarget || servoDriver->getCurrentAngle() != startAngle) {
+    LOG_INFO("🎯 Moviendo a la pose inicial");
+    if (!moveToPose(lastTarget, startAngle)) {
+      return;
+    }
+  }
+  
+  markTakeStart();
+  LOG_INFO(reverse ? "⏪ Trayectoria en reversa: %lums al %u%%" : "🎞️ Trayectoria: %lums al %u%%",
+           (unsigned long)durationMs, percent);
+  
+  uint64_t pathCenti = 0;
+  uint32_t elapsedMs = 0;
+  float feed = feedPercent;
+  bool resync = false;
+  TickType_t lastWake = xTaskGetTickCount();
+  
+  while (elapsedMs < durationMs) {
+    esp_task_wdt_reset();
+    sleepUntil(lastWake, pdMS_TO_TICKS(PATH_CONTROL_PERIOD_MS));
+    
+    if (!isExecuting) {
+      return;
+    }
+    // Salto: el reloj pasa al instante pedido y los ejes van a esa pose
+    if (seekPending) {
+      seekPending = false;
+      elapsedMs = min(seekValue, durationMs);
+      pathCenti = (uint64_t)elapsedMs * 100;
+      uint32_t pathMs = reverse ? durationMs - elapsedMs : elapsedMs;
+      path.sample(pathMs, cursor, position, angle);
+      lastTarget = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+      applyLayers(layers, pathMs, durationMs, lastTarget, angle);
+      if (!moveToPose(lastTarget, (int)(angle + 0.5f))) {
+        return;
+      }
+      feed = 0;
+      lastWake = xTaskGetTickCount();
+      continue;
+    }
+    // En pausa el reloj de la trayectoria se congela. El stepper frenó con
+    // rampa y descartó su cola: se retoma desde donde quedó.
+    if (isPaused) {
+      resync = true;
+      continue;
+    }
+    if (resync) {
+      lastTarget = stepperDriver->getCurrentPosition();
+      feed = 0;
+      resync = false;
+    }
+    
+    // Rampa del avance (ver arriba): 'position' es todavía la del tick
+    // anterior
+    int acceleration = stepperDriver->getAcceleration();
+    if (acceleration > 0) {
+      uint32_t aheadMs = min<uint32_t>(elapsedMs + PATH_CONTROL_PERIOD_MS * percent / 100, durationMs);
+      typename Path::Cursor ahead = cursor;
+      float aheadPosition, aheadAngle;
+      path.sample(reverse ? durationMs - aheadMs : aheadMs, ahead, aheadPosition, aheadAngle);
+      float nominalSpeed = fabsf(stepperDriver->mmToSteps(aheadPosition, MM_PER_REVOLUTION) -
+                                 stepperDriver->mmToSteps(position, MM_PER_REVOLUTION)) * 1000.0f / PATH_CONTROL_PERIOD_MS;
+      float maxChange = nominalSpeed > 0 ?
+        100.0f * acceleration * PATH_CONTROL_PERIOD_MS / 1000.0f / nominalSpeed : FEED_OVERRIDE_MAX;
+      feed += constrain((float)feedPercent - feed, -maxChange, maxChange);
+    } else {
+      feed = feedPercent;
+    }
+    
+    pathCenti += (uint64_t)(PATH_CONTROL_PERIOD_MS * percent * feed / 100.0f + 0.5f);
+    elapsedMs = min<uint32_t>(pathCenti / 100, durationMs);
+    uint32_t pathMs = reverse ? durationMs - elapsedMs : elapsedMs;
+    path.sample(pathMs, cursor, position, angle);
+    
+    // Objetivos absolutos: si el stepper se retrasa, el siguiente tramo
+    // lo recupera. Con más de 2 tramos en cola se salta el tick para no
+    // bloquear el reloj.
+    long target = stepperDriver->mmToSteps(position, MM_PER_REVOLUTION);
+    applyLayers(layers, pathMs, durationMs, target, angle);
+    long delta = abs(target - lastTarget);
+    if (delta > 0 && stepperDriver->getQueuedCommands() < 2) {
+      int speed = (delta * 1000 + PATH_CONTROL_PERIOD_MS - 1) / PATH_CONTROL_PERIOD_MS;
+      stepperDriver->moveTo(target, speed, false);
+      lastTarget = target;
+    }
+    
+    servoDriver->setAngleImmediate(angle);
+    prefetchNext();
+  }
+  
+  // Último tramo del stepper
+  while ((stepperDriver->getIsMoving() || stepperDriver->getQueuedCommands() > 0) && isExecuting) {
+    esp_task_wdt_reset();
+    serviceCommands(10);
+  }
+}
+
+// Movimiento a una pose absoluta a la velocidad por defecto, interrumpible
+// por las órdenes como cualquier movimiento de la secuencia
+bool SequenceManager::moveToPose(long steps, int angle) {
+  MoveTargets targets;
+  targets.steps = steps;
+  targets.stepperSpeed = -1;
+  targets.angle = angle;
+  targets.angleSpeed = -1;
+  targets.axisCount = 0;
+  return driveTo(targets, true, WAIT_POLL_US / 1000);
+}
+
+// ========== Límites ==========
+
+void SequenceManager::setSoftLimits(float minMm, float maxMm) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  softMinSteps = stepperDriver->mmToSteps(min(minMm, maxMm), MM_PER_REVOLUTION);
+  softMaxSteps = stepperDriver->mmToSteps(max(minMm, maxMm), MM_PER_REVOLUTION);
+  softLimitsEnabled = true;
+  xSemaphoreGive(mutex);
+  LOG_INFO("🚧 Límites blandos: %.1f a %.1f mm", min(minMm, maxMm), max(minMm, maxMm));
+}
+
+void SequenceManager::disableSoftLimits() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  softLimitsEnabled = false;
+  xSemaphoreGive(mutex);
+}
+
+void SequenceManager::setSpeedCap(uint32_t stepsPerSecond) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  speedCap = stepsPerSecond;
+  xSemaphoreGive(mutex);
+}
+
+bool SequenceManager::setFeedOverride(int percent, String& reason) {
+  if (percent < FEED_OVERRIDE_MIN || percent > FEED_OVERRIDE_MAX) {
+    reason = "Avance fuera de rango (" + String(FEED_OVERRIDE_MIN) + "-" + String(FEED_OVERRIDE_MAX) + "%)";
+    return false;
+  }
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  // Con una secuencia en marcha el nuevo pico tiene que respetar el tope
+  ExecutorStatus status = getExecutorStatus();
+  if (status.state != EXEC_IDLE && isValidIndex(status.sequence) &&
+      sequences[status.sequence].analysis.valid) {
+    uint32_t cap = speedCap > 0 ? speedCap : stepperDriver->getMaxSpeed();
+    uint32_t peak = (uint64_t)sequences[status.sequence].analysis.peakStepRate * percent / 100;
+    if (peak > cap) {
+      xSemaphoreGive(mutex);
+      reason = "Velocidad " + String(peak) + " steps/s supera el máximo " + String(cap);
+      return false;
+    }
+  }
+  
+  feedPercent = percent;
+  if (driverFeed) {
+    stepperDriver->setFeedOverride(percent);
+    servoDriver->setFeedOverride(percent);
+  }
+  xSemaphoreGive(mutex);
+  
+  LOG_INFO("🎚️ Avance global: %d%%", percent);
+  return true;
+}
+
+// Los drivers solo escalan durante los movimientos; fuera de la ejecución
+// (y en las trayectorias, que escalan su reloj) vuelven al 100%
+void SequenceManager::applyDriverFeed(bool enabled) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  driverFeed = enabled;
+  int percent = enabled ? feedPercent : 100;
+  stepperDriver->setFeedOverride(percent);
+  servoDriver->setFeedOverride(percent);
+  xSemaphoreGive(mutex);
+}
+
+// Pausas e intervalos a la velocidad global (se toma al empezar cada una)
+uint32_t SequenceManager::feedScaled(uint32_t ms) const {
+  return (uint64_t)ms * 100 / feedPercent;
+}
+
+String SequenceManager::getLimitsAsJson() const {
+  String json = "{";
+  json += "\"enabled\":" + String(softLimitsEnabled ? "true" : "false") + ",";
+  json += "\"minMm\":" + String(stepperDriver->stepsToMm(softMinSteps, MM_PER_REVOLUTION), 2) + ",";
+  json += "\"maxMm\":" + String(stepperDriver->stepsToMm(softMaxSteps, MM_PER_REVOLUTION), 2) + ",";
+  json += "\"speedCap\":" + String(speedCap > 0 ? speedCap : (uint32_t)stepperDriver->getMaxSpeed());
+  json += "}";
+  return json;
+}
+
+// Verifica la envolvente y la velocidad pico contra los límites, partiendo
+// de 'start' y con 'passes' pasadas (llamar con el mutex y el análisis válido)
+bool SequenceManager::checkLimits(const Sequence& seq, long start, int passes, bool loop,
+                                  String& reason, PlaybackMode mode) const {
+  const SequenceAnalysis& analysis = seq.analysis;
+  
+  // El análisis está hecho al 100%: el override escala el pico
+  uint32_t cap = speedCap > 0 ? speedCap : stepperDriver->getMaxSpeed();
+  uint32_t peak = (uint64_t)analysis.peakStepRate * feedPercent / 100;
+  if (peak > cap) {
+    reason = "Velocidad " + String(peak) + " steps/s supera el máximo " + String(cap);
+    return false;
+  }
+  
+  if (!softLimitsEnabled) {
+    return true;
+  }
+  
+  long low, high;
+  if (isTrajectory(seq)) {
+    // Posiciones absolutas; se llega a la pose inicial desde 'start'
+    low = min<long>(start, analysis.minSteps);
+    high = max<long>(start, analysis.maxSteps);
+  } else {
+    // Posiciones relativas: cada repetición arranca donde terminó la
+    // anterior. La reversa recorre la misma envolvente corrida en -endSteps
+    // (arranca en el final de la ida); la ida y vuelta no se desplaza.
+    long origin = mode == PLAY_REVERSE ? start - analysis.endSteps : start;
+    long pass = mode == PLAY_REVERSE ? -analysis.endSteps : analysis.endSteps;
+    if (mode == PLAY_PINGPONG) {
+      pass = 0;
+    }
+    if (loop && pass != 0) {
+      reason = "La secuencia en loop no vuelve al inicio";
+      return false;
+    }
+    long drift = (long)(passes - 1) * pass;
+    low = origin + analysis.minSteps + min(0L, drift);
+    high = origin + analysis.maxSteps + max(0L, drift);
+  }
+  
+  if (low < softMinSteps || high > softMaxSteps) {
+    reason = "Recorrido " + String(stepperDriver->stepsToMm(low, MM_PER_REVOLUTION), 1) + " a " +
+             String(stepperDriver->stepsToMm(high, MM_PER_REVOLUTION), 1) + " mm fuera de los límites";
+    return false;
+  }
+  return true;
+}
+
+// Posición del stepper al terminar 'passes' pasadas que arrancan en 'start'
+long SequenceManager::chainEndSteps(const Sequence& seq, long start, int passes) const {
+  if (isTrajectory(seq)) {
+    return seq.analysis.endSteps;
+  }
+  return start + (long)passes * seq.analysis.endSteps;
+}
+
+// Encadena las entradas desde la posición actual: cada una se verifica desde
+// donde termina la anterior. 'estimateUs' recibe la duración total,
+// llegadas a las poses incluidas (0 en loop). Llamar con el mutex tomado.
+bool SequenceManager::checkPlaylist(String& reason, uint64_t* estimateUs) const {
+  if (playlistCount == 0) {
+    reason = "Playlist vacía";
+    return false;
+  }
+  
+  long position = stepperDriver->getCurrentPosition();
+  int angle = servoDriver->getCurrentAngle();
+  uint64_t total = 0;
+  for (int i = 0; i < playlistCount; i++) {
+    const Sequence& seq = sequences[playlist[i].sequence];
+    if (!seq.used) {
+      reason = "Entrada " + String(i + 1) + ": secuencia borrada";
+      return false;
+    }
+    if (!seq.analysis.valid) analyzeSequence(seq);
+    if (!checkLimits(seq, position, playlist[i].repeat, false, reason)) {
+      reason = "Entrada " + String(i + 1) + ": " + reason;
+      return false;
+    }
+    total += transitionUs(seq, position, angle) + seq.analysis.durationUs * playlist[i].repeat;
+    position = chainEndSteps(seq, position, playlist[i].repeat);
+    if (seq.analysis.lastAngle >= 0) angle = seq.analysis.lastAngle;
+  }
+  
+  if (playlistLoop) {
+    if (total == 0) {
+      reason = "La playlist en loop no tiene movimientos";
+      return false;
+    }
+    // Una segunda vuelta que termina en otro lado deriva en cada vuelta
+    long second = position;
+    for (int i = 0; i < playlistCount; i++) {
+      second = chainEndSteps(sequences[playlist[i].sequence], second, playlist[i].repeat);
+    }
+    if (softLimitsEnabled && second != position) {
+      reason = "La playlist en loop no vuelve al inicio";
+      return false;
+    }
+  }
+  
+  if (estimateUs != nullptr) {
+    *estimateUs = playlistLoop ? 0 : total;
+  }
+  return true;
+}
+
+// Secuencias que no se pueden borrar ni recompilar: la que suena y las de la
+// playlist en curso (llamar con el mutex tomado)
+bool SequenceManager::isSequenceBusy(int index) const {
+  if (!isExecuting && !startPending) {
+    return false;
+  }
+  if (activeSequenceIndex == index) {
+    return true;
+  }
+  if (playlistActive) {
+    for (int i = 0; i < playlistCount; i++) {
+      if (playlist[i].sequence == index) return true;
+    }
+  }
+  return false;
+}
+
+bool SequenceManager::validateSequence(int sequenceIndex, String& reason, PlaybackMode mode) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if (!isValidIndex(sequenceIndex)) {
+    xSemaphoreGive(mutex);
+    reason = "Índice de secuencia inválido";
+    return false;
+  }
+  
+  const Sequence& seq = sequences[sequenceIndex];
+  if (seq.type == SEQUENCE_PROGRAM && mode != PLAY_FORWARD) {
+    xSemaphoreGive(mutex);
+    reason = "Los programas solo se reproducen hacia adelante";
+    return false;
+  }
+  if (!seq.analysis.valid) analyzeSequence(seq);
+  bool allowed = checkLimits(seq, stepperDriver->getCurrentPosition(), max(seq.repeatCount, 1),
+                             seq.loop, reason, mode);
+  
+  xSemaphoreGive(mutex);
+  return allowed;
+}
+
+bool SequenceManager::executeSequence(int sequenceIndex, PlaybackMode mode) {
+  return startExecution(sequenceIndex, false, false, mode);
+}
+
+bool SequenceManager::armSequence(int sequenceIndex, PlaybackMode mode) {
+  return startExecution(sequenceIndex, true, false, mode);
+}
+
+bool SequenceManager::startExecution(int sequenceIndex, bool arm, bool withPlaylist, PlaybackMode mode) {
+  if (!isValidIndex(sequenceIndex)) {
+    LOG_ERROR("❌ Índice de secuencia inválido");
+    return false;
+  }
+  
+  if (isEmergencyLatched()) {
+    LOG_WARN("⛔ Parada de emergencia enclavada: resetear antes de ejecutar");
+    return false;
+  }
+  
+  String reason;
+  if (!withPlaylist && !validateSequence(sequenceIndex, reason, mode)) {
+    LOG_ERROR("❌ Secuencia %d rechazada: %s", sequenceIndex, reason.c_str());
+    return false;
+  }
+  
+  // Con el mutex: un segundo arranque no puede colarse entre la
+  // verificación y el encolado, ni mientras la ejecución anterior termina
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (isExecuting || startPending) {
+    xSemaphoreGive(mutex);
+    LOG_WARN("⚠️ Ya hay una secuencia en ejecución");
+    return false;
+  }
+  if (withPlaylist && !checkPlaylist(reason, &playlistEstimateUs)) {
+    xSemaphoreGive(mutex);
+    LOG_ERROR("❌ Playlist rechazada: %s", reason.c_str());
+    return false;
+  }
+  const Sequence& seq = sequences[sequenceIndex];
+  executionEstimateUs = seq.loop ? 0 :
+                        startupDurationUs(seq) + seq.analysis.durationUs * max(seq.repeatCount, 1);
+  executionStartMillis = millis();
+  playlistStartMillis = executionStartMillis;
+  activeSequenceIndex = sequenceIndex;
+  playlistActive = withPlaylist;
+  
+  ExecutorCommand command = { EXEC_START, 0, (int16_t)sequenceIndex, 0, esp_timer_get_time() };
+  if (arm) command.flags |= EXEC_FLAG_ARM;
+  if (withPlaylist) command.flags |= EXEC_FLAG_PLAYLIST;
+  if (mode == PLAY_REVERSE) command.flags |= EXEC_FLAG_REVERSE;
+  if (mode == PLAY_PINGPONG) command.flags |= EXEC_FLAG_PINGPONG;
+  startPending = xQueueSend(commandQueue, &command, 0) == pdTRUE;
+  if (!startPending) {
+    playlistActive = false;
+    controlStats.dropped++;
   }
+  xSemaphoreGive(mutex);
+  
+  if (!startPending) {
+    LOG_ERROR("❌ Cola del ejecutor llena");
+  }
+  return startPending;
 }
 
-bool SequenceManager::begin() {
-  mutex = xSemaphoreCreateMutex();
-  if (mutex == nullptr) {
-    Serial.println("❌ SequenceManager: Error creando mutex");
+bool SequenceManager::rapidReturn(String& reason, uint32_t& etaMs) {
+  if (isEmergencyLatched()) {
+    reason = "Parada de emergencia enclavada";
     return false;
   }
   
-  Serial.println("✅ SequenceManager inicializado");
-  return true;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (isExecuting || startPending) {
+    xSemaphoreGive(mutex);
+    reason = "Hay una secuencia en ejecución";
+    return false;
+  }
+  if (!takeStart.valid) {
+    xSemaphoreGive(mutex);
+    reason = "No hay una toma anterior";
+    return false;
+  }
+  if (softLimitsEnabled && (takeStart.steps < softMinSteps || takeStart.steps > softMaxSteps)) {
+    xSemaphoreGive(mutex);
+    reason = "La pose inicial está fuera de los límites";
+    return false;
+  }
+  
+  uint32_t cap = speedCap > 0 ? min<uint32_t>(speedCap, stepperDriver->getMaxSpeed()) : stepperDriver->getMaxSpeed();
+  long distance = takeStart.steps - stepperDriver->getCurrentPosition();
+  uint32_t servoMs = servoDriver->estimateMoveMs(servoDriver->getCurrentAngle(), takeStart.angle, 100);
+  executionEstimateUs = max<uint64_t>(stepperDriver->estimateRapidMicros(distance, cap), (uint64_t)servoMs * 1000);
+  executionStartMillis = millis();
+  activeSequenceIndex = takeStart.sequence;
+  etaMs = executionEstimateUs / 1000;
+  
+  ExecutorCommand command = { EXEC_START, EXEC_FLAG_RETURN, (int16_t)takeStart.sequence, 0, esp_timer_get_time() };
+  startPending = xQueueSend(commandQueue, &command, 0) == pdTRUE;
+  if (!startPending) {
+    controlStats.dropped++;
+    reason = "Cola del ejecutor llena";
+  }
+  xSemaphoreGive(mutex);
+  return startPending;
 }
 
-int SequenceManager::createSequence(const String& name) {
+void SequenceManager::runReturn() {
   xSemaphoreTake(mutex, portMAX_DELAY);
+  TakeStart pose = takeStart;
+  uint32_t cap = speedCap > 0 ? min<uint32_t>(speedCap, stepperDriver->getMaxSpeed()) : stepperDriver->getMaxSpeed();
+  xSemaphoreGive(mutex);
+  
+  MoveTargets targets;
+  targets.steps = pose.steps;
+  targets.stepperSpeed = cap;
+  targets.rapid = true;
+  targets.angle = pose.angle;
+  targets.angleSpeed = 100;
+  targets.axisCount = 0;
+  for (int i = 0; i < pose.axisCount && motion != nullptr; i++) {
+    MotionAxis* axis = motion->getAxis(i);
+    if (axis == nullptr) continue;
+    int n = targets.axisCount++;
+    targets.axisIndex[n] = i;
+    targets.axisTarget[n] = pose.axisPosition[i];
+    targets.axisRate[n] = axis->getMaxRate();
+  }
   
-  Sequence newSeq;
-  newSeq.name = name;
-  newSeq.loop = false;
-  newSeq.repeatCount = 1;
+  LOG_INFO("⏪ Vuelta rápida: %.1fmm, %d°", stepperDriver->stepsToMm(pose.steps, MM_PER_REVOLUTION), pose.angle);
+  unsigned long startMillis = millis();
+  if (driveTo(targets, true, WAIT_POLL_US / 1000)) {
+    LOG_INFO("✅ En la pose inicial (%lums)", (unsigned long)(millis() - startMillis));
+  }
+}
+
+// Secuencia armada: motor habilitado y retenido, ejes en la pose inicial y
+// espera del go. Devuelve false si se detuvo antes del go.
+bool SequenceManager::prepareArmed(int index) {
+  const Sequence& seq = sequences[index];
+  unsigned long prepareStart = millis();
+  LOG_INFO("🎯 Armando secuencia: %s", seq.name);
   
-  sequences.push_back(newSeq);
-  int index = sequences.size() - 1;
+  if (!stepperDriver->getIsEnabled()) {
+    stepperDriver->enable();
+  }
+  stepperDriver->setHoldLock(true);
+  servoDriver->setHoldLock(true);
   
+  // Trayectorias: pose absoluta. Movimientos: solo el primer ángulo, el
+  // recorrido del riel es relativo a donde esté. En reversa se arranca en
+  // la pose final de la ida.
+  long steps;
+  float angle;
+  bool reverse = passReversed(0);
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool absolute = pathStartPose(seq, steps, angle, reverse);
+  int firstAngle = reverse ? seq.analysis.lastAngle : seq.analysis.firstAngle;
   xSemaphoreGive(mutex);
   
-  Serial.printf("✅ Secuencia '%s' creada (index: %d)\n", name.c_str(), index);
-  return index;
-}
-
-bool SequenceManager::deleteSequence(int index) {
-  if (index < 0 || index >= sequences.size()) {
+  if (absolute) {
+    moveToPose(steps, (int)(angle + 0.5f));
+  } else if (firstAngle >= 0) {
+    moveToPose(stepperDriver->getCurrentPosition(), firstAngle);
+  }
+  
+  // Copia y MOVING en flash ahora: tras el go no se escribe nada
+  beginCheckpointRun(index);
+  checkpointArm();
+  
+  armStats.lastPrepareMs = millis() - prepareStart;
+  armReady = true;
+  if (isExecuting) {
+    LOG_INFO("🟢 Armada en %lums: esperando go", (unsigned long)armStats.lastPrepareMs);
+  }
+  
+  // EXEC_GO (o EXEC_STOP) despierta a la task en el acto
+  while (isExecuting && !goRequested) {
+    esp_task_wdt_reset();
+    serviceCommands(1000);
+  }
+  armed = false;
+  publishState();
+  if (!isExecuting) {
     return false;
   }
   
+  // El primer pulso de STEP cierra la medida en StepperDriver
+  stepperDriver->markFirstStep(goRequestUs);
+  uint32_t latency = esp_timer_get_time() - goRequestUs;
+  armStats.goCount++;
+  armStats.lastWakeUs = latency;
+  if (latency > armStats.maxWakeUs) armStats.maxWakeUs = latency;
+  
+  // El ETA cuenta desde el go y ya no incluye la llegada a la pose
   xSemaphoreTake(mutex, portMAX_DELAY);
-  sequences.erase(sequences.begin() + index);
+  executionEstimateUs = seq.loop ? 0 : seq.analysis.durationUs * max(seq.repeatCount, 1);
+  executionStartMillis = millis();
   xSemaphoreGive(mutex);
   
+  LOG_INFO("🚀 Go (ejecutor en %luus)", (unsigned long)latency);
   return true;
 }
 
-bool SequenceManager::addMovement(int sequenceIndex, const Movement& movement) {
-  if (sequenceIndex < 0 || sequenceIndex >= sequences.size()) {
+bool SequenceManager::go() {
+  if (getExecutorStatus().state != EXEC_ARMED) {
     return false;
   }
-  
+  return postCommand(EXEC_GO, 0, true);
+}
+
+// Disparo por GPIO: encola el go al frente y despierta a la task
+void IRAM_ATTR SequenceManager::goFromISR() {
+  if ((executorWord & 0xFF) != EXEC_ARMED) {
+    return;
+  }
+  ExecutorCommand command = { EXEC_GO, 0, 0, 0, esp_timer_get_time() };
+  BaseType_t woken = pdFALSE;
+  xQueueSendToFrontFromISR(commandQueue, &command, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+void IRAM_ATTR SequenceManager::stopFromISR() {
+  if (commandQueue == nullptr) {
+    return;
+  }
+  ExecutorCommand command = { EXEC_STOP, 0, 0, 0, esp_timer_get_time() };
+  BaseType_t woken = pdFALSE;
+  xQueueSendToFrontFromISR(commandQueue, &command, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+String SequenceManager::getArmStatusAsJson() const {
+  String json = "{";
+  json += "\"armed\":" + String(armed ? "true" : "false") + ",";
+  json += "\"ready\":" + String(armed && armReady ? "true" : "false") + ",";
+  json += "\"index\":" + String(armed ? activeSequenceIndex : -1) + ",";
+  FirstStepStats firstStep = stepperDriver->getFirstStepStats();
+  json += "\"goCount\":" + String(armStats.goCount) + ",";
+  json += "\"steppedCount\":" + String(firstStep.count) + ",";
+  json += "\"lastLatencyUs\":" + String(firstStep.lastLatencyUs) + ",";
+  json += "\"maxLatencyUs\":" + String(firstStep.maxLatencyUs) + ",";
+  json += "\"wakeUs\":" + String(armStats.lastWakeUs) + ",";
+  json += "\"maxWakeUs\":" + String(armStats.maxWakeUs) + ",";
+  json += "\"prepareMs\":" + String(armStats.lastPrepareMs);
+  json += "}";
+  return json;
+}
+
+// Pausa inmediata: el ejecutor frena los motores con rampa a mitad del
+// movimiento y lo retoma al reanudar
+void SequenceManager::pause() {
+  if (getIsExecuting()) {
+    postCommand(EXEC_PAUSE);
+  }
+}
+
+void SequenceManager::resume() {
+  if (getIsExecuting()) {
+    postCommand(EXEC_RESUME);
+  }
+}
+
+// Detiene con rampa de frenado (la parada de emergencia es /stop). Pasa al
+// frente de la cola. También cancela un arranque aún no aplicado.
+void SequenceManager::stop() {
   xSemaphoreTake(mutex, portMAX_DELAY);
-  sequences[sequenceIndex].movements.push_back(movement);
+  bool active = isExecuting || startPending;
   xSemaphoreGive(mutex);
-  
-  Serial.printf("✅ Movimiento agregado a secuencia %d\n", sequenceIndex);
-  return true;
+  if (active) {
+    postCommand(EXEC_STOP, 0, true);
+  }
 }
 
-bool SequenceManager::removeMovement(int sequenceIndex, int movementIndex) {
-  if (sequenceIndex < 0 || sequenceIndex >= sequences.size()) {
+bool SequenceManager::seek(uint32_t position) {
+  if (!getIsExecuting()) {
     return false;
   }
-  
+  // Un programa no tiene posiciones a las que saltar. El tipo se lee con
+  // el mutex: la secuencia puede borrarse o recrearse entre tanto.
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  ExecutorStatus status = getExecutorStatus();
+  bool program = isValidIndex(status.sequence) && sequences[status.sequence].type == SEQUENCE_PROGRAM;
+  xSemaphoreGive(mutex);
+  if (program) {
+    return false;
+  }
+  return postCommand(EXEC_SEEK, position);
+}
+
+bool SequenceManager::exportSnapshot(int sequenceIndex, std::vector<uint8_t>& out, size_t maxBytes) const {
   xSemaphoreTake(mutex, portMAX_DELAY);
   
-  if (movementIndex < 0 || movementIndex >= sequences[sequenceIndex].movements.size()) {
+  if (!isValidIndex(sequenceIndex) || sequences[sequenceIndex].type != SEQUENCE_MOVEMENTS) {
     xSemaphoreGive(mutex);
     return false;
   }
   
-  sequences[sequenceIndex].movements.erase(
-    sequences[sequenceIndex].movements.begin() + movementIndex
-  );
-  
-  xSemaphoreGive(mutex);
-  return true;
-}
-
-bool SequenceManager::clearSequence(int sequenceIndex) {
-  if (sequenceIndex < 0 || sequenceIndex >= sequences.size()) {
+  const Sequence& seq = sequences[sequenceIndex];
+  const PackedMovement* records = &pool[seq.offset];
+  int generatorCount = 0;
+  for (int r = 0; r < seq.count; r++) {
+    if (records[r].flags & MOVE_GENERATOR) generatorCount++;
+  }
+  size_t size = sizeof(SnapshotHeader) + seq.count * sizeof(PackedMovement) +
+                generatorCount * sizeof(FrameGenerator);
+  if (size > maxBytes) {
+    xSemaphoreGive(mutex);
+    LOG_WARN("⚠️ Secuencia %d: la copia (%u bytes) no entra en el punto de control",
+             sequenceIndex, (unsigned)size);
     return false;
   }
   
-  xSemaphoreTake(mutex, portMAX_DELAY);
-  sequences[sequenceIndex].movements.clear();
-  xSemaphoreGive(mutex);
+  out.resize(size);
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  header.version = SNAPSHOT_VERSION;
+  strlcpy(header.name, seq.name, sizeof(header.name));
+  header.loop = seq.loop;
+  header.repeatCount = seq.repeatCount;
+  header.count = seq.count;
+  header.generatorCount = generatorCount;
+  memcpy(out.data(), &header, sizeof(header));
+  
+  uint8_t* recordOut = out.data() + sizeof(header);
+  uint8_t* generatorOut = recordOut + seq.count * sizeof(PackedMovement);
+  int generator = 0;
+  for (int r = 0; r < seq.count; r++) {
+    PackedMovement record = records[r];
+    if (record.flags & MOVE_GENERATOR) {
+      memcpy(generatorOut + generator * sizeof(FrameGenerator), &generators[record.steps], sizeof(FrameGenerator));
+      record.steps = generator++;
+    }
+    memcpy(recordOut + r * sizeof(PackedMovement), &record, sizeof(PackedMovement));
+  }
   
+  xSemaphoreGive(mutex);
   return true;
 }
 
-void SequenceManager::executionTaskFunc(void* parameter) {
-  SequenceManager* manager = static_cast<SequenceManager*>(parameter);
-  
-  // Suscribir task al watchdog
-  esp_task_wdt_add(NULL);
+int SequenceManager::importSnapshot(const uint8_t* data, size_t length) {
+  SnapshotHeader header;
+  if (data == nullptr || length < sizeof(header)) {
+    return -1;
+  }
+  memcpy(&header, data, sizeof(header));
+  size_t expected = sizeof(header) + header.count * sizeof(PackedMovement) +
+                    header.generatorCount * sizeof(FrameGenerator);
+  if (header.version != SNAPSHOT_VERSION || length != expected || header.generatorCount > MAX_GENERATORS) {
+    return -1;
+  }
+  header.name[SEQUENCE_NAME_LENGTH - 1] = '\0';
   
-  if (manager->activeSequenceIndex < 0 || 
-      manager->activeSequenceIndex >= manager->sequences.size()) {
-    manager->isExecuting = false;
-    esp_task_wdt_delete(NULL);
-    vTaskDelete(NULL);
-    return;
+  int index = createSequence(String(header.name), SEQUENCE_MOVEMENTS, max<uint16_t>(header.count, 1));
+  if (index < 0) {
+    return -1;
   }
   
-  const Sequence& seq = manager->sequences[manager->activeSequenceIndex];
+  const uint8_t* records = data + sizeof(header);
+  const uint8_t* generatorData = records + header.count * sizeof(PackedMovement);
   
-  Serial.printf("▶️ Ejecutando secuencia: %s\n", seq.name.c_str());
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  int slots[MAX_GENERATORS];
+  int found = 0;
+  for (int i = 0; i < MAX_GENERATORS && found < header.generatorCount; i++) {
+    if (!generatorUsed[i]) slots[found++] = i;
+  }
+  bool ok = found == header.generatorCount;
   
-  for (int repeat = 0; repeat < seq.repeatCount || seq.loop; repeat++) {
-    for (size_t i = 0; i < seq.movements.size(); i++) {
-      // Resetear watchdog cada movimiento
-      esp_task_wdt_reset();
-      
-      // Verificar pausa
-      while (manager->isPaused && manager->isExecuting) {
-        esp_task_wdt_reset();
-        vTaskDelay(pdMS_TO_TICKS(100));
-      }
-      
-      // Verificar si se detuvo
-      if (!manager->isExecuting) {
+  for (int r = 0; r < header.count && ok; r++) {
+    PackedMovement record;
+    memcpy(&record, records + r * sizeof(PackedMovement), sizeof(PackedMovement));
+    int slot = -1;
+    if (record.flags & MOVE_GENERATOR) {
+      if (record.steps < 0 || record.steps >= header.generatorCount) {
+        ok = false;
         break;
       }
-      
-      Serial.printf("📍 Movimiento %d/%d\n", i + 1, seq.movements.size());
-      manager->executeMovement(seq.movements[i]);
-    }
-    
-    if (!manager->isExecuting) {
-      break;
-    }
-    
-    if (seq.loop) {
-      Serial.println("🔄 Repitiendo secuencia (loop)...");
+      slot = slots[record.steps];
+      memcpy(&generators[slot], generatorData + record.steps * sizeof(FrameGenerator), sizeof(FrameGenerator));
+      record.steps = slot;
     }
+    ok = appendPacked(index, record);
+    if (ok && slot >= 0) generatorUsed[slot] = true;
   }
   
-  manager->isExecuting = false;
-  Serial.println("✅ Secuencia completada");
+  Sequence& seq = sequences[index];
+  seq.loop = header.loop;
+  seq.repeatCount = constrain((int)header.repeatCount, 1, 1000);
+  seq.version++;
+  xSemaphoreGive(mutex);
   
-  esp_task_wdt_delete(NULL);
-  vTaskDelete(NULL);
+  if (!ok) {
+    deleteSequence(index);
+    LOG_ERROR("❌ Copia de secuencia inválida");
+    return -1;
+  }
+  return index;
 }
 
-void SequenceManager::executeMovement(const Movement& movement) {
-  if (movement.simultaneous) {
-    // Mover ambos motores simultáneamente
-    Serial.println("⚙️ Movimiento simultáneo");
-    
-    // Convertir velocidad de 0-100% a steps/segundo
-    int stepperSpeed = map(movement.horizontalSpeed, 0, 100, 100, 2000);
-    
-    // Convertir mm a steps (asumiendo 8mm por revolución - ajustar según tu setup)
-    long steps = stepperDriver->mmToSteps(movement.horizontalDistance, 8.0);
-    
-    // Iniciar movimientos sin esperar
-    stepperDriver->moveRelative(steps, stepperSpeed, false);
-    servoDriver->moveTo(movement.angle, movement.angleSpeed, false);
-    
-    // Esperar a que ambos terminen
-    while (stepperDriver->getIsMoving() || servoDriver->getIsMoving()) {
-      vTaskDelay(pdMS_TO_TICKS(50));
-    }
-  } else {
-    // Mover secuencialmente
-    Serial.println("⚙️ Movimiento secuencial");
-    
-    // Primero el stepper
-    if (movement.horizontalDistance != 0) {
-      int stepperSpeed = map(movement.horizontalSpeed, 0, 100, 100, 2000);
-      long steps = stepperDriver->mmToSteps(movement.horizontalDistance, 8.0);
-      stepperDriver->moveRelative(steps, stepperSpeed, true);
-    }
-    
-    // Luego el servo
-    if (movement.angle >= 0) {
-      servoDriver->moveTo(movement.angle, movement.angleSpeed, true);
-    }
+bool SequenceManager::resumeSequence(int sequenceIndex, uint16_t pass, uint16_t record, uint32_t frame) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool valid = isValidIndex(sequenceIndex) && !isExecuting && !startPending;
+  if (valid) {
+    const Sequence& seq = sequences[sequenceIndex];
+    valid = seq.type == SEQUENCE_MOVEMENTS && record <= seq.count &&
+            (seq.loop || pass < max(seq.repeatCount, 1));
   }
+  if (valid) {
+    resumePending = true;
+    resumeIndex = sequenceIndex;
+    resumePass = pass;
+    resumeRecord = record;
+    resumeFrame = frame;
+  }
+  xSemaphoreGive(mutex);
   
-  // Pausa después del movimiento
-  if (movement.pauseAfter > 0) {
-    Serial.printf("⏸️ Pausa: %dms\n", movement.pauseAfter);
-    vTaskDelay(pdMS_TO_TICKS(movement.pauseAfter));
+  if (valid && startExecution(sequenceIndex, false)) {
+    return true;
   }
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (resumeIndex == sequenceIndex && !startPending) resumePending = false;
+  xSemaphoreGive(mutex);
+  return false;
 }
 
-bool SequenceManager::executeSequence(int sequenceIndex) {
-  if (sequenceIndex < 0 || sequenceIndex >= sequences.size()) {
-    Serial.println("❌ Índice de secuencia inválido");
+String SequenceManager::getExecutorStatusAsJson() const {
+  static const char* const STATE_NAMES[] = { "idle", "armed", "running", "paused" };
+  static const char* const MODE_NAMES[] = { "forward", "reverse", "pingpong" };
+  ExecutorStatus status = getExecutorStatus();
+  String json = "{";
+  json += "\"state\":\"" + String(STATE_NAMES[status.state]) + "\",";
+  json += "\"sequence\":" + String(status.sequence) + ",";
+  json += "\"entry\":" + String(status.entry) + ",";
+  json += "\"run\":" + String(status.run) + ",";
+  json += "\"feed\":" + String(feedPercent) + ",";
+  json += "\"mode\":\"" + String(MODE_NAMES[playMode]) + "\",";
+  json += "\"returnAvailable\":" + String(takeStart.valid ? "true" : "false") + ",";
+  json += "\"queued\":" + String((uint32_t)uxQueueMessagesWaiting(commandQueue)) + ",";
+  json += "\"commands\":" + String(controlStats.commands) + ",";
+  json += "\"lastLatencyUs\":" + String(controlStats.lastUs) + ",";
+  json += "\"maxLatencyUs\":" + String(controlStats.maxUs) + ",";
+  json += "\"dropped\":" + String(controlStats.dropped);
+  json += "}";
+  return json;
+}
+
+// ========== Playlist ==========
+
+bool SequenceManager::setPlaylist(const PlaylistEntry* entries, int count, bool loop) {
+  if (count < 0 || count > MAX_PLAYLIST_ENTRIES) {
     return false;
   }
   
-  if (isExecuting) {
-    Serial.println("⚠️ Ya hay una secuencia en ejecución");
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  
+  if ((isExecuting || startPending) && playlistActive) {
+    xSemaphoreGive(mutex);
+    LOG_WARN("⚠️ La playlist está en ejecución");
     return false;
   }
+  for (int i = 0; i < count; i++) {
+    if (!isValidIndex(entries[i].sequence) || entries[i].repeat == 0) {
+      xSemaphoreGive(mutex);
+      return false;
+    }
+  }
+  
+  memcpy(playlist, entries, count * sizeof(PlaylistEntry));
+  playlistCount = count;
+  playlistLoop = loop;
   
+  xSemaphoreGive(mutex);
+  LOG_INFO("📜 Playlist: %d entradas%s", count, loop ? " (loop)" : "");
+  return true;
+}
+
+bool SequenceManager::validatePlaylist(String& reason) {
   xSemaphoreTake(mutex, portMAX_DELAY);
-  activeSequenceIndex = sequenceIndex;
-  isExecuting = true;
-  isPaused = false;
+  bool allowed = checkPlaylist(reason);
   xSemaphoreGive(mutex);
-  
-  BaseType_t result = xTaskCreatePinnedToCore(
-    executionTaskFunc,
-    "SequenceTask",
-    8192,
-    this,
-    1,
-    &executionTask,
-    1
-  );
-  
-  if (result != pdPASS) {
-    Serial.println("❌ Error creando task de ejecución");
-    isExecuting = false;
+  return allowed;
+}
+
+bool SequenceManager::executePlaylist() {
+  if (playlistCount == 0) {
+    LOG_WARN("⚠️ Playlist vacía");
     return false;
   }
+  return startExecution(playlist[0].sequence, false, true);
+}
+
+String SequenceManager::getPlaylistAsJson() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool active = isExecuting && playlistActive;
+  
+  String json = "{\"entries\":[";
+  for (int i = 0; i < playlistCount; i++) {
+    const Sequence& seq = sequences[playlist[i].sequence];
+    if (i > 0) json += ",";
+    json += "{\"index\":" + String(playlist[i].sequence) + ",";
+    json += "\"name\":\"" + String(seq.used ? seq.name : "") + "\",";
+    json += "\"repeat\":" + String(playlist[i].repeat);
+    if (seq.used && seq.analysis.valid) {
+      json += ",\"durationMs\":" + String((uint32_t)(seq.analysis.durationUs * playlist[i].repeat / 1000));
+    }
+    json += "}";
+  }
+  json += "],";
+  json += "\"loop\":" + String(playlistLoop ? "true" : "false") + ",";
+  json += "\"active\":" + String(active ? "true" : "false");
+  if (active) {
+    uint32_t elapsedMs = millis() - playlistStartMillis;
+    json += ",\"position\":" + String(playlistPosition) + ",";
+    json += "\"elapsedMs\":" + String(elapsedMs);
+    if (playlistEstimateUs > 0) {
+      uint32_t estimateMs = playlistEstimateUs / 1000;
+      json += ",\"remainingMs\":" + String(estimateMs > elapsedMs ? estimateMs - elapsedMs : 0);
+    }
+  }
+  json += ",\"handoff\":{";
+  json += "\"count\":" + String(handoffStats.count) + ",";
+  json += "\"lastUs\":" + String(handoffStats.lastUs) + ",";
+  json += "\"maxUs\":" + String(handoffStats.maxUs) + ",";
+  json += "\"prefetchMisses\":" + String(handoffStats.prefetchMisses) + "}";
+  json += "}";
   
-  return true;
+  xSemaphoreGive(mutex);
+  return json;
 }
 
-void SequenceManager::pause() {
+String SequenceManager::getStopLatencyAsJson() const {
+  DecelStats stats = stepperDriver->getDecelStats();
+  String json = "{\"stepper\":{";
+  json += "\"requests\":" + String(stats.requests) + ",";
+  json += "\"ramps\":" + String(stats.ramps) + ",";
+  json += "\"lastUs\":" + String(stats.lastLatencyUs) + ",";
+  json += "\"maxUs\":" + String(stats.maxLatencyUs) + ",";
+  json += "\"rampSteps\":" + String(stats.lastRampSteps) + ",";
+  // Cota a la velocidad mínima de las secuencias (0% = 100 steps/s)
+  json += "\"boundUs\":" + String(stepperDriver->getStopLatencyBoundUs(100)) + "},";
+  json += "\"servo\":{";
+  json += "\"lastUs\":" + String(servoDriver->getLastStopLatencyUs()) + ",";
+  json += "\"maxUs\":" + String(servoDriver->getMaxStopLatencyUs()) + "}}";
+  return json;
+}
+
+int SequenceManager::getSequenceCount() const {
+  int count = 0;
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (sequences[i].used) count++;
+  }
+  return count;
+}
+
+const Sequence* SequenceManager::getSequence(int index) const {
+  if (!isValidIndex(index)) {
+    return nullptr;
+  }
+  return &sequences[index];
+}
+
+int SequenceManager::getMovementCount(int sequenceIndex) const {
   xSemaphoreTake(mutex, portMAX_DELAY);
-  isPaused = true;
+  int count = isValidIndex(sequenceIndex) ? movementCount(sequences[sequenceIndex]) : 0;
   xSemaphoreGive(mutex);
-  Serial.println("⏸️ Secuencia pausada");
+  return count;
 }
 
-void SequenceManager::resume() {
+bool SequenceManager::getMovement(int sequenceIndex, int movementIndex, Movement& movement) const {
   xSemaphoreTake(mutex, portMAX_DELAY);
-  isPaused = false;
+  int record = isValidIndex(sequenceIndex) ? recordIndex(sequences[sequenceIndex], movementIndex) : -1;
+  bool valid = record >= 0;
+  if (valid) {
+    const Sequence& seq = sequences[sequenceIndex];
+    movement = unpackRecords(seq, record, recordSpan(seq, record));
+  }
   xSemaphoreGive(mutex);
-  Serial.println("▶️ Secuencia reanudada");
+  return valid;
 }
 
-void SequenceManager::stop() {
+bool SequenceManager::getGenerator(int sequenceIndex, int movementIndex, FrameGenerator& generator) const {
   xSemaphoreTake(mutex, portMAX_DELAY);
-  isExecuting = false;
-  isPaused = false;
+  int record = isValidIndex(sequenceIndex) ? recordIndex(sequences[sequenceIndex], movementIndex) : -1;
+  bool valid = record >= 0;
+  if (valid) {
+    const PackedMovement& packed = pool[sequences[sequenceIndex].offset + record];
+    valid = packed.flags & MOVE_GENERATOR;
+    if (valid) generator = generators[packed.steps];
+  }
   xSemaphoreGive(mutex);
+  return valid;
+}
+
+SequenceAnalysis SequenceManager::getAnalysis(int sequenceIndex) const {
+  SequenceAnalysis analysis;
+  resetAnalysis(analysis);
   
-  // Detener motores
-  servoDriver->stop();
-  stepperDriver->stop();
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (isValidIndex(sequenceIndex)) {
+    const Sequence& seq = sequences[sequenceIndex];
+    if (!seq.analysis.valid) analyzeSequence(seq);
+    analysis = seq.analysis;
+  }
+  xSemaphoreGive(mutex);
   
-  Serial.println("⏹️ Secuencia detenida");
+  return analysis;
 }
 
-const Sequence* SequenceManager::getSequence(int index) const {
-  if (index < 0 || index >= sequences.size()) {
-    return nullptr;
+PoolUsage SequenceManager::getPoolUsage() const {
+  PoolUsage usage;
+  usage.capacity = poolCapacity;
+  usage.reserved = 0;
+  usage.used = 0;
+  usage.sequences = 0;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (!sequences[i].used) continue;
+    usage.reserved += sequences[i].capacity;
+    usage.used += sequences[i].count;
+    usage.sequences++;
   }
-  return &sequences[index];
+  usage.largestFree = largestFreeRange();
+  xSemaphoreGive(mutex);
+  
+  return usage;
+}
+
+// Cota del JSON de una secuencia con 'movements' movimientos, para
+// reservarlo entero antes de armarlo
+size_t SequenceManager::jsonBytes(const Sequence& seq, int movements) const {
+  size_t bytes = 1024 + (size_t)movements * SEQUENCE_JSON_MOVEMENT_BYTES;
+  if (seq.type == SEQUENCE_KEYFRAMES && seq.path != nullptr) {
+    bytes += seq.path->getKeyframes().size() * 64;
+  }
+  if (seq.type == SEQUENCE_PROGRAM && seq.program != nullptr) {
+    bytes += seq.program->getByteSize() * 2;
+  }
+  if (seq.layers != nullptr) {
+    bytes += seq.layers->getCount() * 192;
+  }
+  return bytes;
 }
 
-String SequenceManager::getSequenceAsJson(int index) const {
-  if (index < 0 || index >= sequences.size()) {
+String SequenceManager::getSequenceAsJson(int index, int offset, int limit) const {
+  if (!isValidIndex(index)) {
     return "{}";
   }
   
   const Sequence& seq = sequences[index];
-  String json = "{";
-  json += "\"name\":\"" + seq.name + "\",";
+  int total = getMovementCount(index);
+  int first = constrain(offset, 0, total);
+  int shown = constrain(limit, 0, total - first);
+  
+  // String::concat no avisa si se queda sin memoria: se reserva todo antes
+  String json;
+  if (!json.reserve(jsonBytes(seq, shown))) {
+    LOG_WARN("⚠️ Secuencia %d: sin memoria para el JSON (%u bytes)", index, (unsigned)jsonBytes(seq, shown));
+    return String();
+  }
+  json += "{";
+  json += "\"index\":" + String(index) + ",";
+  json += "\"name\":\"" + String(seq.name) + "\",";
+  json += "\"type\":\"" + String(seq.type == SEQUENCE_KEYFRAMES ? "keyframes" :
+                                   seq.type == SEQUENCE_RECORDED ? "recorded" :
+                                   seq.type == SEQUENCE_PROGRAM ? "program" : "movements") + "\",";
   json += "\"loop\":" + String(seq.loop ? "true" : "false") + ",";
   json += "\"repeatCount\":" + String(seq.repeatCount) + ",";
+  json += "\"version\":" + String(seq.version) + ",";
+  json += "\"capacity\":" + String(seq.capacity) + ",";
+  json += "\"count\":" + String(total) + ",";
+  json += "\"offset\":" + String(first) + ",";
   json += "\"movements\":[";
   
-  for (size_t i = 0; i < seq.movements.size(); i++) {
-    if (i > 0) json += ",";
-    const Movement& m = seq.movements[i];
+  // Duración y posición acumulada (suma de prefijos) de cada movimiento,
+  // con el mismo modelo que el análisis de la secuencia. La página arranca
+  // en el bloque del análisis que la contiene; los movimientos anteriores
+  // del bloque solo se acumulan.
+  int angle = -1;
+  long positionSteps = 0;
+  int span = 1;
+  int startRecord = 0;
+  int startNumber = 0;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (seq.type == SEQUENCE_MOVEMENTS && !seq.analysis.valid) analyzeSequence(seq);
+  if (seq.analysis.valid && seq.blockCount > 0) {
+    SequenceAnalysis prefix;
+    startRecord = blockPrefix(seq, first, prefix, startNumber);
+    positionSteps = prefix.endSteps;
+    angle = prefix.lastAngle;
+  }
+  xSemaphoreGive(mutex);
+  for (int i = startRecord, number = startNumber; ; i += span, number++) {
+    PackedMovement packed;
+    FrameGenerator g;
+    SequenceAnalysis step;
+    Movement m;
+    
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool valid = i < seq.count && number < first + shown;
+    if (valid) {
+      packed = pool[seq.offset + i];
+      if (packed.flags & MOVE_GENERATOR) g = generators[packed.steps];
+      span = recordSpan(seq, i);
+      if (number >= first && !(packed.flags & MOVE_GENERATOR)) m = unpackRecords(seq, i, span);
+      resetAnalysis(step);
+      step.lastAngle = angle;
+      for (int k = 0; k < span; k++) {
+        accumulateMovement(step, pool[seq.offset + i + k]);
+      }
+    }
+    xSemaphoreGive(mutex);
+    if (!valid) break;
+    
+    positionSteps += step.endSteps;
+    angle = step.lastAngle;
+    if (number < first) continue;
+    
+    if (number > first) json += ",";
+    if (packed.flags & MOVE_GENERATOR) {
+      static const char* EASING_NAMES[] = { "linear", "in", "out", "inout" };
+      json += "{\"generator\":true,";
+      json += "\"frames\":" + String(g.frames) + ",";
+      json += "\"distance\":" + String(g.distance, 2) + ",";
+      json += "\"startAngle\":" + String(g.startAngle) + ",";
+      json += "\"endAngle\":" + String(g.endAngle) + ",";
+      json += "\"speed\":" + String(g.speed) + ",";
+      json += "\"angleSpeed\":" + String(g.angleSpeed) + ",";
+      json += "\"easing\":\"" + String(EASING_NAMES[g.easing]) + "\",";
+      json += "\"shutter\":" + String(g.shutter ? "true" : "false") + ",";
+      json += "\"interval\":" + String(g.intervalMs) + ",";
+      json += "\"settle\":" + String(g.settleMs) + ",";
+      json += "\"exposure\":" + String(g.exposureMs) + ",";
+      json += "\"durationMs\":" + String((uint32_t)(step.durationUs / 1000)) + ",";
+      json += "\"positionMm\":" + String(stepperDriver->stepsToMm(positionSteps, MM_PER_REVOLUTION), 2) + "}";
+      continue;
+    }
+    
     json += "{";
     json += "\"distance\":" + String(m.horizontalDistance, 2) + ",";
     json += "\"speed\":" + String(m.horizontalSpeed) + ",";
     json += "\"angle\":" + String(m.angle) + ",";
     json += "\"angleSpeed\":" + String(m.angleSpeed) + ",";
     json += "\"simultaneous\":" + String(m.simultaneous ? "true" : "false") + ",";
-    json += "\"pause\":" + String(m.pauseAfter);
+    json += "\"pause\":" + String(m.pauseAfter) + ",";
+    if (span > 1) {
+      json += "\"axes\":[";
+      bool first = true;
+      for (int axis = 0; axis < MAX_MOTION_AXES; axis++) {
+        if (!m.axes[axis].active) continue;
+        if (!first) json += ",";
+        json += "{\"axis\":" + String(axis) + ",";
+        json += "\"value\":" + String(m.axes[axis].value, 2) + ",";
+        json += "\"speed\":" + String(m.axes[axis].speed) + "}";
+        first = false;
+      }
+      json += "],";
+    }
+    json += "\"durationMs\":" + String((uint32_t)(step.durationUs / 1000)) + ",";
+    json += "\"positionMm\":" + String(stepperDriver->stepsToMm(positionSteps, MM_PER_REVOLUTION), 2);
     json += "}";
   }
   
-  json += "]}";
+  json += "],\"more\":" + String(first + shown < total ? "true" : "false");
+  
+  if (seq.type == SEQUENCE_KEYFRAMES && seq.path != nullptr) {
+    const std::vector<Keyframe>& keys = seq.path->getKeyframes();
+    json += ",\"interp\":\"";
+    json += seq.path->getInterpolation() == INTERP_CATMULL_ROM ? "catmull" : "monotone";
+    json += "\",\"keyframes\":[";
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (i > 0) json += ",";
+      json += "{\"t\":" + String(keys[i].timeMs) + ",";
+      json += "\"pos\":" + String(keys[i].position, 2) + ",";
+      json += "\"angle\":" + String(keys[i].angle, 1) + "}";
+    }
+    json += "]";
+  }
+  if (seq.type == SEQUENCE_RECORDED && seq.recording != nullptr) {
+    json += ",\"recording\":{";
+    json += "\"points\":" + String(seq.recording->getPointCount()) + ",";
+    json += "\"bytes\":" + String((uint32_t)seq.recording->getByteSize()) + ",";
+    json += "\"durationMs\":" + String(seq.recording->getDurationMs()) + "}";
+  }
+  if (seq.type == SEQUENCE_PROGRAM && seq.program != nullptr) {
+    json += ",\"program\":" + seq.program->getAsJson();
+  }
+  if (isTrajectory(seq)) {
+    json += ",\"playbackSpeed\":" + String(seq.playbackPercent);
+    json += ",\"layers\":" + (seq.layers != nullptr ? seq.layers->getAsJson() : String("[]"));
+  }
+  
+  // Análisis: duración, ETA y envolvente
+  SequenceAnalysis analysis = getAnalysis(index);
+  String reason;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint64_t startupUs = startupDurationUs(seq);
+  bool allowed = checkLimits(seq, stepperDriver->getCurrentPosition(), max(seq.repeatCount, 1),
+                             seq.loop, reason);
+  xSemaphoreGive(mutex);
+  
+  int passes = max(seq.repeatCount, 1);
+  json += ",\"analysis\":{";
+  json += "\"durationMs\":" + String((uint32_t)(analysis.durationUs / 1000)) + ",";
+  json += "\"startupMs\":" + String((uint32_t)(startupUs / 1000)) + ",";
+  if (seq.loop) {
+    json += "\"totalMs\":-1,";
+  } else {
+    json += "\"totalMs\":" + String((uint32_t)((startupUs + analysis.durationUs * passes) / 1000)) + ",";
+  }
+  json += "\"endMm\":" + String(stepperDriver->stepsToMm(analysis.endSteps, MM_PER_REVOLUTION), 2) + ",";
+  json += "\"minMm\":" + String(stepperDriver->stepsToMm(analysis.minSteps, MM_PER_REVOLUTION), 2) + ",";
+  json += "\"maxMm\":" + String(stepperDriver->stepsToMm(analysis.maxSteps, MM_PER_REVOLUTION), 2) + ",";
+  json += "\"absolute\":" + String(isTrajectory(seq) ? "true" : "false") + ",";
+  json += "\"minAngle\":" + String(analysis.minAngle) + ",";
+  json += "\"maxAngle\":" + String(analysis.maxAngle) + ",";
+  json += "\"peakStepRate\":" + String(analysis.peakStepRate) + ",";
+  json += "\"allowed\":" + String(allowed ? "true" : "false");
+  if (!allowed) {
+    json += ",\"reason\":\"" + reason + "\"";
+  }
+  if (getIsExecuting() && activeSequenceIndex == index) {
+    uint32_t elapsedMs = millis() - executionStartMillis;
+    json += ",\"elapsedMs\":" + String(elapsedMs);
+    if (executionEstimateUs > 0) {
+      uint32_t estimateMs = executionEstimateUs / 1000;
+      json += ",\"remainingMs\":" + String(estimateMs > elapsedMs ? estimateMs - elapsedMs : 0);
+    }
+  }
+  json += "}";
+  
+  json += "}";
   return json;
 }
 
 String SequenceManager::getAllSequencesAsJson() const {
-  String json = "[";
+  size_t bytes = 2;
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (sequences[i].used) bytes += jsonBytes(sequences[i], 0) + 1;
+  }
+  String json;
+  if (!json.reserve(bytes)) {
+    return String();
+  }
+  json += "[";
+  bool first = true;
   
-  for (size_t i = 0; i < sequences.size(); i++) {
-    if (i > 0) json += ",";
-    json += getSequenceAsJson(i);
+  for (int i = 0; i < MAX_SEQUENCES; i++) {
+    if (!sequences[i].used) continue;
+    String entry = getSequenceAsJson(i, 0, 0);
+    if (entry.length() == 0) {
+      return String();
+    }
+    if (!first) json += ",";
+    json += entry;
+    first = false;
   }
   
   json += "]";
   return json;
 }
+
+String SequenceManager::getPoolUsageAsJson() const {
+  PoolUsage usage = getPoolUsage();
+  String json = "{";
+  json += "\"capacity\":" + String(usage.capacity) + ",";
+  json += "\"bytes\":" + String((unsigned long)(usage.capacity * sizeof(PackedMovement) +
+                                         usage.capacity / ANALYSIS_BLOCK_MOVEMENTS * sizeof(AnalysisBlock))) + ",";
+  json += "\"reserved\":" + String(usage.reserved) + ",";
+  json += "\"used\":" + String(usage.used) + ",";
+  json += "\"largestFree\":" + String(usage.largestFree) + ",";
+  json += "\"sequences\":" + String(usage.sequences) + ",";
+  json += "\"maxSequences\":" + String(MAX_SEQUENCES) + ",";
+  json += "\"bytesPerMovement\":" + String((int)sizeof(PackedMovement));
+  json += "}";
+  return json;
+}
@@ -1,12 +1,30 @@
 #include "drivers/ServoDriver.h"
+#include "TaskConfig.h"
+#include "PowerManager.h"
+#include "EmergencyStop.h"
+#include "Log.h"
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
+
+// Grados recorridos durante el frenado controlado
+static const int SERVO_DECEL_DEGREES = 2;
+
+// Recuperación de juego: un grado cada SERVO_TAKEUP_MS (la rampa más rápida)
+static const int SERVO_TAKEUP_MS = 10;
+static const int MAX_BACKLASH_DEG = 10;
 
 ServoDriver::ServoDriver(int servoPin) 
-  : pin(servoPin), currentAngle(90), defaultSpeed(50), isMoving(false),
-    servoAttached(false) {
+  : pin(servoPin), currentAngle(90), defaultSpeed(50), feedPercent(100), isMoving(false),
+    servoAttached(false), angleKnown(false), holdLocked(false), sleepDetached(false),
+    idleTimeoutMs(10000),
+    lastActivityMillis(0), decelRequested(false), decelRequestUs(0),
+    lastStopLatencyUs(0), maxStopLatencyUs(0),
+    backlashDeg(0), lastForward(true), backlashOffset(0), slaved(false),
+    emergencyStopFlag(nullptr), emergencyMutex(nullptr) {
   commandQueue = nullptr;
   taskHandle = nullptr;
   mutex = nullptr;
+  taskExitRequested = false;
 }
 
 ServoDriver::~ServoDriver() {
@@ -33,35 +51,58 @@ bool ServoDriver::begin() {
   // Crear mutex
   mutex = xSemaphoreCreateMutex();
   if (mutex == nullptr) {
-    Serial.println("❌ ServoDriver: Error creando mutex");
+    LOG_ERROR("❌ ServoDriver: Error creando mutex");
     return false;
   }
   
   // Crear cola de comandos
   commandQueue = xQueueCreate(10, sizeof(ServoCommand));
   if (commandQueue == nullptr) {
-    Serial.println("❌ ServoDriver: Error creando queue");
+    LOG_ERROR("❌ ServoDriver: Error creando queue");
     return false;
   }
   
   // Crear task
+  if (!createTask()) {
+    LOG_ERROR("❌ ServoDriver: Error creando task");
+    return false;
+  }
+  
+  LOG_INFO("✅ ServoDriver inicializado en pin %d", pin);
+  return true;
+}
+
+void ServoDriver::setEmergencyFlag(volatile bool* flag, portMUX_TYPE* mutex) {
+  emergencyStopFlag = flag;
+  emergencyMutex = mutex;
+}
+
+bool ServoDriver::createTask() {
+  const TaskPlacement& placement = getTaskPlacement(TASK_SERVO);
   BaseType_t result = xTaskCreatePinnedToCore(
     servoTask,
     "ServoTask",
-    8192,  // Aumentar stack a 8KB
+    placement.stackSize,
     this,
-    2,
+    placement.priority,
     &taskHandle,
-    1  // Core 1
+    placement.core
   );
   
-  if (result != pdPASS) {
-    Serial.println("❌ ServoDriver: Error creando task");
-    return false;
+  return result == pdPASS;
+}
+
+bool ServoDriver::restartTask() {
+  if (isMoving || getQueuedCommands() > 0) return false;
+  
+  // La task termina sola en su próxima iteración (como mucho 100 ms)
+  if (taskHandle != nullptr) {
+    taskExitRequested = true;
+    while (taskHandle != nullptr) vTaskDelay(pdMS_TO_TICKS(10));
+    taskExitRequested = false;
   }
   
-  Serial.printf("✅ ServoDriver inicializado en pin %d\n", pin);
-  return true;
+  return createTask();
 }
 
 void ServoDriver::servoTask(void* parameter) {
@@ -71,17 +112,25 @@ void ServoDriver::servoTask(void* parameter) {
   // Suscribir task al watchdog
   esp_task_wdt_add(NULL);
   
-  while (true) {
+  while (!driver->taskExitRequested) {
     // Resetear watchdog al inicio de cada iteración
     esp_task_wdt_reset();
     
     if (xQueueReceive(driver->commandQueue, &cmd, pdMS_TO_TICKS(100)) == pdTRUE) {
       driver->processCommand(cmd);
+    } else {
+      driver->checkIdle();
     }
   }
+  
+  driver->taskHandle = nullptr;
+  esp_task_wdt_delete(NULL);
+  vTaskDelete(NULL);
 }
 
 void ServoDriver::processCommand(ServoCommand cmd) {
+  if (emergencyActive()) return;
+  
   xSemaphoreTake(mutex, portMAX_DELAY);
   isMoving = true;
   xSemaphoreGive(mutex);
@@ -90,59 +139,188 @@ void ServoDriver::processCommand(ServoCommand cmd) {
   int speed = (cmd.speed < 0) ? defaultSpeed : cmd.speed;
   speed = constrain(speed, 1, 100);
 
-  if (!servoAttached) {
-    servo.attach(pin, 500, 2400);
-    servo.write(targetAngle);
+  if (!servoAttached && !angleKnown) {
+    // Primer comando tras el arranque: la posición real es desconocida
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    writeAngle(targetAngle);
     currentAngle = targetAngle;
     servoAttached = true;
+    angleKnown = true;
+    powerSetLoad(POWER_SERVO_ATTACHED, true);
 
     xSemaphoreTake(mutex, portMAX_DELAY);
     isMoving = false;
+    lastActivityMillis = millis();
     xSemaphoreGive(mutex);
 
-    Serial.printf("✅ Servo activado tras primer comando: %d°\n", currentAngle);
+    LOG_INFO("✅ Servo activado tras primer comando: %d°", currentAngle);
     return;
   }
   
+  if (!servoAttached) {
+    // Desconectado por inactividad: reconectar donde quedó y luego mover
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    writeAngle(currentAngle);
+    servoAttached = true;
+    powerSetLoad(POWER_SERVO_ATTACHED, true);
+  }
+  
+  powerSetLoad(POWER_SERVO_MOVING, true);
+  
+  if (targetAngle != currentAngle) {
+    takeUp(targetAngle > currentAngle);
+  }
+  
   // Calcular delay basado en velocidad (1-100% -> 50ms-10ms) - más lento
   int delayTime = map(speed, 0, 100, 50, 10);
   
   // Mover suavemente con paso más pequeño (0.5 grados)
   int steps = abs(targetAngle - currentAngle) * 2; // Duplicar pasos para paso de 0.5°
   int direction = (targetAngle > currentAngle) ? 1 : -1;
+  int rampStart = -1;
   
   for (int i = 0; i < steps; i++) {
+    if (emergencyActive()) {
+      emergencyStopAck(ESTOP_ACK_SERVO);
+      break;
+    }
+    if (slaved) {
+      break;
+    }
+    
+    // Frenado: unos grados más con iteraciones cada vez más largas, sin
+    // pasar del objetivo
+    if (decelRequested && rampStart < 0) {
+      uint32_t latency = esp_timer_get_time() - decelRequestUs;
+      lastStopLatencyUs = latency;
+      if (latency > maxStopLatencyUs) maxStopLatencyUs = latency;
+      rampStart = i;
+      steps = min(steps, i + SERVO_DECEL_DEGREES * 2);
+    }
+    
     // Actualizar cada 2 iteraciones (paso de 0.5°)
     if (i % 2 == 0) {
       currentAngle += direction;
-      servo.write(currentAngle);
+      writeAngle(currentAngle);
     }
     
     // Usar vTaskDelay para no bloquear el watchdog
-    vTaskDelay(pdMS_TO_TICKS(delayTime));
+    int wait = rampStart < 0 ? delayTime : delayTime * (2 + i - rampStart);
+    vTaskDelay(pdMS_TO_TICKS(max(1, wait * 100 / feedPercent)));
   }
   
+  powerSetLoad(POWER_SERVO_MOVING, false);
+  
   xSemaphoreTake(mutex, portMAX_DELAY);
   isMoving = false;
+  lastActivityMillis = millis();
+  xSemaphoreGive(mutex);
+  
+  LOG_DEBUG("✅ Servo en posición: %d°", currentAngle);
+}
+
+void ServoDriver::checkIdle() {
+  if (!servoAttached || isMoving || holdLocked || idleTimeoutMs == 0) return;
+  if (millis() - lastActivityMillis < idleTimeoutMs) return;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  servo.detach();
+  servoAttached = false;
+  xSemaphoreGive(mutex);
+  powerSetLoad(POWER_SERVO_ATTACHED, false);
+  LOG_INFO("💤 Servo desconectado por inactividad (%d°)", currentAngle);
+}
+
+void ServoDriver::setHoldLock(bool locked) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  holdLocked = locked;
+  lastActivityMillis = millis();
+  bool reattach = locked && !servoAttached && angleKnown;
+  if (reattach) {
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    writeAngle(currentAngle);
+    servoAttached = true;
+  }
+  xSemaphoreGive(mutex);
+  
+  if (reattach) powerSetLoad(POWER_SERVO_ATTACHED, true);
+}
+
+bool ServoDriver::suspendForSleep() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (isMoving || uxQueueMessagesWaiting(commandQueue) > 0) {
+    xSemaphoreGive(mutex);
+    return false;
+  }
+  bool detach = servoAttached;
+  if (detach) {
+    servo.detach();
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    servoAttached = false;
+    sleepDetached = true;
+  }
   xSemaphoreGive(mutex);
   
-  Serial.printf("✅ Servo en posición: %d°\n", currentAngle);
+  if (detach) powerSetLoad(POWER_SERVO_ATTACHED, false);
+  return true;
+}
+
+void ServoDriver::resumeAfterSleep() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool reattach = sleepDetached && !servoAttached;
+  if (reattach) {
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    writeAngle(currentAngle);
+    servoAttached = true;
+  }
+  sleepDetached = false;
+  xSemaphoreGive(mutex);
+  
+  if (reattach) powerSetLoad(POWER_SERVO_ATTACHED, true);
+}
+
+void ServoDriver::restoreAngle(int angle) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (!servoAttached) {
+    currentAngle = constrain(angle, 0, 180);
+    angleKnown = true;
+  }
+  xSemaphoreGive(mutex);
+}
+
+void ServoDriver::setIdleTimeout(uint32_t ms) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  idleTimeoutMs = ms;
+  lastActivityMillis = millis();
+  xSemaphoreGive(mutex);
+}
+
+// Mismo modelo que processCommand(): 2 iteraciones por grado de 'delayTime' ms
+uint32_t ServoDriver::estimateMoveMs(int fromAngle, int toAngle, int speed) const {
+  speed = constrain(speed < 0 ? defaultSpeed : speed, 1, 100);
+  int delayTime = map(speed, 0, 100, 50, 10);
+  uint32_t iterations = abs(constrain(toAngle, 0, 180) - constrain(fromAngle, 0, 180)) * 2;
+  return iterations * pdMS_TO_TICKS(delayTime) * portTICK_PERIOD_MS;
 }
 
 bool ServoDriver::moveTo(int angle, int speed, bool wait) {
+  if (emergencyActive()) return false;
+  if (slaved) return true;
+  decelRequested = false;
   ServoCommand cmd;
   cmd.targetAngle = angle;
   cmd.speed = speed;
   cmd.waitCompletion = wait;
   
   if (xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
-    Serial.println("❌ ServoDriver: Queue llena");
+    LOG_ERROR("❌ ServoDriver: Queue llena");
     return false;
   }
   
   if (wait) {
-    // Esperar a que termine el movimiento
-    while (isMoving) {
+    // Esperar a que termine el movimiento (incluye comandos aún en cola)
+    while (isMoving || uxQueueMessagesWaiting(commandQueue) > 0) {
       vTaskDelay(pdMS_TO_TICKS(10));
     }
   }
@@ -150,12 +328,88 @@ bool ServoDriver::moveTo(int angle, int speed, bool wait) {
   return true;
 }
 
+void ServoDriver::setAngleImmediate(float angle) {
+  if (slaved) return;
+  applyAngle(angle);
+}
+
+void ServoDriver::setSlaved(bool on) {
+  slaved = on;
+  if (on) {
+    xQueueReset(commandQueue);
+  }
+}
+
+void ServoDriver::trackAngle(float angle) {
+  if (slaved) applyAngle(angle);
+}
+
+// Las trayectorias muestreadas recuperan el juego repartido entre muestras
+// sucesivas, a lo sumo un grado por llamada
+void ServoDriver::applyAngle(float angle) {
+  if (emergencyActive()) return;
+  angle = constrain(angle, 0.0f, 180.0f);
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (!servoAttached) {
+    servo.attach(pin, MIN_PULSE_US, MAX_PULSE_US);
+    servoAttached = true;
+    powerSetLoad(POWER_SERVO_ATTACHED, true);
+  }
+  if (angleKnown && fabsf(angle - currentAngle) >= 1.0f) {
+    lastForward = angle > currentAngle;
+  }
+  float goal = lastForward ? 0.0f : -(float)backlashDeg;
+  backlashOffset += constrain(goal - backlashOffset, -1.0f, 1.0f);
+  writeAngle(angle);
+  currentAngle = (int)(angle + 0.5f);
+  angleKnown = true;
+  lastActivityMillis = millis();
+  xSemaphoreGive(mutex);
+}
+
+// Ángulo lógico más la corrección de juego vigente
+void ServoDriver::writeAngle(float angle) {
+  float output = constrain(angle + backlashOffset, 0.0f, 180.0f);
+  servo.writeMicroseconds(MIN_PULSE_US + (int)(output * (MAX_PULSE_US - MIN_PULSE_US) / 180.0f + 0.5f));
+}
+
+// Lleva la corrección a la del nuevo sentido sin mover el ángulo lógico
+void ServoDriver::takeUp(bool forward) {
+  lastForward = forward;
+  float goal = forward ? 0.0f : -(float)backlashDeg;
+  while (backlashOffset != goal && !emergencyActive()) {
+    backlashOffset += constrain(goal - backlashOffset, -1.0f, 1.0f);
+    writeAngle(currentAngle);
+    vTaskDelay(pdMS_TO_TICKS(SERVO_TAKEUP_MS));
+  }
+}
+
+void ServoDriver::setBacklash(int degrees) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  backlashDeg = constrain(degrees, 0, MAX_BACKLASH_DEG);
+  xSemaphoreGive(mutex);
+}
+
+uint32_t ServoDriver::getTakeUpMs() const {
+  return backlashDeg * pdMS_TO_TICKS(SERVO_TAKEUP_MS) * portTICK_PERIOD_MS;
+}
+
+int ServoDriver::getQueuedCommands() const {
+  if (commandQueue == nullptr) return 0;
+  return uxQueueMessagesWaiting(commandQueue);
+}
+
 void ServoDriver::setDefaultSpeed(int speed) {
   xSemaphoreTake(mutex, portMAX_DELAY);
   defaultSpeed = constrain(speed, 1, 100);
   xSemaphoreGive(mutex);
 }
 
+void ServoDriver::setFeedOverride(int percent) {
+  feedPercent = constrain(percent, 1, 400);
+}
+
 void ServoDriver::stop() {
   // Limpiar la cola de comandos
   xQueueReset(commandQueue);
@@ -163,3 +417,9 @@ void ServoDriver::stop() {
   isMoving = false;
   xSemaphoreGive(mutex);
 }
+
+void ServoDriver::decelerateStop() {
+  xQueueReset(commandQueue);
+  decelRequestUs = esp_timer_get_time();
+  decelRequested = true;
+}
@@ -1,18 +1,51 @@
 #include "drivers/StepperDriver.h"
+#include "TaskConfig.h"
+#include "PowerManager.h"
+#include "EmergencyStop.h"
+#include "PositionTriggers.h"
+#include "Checkpoint.h"
+#include "Log.h"
 #include <esp_task_wdt.h>
+#include <esp_timer.h>
+
+// Tiempo para que el TB6600 recupere la corriente tras activar ENA
+static const uint32_t HOLD_RESTORE_MS = 5;
+
+// Ancho del pulso PUL y cada cuántos pasos se cede la CPU un tick
+static const uint32_t STEP_PULSE_US = 5;
+static const long FEED_WDT_EVERY = 100;
+
+// La rampa de frenado termina al bajar de esta velocidad (la mínima de
+// las secuencias)
+static const int MIN_RAMP_SPEED = 100;
+
+// Calibración de juego: recorrido máximo buscando el final de carrera y
+// juego máximo creíble, en vueltas, y pasos con que se aleja en cada ciclo
+static const long CALIBRATION_MAX_REVS = 200;
+static const long CALIBRATION_MAX_DEAD_BAND = 1;
+static const long CALIBRATION_CLEAR_STEPS = 100;
 
 // Constructor actualizado
 StepperDriver::StepperDriver(int pul, int dir, int ena, int lim1, int lim2, int ledGreen)
   : pinPUL(pul), pinDIR(dir), pinENA(ena), pinLimit1(lim1), pinLimit2(lim2), pinLedGreen(ledGreen),
     currentPosition(0), targetPosition(0), currentSpeed(1000),
-    isMoving(false), isEnabled(false), shouldAbort(false),
-    stepsPerRevolution(200), maxSpeed(2000), acceleration(500) {
+    isMoving(false), isEnabled(false), holdReleased(false), holdLocked(false),
+    idleTimeoutMs(30000), lastActivityMillis(0), shouldAbort(false), decelRequested(false),
+    feedPercent(100), decelRequestUs(0), firstStepPending(false), firstStepFromUs(0),
+    stepsPerRevolution(200), maxSpeed(2000), acceleration(500),
+    backlashSteps(0), takeUpSpeed(400), lastDirection(0), calibrationSpeed(200) {
   
   emergencyStopFlag = nullptr;
   emergencyMutex = nullptr;
   commandQueue = nullptr;
   taskHandle = nullptr;
   mutex = nullptr;
+  taskExitRequested = false;
+  timingCapture = false;
+  memset(&timingStats, 0, sizeof(timingStats));
+  memset(&decelStats, 0, sizeof(decelStats));
+  memset(&firstStepStats, 0, sizeof(firstStepStats));
+  memset(&calibration, 0, sizeof(calibration));
   portMUX_INITIALIZE(&abortMux);
 }
 
@@ -54,13 +87,30 @@ bool StepperDriver::begin(int stepsPerRev) {
   commandQueue = xQueueCreate(10, sizeof(StepperCommand));
   if (commandQueue == nullptr) return false;
   
+  return createTask();
+}
+
+bool StepperDriver::createTask() {
+  const TaskPlacement& placement = getTaskPlacement(TASK_STEPPER);
   BaseType_t result = xTaskCreatePinnedToCore(
-    stepperTask, "StepperTask", 8192, this, 1, &taskHandle, 0
+    stepperTask, "StepperTask", placement.stackSize, this,
+    placement.priority, &taskHandle, placement.core
   );
   
-  if (result != pdPASS) return false;
+  return result == pdPASS;
+}
+
+bool StepperDriver::restartTask() {
+  if (isMoving || getQueuedCommands() > 0) return false;
+  
+  // La task termina sola en su próxima iteración (como mucho 100 ms)
+  if (taskHandle != nullptr) {
+    taskExitRequested = true;
+    while (taskHandle != nullptr) vTaskDelay(pdMS_TO_TICKS(10));
+    taskExitRequested = false;
+  }
   
-  return true;
+  return createTask();
 }
 
 void StepperDriver::stepperTask(void* parameter) {
@@ -68,16 +118,69 @@ void StepperDriver::stepperTask(void* parameter) {
   StepperCommand cmd;
   esp_task_wdt_add(NULL);
   
-  while (true) {
+  while (!driver->taskExitRequested) {
     esp_task_wdt_reset();
     if (xQueueReceive(driver->commandQueue, &cmd, pdMS_TO_TICKS(100)) == pdTRUE) {
       driver->processCommand(cmd);
+    } else {
+      driver->checkIdle();
     }
   }
+  
+  driver->taskHandle = nullptr;
+  esp_task_wdt_delete(NULL);
+  vTaskDelete(NULL);
+}
+
+void StepperDriver::checkIdle() {
+  if (emergencyActive()) {
+    releaseForEmergency();
+    return;
+  }
+  if (!isEnabled || holdReleased || holdLocked || idleTimeoutMs == 0) return;
+  if (millis() - lastActivityMillis < idleTimeoutMs) return;
+  
+  if (pinENA >= 0) digitalWrite(pinENA, HIGH);
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  holdReleased = true;
+  xSemaphoreGive(mutex);
+  powerSetLoad(POWER_STEPPER_HOLD, false);
+  LOG_INFO("💤 Stepper: corriente de retención liberada");
+}
+
+// ENA ya está desactivado por emergencyCut(): se registra como retención
+// liberada para que el primer movimiento tras el reset la restaure
+void StepperDriver::releaseForEmergency() {
+  if (!isEnabled || holdReleased) return;
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  holdReleased = true;
+  lastDirection = 0;           // Sin corriente el juego queda donde caiga
+  xSemaphoreGive(mutex);
+  powerSetLoad(POWER_STEPPER_HOLD, false);
+}
+
+void StepperDriver::restoreHold() {
+  if (pinENA >= 0) digitalWrite(pinENA, LOW);
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  holdReleased = false;
+  xSemaphoreGive(mutex);
+  powerSetLoad(POWER_STEPPER_HOLD, true);
+  vTaskDelay(pdMS_TO_TICKS(HOLD_RESTORE_MS));
 }
 
 void StepperDriver::processCommand(StepperCommand cmd) {
   if (!isEnabled) return;
+  if (emergencyActive()) {
+    releaseForEmergency();
+    return;
+  }
+  
+  if (holdReleased) restoreHold();
+  
+  if (cmd.calibrate) {
+    runBacklashCalibration();
+    return;
+  }
   
   esp_task_wdt_reset();
   xSemaphoreTake(mutex, portMAX_DELAY);
@@ -109,23 +212,54 @@ void StepperDriver::processCommand(StepperCommand cmd) {
   int speed = (cmd.speed > 0) ? cmd.speed : currentSpeed;
   speed = constrain(speed, 1, maxSpeed);
   
-  stepMotor(stepsToMove, speed);
+  powerSetLoad(POWER_STEPPER_MOVING, true);
+  stepMotor(stepsToMove, speed, cmd.profiled);
+  powerSetLoad(POWER_STEPPER_MOVING, false);
+  if (emergencyActive()) releaseForEmergency();
   
   xSemaphoreTake(mutex, portMAX_DELAY);
   isMoving = false;
+  lastActivityMillis = millis();
   xSemaphoreGive(mutex);
   
   // Apagar LED verde cuando termina de moverse
   if (pinLedGreen >= 0) digitalWrite(pinLedGreen, LOW);
 }
 
-void StepperDriver::stepMotor(long steps, int speed) {
+void StepperDriver::stepMotor(long steps, int speed, bool profiled) {
   bool forward = steps > 0;
   digitalWrite(pinDIR, forward ? HIGH : LOW);
   
+  // Al invertir el sentido el motor gira el juego antes de que el carro se
+  // mueva. Si se abandona a mitad, lastDirection no cambia y el próximo
+  // movimiento en este sentido lo recupera entero.
+  int8_t direction = forward ? 1 : -1;
+  if (lastDirection != 0 && direction != lastDirection && backlashSteps > 0) {
+    if (!takeUp()) return;
+  }
+  lastDirection = direction;
+  
   long absSteps = abs(steps);
-  unsigned long delayMicros = 1000000 / speed;
-  const int FEED_WDT_EVERY = 100;
+  
+  // Crucero = speed · feed / 100. Arranca ya a esa velocidad (como sin
+  // override) y, si el feed cambia en marcha, la sigue con la aceleración.
+  // Con perfil arranca desde MIN_RAMP_SPEED y no aplica el feed.
+  profiled = profiled && acceleration > 0;
+  uint16_t feed = profiled ? 100 : feedPercent;
+  float cruiseSpeed = feedSpeed(speed, feed);
+  float runSpeed = profiled ? min(cruiseSpeed, (float)MIN_RAMP_SPEED) : cruiseSpeed;
+  unsigned long delayMicros = 1000000 / runSpeed;
+  
+  // Jitter: solo se miden intervalos sin cesión voluntaria de CPU
+  unsigned long lastStepMicros = 0;
+  bool measureNext = false;
+  bool capture = timingCapture && delayMicros <= 10000;
+  
+  // Velocidad durante la rampa de frenado (0 = sin frenar)
+  float rampSpeed = 0;
+  
+  // La posición pudo cambiar desde el último movimiento (cero, calibración)
+  positionTriggerSync(currentPosition);
   
   for (long i = 0; i < absSteps; i++) {
     // === PROTECCIÓN DE FINALES DE CARRERA ===
@@ -135,37 +269,320 @@ void StepperDriver::stepMotor(long steps, int speed) {
 
     // Si voy hacia atrás (Start) y toco Limit1 -> Parar
     if (!forward && hitLimit1) {
-       Serial.println("⛔ LIMITE 1 (Inicio) Alcanzado");
+       LOG_WARN("⛔ LIMITE 1 (Inicio) Alcanzado");
        break; 
     }
     // Si voy hacia adelante (Fin) y toco Limit2 -> Parar
     if (forward && hitLimit2) {
-       Serial.println("⛔ LIMITE 2 (Final) Alcanzado");
+       LOG_WARN("⛔ LIMITE 2 (Final) Alcanzado");
        break; 
     }
     // ========================================
 
     if (shouldAbort) break;
+    if (emergencyActive()) {
+      emergencyStopAck(ESTOP_ACK_STEPPER);
+      break;
+    }
     
+    if (decelRequested && rampSpeed == 0) {
+      uint32_t latency = esp_timer_get_time() - decelRequestUs;
+      decelStats.ramps++;
+      decelStats.lastLatencyUs = latency;
+      if (latency > decelStats.maxLatencyUs) decelStats.maxLatencyUs = latency;
+      decelStats.lastRampSteps = 0;
+      rampSpeed = runSpeed;
+      capture = false;
+    }
+    if (profiled && rampSpeed == 0) {
+      // Acelerar hacia el crucero sin pasar de la velocidad desde la que
+      // todavía se frena a MIN_RAMP_SPEED en los pasos que quedan
+      float reachable = sqrtf((float)MIN_RAMP_SPEED * MIN_RAMP_SPEED + 2.0f * acceleration * (absSteps - i));
+      float next = min(approachSpeed(runSpeed, cruiseSpeed), max(reachable, (float)MIN_RAMP_SPEED));
+      if (next != runSpeed) {
+        runSpeed = next;
+        delayMicros = 1000000 / runSpeed;
+        capture = false;
+      }
+    } else if (rampSpeed == 0 && (feedPercent != feed || runSpeed != cruiseSpeed)) {
+      feed = feedPercent;
+      cruiseSpeed = feedSpeed(speed, feed);
+      runSpeed = approachSpeed(runSpeed, cruiseSpeed);
+      delayMicros = 1000000 / runSpeed;
+      capture = false;
+    }
+    if (rampSpeed > 0) {
+      // v² = v0² - 2·a·x, recalculado en cada paso
+      float v2 = rampSpeed * rampSpeed - 2.0f * acceleration;
+      if (acceleration <= 0 || v2 < (float)MIN_RAMP_SPEED * MIN_RAMP_SPEED) break;
+      rampSpeed = sqrtf(v2);
+      delayMicros = 1000000 / rampSpeed;
+      decelStats.lastRampSteps++;
+    }
+    
+    if (capture) {
+      unsigned long now = micros();
+      if (measureNext) {
+        long deviation = (long)(now - lastStepMicros) - (long)(delayMicros + STEP_PULSE_US);
+        uint32_t absDeviation = abs(deviation);
+        timingStats.samples++;
+        timingStats.sumDeviationUs += deviation;
+        timingStats.sumSquaredUs += (int64_t)deviation * deviation;
+        if (absDeviation > timingStats.maxDeviationUs) timingStats.maxDeviationUs = absDeviation;
+      }
+      lastStepMicros = now;
+      measureNext = true;
+    }
+    
+    if (firstStepPending) stampFirstStep();
     digitalWrite(pinPUL, HIGH);
-    delayMicroseconds(5);
+    delayMicroseconds(STEP_PULSE_US);
     digitalWrite(pinPUL, LOW);
     
     xSemaphoreTake(mutex, portMAX_DELAY);
     if (forward) currentPosition++;
     else currentPosition--;
+    long position = currentPosition;
     xSemaphoreGive(mutex);
     
+    positionTriggerStep(position, forward);
+    
     if (delayMicros > 10000) {
       vTaskDelay(pdMS_TO_TICKS(delayMicros / 1000));
     } else {
       delayMicroseconds(delayMicros);
     }
     
-    if (i % FEED_WDT_EVERY == 0) vTaskDelay(1);
+    if (i > 0 && i % FEED_WDT_EVERY == 0) {
+      vTaskDelay(1);
+      measureNext = false;
+    }
   }
 }
 
+float StepperDriver::feedSpeed(int speed, uint16_t feed) const {
+  if (feed == 100) return speed;
+  return constrain(speed * feed / 100.0f, 1.0f, (float)maxSpeed);
+}
+
+// Un paso de la rampa hacia 'target': v² = v0² ± 2·a
+float StepperDriver::approachSpeed(float current, float target) const {
+  if (acceleration <= 0) return target;
+  if (current < target) {
+    return min(target, sqrtf(current * current + 2.0f * acceleration));
+  }
+  float v2 = current * current - 2.0f * acceleration;
+  return v2 <= target * target ? target : sqrtf(v2);
+}
+
+// Un paso sin contar posición ni rampa (recuperación de juego y
+// calibración). false si hay que abandonar.
+bool StepperDriver::pulseStep(unsigned long delayMicros) {
+  if (emergencyActive()) {
+    emergencyStopAck(ESTOP_ACK_STEPPER);
+    return false;
+  }
+  if (shouldAbort) return false;
+  
+  if (firstStepPending) stampFirstStep();
+  digitalWrite(pinPUL, HIGH);
+  delayMicroseconds(STEP_PULSE_US);
+  digitalWrite(pinPUL, LOW);
+  
+  if (delayMicros > 10000) {
+    vTaskDelay(pdMS_TO_TICKS(delayMicros / 1000));
+  } else {
+    delayMicroseconds(delayMicros);
+  }
+  return true;
+}
+
+// El carro no se mueve mientras se recupera el juego: estos pasos no
+// cuentan en currentPosition
+bool StepperDriver::takeUp() {
+  unsigned long delayMicros = 1000000 / takeUpSpeed;
+  for (int i = 0; i < backlashSteps; i++) {
+    if (!pulseStep(delayMicros)) return false;
+    if (i > 0 && i % FEED_WDT_EVERY == 0) vTaskDelay(1);
+  }
+  return true;
+}
+
+uint64_t StepperDriver::getTakeUpMicros() const {
+  if (backlashSteps <= 0) return 0;
+  return (uint64_t)backlashSteps * (1000000 / takeUpSpeed + STEP_PULSE_US);
+}
+
+void StepperDriver::setBacklash(int steps, int speed) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  backlashSteps = constrain(steps, 0, stepsPerRevolution);
+  if (speed > 0) takeUpSpeed = constrain(speed, 1, maxSpeed);
+  xSemaphoreGive(mutex);
+}
+
+// 1 = presionado, 0 = libre, -1 = rebotando. Tres lecturas iguales
+// separadas 200 µs.
+int StepperDriver::readLimit(int pin) const {
+  bool hit = digitalRead(pin) == LOW;
+  for (int i = 0; i < 2; i++) {
+    delayMicroseconds(200);
+    if ((digitalRead(pin) == LOW) != hit) return -1;
+  }
+  return hit ? 1 : 0;
+}
+
+// Un paso de calibración, el número 'i' del tramo. Cuenta posición sin
+// recuperar juego: la calibración lo mide justamente en las inversiones.
+// Devuelve false si se abandonó.
+bool StepperDriver::calibrationStep(bool forward, long i) {
+  // Hacia el otro extremo: no empujar contra su final de carrera
+  if (forward && readLimit(pinLimit2) == 1) return false;
+  if (!pulseStep(1000000 / calibrationSpeed)) return false;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  currentPosition += forward ? 1 : -1;
+  xSemaphoreGive(mutex);
+  
+  if (i > 0 && i % FEED_WDT_EVERY == 0) {
+    esp_task_wdt_reset();
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+// Avanza hasta que 'pin' llega al estado pedido. Devuelve los pasos dados,
+// maxSteps si no llegó o -1 si se abandonó.
+long StepperDriver::stepUntilLimit(int pin, bool forward, bool wantHit, long maxSteps) {
+  digitalWrite(pinDIR, forward ? HIGH : LOW);
+  for (long i = 0; i < maxSteps; i++) {
+    if (readLimit(pin) == (wantHit ? 1 : 0)) return i;
+    if (!calibrationStep(forward, i)) return -1;
+  }
+  return maxSteps;
+}
+
+// Da exactamente 'steps' pasos sin mirar el final de carrera 1. Devuelve
+// false si se abandonó.
+bool StepperDriver::stepExactly(bool forward, long steps) {
+  digitalWrite(pinDIR, forward ? HIGH : LOW);
+  for (long i = 0; i < steps; i++) {
+    if (!calibrationStep(forward, i)) return false;
+  }
+  return true;
+}
+
+bool StepperDriver::startBacklashCalibration(int cycles, int speed, long hysteresisSteps) {
+  if (!isEnabled || isMoving || getQueuedCommands() > 0 || emergencyActive()) return false;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  memset(&calibration, 0, sizeof(calibration));
+  calibration.running = true;
+  calibration.cycles = constrain(cycles, 1, 10);
+  calibration.hysteresisSteps = max(0L, hysteresisSteps);
+  calibrationSpeed = constrain(speed, 1, maxSpeed);
+  xSemaphoreGive(mutex);
+  
+  StepperCommand cmd = {0, 0, false, false, true, false};
+  decelRequested = false;
+  checkpointMotionStart(currentPosition, 0);
+  if (xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) {
+    calibration.running = false;
+    return false;
+  }
+  return true;
+}
+
+void StepperDriver::runBacklashCalibration() {
+  long maxSearch = (long)stepsPerRevolution * CALIBRATION_MAX_REVS;
+  long maxDeadBand = (long)stepsPerRevolution * CALIBRATION_MAX_DEAD_BAND;
+  long sum = 0;
+  long minSample = maxDeadBand;
+  long maxSample = 0;
+  int samples = 0;
+  const char* error = nullptr;
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  isMoving = true;
+  shouldAbort = false;
+  int cycles = calibration.cycles;
+  xSemaphoreGive(mutex);
+  if (pinLedGreen >= 0) digitalWrite(pinLedGreen, HIGH);
+  powerSetLoad(POWER_STEPPER_MOVING, true);
+  LOG_INFO("📏 Calibrando juego (%d ciclos a %d pasos/s)", cycles, calibrationSpeed);
+  
+  // Apoyarse en el final de carrera 1: el juego queda del lado de retroceso
+  long found = stepUntilLimit(pinLimit1, false, true, maxSearch);
+  if (found < 0 || found == maxSearch) {
+    error = "No se encontró el final de carrera 1";
+  }
+  
+  for (int c = 0; c < cycles && error == nullptr; c++) {
+    // Desde el contacto hasta que se libera: juego + histéresis
+    long release = stepUntilLimit(pinLimit1, true, false, maxDeadBand);
+    if (release < 0 || release == maxDeadBand) {
+      error = "El final de carrera no se libera";
+      break;
+    }
+    // Alejarse deja el juego del lado de avance. Son pasos fijos: si el
+    // contacto rebota no se corta el tramo y la vuelta mide lo mismo
+    if (!stepExactly(true, CALIBRATION_CLEAR_STEPS)) {
+      error = "Calibración interrumpida";
+      break;
+    }
+    // De vuelta al contacto: lo alejado + juego + histéresis
+    long back = stepUntilLimit(pinLimit1, false, true, CALIBRATION_CLEAR_STEPS + maxDeadBand);
+    if (back < 0 || back == CALIBRATION_CLEAR_STEPS + maxDeadBand) {
+      error = "No se volvió a tocar el final de carrera";
+      break;
+    }
+    
+    long measures[2] = { release, back - CALIBRATION_CLEAR_STEPS };
+    for (long m : measures) {
+      sum += m;
+      minSample = min(minSample, m);
+      maxSample = max(maxSample, m);
+      samples++;
+    }
+  }
+  
+  powerSetLoad(POWER_STEPPER_MOVING, false);
+  if (pinLedGreen >= 0) digitalWrite(pinLedGreen, LOW);
+  
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  isMoving = false;
+  lastActivityMillis = millis();
+  calibration.running = false;
+  calibration.samples = samples;
+  calibration.error = error;
+  if (error == nullptr) {
+    calibration.deadBandSteps = (sum + samples / 2) / samples;
+    calibration.spreadSteps = maxSample - minSample;
+    calibration.backlashSteps = max(0L, calibration.deadBandSteps - calibration.hysteresisSteps);
+    calibration.valid = true;
+    // Apoyado en el final de carrera 1 tras retroceder: referencia conocida
+    currentPosition = 0;
+    targetPosition = 0;
+    lastDirection = -1;
+  } else {
+    lastDirection = 0;
+  }
+  xSemaphoreGive(mutex);
+  
+  if (error == nullptr) {
+    LOG_INFO("✅ Juego medido: %ld pasos (banda %ld, dispersión %ld)",
+                  calibration.backlashSteps, calibration.deadBandSteps, calibration.spreadSteps);
+  } else {
+    LOG_ERROR("❌ Calibración de juego: %s", error);
+  }
+}
+
+BacklashCalibration StepperDriver::getBacklashCalibration() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  BacklashCalibration result = calibration;
+  xSemaphoreGive(mutex);
+  return result;
+}
+
 // === RESTO DE FUNCIONES IGUALES ===
 
 void StepperDriver::setEmergencyFlag(volatile bool* flag, portMUX_TYPE* mutex) {
@@ -173,17 +590,38 @@ void StepperDriver::setEmergencyFlag(volatile bool* flag, portMUX_TYPE* mutex) {
   emergencyMutex = mutex;
 }
 
+void IRAM_ATTR StepperDriver::emergencyCut() {
+  if (pinENA >= 0) digitalWrite(pinENA, HIGH);
+  digitalWrite(pinPUL, LOW);
+}
+
 bool StepperDriver::moveTo(long position, int speed, bool wait) {
-  StepperCommand cmd = {position, speed, false, wait};
+  if (emergencyActive()) return false;
+  StepperCommand cmd = {position, speed, false, wait, false, false};
+  decelRequested = false;
+  checkpointMotionStart(currentPosition, position);
   if (xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) return false;
-  if (wait) while (isMoving) vTaskDelay(pdMS_TO_TICKS(10));
+  if (wait) while (isMoving || uxQueueMessagesWaiting(commandQueue) > 0) vTaskDelay(pdMS_TO_TICKS(10));
   return true;
 }
 
 bool StepperDriver::moveRelative(long steps, int speed, bool wait) {
-  StepperCommand cmd = {steps, speed, true, wait};
+  if (emergencyActive()) return false;
+  StepperCommand cmd = {steps, speed, true, wait, false, false};
+  decelRequested = false;
+  checkpointMotionStart(currentPosition, currentPosition + steps);
+  if (xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) return false;
+  if (wait) while (isMoving || uxQueueMessagesWaiting(commandQueue) > 0) vTaskDelay(pdMS_TO_TICKS(10));
+  return true;
+}
+
+bool StepperDriver::rapidTo(long position, int speed, bool wait) {
+  if (emergencyActive()) return false;
+  StepperCommand cmd = {position, speed > 0 ? speed : maxSpeed, false, wait, false, true};
+  decelRequested = false;
+  checkpointMotionStart(currentPosition, position);
   if (xQueueSend(commandQueue, &cmd, pdMS_TO_TICKS(100)) != pdTRUE) return false;
-  if (wait) while (isMoving) vTaskDelay(pdMS_TO_TICKS(10));
+  if (wait) while (isMoving || uxQueueMessagesWaiting(commandQueue) > 0) vTaskDelay(pdMS_TO_TICKS(10));
   return true;
 }
 
@@ -194,18 +632,120 @@ void StepperDriver::stop() {
   xQueueReset(commandQueue);
 }
 
+void StepperDriver::decelerateStop() {
+  xQueueReset(commandQueue);
+  portENTER_CRITICAL(&abortMux);
+  decelRequestUs = esp_timer_get_time();
+  decelRequested = true;
+  decelStats.requests++;
+  portEXIT_CRITICAL(&abortMux);
+}
+
+DecelStats StepperDriver::getDecelStats() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  DecelStats stats = decelStats;
+  xSemaphoreGive(mutex);
+  return stats;
+}
+
+void StepperDriver::markFirstStep(int64_t sinceUs) {
+  portENTER_CRITICAL(&abortMux);
+  firstStepFromUs = sinceUs;
+  firstStepPending = true;
+  portEXIT_CRITICAL(&abortMux);
+}
+
+void StepperDriver::cancelFirstStep() {
+  firstStepPending = false;
+}
+
+// Justo antes del flanco de subida: la latencia incluye el despertar del
+// ejecutor, la cola del stepper y la reactivación de ENA
+void StepperDriver::stampFirstStep() {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&abortMux);
+  uint32_t latency = now - firstStepFromUs;
+  firstStepPending = false;
+  firstStepStats.count++;
+  firstStepStats.lastLatencyUs = latency;
+  if (latency > firstStepStats.maxLatencyUs) firstStepStats.maxLatencyUs = latency;
+  portEXIT_CRITICAL(&abortMux);
+}
+
+FirstStepStats StepperDriver::getFirstStepStats() const {
+  portENTER_CRITICAL(&abortMux);
+  FirstStepStats stats = firstStepStats;
+  portEXIT_CRITICAL(&abortMux);
+  return stats;
+}
+
+// El pedido se atiende al inicio del siguiente paso: como mucho un periodo
+// completo más el tick cedido cada FEED_WDT_EVERY pasos
+uint32_t StepperDriver::getStopLatencyBoundUs(int speed) const {
+  speed = constrain(speed, 1, maxSpeed);
+  uint32_t tickUs = portTICK_PERIOD_MS * 1000;
+  uint32_t delayMicros = 1000000 / speed;
+  uint32_t periodUs = delayMicros > 10000 ? pdMS_TO_TICKS(delayMicros / 1000) * tickUs : delayMicros;
+  return periodUs + STEP_PULSE_US + tickUs;
+}
+
+void StepperDriver::setTimingCapture(bool enabled) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (enabled) memset(&timingStats, 0, sizeof(timingStats));
+  timingCapture = enabled;
+  xSemaphoreGive(mutex);
+}
+
+StepTimingStats StepperDriver::getTimingStats() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  StepTimingStats stats = timingStats;
+  xSemaphoreGive(mutex);
+  return stats;
+}
+
+int StepperDriver::getQueuedCommands() const {
+  if (commandQueue == nullptr) return 0;
+  return uxQueueMessagesWaiting(commandQueue);
+}
+
 void StepperDriver::enable() {
+  if (emergencyActive()) {
+    LOG_WARN("⛔ Stepper: parada de emergencia enclavada");
+    return;
+  }
   if (pinENA >= 0) digitalWrite(pinENA, LOW);
   xSemaphoreTake(mutex, portMAX_DELAY);
   isEnabled = true;
+  holdReleased = false;
+  lastActivityMillis = millis();
   xSemaphoreGive(mutex);
+  powerSetLoad(POWER_STEPPER_HOLD, true);
 }
 
 void StepperDriver::disable() {
   if (pinENA >= 0) digitalWrite(pinENA, HIGH);
   xSemaphoreTake(mutex, portMAX_DELAY);
   isEnabled = false;
+  holdReleased = false;
   xSemaphoreGive(mutex);
+  powerSetLoad(POWER_STEPPER_HOLD, false);
+}
+
+void StepperDriver::setIdleTimeout(uint32_t ms) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  idleTimeoutMs = ms;
+  lastActivityMillis = millis();
+  xSemaphoreGive(mutex);
+}
+
+void StepperDriver::setHoldLock(bool locked) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  holdLocked = locked;
+  lastActivityMillis = millis();
+  bool restore = locked && isEnabled && holdReleased && !emergencyActive();
+  xSemaphoreGive(mutex);
+  
+  if (restore) restoreHold();
 }
 
 void StepperDriver::setSpeed(int speed) {
@@ -214,6 +754,10 @@ void StepperDriver::setSpeed(int speed) {
   xSemaphoreGive(mutex);
 }
 
+void StepperDriver::setFeedOverride(int percent) {
+  feedPercent = constrain(percent, 1, 400);
+}
+
 void StepperDriver::setMaxSpeed(int speed) {
   xSemaphoreTake(mutex, portMAX_DELAY);
   maxSpeed = speed;
@@ -239,8 +783,54 @@ void StepperDriver::zero() {
   xSemaphoreGive(mutex);
 }
 
+void StepperDriver::restorePosition(long position) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  currentPosition = position;
+  targetPosition = position;
+  lastDirection = 0;
+  xSemaphoreGive(mutex);
+}
+
+// Modelo de tiempo de stepMotor(): periodo constante (sin rampa), pulso de
+// STEP_PULSE_US y un tick cedido cada FEED_WDT_EVERY pasos
+uint64_t StepperDriver::estimateMoveMicros(long steps, int speed) const {
+  long absSteps = labs(steps);
+  if (absSteps == 0) return 0;
+  
+  speed = constrain(speed > 0 ? speed : currentSpeed, 1, maxSpeed);
+  unsigned long delayMicros = 1000000 / speed;
+  uint64_t tickUs = (uint64_t)portTICK_PERIOD_MS * 1000;
+  uint64_t periodUs = delayMicros > 10000 ? pdMS_TO_TICKS(delayMicros / 1000) * tickUs : delayMicros;
+  
+  uint64_t yields = (absSteps - 1) / FEED_WDT_EVERY;
+  return absSteps * (periodUs + STEP_PULSE_US) + yields * tickUs;
+}
+
+// Acelera de MIN_RAMP_SPEED al crucero en (v² - v0²) / 2a pasos y frena
+// en otros tantos; si no alcanza, el pico es √(v0² + a·pasos)
+uint64_t StepperDriver::estimateRapidMicros(long steps, int speed) const {
+  long absSteps = labs(steps);
+  if (absSteps == 0) return 0;
+  
+  float cruise = constrain(speed > 0 ? speed : maxSpeed, 1, maxSpeed);
+  float v0 = min(cruise, (float)MIN_RAMP_SPEED);
+  if (acceleration <= 0) return estimateMoveMicros(steps, cruise);
+  
+  float rampSteps = (cruise * cruise - v0 * v0) / (2.0f * acceleration);
+  float seconds;
+  if (2.0f * rampSteps >= absSteps) {
+    float peak = sqrtf(v0 * v0 + (float)acceleration * absSteps);
+    seconds = 2.0f * (peak - v0) / acceleration;
+  } else {
+    seconds = 2.0f * (cruise - v0) / acceleration + (absSteps - 2.0f * rampSteps) / cruise;
+  }
+  return (uint64_t)(seconds * 1e6f) + absSteps * STEP_PULSE_US;
+}
+
+// Redondeo al paso más cercano: truncar convertía posiciones que llegan de
+// stepsToMm() (p. ej. trayectorias grabadas) en un paso menos
 long StepperDriver::mmToSteps(float mm, float mmPerRevolution) {
-  return (long)((mm / mmPerRevolution) * stepsPerRevolution);
+  return lroundf((mm / mmPerRevolution) * stepsPerRevolution);
 }
 
 float StepperDriver::stepsToMm(long steps, float mmPerRevolution) {
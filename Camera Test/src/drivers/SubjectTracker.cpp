@@ -0,0 +1,187 @@
+#include "drivers/SubjectTracker.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "Log.h"
+
+#define ATAN_SEGMENTS (1 << TRACK_ATAN_BITS)
+#define RATIO_SHIFT 16                     // dx/dy en Q16
+#define FRACTION_BITS (RATIO_SHIFT - TRACK_ATAN_BITS)
+#define ANGLE_ONE (1L << TRACK_ANGLE_SHIFT)
+
+uint16_t SubjectTracker::atanTable[ATAN_SEGMENTS + 1];
+
+SubjectTracker::SubjectTracker(StepperDriver* stepper, ServoDriver* servo)
+  : stepperDriver(stepper), servoDriver(servo), tickTimer(nullptr), mutex(nullptr),
+    active(false), locked(false), subjectSteps(0), distanceSteps(1), centerQ(90 * ANGLE_ONE),
+    direction(1), angleQ(0), ticks(0), writes(0), lastUs(0), maxUs(0) {
+}
+
+SubjectTracker::~SubjectTracker() {
+  if (tickTimer != nullptr) {
+    esp_timer_stop(tickTimer);
+    esp_timer_delete(tickTimer);
+  }
+  if (mutex != nullptr) {
+    vSemaphoreDelete(mutex);
+  }
+}
+
+bool SubjectTracker::begin() {
+  // La tabla se arma una sola vez; el cálculo por cuadro es solo enteros
+  for (int i = 0; i <= ATAN_SEGMENTS; i++) {
+    float degrees = atanf((float)i / ATAN_SEGMENTS) * 180.0f / PI;
+    atanTable[i] = (uint16_t)(degrees * ANGLE_ONE + 0.5f);
+  }
+
+  mutex = xSemaphoreCreateMutex();
+  if (mutex == nullptr) {
+    LOG_ERROR("❌ SubjectTracker: Error creando mutex");
+    return false;
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = &SubjectTracker::onTick;
+  args.arg = this;
+  args.name = "TrackTick";
+  if (esp_timer_create(&args, &tickTimer) != ESP_OK) {
+    LOG_ERROR("❌ SubjectTracker: Error creando timer");
+    return false;
+  }
+
+  LOG_INFO("✅ SubjectTracker inicializado (%d ms)", TRACK_PERIOD_MS);
+  return true;
+}
+
+// Interpolación lineal entre las dos entradas vecinas; ratio en Q16 [0, 1]
+int32_t SubjectTracker::lookupAtan(uint32_t ratio) {
+  uint32_t index = ratio >> FRACTION_BITS;
+  if (index >= ATAN_SEGMENTS) {
+    return atanTable[ATAN_SEGMENTS];
+  }
+  int32_t fraction = ratio & ((1 << FRACTION_BITS) - 1);
+  int32_t base = atanTable[index];
+  int32_t span = atanTable[index + 1] - base;
+  return base + ((span * fraction + (1 << (FRACTION_BITS - 1))) >> FRACTION_BITS);
+}
+
+// Con |y| > x se usa atan(t) = 90° - atan(1/t) para que la tabla solo
+// cubra [0, 1]
+int32_t SubjectTracker::atanQ10(int32_t y, int32_t x) {
+  uint32_t a = y < 0 ? (uint32_t)(-(int64_t)y) : (uint32_t)y;
+  uint32_t b = (uint32_t)x;
+  int32_t degrees;
+  if (a <= b) {
+    degrees = lookupAtan((uint32_t)(((uint64_t)a << RATIO_SHIFT) / b));
+  } else {
+    degrees = 90 * ANGLE_ONE - lookupAtan((uint32_t)(((uint64_t)b << RATIO_SHIFT) / a));
+  }
+  return y < 0 ? -degrees : degrees;
+}
+
+bool SubjectTracker::start(float alongMm, float distanceMm, float centerDeg, bool invert) {
+  long distance = stepperDriver->mmToSteps(distanceMm, MM_PER_REVOLUTION);
+  if (distance <= 0 || centerDeg < 0 || centerDeg > 180) {
+    return false;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  subjectSteps = stepperDriver->mmToSteps(alongMm, MM_PER_REVOLUTION);
+  distanceSteps = distance;
+  centerQ = (int32_t)(centerDeg * ANGLE_ONE + 0.5f);
+  direction = invert ? -1 : 1;
+  // Con un sujeto nuevo se vuelve a enganchar a ritmo acotado
+  locked = false;
+  bool starting = !active;
+  if (starting) {
+    angleQ = servoDriver->getCurrentAngle() * ANGLE_ONE;
+    ticks = 0;
+    writes = 0;
+    maxUs = 0;
+    active = true;
+    servoDriver->setSlaved(true);
+  }
+  xSemaphoreGive(mutex);
+
+  if (starting) {
+    esp_timer_start_periodic(tickTimer, TRACK_PERIOD_MS * 1000);
+  }
+  LOG_INFO("🎯 Seguimiento: sujeto a %.0f mm, %.0f mm del rail", alongMm, distanceMm);
+  return true;
+}
+
+void SubjectTracker::stop() {
+  esp_timer_stop(tickTimer);
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  bool wasActive = active;
+  active = false;
+  servoDriver->setSlaved(false);
+  xSemaphoreGive(mutex);
+
+  if (wasActive) {
+    LOG_INFO("⏹️ Seguimiento detenido: %lu cuadros, %lu escrituras",
+             (unsigned long)ticks, (unsigned long)writes);
+  }
+}
+
+void SubjectTracker::onTick(void* arg) {
+  static_cast<SubjectTracker*>(arg)->update();
+}
+
+void SubjectTracker::update() {
+  int64_t startUs = esp_timer_get_time();
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (!active) {
+    xSemaphoreGive(mutex);
+    return;
+  }
+
+  int32_t dx = subjectSteps - (int32_t)stepperDriver->getCurrentPosition();
+  int32_t target = centerQ + direction * atanQ10(dx, distanceSteps);
+  target = constrain(target, 0L, 180L * ANGLE_ONE);
+
+  // Al arrancar el servo puede estar lejos del sujeto: gira a lo sumo
+  // TRACK_ACQUIRE_DEG por cuadro hasta alcanzarlo y desde ahí sigue libre
+  if (!locked) {
+    int32_t limit = TRACK_ACQUIRE_DEG * ANGLE_ONE;
+    int32_t error = target - angleQ;
+    if (error > limit) {
+      target = angleQ + limit;
+    } else if (error < -limit) {
+      target = angleQ - limit;
+    } else {
+      locked = true;
+    }
+  }
+
+  ticks++;
+  if (target != angleQ) {
+    angleQ = target;
+    servoDriver->trackAngle((float)target / ANGLE_ONE);
+    writes++;
+  }
+
+  lastUs = esp_timer_get_time() - startUs;
+  if (lastUs > maxUs) maxUs = lastUs;
+  xSemaphoreGive(mutex);
+}
+
+String SubjectTracker::getStatusAsJson() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  String json = "{";
+  json += "\"active\":" + String(active ? "true" : "false");
+  json += ",\"locked\":" + String(locked ? "true" : "false");
+  json += ",\"alongMm\":" + String(stepperDriver->stepsToMm(subjectSteps, MM_PER_REVOLUTION), 1);
+  json += ",\"distanceMm\":" + String(stepperDriver->stepsToMm(distanceSteps, MM_PER_REVOLUTION), 1);
+  json += ",\"center\":" + String((float)centerQ / ANGLE_ONE, 1);
+  json += ",\"invert\":" + String(direction < 0 ? "true" : "false");
+  json += ",\"angle\":" + String((float)angleQ / ANGLE_ONE, 2);
+  json += ",\"periodMs\":" + String(TRACK_PERIOD_MS);
+  json += ",\"ticks\":" + String(ticks);
+  json += ",\"writes\":" + String(writes);
+  json += ",\"lastUs\":" + String(lastUs);
+  json += ",\"maxUs\":" + String(maxUs);
+  json += "}";
+  xSemaphoreGive(mutex);
+  return json;
+}
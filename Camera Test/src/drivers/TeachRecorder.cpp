@@ -0,0 +1,166 @@
+#include "drivers/TeachRecorder.h"
+#include "drivers/StepperDriver.h"
+#include "drivers/ServoDriver.h"
+#include "Log.h"
+
+TeachRecorder::TeachRecorder(StepperDriver* stepper, ServoDriver* servo)
+  : stepperDriver(stepper), servoDriver(servo), sampleTimer(nullptr), mutex(nullptr),
+    path(nullptr), anchor({0, 0, 0}), windowCount(0), samples(0), startUs(0),
+    toleranceSteps(0), toleranceAngle(0), full(false) {
+}
+
+TeachRecorder::~TeachRecorder() {
+  if (sampleTimer != nullptr) {
+    esp_timer_stop(sampleTimer);
+    esp_timer_delete(sampleTimer);
+  }
+  delete path;
+  if (mutex != nullptr) {
+    vSemaphoreDelete(mutex);
+  }
+}
+
+bool TeachRecorder::begin() {
+  mutex = xSemaphoreCreateMutex();
+  if (mutex == nullptr) {
+    LOG_ERROR("❌ TeachRecorder: Error creando mutex");
+    return false;
+  }
+
+  esp_timer_create_args_t args = {};
+  args.callback = &TeachRecorder::onSample;
+  args.arg = this;
+  args.name = "TeachSample";
+  if (esp_timer_create(&args, &sampleTimer) != ESP_OK) {
+    LOG_ERROR("❌ TeachRecorder: Error creando timer");
+    return false;
+  }
+
+  LOG_INFO("✅ TeachRecorder inicializado");
+  return true;
+}
+
+bool TeachRecorder::start(float toleranceMm, int toleranceDeg) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  if (path != nullptr) {
+    xSemaphoreGive(mutex);
+    return false;
+  }
+
+  path = new RecordedPath(stepperDriver->stepsToMm(1, MM_PER_REVOLUTION));
+  toleranceSteps = max(0L, stepperDriver->mmToSteps(toleranceMm, MM_PER_REVOLUTION));
+  toleranceAngle = max(0, toleranceDeg);
+  windowCount = 0;
+  samples = 0;
+  full = false;
+  startUs = esp_timer_get_time();
+
+  // La pose de partida es el primer punto
+  anchor = { 0, (int32_t)stepperDriver->getCurrentPosition(), (int16_t)servoDriver->getCurrentAngle() };
+  path->append(anchor);
+  samples++;
+  xSemaphoreGive(mutex);
+
+  esp_timer_start_periodic(sampleTimer, TEACH_SAMPLE_MS * 1000);
+  LOG_INFO("⏺️ Grabando trayectoria (tolerancia %ld pasos, %d°)",
+                (long)toleranceSteps, toleranceAngle);
+  return true;
+}
+
+RecordedPath* TeachRecorder::stop() {
+  esp_timer_stop(sampleTimer);
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  RecordedPath* result = path;
+  if (result != nullptr) {
+    // La última muestra cierra la trayectoria
+    if (windowCount > 0) {
+      emit(window[windowCount - 1]);
+    }
+    result->shrink();
+    path = nullptr;
+  }
+  xSemaphoreGive(mutex);
+
+  if (result != nullptr) {
+    LOG_INFO("⏹️ Grabación terminada: %lu muestras -> %lu puntos, %u bytes",
+                  (unsigned long)samples, (unsigned long)result->getPointCount(),
+                  (unsigned)result->getByteSize());
+  }
+  return result;
+}
+
+void TeachRecorder::onSample(void* arg) {
+  TeachRecorder* recorder = static_cast<TeachRecorder*>(arg);
+  RecordedPoint point;
+  point.timeMs = (esp_timer_get_time() - recorder->startUs) / 1000;
+  point.steps = recorder->stepperDriver->getCurrentPosition();
+  point.angle = recorder->servoDriver->getCurrentAngle();
+
+  xSemaphoreTake(recorder->mutex, portMAX_DELAY);
+  if (recorder->path != nullptr) {
+    recorder->addSample(point);
+  }
+  xSemaphoreGive(recorder->mutex);
+}
+
+// Simplificación en línea (ventana deslizante): la muestra nueva extiende el
+// tramo desde el ancla mientras todas las muestras intermedias queden a
+// menos de la tolerancia de la recta; si no, se guarda la anterior y pasa a
+// ser el ancla. O(TEACH_WINDOW) por muestra y memoria fija.
+void TeachRecorder::addSample(const RecordedPoint& point) {
+  if (full) {
+    return;
+  }
+  if (windowCount > 0 && point.timeMs <= window[windowCount - 1].timeMs) {
+    return;
+  }
+  samples++;
+
+  if (windowCount == TEACH_WINDOW || (windowCount > 0 && !fitsLine(point))) {
+    emit(window[windowCount - 1]);
+  }
+  window[windowCount++] = point;
+
+  if (path->getByteSize() >= TEACH_MAX_BYTES) {
+    full = true;
+    LOG_WARN("⚠️ Grabación llena: se conserva lo grabado hasta aquí");
+  }
+}
+
+bool TeachRecorder::fitsLine(const RecordedPoint& end) const {
+  float span = end.timeMs - anchor.timeMs;
+  for (int i = 0; i < windowCount; i++) {
+    const RecordedPoint& q = window[i];
+    float u = (q.timeMs - anchor.timeMs) / span;
+    float steps = anchor.steps + (end.steps - anchor.steps) * u;
+    float angle = anchor.angle + (end.angle - anchor.angle) * u;
+    if (fabsf(q.steps - steps) > toleranceSteps || fabsf(q.angle - angle) > toleranceAngle) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void TeachRecorder::emit(const RecordedPoint& point) {
+  path->append(point);
+  anchor = point;
+  windowCount = 0;
+}
+
+String TeachRecorder::getStatusAsJson() const {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  String json = "{";
+  json += "\"recording\":" + String(path != nullptr ? "true" : "false");
+  if (path != nullptr) {
+    json += ",\"elapsedMs\":" + String((uint32_t)((esp_timer_get_time() - startUs) / 1000));
+    json += ",\"samples\":" + String(samples);
+    json += ",\"points\":" + String(path->getPointCount() + (windowCount > 0 ? 1 : 0));
+    json += ",\"bytes\":" + String((uint32_t)path->getByteSize());
+    json += ",\"maxBytes\":" + String(TEACH_MAX_BYTES);
+    json += ",\"full\":" + String(full ? "true" : "false");
+  }
+  json += "}";
+  xSemaphoreGive(mutex);
+  return json;
+}
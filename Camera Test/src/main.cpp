@@ -1,10 +1,22 @@
 #include <Arduino.h>
 #include <BleKeyboard.h>
+#include <NimBLEDevice.h>
 #include <esp_task_wdt.h>
 #include "interface.h"
+#include "TaskConfig.h"
+#include "JitterBenchmark.h"
+#include "PowerManager.h"
+#include "EmergencyStop.h"
+#include "Backlash.h"
+#include "Checkpoint.h"
+#include "PositionTriggers.h"
+#include "Log.h"
 #include "drivers/ServoDriver.h"
 #include "drivers/StepperDriver.h"
 #include "drivers/SequenceManager.h"
+#include "drivers/MotionController.h"
+#include "drivers/TeachRecorder.h"
+#include "drivers/SubjectTracker.h"
 
 // ========== Configuración de Pines ==========
 const int SERVO_PIN = 19;
@@ -20,17 +32,124 @@ const int BLUE_LED = 33; // LED Azul para estado BLE
 const int RED_LED = 35;  // LED Rojo para estado de Error
 const int GREEN_LED = 32; // LED Verde para estado de Operación
 
+// Ejes adicionales opcionales en el MotionController (-1 = no instalado).
+// Se habilitan desde build_flags, p. ej. -D TILT_SERVO_PIN=18
+#ifndef TILT_SERVO_PIN
+#define TILT_SERVO_PIN -1
+#endif
+#ifndef FOCUS_PUL_PIN
+#define FOCUS_PUL_PIN -1
+#endif
+#ifndef FOCUS_DIR_PIN
+#define FOCUS_DIR_PIN -1
+#endif
+#ifndef FOCUS_ENA_PIN
+#define FOCUS_ENA_PIN -1
+#endif
+
+// Disparador externo del go de una secuencia armada (-1 = sin disparador).
+// Activo en bajo con pull-up, p. ej. -D GO_TRIGGER_PIN=27
+#ifndef GO_TRIGGER_PIN
+#define GO_TRIGGER_PIN -1
+#endif
+
+// Entrada de parada de emergencia (-1 = solo por software). Por defecto
+// contacto NC a GND: abrir el circuito (o cortar el cable) dispara.
+// -D ESTOP_ACTIVE_LOW=1 para un pulsador NA a GND.
+#ifndef ESTOP_PIN
+#define ESTOP_PIN -1
+#endif
+#ifndef ESTOP_ACTIVE_LOW
+#define ESTOP_ACTIVE_LOW 0
+#endif
+
+// Disparos por posición: salida al optoacoplador del disparador de la
+// cámara y LED marcador (-1 = sin salida), p. ej. -D TRIGGER_PULSE_PIN=26
+#ifndef TRIGGER_PULSE_PIN
+#define TRIGGER_PULSE_PIN -1
+#endif
+#ifndef MARKER_LED_PIN
+#define MARKER_LED_PIN -1
+#endif
+
+// LED de falla enclavada. RED_LED (GPIO35) es solo entrada en el ESP32 y
+// no puede encenderse: reasignar con -D FAULT_LED_PIN=<gpio de salida>
+#ifndef FAULT_LED_PIN
+#define FAULT_LED_PIN RED_LED
+#endif
+
+// Tras un corte, la ejecución interrumpida se retoma cuando vuelve la
+// conexión BLE (el disparo de la cámara) o, sin ella, pasado este tiempo
+#ifndef AUTO_RESUME_WAIT_MS
+#define AUTO_RESUME_WAIT_MS 15000
+#endif
+
 BleKeyboard bleKeyboard("ESP Camera Slider", "DIY", 100);
 ServoDriver* servoDriver = nullptr;
 StepperDriver* stepperDriver = nullptr;
 SequenceManager* sequenceManager = nullptr;
+MotionController* motionController = nullptr;
+TeachRecorder* teachRecorder = nullptr;
+SubjectTracker* subjectTracker = nullptr;
 
 void takePhoto() {
   if (bleKeyboard.isConnected()) {
-    Serial.println("📸 Disparando foto...");
+    LOG_DEBUG("📸 Disparando foto...");
     bleKeyboard.write(KEY_MEDIA_VOLUME_UP);
   } else {
-    Serial.println("⚠️ Bluetooth no conectado");
+    LOG_WARN("⚠️ Bluetooth no conectado");
+  }
+}
+
+void IRAM_ATTR onGoTrigger() {
+  if (sequenceManager) {
+    sequenceManager->goFromISR();
+  }
+}
+
+// Light sleep solo sin WiFi activo ni conexión BLE que mantener
+bool radiosAllowSleep() {
+  return WiFi.getMode() == WIFI_OFF && !bleKeyboard.isConnected();
+}
+
+// Radios apagadas en ejecución: sin WiFi y sin conexión ni anuncio BLE. La
+// desconexión BLE es asíncrona; hasta que termina radiosAllowSleep() no deja
+// dormir.
+void radiosDown() {
+  NimBLEServer* server = NimBLEDevice::getServer();
+  if (server != nullptr) {
+    server->advertiseOnDisconnect(false);
+    for (uint16_t handle : server->getPeerDevices()) {
+      server->disconnect(handle);
+    }
+  }
+  NimBLEDevice::stopAdvertising();
+  suspendWiFi();
+}
+
+void radiosUp() {
+  resumeWiFi();
+  NimBLEServer* server = NimBLEDevice::getServer();
+  if (server != nullptr) {
+    server->advertiseOnDisconnect(true);
+  }
+  NimBLEDevice::startAdvertising();
+}
+
+bool beforeSleep() {
+  return servoDriver == nullptr || servoDriver->suspendForSleep();
+}
+
+void afterWake() {
+  if (servoDriver) {
+    servoDriver->resumeAfterSleep();
+  }
+}
+
+// Carga BLE sintética para la medición de jitter (reporte vacío, no pulsa nada)
+void sendBleKeepalive() {
+  if (bleKeyboard.isConnected()) {
+    bleKeyboard.releaseAll();
   }
 }
 
@@ -38,6 +157,9 @@ void setup() {
   Serial.begin(115200);
   delay(1000);
   
+  // Primero el registro: los drivers ya escriben en él al iniciar
+  beginLog();
+  
   pinMode(BLUE_LED, OUTPUT);
   pinMode(RED_LED, OUTPUT);
   
@@ -45,8 +167,10 @@ void setup() {
   digitalWrite(RED_LED, HIGH);
   
   esp_task_wdt_init(10, false);
+  beginPowerManager();
   
-  Serial.println("🔧 Inicializando drivers...");
+  LOG_INFO("🔧 Inicializando drivers...");
+  loadTaskLayout();
   
   servoDriver = new ServoDriver(SERVO_PIN);
   if (!servoDriver->begin()) return;
@@ -59,34 +183,69 @@ void setup() {
   stepperDriver->setMaxSpeed(2000);
   stepperDriver->setSpeed(1000);
   stepperDriver->enable();
+  loadBacklashConfig(stepperDriver, servoDriver);
+  // Pose del último punto de control, antes de cualquier movimiento
+  beginCheckpoints(stepperDriver, servoDriver);
   
-  sequenceManager = new SequenceManager(servoDriver, stepperDriver);
+  // Tilt en centésimas de grado (90°/s máx.), foco en pasos
+  motionController = new MotionController();
+  if (TILT_SERVO_PIN >= 0) {
+    motionController->addAxis(new Axis<ServoPwmOutput>("tilt", ServoPwmOutput(TILT_SERVO_PIN), 9000, 100.0f, 9000));
+  }
+  if (FOCUS_PUL_PIN >= 0) {
+    motionController->addAxis(new Axis<StepDirOutput>("focus",
+      StepDirOutput(FOCUS_PUL_PIN, FOCUS_DIR_PIN, FOCUS_ENA_PIN), 4000, 1.0f));
+  }
+  if (!motionController->begin()) return;
+  
+  sequenceManager = new SequenceManager(servoDriver, stepperDriver, motionController);
   if (!sequenceManager->begin()) return;
+  sequenceManager->setShutterCallback(takePhoto);
+  if (GO_TRIGGER_PIN >= 0) {
+    pinMode(GO_TRIGGER_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(GO_TRIGGER_PIN), onGoTrigger, FALLING);
+  }
+  
+  beginPositionTriggers(stepperDriver, takePhoto, TRIGGER_PULSE_PIN, MARKER_LED_PIN);
+  
+  beginEmergencyStop(stepperDriver, servoDriver, motionController, sequenceManager,
+                     ESTOP_PIN, !ESTOP_ACTIVE_LOW, FAULT_LED_PIN);
+  
+  teachRecorder = new TeachRecorder(stepperDriver, servoDriver);
+  if (!teachRecorder->begin()) return;
+  
+  subjectTracker = new SubjectTracker(stepperDriver, servoDriver);
+  if (!subjectTracker->begin()) return;
   
   bleKeyboard.begin();
   setPhotoCallback(takePhoto);
+  setBenchmarkBleCallback(sendBleKeepalive);
+  setRadioSleepCheck(radiosAllowSleep);
+  setRadioControl(radiosDown, radiosUp);
+  setSleepHooks(beforeSleep, afterWake);
   setupWebServer();
   
-  Serial.println("✅ SISTEMA LISTO (Con Finales de Carrera)");
+  LOG_INFO("✅ SISTEMA LISTO (Con Finales de Carrera)");
 }
 
 void loop() {
   static bool wasConnected = false;
+  static bool resumeChecked = false;
   bool isConnected = bleKeyboard.isConnected();
   
-  // Debug: Mostrar estado de conexión
+  // El LED azul solo se escribe cuando cambia el estado de conexión
   if (isConnected != wasConnected) {
-    if (isConnected) {
-      digitalWrite(BLUE_LED, HIGH);
-    } else {
-      digitalWrite(BLUE_LED, LOW);
-    }
+    digitalWrite(BLUE_LED, isConnected ? HIGH : LOW);
     updateBLEStatus(isConnected);
     wasConnected = isConnected;
   }
   
-  // Actualizar LED azul
-  digitalWrite(BLUE_LED, isConnected ? HIGH : LOW);
+  if (!resumeChecked && sequenceManager && (isConnected || millis() > AUTO_RESUME_WAIT_MS)) {
+    resumeChecked = true;
+    autoResumeCheckpoint(sequenceManager);
+  }
+  
+  serviceWebServer();
   
-  vTaskDelay(pdMS_TO_TICKS(50));
+  vTaskDelay(pdMS_TO_TICKS(250));
 }
\ No newline at end of file
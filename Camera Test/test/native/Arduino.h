@@ -0,0 +1,109 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Núcleo Arduino mínimo para el build native ([env:native]): lo que usan
+// CommandRouter y los módulos sin hardware (String, map, constrain,
+// millis). No emula periféricos ni FreeRTOS.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+using std::min;
+using std::max;
+
+#define IRAM_ATTR
+
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis() {
+  return micros() / 1000;
+}
+
+class String {
+public:
+  String(const char* text = "") : value(text != nullptr ? text : "") {}
+  String(const std::string& text) : value(text) {}
+  explicit String(char c) : value(1, c) {}
+  explicit String(int v) : value(std::to_string(v)) {}
+  explicit String(unsigned int v) : value(std::to_string(v)) {}
+  explicit String(long v) : value(std::to_string(v)) {}
+  explicit String(unsigned long v) : value(std::to_string(v)) {}
+  explicit String(long long v) : value(std::to_string(v)) {}
+  explicit String(unsigned long long v) : value(std::to_string(v)) {}
+  explicit String(float v, unsigned int decimals = 2) : value(format(v, decimals)) {}
+  explicit String(double v, unsigned int decimals = 2) : value(format(v, decimals)) {}
+
+  unsigned int length() const { return value.size(); }
+  const char* c_str() const { return value.c_str(); }
+  bool reserve(unsigned int size) { value.reserve(size); return true; }
+  bool concat(const String& s) { value += s.value; return true; }
+  bool concat(const char* s) { value += s; return true; }
+  bool concat(char c) { value += c; return true; }
+
+  String& operator+=(const String& s) { value += s.value; return *this; }
+  String& operator+=(const char* s) { value += s; return *this; }
+  String& operator+=(char c) { value += c; return *this; }
+
+  char operator[](unsigned int index) const { return index < value.size() ? value[index] : '\0'; }
+  bool operator==(const String& s) const { return value == s.value; }
+  bool operator==(const char* s) const { return value == s; }
+  bool operator!=(const String& s) const { return value != s.value; }
+  bool operator!=(const char* s) const { return value != s; }
+
+  long toInt() const { return strtol(value.c_str(), nullptr, 10); }
+  float toFloat() const { return strtof(value.c_str(), nullptr); }
+  bool startsWith(const String& prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t at = value.find(c, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+  int indexOf(const String& s, unsigned int from = 0) const {
+    size_t at = value.find(s.value, from);
+    return at == std::string::npos ? -1 : (int)at;
+  }
+  String substring(unsigned int from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    return from < value.size() ? String(value.substr(from, to - from)) : String();
+  }
+  void replace(const String& find, const String& with) {
+    if (find.value.empty()) return;
+    for (size_t at = value.find(find.value); at != std::string::npos;
+         at = value.find(find.value, at + with.value.size())) {
+      value.replace(at, find.value.size(), with.value);
+    }
+  }
+
+  friend String operator+(const String& a, const String& b) { return String(a.value + b.value); }
+  friend String operator+(const String& a, const char* b) { return String(a.value + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.value); }
+  friend String operator+(const String& a, char b) { return String(a.value + b); }
+
+private:
+  std::string value;
+
+  static std::string format(double v, unsigned int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, v);
+    return buffer;
+  }
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef MOCK_TARGETS_H
+#define MOCK_TARGETS_H
+
+#include "CommandTargets.h"
+
+// Drivers y módulos simulados para CommandRouter: aceptan todo, no mueven
+// nada y devuelven JSON fijo construido una sola vez, así la medición del
+// router no incluye el trabajo de los drivers (solo la copia del String).
+
+static String fixedJson(int entries) {
+  String json = "[";
+  for (int i = 0; i < entries; i++) {
+    if (i > 0) json += ",";
+    json += "{\"distance\":10.00,\"speed\":50,\"angle\":90,\"angleSpeed\":50,\"pause\":0}";
+  }
+  json += "]";
+  return json;
+}
+
+class MockStepper : public StepperControl {
+public:
+  long position = 0;
+  int queued = 0;
+  int backlash = 0;
+  uint32_t idleMs = 0;
+
+  bool moveTo(long target, int, bool) override { position = target; return true; }
+  bool moveRelative(long steps, int, bool) override { position += steps; return true; }
+  void stop() override {}
+  void enable() override {}
+  void disable() override {}
+  void zero() override { position = 0; }
+
+  long getCurrentPosition() const override { return position; }
+  bool getIsMoving() const override { return false; }
+  int getQueuedCommands() const override { return queued; }
+
+  void setIdleTimeout(uint32_t ms) override { idleMs = ms; }
+  uint32_t getIdleTimeout() const override { return idleMs; }
+  bool getIsHoldReleased() const override { return false; }
+
+  void setBacklash(int steps, int) override { backlash = steps; }
+  int getBacklashSteps() const override { return backlash; }
+  bool startBacklashCalibration(int, int, long) override { return true; }
+  BacklashCalibration getBacklashCalibration() const override {
+    BacklashCalibration cal = {};
+    cal.valid = true;
+    cal.backlashSteps = 12;
+    return cal;
+  }
+
+  long mmToSteps(float mm, float mmPerRevolution) override { return lroundf(mm / mmPerRevolution * 1600); }
+  float stepsToMm(long steps, float mmPerRevolution) override { return steps * mmPerRevolution / 1600; }
+};
+
+class MockServo : public ServoControl {
+public:
+  int angle = 90;
+  uint32_t idleMs = 0;
+
+  bool moveTo(int target, int, bool) override { angle = target; return true; }
+  void stop() override {}
+
+  int getCurrentAngle() const override { return angle; }
+  bool getIsMoving() const override { return false; }
+  int getQueuedCommands() const override { return 0; }
+
+  void setBacklash(int) override {}
+  void setIdleTimeout(uint32_t ms) override { idleMs = ms; }
+  uint32_t getIdleTimeout() const override { return idleMs; }
+  bool getIsAttached() const override { return true; }
+};
+
+class MockAxes : public AxesControl {
+public:
+  String json = fixedJson(2);
+
+  int getAxisCount() const override { return 2; }
+  int32_t toAxisUnits(int, float value) const override { return lroundf(value * 100); }
+  uint32_t rateForSpeed(int, int speed) const override { return speed * 10; }
+  bool queueMove(int, int32_t, uint32_t) override { return true; }
+  String getAxesAsJson() const override { return json; }
+};
+
+class MockTeach : public TeachControl {
+public:
+  String json = "{\"recording\":false}";
+
+  bool start(float, int) override { return true; }
+  RecordedPath* stop() override {
+    RecordedPath* path = new RecordedPath(0.005f);
+    path->append({ 0, 0, 90 });
+    path->append({ 1000, 1600, 45 });
+    return path;
+  }
+  String getStatusAsJson() const override { return json; }
+};
+
+class MockTracker : public TrackerControl {
+public:
+  String json = "{\"active\":false}";
+
+  bool start(float, float distanceMm, float, bool) override { return distanceMm > 0; }
+  void stop() override {}
+  String getStatusAsJson() const override { return json; }
+};
+
+// Una secuencia de movimientos en el índice 0; las demás no existen
+class MockSequences : public SequenceControl {
+public:
+  Sequence sequence = {};
+  bool executing = false;
+  String listJson = fixedJson(4);
+  String sequenceJson = fixedJson(64);
+  String statusJson = "{\"state\":\"idle\"}";
+
+  MockSequences() {
+    sequence.used = true;
+    strcpy(sequence.name, "Toma");
+    sequence.type = SEQUENCE_MOVEMENTS;
+    sequence.capacity = 16;
+    sequence.count = 3;
+    sequence.repeatCount = 1;
+    sequence.version = 7;
+  }
+
+  int createSequence(const String&, SequenceType, uint16_t) override { return 1; }
+  bool deleteSequence(int index) override { return index == 0 || index == 1; }
+  bool addMovement(int index, const Movement&) override { return index == 0; }
+  SequenceEditResult updateMovement(int index, int, const Movement&, uint32_t) override { return edit(index); }
+  SequenceEditResult insertMovement(int index, int, const Movement&, uint32_t) override { return edit(index); }
+  SequenceEditResult moveMovement(int index, int, int, uint32_t) override { return edit(index); }
+  SequenceEditResult removeMovement(int index, int, uint32_t) override { return edit(index); }
+  SequenceEditResult setRepeat(int index, bool, int, uint32_t) override { return edit(index); }
+  bool addGenerator(int index, const FrameGenerator&) override { return index == 0; }
+  bool setKeyframes(int index, const std::vector<Keyframe>&, InterpolationType) override { return index == 0; }
+  bool setRecording(int, RecordedPath* recording) override { delete recording; return true; }
+  bool setProgram(int, MotionProgram* program) override { delete program; return true; }
+  bool setPlaybackSpeed(int index, int) override { return index == 0; }
+  bool setLayers(int index, const MotionLayer*, int) override { return index == 0; }
+
+  void setSoftLimits(float, float) override {}
+  void disableSoftLimits() override {}
+  void setSpeedCap(uint32_t) override {}
+  String getLimitsAsJson() const override { return statusJson; }
+  bool setFeedOverride(int, String&) override { return true; }
+  int getFeedOverride() const override { return 100; }
+  void invalidateAnalyses() override {}
+
+  bool validateSequence(int index, String& reason, PlaybackMode) override {
+    if (index != 0) reason = "Secuencia inexistente";
+    return index == 0;
+  }
+  bool executeSequence(int, PlaybackMode) override { return true; }
+  bool armSequence(int, PlaybackMode) override { return true; }
+  bool rapidReturn(String&, uint32_t& etaMs) override { etaMs = 1200; return true; }
+  bool go() override { return true; }
+  void pause() override {}
+  void resume() override {}
+  void stop() override {}
+  bool seek(uint32_t) override { return true; }
+
+  bool setPlaylist(const PlaylistEntry*, int, bool) override { return true; }
+  bool validatePlaylist(String&) override { return true; }
+  bool executePlaylist() override { return true; }
+
+  int getMovementCount(int index) const override { return index == 0 ? sequence.count : 0; }
+  const Sequence* getSequence(int index) const override { return index == 0 ? &sequence : nullptr; }
+  bool getIsExecuting() const override { return executing; }
+  String getArmStatusAsJson() const override { return statusJson; }
+  String getExecutorStatusAsJson() const override { return statusJson; }
+  String getPlaylistAsJson() const override { return statusJson; }
+  String getStopLatencyAsJson() const override { return statusJson; }
+  String getSequenceAsJson(int, int, int) const override { return sequenceJson; }
+  String getAllSequencesAsJson() const override { return listJson; }
+  String getPoolUsageAsJson() const override { return statusJson; }
+
+private:
+  SequenceEditResult edit(int index) const { return index == 0 ? EDIT_OK : EDIT_NOT_FOUND; }
+};
+
+class MockSystem : public SystemControl {
+public:
+  String json = "{\"ok\":true}";
+  PowerConfig power = {};
+  bool latched = false;
+
+  void saveBacklashConfig() override {}
+  String getBacklashAsJson() override { return json; }
+
+  bool setPositionTriggers(const PositionTrigger*, int count) override { return count <= TRIGGER_MAX_ENTRIES; }
+  void clearPositionTriggers() override {}
+  void setTriggerPulseWidth(uint32_t) override {}
+  String getPositionTriggersAsJson() override { return json; }
+
+  void triggerEmergencyStop() override { latched = true; }
+  bool resetEmergencyStop() override { latched = false; return true; }
+  bool isEmergencyLatched() override { return latched; }
+  String getEmergencyStopAsJson() override { return json; }
+
+  void setCheckpointAutoResume(bool) override {}
+  void setCheckpointInterval(uint32_t) override {}
+  bool resumeFromCheckpoint(String& reason) override { reason = "Sin ejecución interrumpida"; return false; }
+  void discardCheckpointRun() override {}
+  String getCheckpointAsJson() override { return json; }
+
+  bool applyTaskLayout(int index) override { return index >= 0 && index < 3; }
+  String getTaskLayoutsAsJson() override { return json; }
+  bool startJitterBenchmark(long, int) override { return true; }
+  bool isJitterBenchmarkRunning() override { return false; }
+  String getJitterBenchmarkAsJson() override { return json; }
+
+  PowerConfig getPowerConfig() override { return power; }
+  void setPowerConfig(const PowerConfig& config) override { power = config; }
+  PowerFrameReport getPowerReport() override { return PowerFrameReport(); }
+
+  String getLogAsJson(uint32_t) override { return json; }
+};
+
+#endif
@@ -0,0 +1,287 @@
+// CommandRouter en el host contra drivers simulados: cada ruta responde sin
+// hardware y se mide la latencia y las reservas de memoria por endpoint.
+// pio test -e native -f test_command_router -v  (el -v muestra la tabla)
+
+#include <unity.h>
+#include <map>
+#include <new>
+#include <stdio.h>
+#include <string>
+#include <chrono>
+#include "CommandRouter.h"
+#include "MockTargets.h"
+
+// ========== Conteo de reservas ==========
+
+static bool countAllocations = false;
+static uint32_t allocations = 0;
+static uint64_t allocatedBytes = 0;
+
+void* operator new(size_t size) {
+  if (countAllocations) {
+    allocations++;
+    allocatedBytes += size;
+  }
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return operator new(size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+// Un solo free(), fuera de línea: las demás variantes pasan por aquí y GCC
+// no ve un free() sobre un puntero de operator new (-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { operator delete(p); }
+
+// ========== Petición simulada ==========
+
+class MapParams : public CommandParams {
+public:
+  std::map<std::string, std::string> values;
+  std::map<std::string, std::string> headers;
+
+  bool has(const char* name) const override { return values.count(name) > 0; }
+  String get(const char* name) const override {
+    auto it = values.find(name);
+    return it != values.end() ? String(it->second.c_str()) : String();
+  }
+  String header(const char* name) const override {
+    auto it = headers.find(name);
+    return it != headers.end() ? String(it->second.c_str()) : String();
+  }
+};
+
+struct RouteCase {
+  const char* path;
+  int status;                    // Respuesta esperada con los mocks
+  std::map<std::string, std::string> params;
+};
+
+// Una petición válida por ruta (los parámetros son los de la interfaz web)
+static const RouteCase CASES[] = {
+  { "/photo",              200, {} },
+  { "/status",             200, {} },
+  { "/servo",              200, { { "angle", "45" }, { "speed", "60" } } },
+  { "/stepper/enable",     200, { { "value", "true" } } },
+  { "/stepper/zero",       200, {} },
+  { "/stepper",            200, { { "distance", "12.5" }, { "speed", "50" } } },
+  { "/backlash/config",    200, { { "stepperMm", "0.1" }, { "servoDeg", "1" } } },
+  { "/backlash/calibrate", 200, { { "cycles", "3" } } },
+  { "/axes",               200, {} },
+  { "/axis",               200, { { "index", "1" }, { "value", "-10" }, { "speed", "40" } } },
+  { "/sequence/create",    200, { { "name", "Toma" }, { "capacity", "32" } } },
+  { "/sequence/add",       200, { { "seq", "0" }, { "distance", "100" }, { "speed", "50" }, { "angle", "90" },
+                                  { "angleSpeed", "50" }, { "pause", "500" }, { "axis0", "15" } } },
+  { "/sequence/update",    200, { { "seq", "0" }, { "index", "1" }, { "distance", "50" }, { "speed", "50" },
+                                  { "angle", "30" }, { "angleSpeed", "50" } } },
+  { "/sequence/insert",    200, { { "seq", "0" }, { "index", "0" }, { "distance", "50" }, { "speed", "50" },
+                                  { "angle", "30" }, { "angleSpeed", "50" } } },
+  { "/sequence/move",      200, { { "seq", "0" }, { "from", "0" }, { "to", "2" } } },
+  { "/sequence/remove",    200, { { "seq", "0" }, { "index", "1" } } },
+  { "/sequence/options",   200, { { "seq", "0" }, { "repeat", "3" }, { "loop", "false" } } },
+  { "/sequence/generator", 200, { { "seq", "0" }, { "frames", "240" }, { "distance", "600" }, { "interval", "5000" },
+                                  { "easing", "inout" } } },
+  { "/sequence/keyframes", 200, { { "seq", "0" }, { "keys", "0,0,90;2000,150,60;5000,300,30;8000,450,90" } } },
+  { "/sequence/layers",    200, { { "seq", "0" }, { "layers", "pan:sine:5:4000:0;rail:triangle:2:1000:90:0:3000:500" } } },
+  { "/sequence/program",   200, { { "seq", "0" }, { "code", "093c28061401d00f04f403050700" } } },
+  { "/playlist/set",       200, { { "entries", "0:2;1;0:1" }, { "loop", "1" } } },
+  { "/playlist/status",    200, {} },
+  { "/playlist/execute",   200, {} },
+  { "/sequence/execute",   200, { { "index", "0" }, { "mode", "pingpong" } } },
+  { "/sequence/arm",       200, { { "index", "0" } } },
+  { "/sequence/go",        200, {} },
+  { "/sequence/return",    200, {} },
+  { "/sequence/armStatus", 200, {} },
+  { "/sequence/pause",     200, {} },
+  { "/sequence/resume",    200, {} },
+  { "/sequence/stop",      200, {} },
+  { "/sequence/playback",  200, { { "index", "0" }, { "speed", "150" } } },
+  { "/sequence/feed",      200, { { "percent", "120" } } },
+  { "/teach/start",        200, { { "tolerance", "0.2" } } },
+  { "/teach/stop",         200, { { "name", "Grabación" } } },
+  { "/teach/status",       200, {} },
+  { "/triggers/set",       200, { { "entries", "100:shutter;150.5:pulse:forward;200:marker:reverse" }, { "pulse", "50" } } },
+  { "/triggers/series",    200, { { "start", "0" }, { "spacing", "5" }, { "count", "100" } } },
+  { "/triggers/clear",     200, {} },
+  { "/triggers/status",    200, {} },
+  { "/track/start",        200, { { "along", "300" }, { "distance", "1500" } } },
+  { "/track/stop",         200, {} },
+  { "/track/status",       200, {} },
+  { "/sequence/seek",      200, { { "position", "2" } } },
+  { "/sequence/executor",  200, {} },
+  { "/sequence/stopLatency", 200, {} },
+  { "/estop/status",       200, {} },
+  { "/estop/trigger",      200, {} },
+  { "/estop/reset",        200, {} },
+  { "/recovery",           200, { { "autoResume", "1" } } },
+  { "/recovery/resume",    409, {} },
+  { "/recovery/discard",   200, {} },
+  { "/sequence/list",      200, {} },
+  { "/sequence/limits",    200, { { "min", "0" }, { "max", "600" } } },
+  { "/sequence/delete",    200, { { "index", "1" } } },
+  { "/sequence/pool",      200, {} },
+  { "/sequence/get",       200, { { "index", "0" }, { "offset", "64" }, { "limit", "64" } } },
+  { "/system/tasks",       200, { { "layout", "1" } } },
+  { "/system/benchmark",   200, {} },
+  { "/system/commands",    200, {} },
+  { "/system/log",         200, { { "since", "0" } } },
+  { "/power",              200, { { "stepperIdle", "30000" }, { "lightSleep", "true" } } },
+};
+
+static const int CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+static const int BENCH_ITERATIONS = 2000;
+
+static MockStepper stepper;
+static MockServo servo;
+static MockSequences sequences;
+static MockAxes axes;
+static MockTeach teach;
+static MockTracker tracker;
+static MockSystem systemMock;
+
+static bool alwaysTrue() { return true; }
+
+static void setFullContext() {
+  CommandContext context = {
+    &stepper, &servo, &sequences, &axes, &teach, &tracker, &systemMock, alwaysTrue, alwaysTrue
+  };
+  setCommandContext(context);
+}
+
+static int findRoute(const char* path) {
+  for (int i = 0; i < getCommandRouteCount(); i++) {
+    if (strcmp(getCommandRoute(i).path, path) == 0) return i;
+  }
+  return -1;
+}
+
+static int dispatch(const RouteCase& rc, CommandResponse& res) {
+  MapParams params;
+  params.values = rc.params;
+  res.status = 0;
+  dispatchCommand(findRoute(rc.path), params, res);
+  return res.status;
+}
+
+// ========== Pruebas ==========
+
+void setUp() {}
+void tearDown() {}
+
+void test_every_route_has_a_case() {
+  for (int i = 0; i < getCommandRouteCount(); i++) {
+    bool found = false;
+    for (int c = 0; c < CASE_COUNT && !found; c++) {
+      found = strcmp(CASES[c].path, getCommandRoute(i).path) == 0;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(found, getCommandRoute(i).path);
+  }
+}
+
+void test_routes_answer_with_mock_drivers() {
+  setFullContext();
+  for (int c = 0; c < CASE_COUNT; c++) {
+    TEST_ASSERT_TRUE_MESSAGE(findRoute(CASES[c].path) >= 0, CASES[c].path);
+    CommandResponse res;
+    TEST_ASSERT_EQUAL_INT_MESSAGE(CASES[c].status, dispatch(CASES[c], res), CASES[c].path);
+    TEST_ASSERT_TRUE_MESSAGE(res.body.length() > 0, CASES[c].path);
+  }
+}
+
+void test_missing_targets_answer_500() {
+  CommandContext empty = {};
+  setCommandContext(empty);
+  for (int c = 0; c < CASE_COUNT; c++) {
+    uint8_t needs = getCommandRoute(findRoute(CASES[c].path)).needs;
+    CommandResponse res;
+    int status = dispatch(CASES[c], res);
+    if (needs != NEEDS_NOTHING) {
+      TEST_ASSERT_EQUAL_INT_MESSAGE(500, status, CASES[c].path);
+    }
+  }
+  setFullContext();
+}
+
+void test_bad_input_is_rejected() {
+  setFullContext();
+  RouteCase badProgram = { "/sequence/program", 400, { { "seq", "0" }, { "code", "0a" } } };
+  RouteCase badKeys = { "/sequence/keyframes", 400, { { "seq", "0" }, { "keys", "0,0;x" } } };
+  RouteCase badFeed = { "/sequence/feed", 400, { { "percent", "500" } } };
+  RouteCase badPage = { "/sequence/get", 400, { { "index", "0" }, { "limit", "65" } } };
+  RouteCase stale = { "/sequence/update", 404, { { "seq", "5" }, { "index", "0" }, { "distance", "1" },
+                                                 { "speed", "50" }, { "angle", "90" }, { "angleSpeed", "50" } } };
+  for (const RouteCase* rc : { &badProgram, &badKeys, &badFeed, &badPage, &stale }) {
+    CommandResponse res;
+    TEST_ASSERT_EQUAL_INT_MESSAGE(rc->status, dispatch(*rc, res), rc->path);
+  }
+}
+
+// Latencia (sin transporte, como /system/commands) y reservas por llamada.
+// Las reservas son las del String de test/native (std::string, con
+// buffer corto y crecimiento al doble), no las de WString en el ESP32,
+// que crece a la medida de cada concatenación y reserva más veces.
+void test_benchmark_endpoints() {
+  setFullContext();
+  printf("\nReservas del host (String sobre std::string, no WString)\n");
+  printf("%-22s %6s %9s %9s %8s %10s %8s\n",
+         "endpoint", "status", "avg us", "max us", "allocs", "bytes", "body");
+  for (int c = 0; c < CASE_COUNT; c++) {
+    MapParams params;
+    params.values = CASES[c].params;
+    int route = findRoute(CASES[c].path);
+
+    double totalUs = 0, maxUs = 0;
+    uint32_t allocs = 0;
+    uint64_t bytes = 0;
+    CommandResponse res;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+      res.body = String();
+      allocations = 0;
+      allocatedBytes = 0;
+      auto start = std::chrono::steady_clock::now();
+      countAllocations = true;
+      dispatchCommand(route, params, res);
+      countAllocations = false;
+      double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      totalUs += us;
+      if (us > maxUs) maxUs = us;
+      allocs += allocations;
+      bytes += allocatedBytes;
+    }
+    printf("%-22s %6d %9.2f %9.2f %8.1f %10.0f %8u\n", CASES[c].path, res.status,
+           totalUs / BENCH_ITERATIONS, maxUs, (double)allocs / BENCH_ITERATIONS,
+           (double)bytes / BENCH_ITERATIONS, res.body.length());
+    TEST_ASSERT_EQUAL_INT_MESSAGE(CASES[c].status, res.status, CASES[c].path);
+  }
+  // Las mismas llamadas vistas por el router
+  TEST_ASSERT_TRUE(getCommandStatsAsJson().length() > 2);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_route_has_a_case);
+  RUN_TEST(test_routes_answer_with_mock_drivers);
+  RUN_TEST(test_missing_targets_answer_500);
+  RUN_TEST(test_bad_input_is_rejected);
+  RUN_TEST(test_benchmark_endpoints);
+  return UNITY_END();
+}
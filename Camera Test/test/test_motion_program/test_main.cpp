@@ -0,0 +1,406 @@
+// MotionProgram en el host: la verificación de load() rechaza cada forma
+// de bytecode inválido, decode() devuelve lo que se ensambló y el análisis
+// sin desenrollar (analyzeProgramBlock) coincide con recorrer el programa
+// instrucción por instrucción, bucles desenrollados.
+// pio test -e native -f test_motion_program
+
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "drivers/MotionProgram.h"
+#include "drivers/ProgramAnalysis.h"
+
+// ========== Ensamblador mínimo (como el de data/script.js) ==========
+
+class Assembler {
+public:
+  std::vector<uint8_t> code;
+
+  Assembler& op(uint8_t value) { code.push_back(value); return *this; }
+  Assembler& varint(uint32_t value) {
+    while (value >= 0x80) {
+      code.push_back((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+    code.push_back(value);
+    return *this;
+  }
+  Assembler& zigzag(int32_t value) { return varint(((uint32_t)value << 1) ^ (uint32_t)(value >> 31)); }
+
+  Assembler& move(int32_t centiMm) { return op(OP_MOVE).zigzag(centiMm); }
+  Assembler& turn(uint32_t angle) { return op(OP_TURN).varint(angle); }
+  Assembler& moveTurn(int32_t centiMm, uint32_t angle) { return op(OP_MOVE_TURN).zigzag(centiMm).varint(angle); }
+  Assembler& pause(uint32_t ms) { return op(OP_PAUSE).varint(ms); }
+  Assembler& wait(uint32_t ms) { return op(OP_WAIT).varint(ms); }
+  Assembler& shutter() { return op(OP_SHUTTER); }
+  Assembler& speed(uint32_t stepper, uint32_t servo) { return op(OP_SPEED).varint(stepper).varint(servo); }
+  Assembler& loop(uint32_t count) { return op(OP_LOOP).varint(count); }
+  Assembler& endLoop() { return op(OP_ENDLOOP); }
+  Assembler& end() { return op(OP_END); }
+};
+
+static bool load(MotionProgram& program, const std::vector<uint8_t>& code, String& error) {
+  return program.load(code.data(), code.size(), error);
+}
+
+static void assertRejected(const std::vector<uint8_t>& code, const char* expected) {
+  MotionProgram program;
+  String error;
+  TEST_ASSERT_FALSE_MESSAGE(load(program, code, error), expected);
+  TEST_ASSERT_TRUE_MESSAGE(error.indexOf(expected) >= 0, error.c_str());
+  TEST_ASSERT_FALSE(program.isLoaded());
+}
+
+// ========== Modelo de costo para el análisis ==========
+
+// Determinista y con estado (ángulo, sentido del juego, velocidades) como
+// el de SequenceManager, sin drivers: 2 pasos por centésima de mm
+class TestModel : public ProgramMovementModel {
+public:
+  void accumulateProgramMove(SequenceAnalysis& analysis, const ProgramInstruction& instruction,
+                             const ProgramSpeeds& speeds) const override {
+    int32_t steps = instruction.op != OP_TURN ? instruction.a * 2 : 0;
+    int angle = instruction.op == OP_TURN ? instruction.a :
+                instruction.op == OP_MOVE_TURN ? instruction.b : -1;
+
+    uint64_t us = (uint64_t)labs(steps) * 1000 / speeds.stepper;
+    int8_t dir = (steps > 0) - (steps < 0);
+    if (dir != 0) {
+      if (analysis.lastStepDir != 0 && dir != analysis.lastStepDir) us += 7000;
+      analysis.lastStepDir = dir;
+      analysis.peakStepRate = max<uint32_t>(analysis.peakStepRate, speeds.stepper * 20u);
+    }
+    if (angle >= 0) {
+      if (analysis.lastAngle >= 0) us += (uint64_t)abs(angle - analysis.lastAngle) * 500 / speeds.servo;
+      if (analysis.firstAngle < 0) {
+        analysis.firstAngle = angle;
+        analysis.minAngle = angle;
+        analysis.maxAngle = angle;
+      }
+      analysis.minAngle = min<int>(analysis.minAngle, angle);
+      analysis.maxAngle = max<int>(analysis.maxAngle, angle);
+      analysis.lastAngle = angle;
+    }
+
+    analysis.durationUs += us;
+    analysis.lastMoveUs = us;
+    analysis.endSteps += steps;
+    analysis.minSteps = min(analysis.minSteps, analysis.endSteps);
+    analysis.maxSteps = max(analysis.maxSteps, analysis.endSteps);
+  }
+};
+
+static const TestModel model;
+
+static void resetAnalysis(SequenceAnalysis& analysis) {
+  memset(&analysis, 0, sizeof(analysis));
+  analysis.valid = true;
+  analysis.firstAngle = -1;
+  analysis.lastAngle = -1;
+  analysis.minAngle = -1;
+  analysis.maxAngle = -1;
+}
+
+// Referencia: el programa recorrido como lo ejecuta executeProgram(), con
+// cada vuelta de cada bucle
+static void analyzeUnrolled(const MotionProgram& program, SequenceAnalysis& analysis) {
+  struct LoopFrame {
+    size_t body;
+    uint32_t remaining;
+  };
+  LoopFrame stack[MAX_PROGRAM_DEPTH];
+  int depth = 0;
+  ProgramSpeeds speeds;
+  ProgramInstruction instruction;
+  size_t pc = 0;
+
+  for (;;) {
+    program.decode(pc, instruction);
+    switch (instruction.op) {
+      case OP_END:
+        return;
+      case OP_MOVE:
+      case OP_TURN:
+      case OP_MOVE_TURN:
+        model.accumulateProgramMove(analysis, instruction, speeds);
+        break;
+      case OP_PAUSE:
+      case OP_WAIT:
+        analysis.durationUs += (uint64_t)instruction.a * 1000;
+        analysis.lastMoveUs = 0;
+        break;
+      case OP_SPEED:
+        speeds.stepper = instruction.a;
+        speeds.servo = instruction.b;
+        break;
+      case OP_LOOP:
+        stack[depth].body = pc;
+        stack[depth].remaining = instruction.a;
+        depth++;
+        break;
+      case OP_ENDLOOP:
+        if (--stack[depth - 1].remaining > 0) {
+          pc = stack[depth - 1].body;
+        } else {
+          depth--;
+        }
+        break;
+    }
+  }
+}
+
+static void assertSameAnalysis(const std::vector<uint8_t>& code, const char* name) {
+  MotionProgram program;
+  String error;
+  TEST_ASSERT_TRUE_MESSAGE(load(program, code, error), error.c_str());
+
+  SequenceAnalysis expected, actual;
+  resetAnalysis(expected);
+  resetAnalysis(actual);
+  analyzeUnrolled(program, expected);
+  ProgramSpeeds speeds;
+  size_t pc = analyzeProgramBlock(program, 0, speeds, actual, model);
+
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(program.getByteSize(), pc, name);
+  TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected.durationUs, actual.durationUs, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.endSteps, actual.endSteps, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.minSteps, actual.minSteps, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.maxSteps, actual.maxSteps, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.firstAngle, actual.firstAngle, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.lastAngle, actual.lastAngle, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.minAngle, actual.minAngle, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.maxAngle, actual.maxAngle, name);
+  TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected.peakStepRate, actual.peakStepRate, name);
+  TEST_ASSERT_EQUAL_UINT64_MESSAGE(expected.lastMoveUs, actual.lastMoveUs, name);
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected.lastStepDir, actual.lastStepDir, name);
+}
+
+// Programas aleatorios pero reproducibles (LCG propio: rand() cambia entre
+// plataformas)
+static uint32_t seed = 12345;
+
+static uint32_t randomBelow(uint32_t limit) {
+  seed = seed * 1103515245u + 12345u;
+  return (seed >> 8) % limit;
+}
+
+static void randomBlock(Assembler& program, int depth) {
+  int items = 1 + randomBelow(4);
+  for (int i = 0; i < items; i++) {
+    switch (randomBelow(depth < MAX_PROGRAM_DEPTH ? 8 : 7)) {
+      case 0: program.move((int32_t)randomBelow(20001) - 10000); break;
+      case 1: program.turn(randomBelow(181)); break;
+      case 2: program.moveTurn((int32_t)randomBelow(20001) - 10000, randomBelow(181)); break;
+      case 3: program.pause(randomBelow(2000)); break;
+      case 4: program.shutter(); break;
+      case 5: program.speed(1 + randomBelow(100), 1 + randomBelow(100)); break;
+      case 6: program.wait(randomBelow(3)); break;
+      default:
+        program.loop(1 + randomBelow(4));
+        randomBlock(program, depth + 1);
+        program.endLoop();
+        break;
+    }
+  }
+}
+
+// ========== Pruebas ==========
+
+void setUp() {}
+void tearDown() {}
+
+void test_load_accepts_valid_program() {
+  Assembler code;
+  code.speed(80, 40).loop(20).move(1500).shutter().endLoop().turn(45).end();
+  MotionProgram program;
+  String error;
+  TEST_ASSERT_TRUE_MESSAGE(load(program, code.code, error), error.c_str());
+  TEST_ASSERT_EQUAL_UINT32(code.code.size(), program.getByteSize());
+  TEST_ASSERT_EQUAL_INT(7, program.getInstructionCount());
+  TEST_ASSERT_EQUAL_INT(1, program.getDepth());
+}
+
+void test_load_rejects_size() {
+  assertRejected({}, "Tamaño inválido");
+  std::vector<uint8_t> huge(MAX_PROGRAM_BYTES + 1, OP_SHUTTER);
+  huge.back() = OP_END;
+  assertRejected(huge, "Tamaño inválido");
+}
+
+void test_load_rejects_unbalanced_loops() {
+  assertRejected(Assembler().loop(3).move(100).end().code, "Bucle sin cerrar");
+  assertRejected(Assembler().move(100).endLoop().end().code, "OP_ENDLOOP sin bucle");
+  assertRejected(Assembler().loop(2).shutter().endLoop().endLoop().end().code, "OP_ENDLOOP sin bucle");
+  assertRejected(Assembler().loop(2).shutter().endLoop().code, "Falta OP_END");
+}
+
+void test_load_rejects_empty_loops() {
+  assertRejected(Assembler().loop(3).endLoop().end().code, "Bucle vacío");
+  // Un cuerpo que solo tiene un bucle vacío tampoco vale
+  assertRejected(Assembler().loop(2).loop(2).endLoop().endLoop().end().code, "Bucle vacío");
+}
+
+void test_load_limits_depth() {
+  Assembler deepest;
+  for (int i = 0; i < MAX_PROGRAM_DEPTH; i++) deepest.loop(2);
+  deepest.move(10);
+  for (int i = 0; i < MAX_PROGRAM_DEPTH; i++) deepest.endLoop();
+  deepest.end();
+  MotionProgram program;
+  String error;
+  TEST_ASSERT_TRUE_MESSAGE(load(program, deepest.code, error), error.c_str());
+  TEST_ASSERT_EQUAL_INT(MAX_PROGRAM_DEPTH, program.getDepth());
+
+  Assembler tooDeep;
+  for (int i = 0; i <= MAX_PROGRAM_DEPTH; i++) tooDeep.loop(2);
+  tooDeep.move(10);
+  for (int i = 0; i <= MAX_PROGRAM_DEPTH; i++) tooDeep.endLoop();
+  tooDeep.end();
+  assertRejected(tooDeep.code, "bucles anidados");
+}
+
+void test_load_rejects_bytes_after_end() {
+  assertRejected(Assembler().move(100).end().shutter().code, "Bytes después de OP_END");
+  assertRejected(Assembler().end().end().code, "Bytes después de OP_END");
+}
+
+void test_load_rejects_truncated_varints() {
+  // Continuación sin byte siguiente
+  assertRejected(Assembler().op(OP_MOVE).op(0x80).code, "Instrucción inválida");
+  assertRejected(Assembler().op(OP_PAUSE).op(0xE8).code, "Instrucción inválida");
+  // El segundo argumento falta
+  assertRejected(Assembler().op(OP_SPEED).varint(50).code, "Instrucción inválida");
+  // Más de 5 bytes
+  assertRejected(Assembler().op(OP_PAUSE).op(0x81).op(0x80).op(0x80).op(0x80).op(0x80).op(0x00).end().code,
+                 "Instrucción inválida");
+}
+
+void test_load_rejects_varint_overflow() {
+  // 2^32 en 5 bytes: los bits que no caben no pueden volver a dar 0°
+  assertRejected(Assembler().op(OP_TURN).op(0x80).op(0x80).op(0x80).op(0x80).op(0x10).end().code,
+                 "Instrucción inválida");
+  assertRejected(Assembler().op(OP_PAUSE).op(0xE8).op(0x87).op(0x80).op(0x80).op(0x70).end().code,
+                 "Instrucción inválida");
+  // El quinto byte con solo los 4 bits bajos es válido (fuera de rango acá)
+  assertRejected(Assembler().op(OP_PAUSE).op(0xFF).op(0xFF).op(0xFF).op(0xFF).op(0x0F).end().code,
+                 "Instrucción inválida");
+  // Y con ceros de relleno, el mismo valor que en forma corta
+  MotionProgram program;
+  String error;
+  std::vector<uint8_t> padded = Assembler().op(OP_TURN).op(0xDA).op(0x80).op(0x80).op(0x80).op(0x00).end().code;
+  TEST_ASSERT_TRUE_MESSAGE(load(program, padded, error), error.c_str());
+  size_t pc = 0;
+  ProgramInstruction instruction;
+  program.decode(pc, instruction);
+  TEST_ASSERT_EQUAL_INT(OP_TURN, instruction.op);
+  TEST_ASSERT_EQUAL_INT(90, instruction.a);
+}
+
+void test_load_rejects_out_of_range_arguments() {
+  assertRejected(Assembler().op(PROGRAM_OP_COUNT).end().code, "Instrucción inválida");
+  assertRejected(Assembler().turn(181).end().code, "Instrucción inválida");
+  assertRejected(Assembler().move(200001).end().code, "Instrucción inválida");
+  assertRejected(Assembler().move(-200001).end().code, "Instrucción inválida");
+  assertRejected(Assembler().moveTurn(100, 200).end().code, "Instrucción inválida");
+  assertRejected(Assembler().pause(3600001).end().code, "Instrucción inválida");
+  assertRejected(Assembler().loop(0).shutter().endLoop().end().code, "Instrucción inválida");
+  assertRejected(Assembler().loop(MAX_PROGRAM_LOOP + 1).shutter().endLoop().end().code, "Instrucción inválida");
+  assertRejected(Assembler().speed(0, 50).end().code, "Instrucción inválida");
+  assertRejected(Assembler().speed(50, 101).end().code, "Instrucción inválida");
+}
+
+void test_decode_round_trip() {
+  const ProgramInstruction expected[] = {
+    { OP_SPEED, 1, 100 },
+    { OP_MOVE, 200000, 0 },
+    { OP_MOVE, -200000, 0 },
+    { OP_MOVE, -1, 0 },
+    { OP_LOOP, MAX_PROGRAM_LOOP, 0 },
+    { OP_TURN, 180, 0 },
+    { OP_MOVE_TURN, -12345, 0 },
+    { OP_ENDLOOP, 0, 0 },
+    { OP_PAUSE, 3600000, 0 },
+    { OP_WAIT, 0, 0 },
+    { OP_SHUTTER, 0, 0 },
+    { OP_MOVE, 0, 0 },
+    { OP_END, 0, 0 },
+  };
+  const int count = sizeof(expected) / sizeof(expected[0]);
+
+  Assembler code;
+  for (const ProgramInstruction& instruction : expected) {
+    switch (instruction.op) {
+      case OP_MOVE: code.move(instruction.a); break;
+      case OP_TURN: code.turn(instruction.a); break;
+      case OP_MOVE_TURN: code.moveTurn(instruction.a, instruction.b); break;
+      case OP_PAUSE: code.pause(instruction.a); break;
+      case OP_WAIT: code.wait(instruction.a); break;
+      case OP_SPEED: code.speed(instruction.a, instruction.b); break;
+      case OP_LOOP: code.loop(instruction.a); break;
+      default: code.op(instruction.op); break;
+    }
+  }
+
+  MotionProgram program;
+  String error;
+  TEST_ASSERT_TRUE_MESSAGE(load(program, code.code, error), error.c_str());
+  TEST_ASSERT_EQUAL_INT(count, program.getInstructionCount());
+
+  size_t pc = 0;
+  for (int i = 0; i < count; i++) {
+    ProgramInstruction instruction;
+    program.decode(pc, instruction);
+    TEST_ASSERT_EQUAL_INT(expected[i].op, instruction.op);
+    TEST_ASSERT_EQUAL_INT(expected[i].a, instruction.a);
+    TEST_ASSERT_EQUAL_INT(expected[i].b, instruction.b);
+  }
+  TEST_ASSERT_EQUAL_UINT32(code.code.size(), pc);
+}
+
+void test_analysis_matches_unrolled() {
+  assertSameAnalysis(Assembler().move(1500).turn(30).pause(200).end().code, "lineal");
+  // Ida y vuelta: la envolvente queda en la primera vuelta y el juego se
+  // recupera en cada inversión
+  assertSameAnalysis(Assembler().loop(50).move(1000).move(-1000).endLoop().end().code, "vaivén");
+  // Deriva: la envolvente crece con cada vuelta
+  assertSameAnalysis(Assembler().turn(90).loop(300).moveTurn(-250, 60).turn(120).shutter().endLoop().end().code,
+                     "deriva");
+  // Velocidades y ángulo que cambian en la primera vuelta
+  assertSameAnalysis(Assembler().loop(7).move(400).speed(90, 10).turn(170).endLoop().speed(20, 20).move(-50).end().code,
+                     "estado");
+  // Bucle de una vuelta y cuerpo sin movimiento
+  assertSameAnalysis(Assembler().loop(1).move(30).endLoop().loop(9).shutter().pause(100).endLoop().end().code,
+                     "sin deriva");
+
+  Assembler nested;
+  for (int i = 0; i < MAX_PROGRAM_DEPTH; i++) nested.loop(3 + i).move(100 * (i % 2 ? -1 : 3));
+  for (int i = 0; i < MAX_PROGRAM_DEPTH; i++) nested.turn(20 * i).endLoop();
+  assertSameAnalysis(nested.end().code, "anidado");
+
+  for (int i = 0; i < 200; i++) {
+    Assembler code;
+    randomBlock(code, 0);
+    code.end();
+    if (code.code.size() > MAX_PROGRAM_BYTES) continue;
+    char name[32];
+    snprintf(name, sizeof(name), "aleatorio %d", i);
+    assertSameAnalysis(code.code, name);
+  }
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_load_accepts_valid_program);
+  RUN_TEST(test_load_rejects_size);
+  RUN_TEST(test_load_rejects_unbalanced_loops);
+  RUN_TEST(test_load_rejects_empty_loops);
+  RUN_TEST(test_load_limits_depth);
+  RUN_TEST(test_load_rejects_bytes_after_end);
+  RUN_TEST(test_load_rejects_truncated_varints);
+  RUN_TEST(test_load_rejects_varint_overflow);
+  RUN_TEST(test_load_rejects_out_of_range_arguments);
+  RUN_TEST(test_decode_round_trip);
+  RUN_TEST(test_analysis_matches_unrolled);
+  return UNITY_END();
+}